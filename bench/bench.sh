@@ -0,0 +1,103 @@
+#!/bin/bash
+# run the wasora benchmark suite and write one JSON object per workload
+# with its wall time, throughput and peak resident set size
+#
+#  usage: bench.sh [size] [output.jsonl]
+#
+# size scales every problem (default 1). results are appended to the output
+# file (default bench-<commit>.jsonl) so runs at different commits can be
+# compared with any tool that reads JSON lines
+
+size=${1:-1}
+benchdir=$(cd $(dirname $0) && pwd)
+
+if [ ! -z "${WASORA}" ]; then
+  wasorabin=${WASORA}
+elif [ -x ${benchdir}/../wasora ]; then
+  wasorabin=${benchdir}/../wasora
+elif [ ! -z "`which wasora`" ]; then
+  wasorabin=`which wasora`
+else
+  echo "do not know how to run wasora :("
+  exit 1
+fi
+
+commit=`cd ${benchdir} && git rev-parse --short HEAD 2> /dev/null || echo unknown`
+output=${2:-${benchdir}/bench-${commit}.jsonl}
+
+workdir=${benchdir}/work
+mkdir -p ${workdir}
+timefile=${workdir}/time.txt
+
+# gnu time gives us the peak rss, otherwise we can only measure wall time
+if /usr/bin/time --version 2>&1 | grep -q GNU; then
+  gnutime=1
+else
+  gnutime=0
+fi
+
+# scale an integer problem size
+function scaled {
+  awk -v n=$1 -v s=${size} -v p=${2:-1} 'BEGIN {printf("%d", n*s^p)}'
+}
+
+# runs a workload and prints its results
+#  bench <name> <units> <wasora arguments...>
+function bench {
+  name=$1
+  units=$2
+  shift 2
+  
+  if [ ${gnutime} = 1 ]; then
+    /usr/bin/time -f "%e %M" -o ${timefile} ${wasorabin} "$@" > ${workdir}/${name}.out 2> ${workdir}/${name}.err
+    status=$?
+    read wall rss <<< `tail -n1 ${timefile}`
+  else
+    start=`date +%s.%N`
+    ${wasorabin} "$@" > ${workdir}/${name}.out 2> ${workdir}/${name}.err
+    status=$?
+    wall=`awk -v a=${start} -v b=$(date +%s.%N) 'BEGIN {printf("%.3f", b-a)}'`
+    rss=null
+  fi
+  
+  throughput=`awk -v n=${units} -v t=${wall} 'BEGIN {if (t > 0) printf("%.6g", n/t); else print "null"}'`
+  
+  echo "{\"commit\": \"${commit}\", \"benchmark\": \"${name}\", \"size\": ${size}, \"units\": ${units}, \"wall\": ${wall}, \"throughput\": ${throughput}, \"max_rss_kb\": ${rss}, \"status\": ${status}}" | tee -a ${output}
+}
+
+
+# synthetic data
+n_data=`scaled 10000`
+n_mesh=`scaled 200 0.5`
+${wasorabin} ${benchdir}/gendata1d.was ${n_data} > ${workdir}/data1d.dat || exit 1
+${wasorabin} ${benchdir}/gendata2d.was ${n_data} > ${workdir}/data2d.dat || exit 1
+for format in msh vtk frd; do
+  ${benchdir}/genmesh.sh ${n_mesh} ${workdir}/square.${format} || exit 1
+done
+n_elements=$((2*n_mesh*n_mesh))
+
+# the workloads
+n=`scaled 200000`
+bench expr ${n} ${benchdir}/expr.was ${n}
+
+n=`scaled 100000`
+bench interp1d ${n} ${benchdir}/interp1d.was ${n} ${workdir}/data1d.dat
+bench interpnd ${n} ${benchdir}/interpnd.was ${n} ${workdir}/data2d.dat
+
+for format in msh vtk frd; do
+  bench mesh-load-${format} ${n_elements} ${benchdir}/mesh-load.was ${workdir}/square.${format}
+done
+
+n=`scaled 100000`
+bench mesh-integrate ${n} ${benchdir}/mesh-integrate.was ${workdir}/square.msh ${n}
+
+if [ `${wasorabin} -i | grep SUNDIAL | wc -l` != 0 ]; then
+  n=`scaled 1000`
+  bench dae ${n} ${benchdir}/dae.was ${n}
+fi
+
+n=`scaled 200`
+bench parametric ${n} ${benchdir}/parametric.was ${n}
+
+n=`scaled 100000`
+bench shm ${n} ${benchdir}/shm.was ${n}
@@ -0,0 +1,105 @@
+#!/bin/bash
+# generate a structured triangular mesh of the unit square with n x n squares
+# (each one split into two triangles) in gmsh (.msh), vtk (.vtk) or
+# calculix (.frd) format, the format is taken from the output file extension
+#
+#  usage: genmesh.sh n output.{msh,vtk,frd}
+
+if [ -z "$2" ]; then
+  echo "usage: $0 n output.{msh,vtk,frd}"
+  exit 1
+fi
+
+n=$1
+output=$2
+format=${output##*.}
+
+case ${format} in
+  msh|vtk|frd)
+    ;;
+  *)
+    echo "unknown mesh format '${format}'"
+    exit 1
+    ;;
+esac
+
+awk -v n=${n} -v format=${format} '
+function node(i, j) {
+  return j*(n+1) + i + 1
+}
+
+BEGIN {
+  n_nodes = (n+1)*(n+1)
+  n_elements = 2*n*n
+  
+  if (format == "msh") {
+    print "$MeshFormat"
+    print "2.2 0 8"
+    print "$EndMeshFormat"
+    print "$PhysicalNames"
+    print "1"
+    print "2 1 \"domain\""
+    print "$EndPhysicalNames"
+    print "$Nodes"
+    print n_nodes
+    for (j = 0; j <= n; j++) {
+      for (i = 0; i <= n; i++) {
+        printf("%d %.16g %.16g 0\n", node(i,j), i/n, j/n)
+      }
+    }
+    print "$EndNodes"
+    print "$Elements"
+    print n_elements
+    e = 0
+    for (j = 0; j < n; j++) {
+      for (i = 0; i < n; i++) {
+        printf("%d 2 2 1 1 %d %d %d\n", ++e, node(i,j), node(i+1,j), node(i+1,j+1))
+        printf("%d 2 2 1 1 %d %d %d\n", ++e, node(i,j), node(i+1,j+1), node(i,j+1))
+      }
+    }
+    print "$EndElements"
+    
+  } else if (format == "vtk") {
+    print "# vtk DataFile Version 2.0"
+    print "wasora benchmark mesh"
+    print "ASCII"
+    print "DATASET UNSTRUCTURED_GRID"
+    printf("POINTS %d double\n", n_nodes)
+    for (j = 0; j <= n; j++) {
+      for (i = 0; i <= n; i++) {
+        printf("%.16g %.16g 0\n", i/n, j/n)
+      }
+    }
+    printf("CELLS %d %d\n", n_elements, 4*n_elements)
+    for (j = 0; j < n; j++) {
+      for (i = 0; i < n; i++) {
+        printf("3 %d %d %d\n", node(i,j)-1, node(i+1,j)-1, node(i+1,j+1)-1)
+        printf("3 %d %d %d\n", node(i,j)-1, node(i+1,j+1)-1, node(i,j+1)-1)
+      }
+    }
+    printf("CELL_TYPES %d\n", n_elements)
+    for (e = 0; e < n_elements; e++) {
+      print "5"
+    }
+    
+  } else if (format == "frd") {
+    print "    1C"
+    printf("    2C%30d%37d\n", n_nodes, 1)
+    for (j = 0; j <= n; j++) {
+      for (i = 0; i <= n; i++) {
+        printf(" -1%10d%20.12e%20.12e%20.12e\n", node(i,j), i/n, j/n, 0)
+      }
+    }
+    print " -3"
+    printf("    3C%30d%37d\n", n_elements, 1)
+    e = 0
+    for (j = 0; j < n; j++) {
+      for (i = 0; i < n; i++) {
+        printf(" -1%10d%5d%5d%5d\n -2%10d%10d%10d\n", ++e, 7, 0, 1, node(i,j), node(i+1,j), node(i+1,j+1))
+        printf(" -1%10d%5d%5d%5d\n -2%10d%10d%10d\n", ++e, 7, 0, 1, node(i,j), node(i+1,j+1), node(i,j+1))
+      }
+    }
+    print " -3"
+    print " 9999"
+  }
+}' > ${output}
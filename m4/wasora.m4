@@ -45,6 +45,8 @@ AC_DEFUN([WASORA_CHECK_BASIC_LIBS],[
 AC_CHECK_LIB([rt],[shm_open])
 # idem
 AC_CHECK_LIB([pthread],[pthread_create])
+# zlib es opcional, para comprimir las salidas vtu
+AC_CHECK_LIB([z],[compress2])
 #AC_CHECK_HEADERS([sys/mman.h sys/stat.h fcntl.h],[],AC_MSG_ERROR([headers for shm_open not found]))
 
 # parece que dlopen puede estar en la libc
@@ -59,7 +61,21 @@ AC_SEARCH_LIBS([cos],[m],[],AC_MSG_ERROR([libm not found]))
 
 AC_DEFUN([WASORA_CHECK_GSL],[
 AC_CHECK_HEADER([gsl/gsl_vector.h])
-AC_CHECK_LIB([gslcblas],[cblas_dgemm])
+
+# gsl_blas can go through any cblas, e.g. --with-cblas=openblas
+AC_ARG_WITH([cblas],
+  [AS_HELP_STRING([--with-cblas=lib], [link against an optimized CBLAS library instead of gslcblas @<:@default=gslcblas@:>@])],
+  [],
+  [with_cblas=gslcblas])
+
+AS_IF([test "x$with_cblas" = "xgslcblas" -o "x$with_cblas" = "xyes" -o "x$with_cblas" = "xno"],[
+  AC_CHECK_LIB([gslcblas],[cblas_dgemm])
+],[
+  AC_CHECK_LIB([$with_cblas],[cblas_dgemm],
+    [LIBS="-l$with_cblas $LIBS"
+     ac_cv_lib_gslcblas_cblas_dgemm=yes],
+    [AC_MSG_ERROR([library $with_cblas does not provide cblas_dgemm])])
+])
 AC_CHECK_LIB([gsl],[gsl_blas_dgemm])
 
 AC_ARG_ENABLE([download-gsl],
@@ -185,6 +201,19 @@ AS_IF([test "x$ac_cv_lib_sundials_ida_IDAInit" = xyes -a "x$ac_cv_header_sundial
   ],[
    ida=0
   ])
+
+# idas es un superconjunto de ida que ademas integra sensibilidades,
+# si esta la usamos en lugar de ida (tienen los mismos simbolos)
+idas=0
+AS_IF([test $ida -eq 1],[
+   AC_CHECK_HEADER([idas/idas.h],[
+     AC_CHECK_LIB([sundials_idas], [IDASensInit],[
+       AC_DEFINE(HAVE_IDAS)
+       LIBS="-lsundials_idas `echo "$LIBS" | sed 's/-lsundials_ida //'`"
+       idas=1
+      ],[AC_MSG_WARN([sundials idas library (libsundials-idas) not found, FIT and MINIMIZE will not compute sensitivities])])
+    ])
+  ])
 ])
 
 
@@ -276,6 +305,9 @@ else
 fi
 echo "  IDA library (optional): ${ida_message}"
 echo "    differential-algebraic systems will${ida_not} be solved"
+if [[ $idas -eq 1 ]]; then
+  echo "    (with forward sensitivities through IDAS)"
+fi
 echo
 
 if [[ $readline -eq 1 ]]; then
@@ -29,115 +29,143 @@
 const char operators[]        = "&|=!<>+-*/^()";
 const char factorseparators[] = "&|=!<>+-*/^(), \t\n";
 
+// evalua un token de una expresion (sin tener en cuenta los operadores)
+// y deja el valor en factor->value
+double wasora_evaluate_factor(factor_t *factor) {
+
+  int index_i, index_j;
+
+  switch(factor->type & EXPR_BASICTYPE_MASK) {
+    case EXPR_CONSTANT:
+      factor->value = factor->constant;
+    break;
+      
+    case EXPR_VARIABLE:
+      switch (factor->type) {
+        case EXPR_VARIABLE | EXPR_CURRENT:
+          factor->value = wasora_value(factor->variable);
+        break;
+        case EXPR_VARIABLE | EXPR_INITIAL_TRANSIENT:
+          factor->value = factor->variable->initial_transient[0];
+        break;
+        case EXPR_VARIABLE | EXPR_INITIAL_STATIC:
+          factor->value = factor->variable->initial_static[0];
+        break;
+      }
+    break;
+    
+    case EXPR_VECTOR:
+  
+      if (!factor->vector->initialized) {
+        if (wasora_vector_init(factor->vector) != WASORA_RUNTIME_OK) {
+          wasora_push_error_message("initialization of vector %s failed", factor->vector->name);
+          wasora_runtime_error();
+        }
+      }
+      
+      index_i = lrint(wasora_evaluate_expression(&factor->arg[0]));
+      if (index_i <= 0 || index_i > factor->vector->size) {
+        wasora_push_error_message("subindex %d out of range for vector %s", index_i, factor->vector->name);
+        wasora_runtime_error();
+        return 0;
+      }
+
+      switch (factor->type) {
+        case EXPR_VECTOR | EXPR_CURRENT:
+          factor->value = wasora_vector_get(factor->vector, index_i-1);
+        break;
+        case EXPR_VECTOR | EXPR_INITIAL_TRANSIENT:
+          factor->value = wasora_vector_get_initial_transient(factor->vector, index_i-1);
+        break;
+        case EXPR_VECTOR | EXPR_INITIAL_STATIC:
+          factor->value = wasora_vector_get_initial_static(factor->vector, index_i-1);
+        break;
+      }
+    break;
+    
+    case EXPR_MATRIX:
+        
+      if (!factor->matrix->initialized) {
+        wasora_call(wasora_matrix_init(factor->matrix));
+      }
+  
+      index_i = lrint(wasora_evaluate_expression(&factor->arg[0]));
+      if (index_i <= 0 || index_i > factor->matrix->rows) {
+        wasora_push_error_message("row subindex %d out of range for matrix %s", index_i, factor->matrix->name);
+        wasora_runtime_error();
+        return 0;
+      }
+      index_j = (int)(round(wasora_evaluate_expression(&factor->arg[1])));
+      if (index_j <= 0 || index_j > factor->matrix->cols) {
+        wasora_push_error_message("column subindex %d out of range for matrix %s", index_j, factor->matrix->name);
+        wasora_runtime_error();
+      }
+
+      switch (factor->type) {
+        case EXPR_MATRIX | EXPR_CURRENT:
+          factor->value = gsl_matrix_get(wasora_value_ptr(factor->matrix), index_i-1, index_j-1);
+        break;
+        case EXPR_MATRIX | EXPR_INITIAL_TRANSIENT:
+          factor->value = gsl_matrix_get(factor->matrix->initial_transient, index_i-1, index_j-1);
+        break;
+        case EXPR_MATRIX | EXPR_INITIAL_STATIC:
+          factor->value = gsl_matrix_get(factor->matrix->initial_static, index_i-1, index_j-1);
+        break;
+      }
+    break;
+
+    case EXPR_BUILTIN_FUNCTION:
+      factor->value = factor->builtin_function->routine(factor);
+    break;
+    case EXPR_BUILTIN_VECTORFUNCTION:
+      factor->value = factor->builtin_vectorfunction->routine(factor->vector_arg);
+    break;
+    case EXPR_BUILTIN_FUNCTIONAL:
+      if (wasora.profile.enabled) {
+        char label[BUFFER_SIZE+16];
+        snprintf(label, BUFFER_SIZE+16, "functional %s", factor->builtin_functional->name);
+        wasora_profile_push(wasora_profile_entry("functional", label));
+        factor->value = factor->builtin_functional->routine(factor, factor->functional_var_arg);
+        wasora_profile_pop();
+      } else {
+        factor->value = factor->builtin_functional->routine(factor, factor->functional_var_arg);
+      }
+    break;
+    case EXPR_FUNCTION:
+      factor->value = wasora_evaluate_factor_function(factor);
+    break;
+  }
+
+  return factor->value;
+}
+
+
 // evalua la expresion del argumento y devuelve su valor
 double wasora_evaluate_expression(expr_t *algebraic_expr) {
 
   int i;
   int level;
   int n_tokens;
-  int index_i, index_j;
+  double value;
   factor_t *token;
   factor_t *E,*P;
 
+  // si la expresion esta compilada a codigo nativo no hay que interpretar nada
+  if (algebraic_expr != NULL && algebraic_expr->jit != NULL) {
+    if (gsl_isnan(value = algebraic_expr->jit()) || gsl_isinf(value)) {
+      wasora_push_error_message("in '%s'", algebraic_expr->string);
+      wasora_nan_error();
+    }
+    return value;
+  }
+
   if (algebraic_expr == NULL || (token = algebraic_expr->token) == NULL ||(n_tokens = algebraic_expr->n_tokens) == 0 ) {
     return 0;
   }
   
   for (i = 0; i < n_tokens; i++) {
     token[i].tmp_level = token[i].level;
-
-    switch(token[i].type & EXPR_BASICTYPE_MASK) {
-      case EXPR_CONSTANT:
-        token[i].value = token[i].constant;
-      break;
-        
-      case EXPR_VARIABLE:
-        switch (token[i].type) {
-          case EXPR_VARIABLE | EXPR_CURRENT:
-            token[i].value = wasora_value(token[i].variable);
-          break;
-          case EXPR_VARIABLE | EXPR_INITIAL_TRANSIENT:
-            token[i].value = token[i].variable->initial_transient[0];
-          break;
-          case EXPR_VARIABLE | EXPR_INITIAL_STATIC:
-            token[i].value = token[i].variable->initial_static[0];
-          break;
-        }
-      break;
-      
-      case EXPR_VECTOR:
-    
-        if (!token[i].vector->initialized) {
-          if (wasora_vector_init(token[i].vector) != WASORA_RUNTIME_OK) {
-            wasora_push_error_message("initialization of vector %s failed", token[i].vector->name);
-            wasora_runtime_error();
-          }
-        }
-        
-        index_i = lrint(wasora_evaluate_expression(&token[i].arg[0]));
-        if (index_i <= 0 || index_i > token[i].vector->size) {
-          wasora_push_error_message("subindex %d out of range for vector %s", index_i, token[i].vector->name);
-          wasora_runtime_error();
-          return 0;
-        }
-
-        switch (token[i].type) {
-          case EXPR_VECTOR | EXPR_CURRENT:
-            token[i].value = wasora_vector_get(token[i].vector, index_i-1);
-          break;
-          case EXPR_VECTOR | EXPR_INITIAL_TRANSIENT:
-            token[i].value = wasora_vector_get_initial_transient(token[i].vector, index_i-1);
-          break;
-          case EXPR_VECTOR | EXPR_INITIAL_STATIC:
-            token[i].value = wasora_vector_get_initial_static(token[i].vector, index_i-1);
-          break;
-        }
-      break;
-      
-      case EXPR_MATRIX:
-          
-        if (!token[i].matrix->initialized) {
-          wasora_call(wasora_matrix_init(token[i].matrix));
-        }
-    
-        index_i = lrint(wasora_evaluate_expression(&token[i].arg[0]));
-        if (index_i <= 0 || index_i > token[i].matrix->rows) {
-          wasora_push_error_message("row subindex %d out of range for matrix %s", index_i, token[i].matrix->name);
-          wasora_runtime_error();
-          return 0;
-        }
-        index_j = (int)(round(wasora_evaluate_expression(&token[i].arg[1])));
-        if (index_j <= 0 || index_j > token[i].matrix->cols) {
-          wasora_push_error_message("column subindex %d out of range for matrix %s", index_j, token[i].matrix->name);
-          wasora_runtime_error();
-        }
-
-        switch (token[i].type) {
-          case EXPR_MATRIX | EXPR_CURRENT:
-            token[i].value = gsl_matrix_get(wasora_value_ptr(token[i].matrix), index_i-1, index_j-1);
-          break;
-          case EXPR_MATRIX | EXPR_INITIAL_TRANSIENT:
-            token[i].value = gsl_matrix_get(token[i].matrix->initial_transient, index_i-1, index_j-1);
-          break;
-          case EXPR_MATRIX | EXPR_INITIAL_STATIC:
-            token[i].value = gsl_matrix_get(token[i].matrix->initial_static, index_i-1, index_j-1);
-          break;
-        }
-      break;
-
-      case EXPR_BUILTIN_FUNCTION:
-        token[i].value = token[i].builtin_function->routine(&token[i]);
-      break;
-      case EXPR_BUILTIN_VECTORFUNCTION:
-        token[i].value = token[i].builtin_vectorfunction->routine(token[i].vector_arg);
-      break;
-      case EXPR_BUILTIN_FUNCTIONAL:
-        token[i].value = token[i].builtin_functional->routine(&token[i], token[i].functional_var_arg);
-      break;
-      case EXPR_FUNCTION:
-        token[i].value = wasora_evaluate_factor_function(&token[i]);
-      break;
-    }
+    wasora_evaluate_factor(&token[i]);
   }
 
   level = 0;
@@ -242,6 +270,8 @@ double wasora_evaluate_expression_in_string(const char *string) {
 //  parsea una cadena conteniendo una expresion algebraica y rellena la estructura algebraic_expr
 int wasora_parse_expression(const char *string, expr_t *expr) {
 
+  int i;
+  
   if (string == NULL || strcmp(string, "") == 0) {
     return WASORA_PARSER_OK;
   }
@@ -273,6 +303,11 @@ int wasora_parse_expression(const char *string, expr_t *expr) {
     return WASORA_PARSER_ERROR;
   }
 
+  // los que tienen estado (lag, integral_dt, random, etc) van a los checkpoints
+  for (i = 0; i < expr->n_tokens; i++) {
+    wasora_checkpoint_register_factor(&expr->token[i]);
+  }
+
   free(string_local_copy);
 
   return WASORA_PARSER_OK;
@@ -0,0 +1,250 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora contiguous storage for variables, vectors and matrices
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#ifndef _WASORA_H_
+#include "wasora.h"
+#endif
+
+// returns true if some re-pointed variable or some pointwise function keeps
+// a raw pointer into the n doubles starting at data, in which case we cannot
+// move them to the arena without leaving the pointer dangling
+static int wasora_arena_is_referenced(const double *data, size_t n) {
+
+  var_t *var;
+  function_t *function;
+  int i;
+
+  for (var = wasora.vars; var != NULL; var = var->hh.next) {
+    if (var->realloced && wasora_value_ptr(var) >= data && wasora_value_ptr(var) < data+n) {
+      return 1;
+    }
+  }
+
+  for (function = wasora.functions; function != NULL; function = function->hh.next) {
+    if (function->data_argument != NULL) {
+      for (i = 0; i < function->n_arguments; i++) {
+        if (function->data_argument[i] != NULL && function->data_argument[i] >= data && function->data_argument[i] < data+n) {
+          return 1;
+        }
+      }
+    }
+    if (function->data_value != NULL && function->data_value >= data && function->data_value < data+n) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int wasora_arena_vector_movable(vector_t *vector) {
+  return vector->initialized && vector->realloced == 0 &&
+         wasora_value_ptr(vector)->stride == 1 && wasora_value_ptr(vector)->owner &&
+         wasora_arena_is_referenced(gsl_vector_ptr(wasora_value_ptr(vector), 0), vector->size) == 0;
+}
+
+static int wasora_arena_vector_reservable(vector_t *vector) {
+  return vector->initialized == 0 && vector->size > 0 &&
+         vector->function_data == NULL && vector->function_arg == NULL;
+}
+
+static int wasora_arena_matrix_movable(matrix_t *matrix) {
+  return matrix->initialized && matrix->realloced == 0 &&
+         wasora_value_ptr(matrix)->tda == matrix->cols && wasora_value_ptr(matrix)->owner &&
+         wasora_arena_is_referenced(gsl_matrix_ptr(wasora_value_ptr(matrix), 0, 0), matrix->rows*matrix->cols) == 0;
+}
+
+// the gsl object keeps its struct but its data now lives in the arena
+static void wasora_arena_adopt_vector(gsl_vector *v, double *data) {
+
+  memcpy(data, v->data, v->size * sizeof(double));
+  if (v->owner) {
+    gsl_block_free(v->block);
+  }
+  v->block = NULL;
+  v->owner = 0;
+  v->data = data;
+
+  return;
+}
+
+static void wasora_arena_adopt_matrix(gsl_matrix *m, double *data) {
+
+  memcpy(data, m->data, m->size1*m->size2 * sizeof(double));
+  if (m->owner) {
+    gsl_block_free(m->block);
+  }
+  m->block = NULL;
+  m->owner = 0;
+  m->data = data;
+
+  return;
+}
+
+// a gsl_vector that does not own its data, just as those returned by
+// gsl_vector_alloc_from_block() so gsl_vector_free() only frees the struct
+gsl_vector *wasora_arena_gsl_vector(double *data, size_t size) {
+
+  gsl_vector *v = calloc(1, sizeof(gsl_vector));
+
+  v->size = size;
+  v->stride = 1;
+  v->data = data;
+  v->block = NULL;
+  v->owner = 0;
+
+  return v;
+}
+
+
+// after parsing we know (almost) all the symbols so we move their storage
+// to three planes (current, initial static and initial transient values)
+// of a single block, so evaluating expressions touches contiguous memory
+// and the whole state can be saved and restored with a single memcpy
+int wasora_arena_init(void) {
+
+  var_t *var;
+  vector_t *vector;
+  matrix_t *matrix;
+  double *plane[3];
+  size_t size, offset;
+
+  if (wasora.arena.block != NULL) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  size = 0;
+  for (var = wasora.vars; var != NULL; var = var->hh.next) {
+    size++;
+  }
+  for (vector = wasora.vectors; vector != NULL; vector = vector->hh.next) {
+    if (wasora_arena_vector_movable(vector) || wasora_arena_vector_reservable(vector)) {
+      size += vector->size;
+    }
+  }
+  for (matrix = wasora.matrices; matrix != NULL; matrix = matrix->hh.next) {
+    if (wasora_arena_matrix_movable(matrix)) {
+      size += matrix->rows*matrix->cols;
+    }
+  }
+
+  if (size == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  // each plane starts on a cache line
+  size = 8*((size+7)/8);
+  if (posix_memalign((void **)&wasora.arena.block, 64, 3*size * sizeof(double)) != 0) {
+    wasora_push_error_message("cannot allocate %ld bytes for the symbol arena", (long)(3*size * sizeof(double)));
+    return WASORA_RUNTIME_ERROR;
+  }
+  memset(wasora.arena.block, 0, 3*size * sizeof(double));
+  wasora.arena.size = size;
+  wasora.arena.value = plane[0] = wasora.arena.block;
+  wasora.arena.initial_static = plane[1] = wasora.arena.block + size;
+  wasora.arena.initial_transient = plane[2] = wasora.arena.block + 2*size;
+
+  offset = 0;
+  for (var = wasora.vars; var != NULL; var = var->hh.next) {
+    // re-pointed variables keep pointing to wherever they point to
+    if (var->realloced == 0) {
+      plane[0][offset] = wasora_value(var);
+      free(wasora_value_ptr(var));
+      wasora_value_ptr(var) = &plane[0][offset];
+    }
+    plane[1][offset] = var->initial_static[0];
+    free(var->initial_static);
+    var->initial_static = &plane[1][offset];
+    plane[2][offset] = var->initial_transient[0];
+    free(var->initial_transient);
+    var->initial_transient = &plane[2][offset];
+    offset++;
+  }
+
+  for (vector = wasora.vectors; vector != NULL; vector = vector->hh.next) {
+    if (wasora_arena_vector_movable(vector)) {
+      wasora_arena_adopt_vector(wasora_value_ptr(vector), &plane[0][offset]);
+      wasora_arena_adopt_vector(vector->initial_static, &plane[1][offset]);
+      wasora_arena_adopt_vector(vector->initial_transient, &plane[2][offset]);
+      offset += vector->size;
+    } else if (wasora_arena_vector_reservable(vector)) {
+      // wasora_vector_init() will take it from here
+      vector->arena_reserved = 1;
+      vector->arena_offset = offset;
+      offset += vector->size;
+    }
+  }
+
+  for (matrix = wasora.matrices; matrix != NULL; matrix = matrix->hh.next) {
+    if (wasora_arena_matrix_movable(matrix)) {
+      wasora_arena_adopt_matrix(wasora_value_ptr(matrix), &plane[0][offset]);
+      wasora_arena_adopt_matrix(matrix->initial_static, &plane[1][offset]);
+      wasora_arena_adopt_matrix(matrix->initial_transient, &plane[2][offset]);
+      offset += matrix->rows*matrix->cols;
+    }
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+int wasora_arena_contains(const double *ptr) {
+  return wasora.arena.block != NULL && ptr >= wasora.arena.block && ptr < wasora.arena.block + 3*wasora.arena.size;
+}
+
+// frees a pointer to a scalar unless it lives in the arena
+void wasora_arena_free(double *ptr) {
+
+  if (wasora_arena_contains(ptr) == 0) {
+    free(ptr);
+  }
+
+  return;
+}
+
+// buffer has to hold 3*wasora.arena.size doubles
+void wasora_arena_save(double *buffer) {
+
+  if (wasora.arena.block != NULL) {
+    memcpy(buffer, wasora.arena.block, 3*wasora.arena.size * sizeof(double));
+  }
+
+  return;
+}
+
+void wasora_arena_restore(const double *buffer) {
+
+  if (wasora.arena.block != NULL) {
+    memcpy(wasora.arena.block, buffer, 3*wasora.arena.size * sizeof(double));
+  }
+
+  return;
+}
+
+void wasora_arena_finalize(void) {
+
+  wasora_free(wasora.arena.block);
+  wasora.arena.value = NULL;
+  wasora.arena.initial_static = NULL;
+  wasora.arena.initial_transient = NULL;
+  wasora.arena.size = 0;
+
+  return;
+}
@@ -35,6 +35,11 @@ int wasora_instruction_assignment(void *arg) {
   
   wasora_call(wasora_get_assignment_array_boundaries(assignment, &i_min, &i_max, &j_min, &j_max));
  
+  // los vectores y matrices van todos juntos
+  if (assignment->variable == NULL && assignment->scalar == 0) {
+    return wasora_assign_array(assignment, i_min, i_max, j_min, j_max);
+  }
+  
   for (i = i_min; i < i_max; i++) {
     for (j = j_min; j < j_max; j++) {
       wasora_call(wasora_get_assignment_rowcol(assignment, i, j, &row, &col));
@@ -153,6 +158,8 @@ void wasora_check_initial_vector(vector_t *vector) {
     if (!vector->initialized) {
       wasora_vector_init(vector);
     }
+    // se llama despues de escribir el vector, asi que cambio
+    vector->version++;
     if (wasora_var(wasora_special_var(in_static))) {
       gsl_vector_memcpy(vector->initial_transient, wasora_value_ptr(vector));
       if ((int)(wasora_var(wasora_special_var(step_static))) == 1) {
@@ -248,6 +255,11 @@ int wasora_assign_scalar(assignment_t *assignment, int row, int col) {
   if (constant && ((int)(wasora_var(wasora_special_var(step_static))) != 1 || (int)(wasora_var(wasora_special_var(step_transient))) != 0)) {
     return WASORA_RUNTIME_OK;
   }
+
+  // las funciones que interpolan datos de este vector tienen que enterarse
+  if (assignment->vector != NULL) {
+    assignment->vector->version++;
+  }
   
   if (assignment->initial_static) {
     // si pide _init solo asignamos si estamos en static_step y en el paso uno
@@ -337,3 +349,191 @@ int wasora_assign_scalar(assignment_t *assignment, int row, int col) {
 }
 
 
+
+// ejecuta una asignacion sobre un rango de elementos de un vector o matriz
+// todo lo que no depende del elemento (constantes, _0, _init, rangos de tiempo
+// y otras asignaciones que le ganan) se resuelve una unica vez y despues
+// es un loop que evalua el miembro derecho y escribe directo en la memoria
+int wasora_assign_array(assignment_t *assignment, int i_min, int i_max, int j_min, int j_max) {
+
+  assignment_t *other;
+  gsl_vector *vector[3];
+  gsl_matrix *matrix[3];
+  double *data[3];
+  size_t stride[3];
+  size_t col_stride;
+  double *special_i = wasora_value_ptr(wasora_special_var(i));
+  double *special_j = wasora_value_ptr(wasora_special_var(j));
+  double t_min, t_max;
+  double value;
+  char *skip = NULL;
+  int constant;
+  int write_static, write_transient;
+  int in_static = (int)(wasora_var(wasora_special_var(in_static)));
+  int first_step = (int)(wasora_var(wasora_special_var(step_static))) == 1;
+  int rows, cols;
+  int row, col;
+  int i, j, k;
+  int other_i_min, other_i_max, other_j_min, other_j_max;
+
+  if (assignment->vector != NULL) {
+    if (!assignment->vector->initialized) {
+      wasora_call(wasora_vector_init(assignment->vector));
+    }
+    constant = assignment->vector->constant;
+    vector[0] = wasora_value_ptr(assignment->vector);
+    vector[1] = assignment->vector->initial_static;
+    vector[2] = assignment->vector->initial_transient;
+    for (k = 0; k < 3; k++) {
+      data[k] = vector[k]->data;
+      stride[k] = vector[k]->stride;
+    }
+    col_stride = 0;
+    rows = assignment->vector->size;
+    cols = 1;
+    
+  } else if (assignment->matrix != NULL) {
+    if (!assignment->matrix->initialized) {
+      wasora_call(wasora_matrix_init(assignment->matrix));
+    }
+    constant = assignment->matrix->constant;
+    matrix[0] = wasora_value_ptr(assignment->matrix);
+    matrix[1] = assignment->matrix->initial_static;
+    matrix[2] = assignment->matrix->initial_transient;
+    for (k = 0; k < 3; k++) {
+      data[k] = matrix[k]->data;
+      stride[k] = matrix[k]->tda;
+    }
+    col_stride = 1;
+    rows = assignment->matrix->rows;
+    cols = assignment->matrix->cols;
+    
+  } else {
+    return WASORA_RUNTIME_OK;
+  }
+
+  // si tenemos constant y no estamos el primer paso, a comerla
+  if (constant && (first_step == 0 || (int)(wasora_var(wasora_special_var(step_transient))) != 0)) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  if (assignment->initial_static) {
+    // si pide _init solo asignamos si estamos en static_step y en el paso uno
+    if (in_static == 0 || first_step == 0) {
+      return WASORA_RUNTIME_OK;
+    }
+    write_static = 1;
+    write_transient = 1;
+    
+  } else if (assignment->initial_transient) {
+    // si pide _0 solo asignamos si estamos en static_step
+    if (in_static == 0) {
+      return WASORA_RUNTIME_OK;
+    }
+    write_static = 0;
+    write_transient = 1;
+    
+  } else if (assignment->t_min.n_tokens != 0) {
+    t_min = wasora_evaluate_expression(&assignment->t_min);
+    t_max = wasora_evaluate_expression(&assignment->t_max);
+    if (wasora_var(wasora_special_var(time)) < t_min || wasora_var(wasora_special_var(time)) >= t_max) {
+      return WASORA_RUNTIME_OK;
+    }
+    write_static = 0;
+    write_transient = 0;
+    
+  } else {
+    
+    if (assignment->initialized == 0) {
+      LL_FOREACH(wasora.assignments, other) {
+        if (other != assignment && ((other->vector != NULL && other->vector == assignment->vector) ||
+                                    (other->matrix != NULL && other->matrix == assignment->matrix))) {
+          assignment->others = realloc(assignment->others, (assignment->n_others+1) * sizeof(assignment_t *));
+          assignment->others[assignment->n_others++] = other;
+        }
+      }
+      assignment->initialized = 1;
+    }
+    
+    // si hay algun assignment con rango de tiempo que se cumple o con _init
+    // gana ese, y si alguno tiene _0 gana en los elementos que asigna
+    for (k = 0; k < assignment->n_others; k++) {
+      other = assignment->others[k];
+      
+      if (other->t_min.n_tokens != 0) {
+        t_min = wasora_evaluate_expression(&other->t_min);
+        t_max = wasora_evaluate_expression(&other->t_max);
+        if (wasora_var(wasora_special_var(time)) >= t_min && wasora_var(wasora_special_var(time)) < t_max) {
+          free(skip);
+          return WASORA_RUNTIME_OK;
+        }
+      }
+      
+      if (in_static && first_step && other->initial_static) {
+        free(skip);
+        return WASORA_RUNTIME_OK;
+      }
+      
+      if (in_static && other->initial_transient) {
+        if (skip == NULL) {
+          skip = calloc(rows*cols, sizeof(char));
+        }
+        wasora_call(wasora_get_assignment_array_boundaries(other, &other_i_min, &other_i_max, &other_j_min, &other_j_max));
+        for (i = other_i_min; i < other_i_max; i++) {
+          for (j = other_j_min; j < other_j_max; j++) {
+            wasora_call(wasora_get_assignment_rowcol(other, i, j, &row, &col));
+            if (row >= 0 && row < rows && col >= 0 && col < cols) {
+              skip[row*cols + col] = 1;
+            }
+          }
+        }
+      }
+    }
+    
+    write_static = in_static && first_step;
+    write_transient = in_static;
+  }
+
+  if (assignment->vector != NULL) {
+    assignment->vector->version++;
+  }
+  
+  for (i = i_min; i < i_max; i++) {
+    *special_i = (double)(i+1);
+    for (j = j_min; j < j_max; j++) {
+      *special_j = (double)(j+1);
+      
+      if (assignment->plain) {
+        row = i;
+        col = j;
+      } else {
+        row = (assignment->row.n_tokens != 0) ? (int)(wasora_evaluate_expression(&assignment->row))-1 : 0;
+        col = (assignment->col.n_tokens != 0) ? (int)(wasora_evaluate_expression(&assignment->col))-1 : 0;
+      }
+      
+      if (row < 0 || row >= rows || col < 0 || col >= cols) {
+        wasora_push_error_message("index (%d,%d) out of range in assignment of '%s'", row+1, col+1, (assignment->vector != NULL) ? assignment->vector->name : assignment->matrix->name);
+        free(skip);
+        return WASORA_RUNTIME_ERROR;
+      }
+      
+      if (skip != NULL && skip[row*cols + col]) {
+        continue;
+      }
+      
+      value = wasora_evaluate_expression(&assignment->rhs);
+      data[0][row*stride[0] + col*col_stride] = value;
+      if (write_transient) {
+        data[2][row*stride[2] + col*col_stride] = value;
+      }
+      if (write_static) {
+        data[1][row*stride[1] + col*col_stride] = value;
+      }
+    }
+  }
+  
+  free(skip);
+
+  return WASORA_RUNTIME_OK;
+
+}
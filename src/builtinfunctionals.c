@@ -23,6 +23,7 @@
 #ifndef _WASORA_H_
 #include "wasora.h"
 #endif
+#include "builtindecl.h"
 
 // from gsl/roots/root.h
 #define SAFE_FUNC_CALL(f, x, yp) \
@@ -38,6 +39,369 @@ typedef struct {
   var_t *variable;
 } gsl_function_arguments_t;
 
+// lo que cada token de integral() o gauss_legendre() se guarda en aux
+// para no tener que alocar y liberar cosas cada vez que se evalua
+#define CUBATURE_MAX_DIMENSIONS   8
+
+// a chain integral(integral(...)) over a hyper-rectangle, outermost first
+typedef struct {
+  int dimensions;
+  factor_t *level[CUBATURE_MAX_DIMENSIONS];
+  var_t *variable[CUBATURE_MAX_DIMENSIONS];
+  expr_t *integrand;
+
+  // the nodes of the genz-malik rule over [-1,1]^n and their values
+  int n_points;
+  double *node;
+  double *value;
+} cubature_nest_t;
+
+typedef struct {
+  double center[CUBATURE_MAX_DIMENSIONS];
+  double halfwidth[CUBATURE_MAX_DIMENSIONS];
+  double result;
+  double error;
+  int split;
+} cubature_region_t;
+
+typedef struct {
+  int busy;
+
+  size_t limit;
+  gsl_integration_workspace *workspace;
+
+#ifdef HAVE_GLFIXED_TABLE
+  size_t n;
+  gsl_integration_glfixed_table *table;
+#endif
+
+  int nest_checked;
+  cubature_nest_t nest;
+  size_t max_regions;
+  cubature_region_t *region;
+} functional_workspace_t;
+
+// genz-malik degree-seven rule with an embedded degree-five one
+#define CUBATURE_LAMBDA2   0.35856858280031809199   // sqrt(9/70)
+#define CUBATURE_LAMBDA4   0.94868329805051379960   // sqrt(9/10)
+#define CUBATURE_LAMBDA5   0.68824720161168529772   // sqrt(9/19)
+
+static functional_workspace_t *wasora_functional_workspace(factor_t *a) {
+
+  // como el random generator, aux no tiene por que ser un double
+  if (a->aux == NULL) {
+    a->aux = (double *)calloc(1, sizeof(functional_workspace_t));
+  }
+
+  return (functional_workspace_t *)a->aux;
+}
+
+// returns true if the value of the expression may change with var, user
+// functions can read any variable so we assume they always do
+static int wasora_expression_depends_on(expr_t *expr, var_t *var) {
+
+  factor_t *token;
+  int i, j, n;
+
+  for (i = 0; i < expr->n_tokens; i++) {
+    token = &expr->token[i];
+    switch (token->type & EXPR_BASICTYPE_MASK) {
+      case EXPR_VARIABLE:
+        if (token->variable == var) {
+          return 1;
+        }
+        n = 0;
+      break;
+      case EXPR_VECTOR:
+        n = 1;
+      break;
+      case EXPR_MATRIX:
+        n = 2;
+      break;
+      case EXPR_BUILTIN_FUNCTION:
+        n = token->builtin_function->max_arguments;
+      break;
+      case EXPR_BUILTIN_FUNCTIONAL:
+        n = token->builtin_functional->max_arguments;
+      break;
+      case EXPR_FUNCTION:
+        return 1;
+      break;
+      default:
+        n = 0;
+      break;
+    }
+
+    if (token->arg != NULL) {
+      for (j = 0; j < n; j++) {
+        if (wasora_expression_depends_on(&token->arg[j], var)) {
+          return 1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+// if the integrand of a is itself a single integral() and so on, and none of
+// the limits depend on the integration variables, the whole chain is a
+// single integral over a hyper-rectangle that we can do with a cubature
+static void wasora_integral_nest(factor_t *a, var_t *var_x, cubature_nest_t *nest) {
+
+  factor_t *level = a;
+  double *node;
+  int n, p, i, j, k, mask;
+
+  nest->dimensions = 0;
+  nest->level[0] = a;
+  nest->variable[0] = var_x;
+  n = 1;
+
+  while (n < CUBATURE_MAX_DIMENSIONS && level->arg[0].n_tokens == 1 &&
+         (level->arg[0].token[0].type & EXPR_BASICTYPE_MASK) == EXPR_BUILTIN_FUNCTIONAL &&
+         level->arg[0].token[0].builtin_functional->routine == builtin_integral) {
+    level = &level->arg[0].token[0];
+    for (j = 0; j < n; j++) {
+      if (nest->variable[j] == level->functional_var_arg) {
+        return;
+      }
+    }
+    nest->level[n] = level;
+    nest->variable[n] = level->functional_var_arg;
+    n++;
+  }
+
+  if (n < 2) {
+    return;
+  }
+
+  for (k = 0; k < n; k++) {
+    for (i = 2; i <= 3; i++) {
+      for (j = 0; j < n; j++) {
+        if (wasora_expression_depends_on(&nest->level[k]->arg[i], nest->variable[j])) {
+          return;
+        }
+      }
+    }
+  }
+
+  // the center, 4n points along the axes, 2n(n-1) points on the planes
+  // spanned by each pair of axes and the 2^n corners, all of them over [-1,1]^n
+  nest->n_points = 1 + 4*n + 2*n*(n-1) + (1<<n);
+  nest->node = calloc(nest->n_points*n, sizeof(double));
+  nest->value = calloc(nest->n_points, sizeof(double));
+
+  p = 1;
+  for (i = 0; i < n; i++) {
+    node = &nest->node[n*p];
+    node[i] = -CUBATURE_LAMBDA2;
+    node[n+i] = +CUBATURE_LAMBDA2;
+    node[2*n+i] = -CUBATURE_LAMBDA4;
+    node[3*n+i] = +CUBATURE_LAMBDA4;
+    p += 4;
+  }
+  for (i = 0; i < n; i++) {
+    for (j = i+1; j < n; j++) {
+      for (k = 0; k < 4; k++) {
+        nest->node[n*p + i] = (k & 1) ? +CUBATURE_LAMBDA4 : -CUBATURE_LAMBDA4;
+        nest->node[n*p + j] = (k & 2) ? +CUBATURE_LAMBDA4 : -CUBATURE_LAMBDA4;
+        p++;
+      }
+    }
+  }
+  for (mask = 0; mask < (1<<n); mask++) {
+    for (i = 0; i < n; i++) {
+      nest->node[n*p + i] = ((mask >> i) & 1) ? +CUBATURE_LAMBDA5 : -CUBATURE_LAMBDA5;
+    }
+    p++;
+  }
+
+  nest->integrand = &level->arg[0];
+  nest->dimensions = n;
+
+  return;
+}
+
+// integrates over one region and chooses the axis it should be split along
+static void wasora_cubature_rule(cubature_nest_t *nest, cubature_region_t *region) {
+
+  int n = nest->dimensions;
+  double *f = nest->value;
+  double volume, f0, sum2, sum3, sum4, sum5;
+  double diff, max_diff;
+  double r7, r5;
+  int p, i;
+
+  // first the integrand at all the nodes of the region in a single batch
+  for (p = 0; p < nest->n_points; p++) {
+    for (i = 0; i < n; i++) {
+      wasora_value(nest->variable[i]) = region->center[i] + region->halfwidth[i]*nest->node[n*p + i];
+    }
+    f[p] = wasora_evaluate_expression(nest->integrand);
+    if (gsl_isnan(f[p]) || gsl_isinf(f[p])) {
+      wasora_nan_error();
+    }
+  }
+
+  // and then the weighted sums
+  volume = 1;
+  f0 = f[0];
+  sum2 = sum3 = sum4 = sum5 = 0;
+  max_diff = 0;
+  region->split = 0;
+  for (i = 0; i < n; i++) {
+    volume *= 2*region->halfwidth[i];
+    p = 1 + 4*i;
+    sum2 += f[p] + f[p+1];
+    sum3 += f[p+2] + f[p+3];
+
+    // fourth difference along axis i, ties go to the widest axis
+    diff = fabs(f[p] + f[p+1] - 2*f0 - (f[p+2] + f[p+3] - 2*f0)/7.0);
+    if (i == 0 || diff > (1+1e-10)*max_diff) {
+      region->split = i;
+      max_diff = diff;
+    } else if (diff >= (1-1e-10)*max_diff && fabs(region->halfwidth[i]) > fabs(region->halfwidth[region->split])) {
+      region->split = i;
+    }
+  }
+  for (p = 1+4*n; p < 1+4*n+2*n*(n-1); p++) {
+    sum4 += f[p];
+  }
+  for (; p < nest->n_points; p++) {
+    sum5 += f[p];
+  }
+
+  r7 = volume * ((12824.0 - 9120.0*n + 400.0*n*n)/19683.0 * f0 +
+                 980.0/6561.0 * sum2 +
+                 (1820.0 - 400.0*n)/19683.0 * sum3 +
+                 200.0/19683.0 * sum4 +
+                 6859.0/19683.0/(1<<n) * sum5);
+  r5 = volume * ((729.0 - 950.0*n + 50.0*n*n)/729.0 * f0 +
+                 245.0/486.0 * sum2 +
+                 (265.0 - 100.0*n)/1458.0 * sum3 +
+                 25.0/729.0 * sum4);
+
+  region->result = r7;
+  region->error = fabs(r7 - r5);
+
+  return;
+}
+
+// binary max-heap of regions keyed by their error
+static void wasora_cubature_heap_push(cubature_region_t *heap, size_t n, cubature_region_t *region) {
+
+  size_t parent;
+
+  while (n > 0 && heap[parent = (n-1)/2].error < region->error) {
+    heap[n] = heap[parent];
+    n = parent;
+  }
+  heap[n] = *region;
+
+  return;
+}
+
+static void wasora_cubature_heap_pop(cubature_region_t *heap, size_t n, cubature_region_t *top) {
+
+  cubature_region_t last;
+  size_t i, child;
+
+  *top = heap[0];
+  last = heap[--n];
+  i = 0;
+  while ((child = 2*i+1) < n) {
+    if (child+1 < n && heap[child+1].error > heap[child].error) {
+      child++;
+    }
+    if (heap[child].error <= last.error) {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
+  }
+  if (n > 0) {
+    heap[i] = last;
+  }
+
+  return;
+}
+
+// adaptive cubature over the nest, always bisecting the region with the
+// largest error estimate until the total one is small enough
+static int wasora_cubature(functional_workspace_t *ws, double epsrel, int intervals, double *result) {
+
+  cubature_nest_t *nest = &ws->nest;
+  cubature_region_t parent, half;
+  double x_old[CUBATURE_MAX_DIMENSIONS];
+  double lower, upper;
+  double error;
+  size_t max_regions, n_regions, j;
+  int n = nest->dimensions;
+  int i, d;
+
+  for (i = 0; i < n; i++) {
+    lower = wasora_evaluate_expression(&nest->level[i]->arg[2]);
+    upper = wasora_evaluate_expression(&nest->level[i]->arg[3]);
+    if (fabs(lower) > 0.9*wasora_var(wasora_special_var(infinite)) || fabs(upper) > 0.9*wasora_var(wasora_special_var(infinite))) {
+      return 1;
+    }
+    parent.center[i] = 0.5*(lower+upper);
+    parent.halfwidth[i] = 0.5*(upper-lower);
+  }
+
+  max_regions = (size_t)intervals * n;
+  if (ws->max_regions < max_regions) {
+    ws->region = realloc(ws->region, max_regions * sizeof(cubature_region_t));
+    ws->max_regions = max_regions;
+  }
+
+  for (i = 0; i < n; i++) {
+    x_old[i] = wasora_value(nest->variable[i]);
+  }
+
+  wasora_cubature_rule(nest, &parent);
+  ws->region[0] = parent;
+  n_regions = 1;
+  *result = parent.result;
+  error = parent.error;
+
+  while (error > GSL_MAX(1e-8, epsrel*fabs(*result)) && n_regions < max_regions) {
+    wasora_cubature_heap_pop(ws->region, n_regions--, &parent);
+    *result -= parent.result;
+    error -= parent.error;
+
+    d = parent.split;
+    half = parent;
+    half.halfwidth[d] *= 0.5;
+
+    half.center[d] = parent.center[d] - half.halfwidth[d];
+    wasora_cubature_rule(nest, &half);
+    *result += half.result;
+    error += half.error;
+    wasora_cubature_heap_push(ws->region, n_regions++, &half);
+
+    half.center[d] = parent.center[d] + half.halfwidth[d];
+    wasora_cubature_rule(nest, &half);
+    *result += half.result;
+    error += half.error;
+    wasora_cubature_heap_push(ws->region, n_regions++, &half);
+  }
+
+  // the running sum accumulates round-off so we add everything up again
+  *result = 0;
+  for (j = 0; j < n_regions; j++) {
+    *result += ws->region[j].result;
+  }
+
+  for (i = 0; i < n; i++) {
+    wasora_value(nest->variable[i]) = x_old[i];
+  }
+
+  return 0;
+}
+
+
 
 ///fu+derivative+name derivative
 ///fu+derivative+usage derivative(f(x), x, a, [h], [p])
@@ -50,7 +414,9 @@ typedef struct {
 ///fu+derivative+desc The fifth optional argument $p$ is a flag that indicates
 ///fu+derivative+desc whether a backward ($p < 0$), centered ($p = 0$) or forward ($p > 0$)
 ///fu+derivative+desc stencil is to be used.
-///fu+derivative+desc This functional calls the GSL functions
+///fu+derivative+desc If neither $h$ nor $p$ are given and $f(x)$ involves only operators, elementary
+///fu+derivative+desc built-in functions and user-defined functions, the derivative is computed exactly
+///fu+derivative+desc using dual numbers. Otherwise, this functional calls the GSL functions
 ///fu+derivative+desc`gsl_deriv_backward`, `gsl_deriv_central` or `gsl_deriv_forward`
 ///fu+derivative+desc according to the indicated flag $p$.
 ///fu+derivative+desc Defaults are $h = (1/2)^{-10} \approx 9.8 \times 10^{-4}$ and $p = 0$.
@@ -71,6 +437,21 @@ double builtin_derivative(factor_t *a, var_t *var_x) {
   x_old = wasora_value(var_x);
 
   x = wasora_evaluate_expression(&a->arg[2]);
+
+  // if neither the step nor the stencil are given we first try to get the
+  // exact derivative with dual numbers and fall back to finite differences
+  if (a->arg[3].n_tokens == 0 && a->arg[4].n_tokens == 0) {
+    double *wrt = wasora_value_ptr(var_x);
+    double value;
+
+    wasora_value(var_x) = x;
+    if (wasora_evaluate_expression_dual(&a->arg[0], 1, &wrt, &value, &result) == WASORA_RUNTIME_OK) {
+      wasora_value(var_x) = x_old;
+      return result;
+    }
+    wasora_value(var_x) = x_old;
+  }
+
   if ((h = wasora_evaluate_expression(&a->arg[3])) == 0) {
     h = DEFAULT_DERIVATIVE_STEP;
   }
@@ -133,6 +514,12 @@ double builtin_derivative(factor_t *a, var_t *var_x) {
 ///fu+integral+desc integrands, the adaptive algorithm may be too expensive or even fail
 ///fu+integral+desc to converge. In these cases, non-adaptive quadrature functionals ought to
 ///fu+integral+desc be used instead.
+///fu+integral+desc If the integrand is itself an `integral` (and so on) and none of the
+///fu+integral+desc limits of the nested integrals depend on any of the integration variables,
+///fu+integral+desc the whole chain is computed as a single multidimensional integral over a
+///fu+integral+desc hyper-rectangle by means of an adaptive Genz-Malik cubature, with the
+///fu+integral+desc tolerance $\epsilon$ and the maximum number of subdivisions of the outermost
+///fu+integral+desc integral times the number of dimensions as the maximum number of subregions.
 ///fu+integral+desc See GSL reference for further information.
 ///fu+integral+math \int_a^b f(x) \, dx  
 ///fu+integral+example integral1.was integral2.was integral3.was
@@ -148,17 +535,13 @@ double builtin_integral(factor_t *a, var_t *var_x) {
   int intervals;
   int pointskey;
 
+  functional_workspace_t *ws;
   gsl_integration_workspace *w;
   gsl_function function_to_integrate;
   gsl_function_arguments_t function_arguments;
 
-  
-  // nos acordamos cuanto vale x para despues volver a dejarle ese valor
-  x_old = wasora_value(var_x);
+  ws = wasora_functional_workspace(a);
 
-  x_lower = wasora_evaluate_expression(&a->arg[2]);
-  x_upper = wasora_evaluate_expression(&a->arg[3]);
-  
   if ((epsrel = wasora_evaluate_expression(&a->arg[4])) == 0) {
     epsrel = DEFAULT_INTEGRATION_TOLERANCE;
   }
@@ -170,7 +553,26 @@ double builtin_integral(factor_t *a, var_t *var_x) {
   if ((intervals = (int)wasora_evaluate_expression(&a->arg[6])) == 0) {
     intervals = DEFAULT_INTEGRATION_INTERVALS;
   }
+
+  // integral(integral(...)) sobre un rectangulo va por cubatura
+  if (ws->nest_checked == 0) {
+    wasora_integral_nest(a, var_x, &ws->nest);
+    ws->nest_checked = 1;
+  }
+  if (ws->nest.dimensions > 1 && ws->busy == 0) {
+    ws->busy = 1;
+    if (wasora_cubature(ws, epsrel, intervals, &result) == 0) {
+      ws->busy = 0;
+      return result;
+    }
+    ws->busy = 0;
+  }
   
+  // nos acordamos cuanto vale x para despues volver a dejarle ese valor
+  x_old = wasora_value(var_x);
+
+  x_lower = wasora_evaluate_expression(&a->arg[2]);
+  x_upper = wasora_evaluate_expression(&a->arg[3]);
   
   function_arguments.function = a;
   function_arguments.variable = var_x;
@@ -178,8 +580,20 @@ double builtin_integral(factor_t *a, var_t *var_x) {
   function_to_integrate.function = wasora_gsl_function;
   function_to_integrate.params = (void *)(&function_arguments);
 
-  // TODO: poner en aux para no tener que hacer alloc cada vez
-  w = gsl_integration_workspace_alloc(intervals);
+  // el workspace vive en aux, salvo que el integrando nos vuelva a llamar
+  if (ws->busy) {
+    w = gsl_integration_workspace_alloc(intervals);
+  } else {
+    if (ws->limit < (size_t)intervals) {
+      if (ws->workspace != NULL) {
+        gsl_integration_workspace_free(ws->workspace);
+      }
+      ws->workspace = gsl_integration_workspace_alloc(intervals);
+      ws->limit = intervals;
+    }
+    w = ws->workspace;
+    ws->busy = 1;
+  }
 
   if (x_lower < -0.9*wasora_var(wasora_special_var(infinite)) && x_upper > +0.9*wasora_var(wasora_special_var(infinite))) {
     gsl_integration_qagi(&function_to_integrate, 1e-8, epsrel, intervals, w, &result, &error);
@@ -195,7 +609,11 @@ double builtin_integral(factor_t *a, var_t *var_x) {
   // le volvemos a poner el valor de x que tenia antes
   wasora_value(var_x) = x_old;
 
-  gsl_integration_workspace_free(w);
+  if (w == ws->workspace) {
+    ws->busy = 0;
+  } else {
+    gsl_integration_workspace_free(w);
+  }
 
   return result;
 }
@@ -290,7 +708,7 @@ double builtin_gauss_legendre(factor_t *a, var_t *var_x) {
   gsl_function function_to_integrate;
   gsl_function_arguments_t function_arguments;
 
-  gsl_integration_glfixed_table *points;
+  functional_workspace_t *ws;
 
   // nos acordamos cuanto vale x para despues volver a dejarle ese valor
   x_old = wasora_value(var_x);
@@ -307,10 +725,16 @@ double builtin_gauss_legendre(factor_t *a, var_t *var_x) {
   function_to_integrate.function = wasora_gsl_function;
   function_to_integrate.params = (void *)(&function_arguments);
 
-  // TODO: poner en aux para no tener que hacer alloc cada vez
-  points = gsl_integration_glfixed_table_alloc(n);
-  result = gsl_integration_glfixed(&function_to_integrate, x_lower, x_upper, points);
-  gsl_integration_glfixed_table_free(points);
+  // la tabla de nodos y pesos vive en aux mientras no cambie n
+  ws = wasora_functional_workspace(a);
+  if (ws->table == NULL || ws->n != n) {
+    if (ws->table != NULL) {
+      gsl_integration_glfixed_table_free(ws->table);
+    }
+    ws->table = gsl_integration_glfixed_table_alloc(n);
+    ws->n = n;
+  }
+  result = gsl_integration_glfixed(&function_to_integrate, x_lower, x_upper, ws->table);
   
   // le volvemos a poner el valor de x que tenia antes
   wasora_value(var_x) = x_old;
@@ -329,8 +753,6 @@ double builtin_gauss_legendre(factor_t *a, var_t *var_x) {
 }
 
 
-// TODO: doble adaptivo
-
 ///fu+prod+name prod
 ///fu+prod+usage prod(f(i), i, a, b)
 ///fu+prod+desc Computes product of the $N=b-a$ expressions $f(i)$
@@ -685,3 +1107,34 @@ double wasora_gsl_function(double x, void *params) {
   return y;
 
 }
+
+
+// aux de integral() y gauss_legendre() tiene cosas de la gsl adentro
+void wasora_free_functional_aux(factor_t *a) {
+
+  functional_workspace_t *ws;
+
+  if (a->aux == NULL) {
+    return;
+  }
+
+  if (a->builtin_functional->routine == builtin_integral || a->builtin_functional->routine == builtin_gauss_legendre) {
+    ws = (functional_workspace_t *)a->aux;
+    if (ws->workspace != NULL) {
+      gsl_integration_workspace_free(ws->workspace);
+    }
+#ifdef HAVE_GLFIXED_TABLE
+    if (ws->table != NULL) {
+      gsl_integration_glfixed_table_free(ws->table);
+    }
+#endif
+    free(ws->nest.node);
+    free(ws->nest.value);
+    free(ws->region);
+  }
+
+  free(a->aux);
+  a->aux = NULL;
+
+  return;
+}
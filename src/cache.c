@@ -0,0 +1,658 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora on-disk cache of compiled expressions and whole runs
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#ifndef _WASORA_H_
+#include "wasora.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MEMO_MAGIC  "wasmem02"
+
+// header of the file the memoized runs are appended to
+typedef struct {
+  char magic[8];
+  unsigned long key;
+  size_t arena_size;
+  int n_key;
+  int n_histories;
+} cache_memo_header_t;
+
+// what a whole run left behind, indexed by the bits of its inputs
+typedef struct {
+  double *key;
+  double *arena;
+  int *history_size;
+  double **history_argument;
+  double **history_value;
+  UT_hash_handle hh;
+} cache_memo_entry_t;
+
+static struct {
+  int initialized;
+  int n_key;
+  var_t **key_var;
+  int n_histories;
+  unsigned long file_key;
+
+  // the key of the run going on and whether it has to be stored at the end
+  double *key;
+  int pending;
+
+  cache_memo_entry_t *entries;
+} memo;
+
+
+// FNV-1a
+unsigned long wasora_cache_hash(const void *data, size_t length, unsigned long hash) {
+  const unsigned char *byte = data;
+  size_t i;
+
+  for (i = 0; i < length; i++) {
+    hash ^= byte[i];
+    hash *= 0x100000001b3UL;
+  }
+
+  return hash;
+}
+
+// identifies the main input file by its contents and the replacement
+// arguments, zero means that there is no file to read (i.e. stdin)
+unsigned long wasora_cache_input_key(void) {
+
+  FILE *input;
+  char buffer[BUFFER_SIZE];
+  unsigned long key;
+  size_t n;
+  int i;
+
+  if (wasora.argv == NULL || strcmp(wasora.argv[wasora.optind], "-") == 0 || (input = fopen(wasora.argv[wasora.optind], "r")) == NULL) {
+    return 0;
+  }
+
+  key = 0xcbf29ce484222325UL;
+  while ((n = fread(buffer, 1, BUFFER_SIZE, input)) > 0) {
+    key = wasora_cache_hash(buffer, n, key);
+  }
+  fclose(input);
+  for (i = wasora.optind+1; i < wasora.argc; i++) {
+    key = wasora_cache_hash(wasora.argv[i], strlen(wasora.argv[i])+1, key);
+  }
+
+  return key;
+}
+
+// the cached stuff goes to $variable, $XDG_CACHE_HOME/wasora or ~/.cache/wasora
+// and nowhere else: we read back (and dlopen) whatever we find there, so the
+// directory has to be ours and closed to everybody else or there is no cache
+char *wasora_cache_dir(const char *variable) {
+
+  struct stat st;
+  char *dir = NULL;
+  char *base;
+
+  if (variable != NULL && (base = getenv(variable)) != NULL) {
+    dir = strdup(base);
+  } else if ((base = getenv("XDG_CACHE_HOME")) != NULL) {
+    if (asprintf(&dir, "%s/wasora", base) == -1) {
+      return NULL;
+    }
+  } else if ((base = getenv("HOME")) != NULL) {
+    if (asprintf(&dir, "%s/.cache", base) == -1) {
+      return NULL;
+    }
+    mkdir(dir, 0700);
+    free(dir);
+    if (asprintf(&dir, "%s/.cache/wasora", base) == -1) {
+      return NULL;
+    }
+  } else {
+    return NULL;
+  }
+
+  if (dir == NULL || (mkdir(dir, 0700) != 0 && errno != EEXIST) ||
+      lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid()) {
+    free(dir);
+    return NULL;
+  }
+
+  // a directory left open by an older version is closed now that it is ours
+  if ((st.st_mode & 077) != 0 && chmod(dir, 0700) != 0) {
+    free(dir);
+    return NULL;
+  }
+
+  return dir;
+}
+
+
+// identity, size and modification time of a file, so touching it (or
+// putting another one in its place) gives a different key
+static unsigned long wasora_cache_stat_hash(const struct stat *st, unsigned long key) {
+
+  key = wasora_cache_hash(&st->st_dev, sizeof(st->st_dev), key);
+  key = wasora_cache_hash(&st->st_ino, sizeof(st->st_ino), key);
+  key = wasora_cache_hash(&st->st_size, sizeof(st->st_size), key);
+  key = wasora_cache_hash(&st->st_mtim, sizeof(st->st_mtim), key);
+
+  return key;
+}
+
+
+// -- memoization of whole runs ------------ -----        ----           --     -
+
+// a run also depends on the files it reads, the ones whose path does not
+// depend on expressions are identified by their path and their stat data
+static unsigned long wasora_memo_files_key(unsigned long key) {
+
+  function_t *function;
+  file_t *file;
+  struct stat st;
+
+  for (function = wasora.functions; function != NULL; function = function->hh.next) {
+    if (function->data_file != NULL) {
+      key = wasora_cache_hash(function->data_file, strlen(function->data_file)+1, key);
+      if (stat(function->data_file, &st) == 0) {
+        key = wasora_cache_stat_hash(&st, key);
+      }
+    }
+  }
+
+  for (file = wasora.files; file != NULL; file = file->hh.next) {
+    if (file != wasora.special_files.stdin_ && file->mode != NULL && file->mode[0] == 'r' && file->n_args == 0 && file->format != NULL) {
+      key = wasora_cache_hash(file->format, strlen(file->format)+1, key);
+      if (stat(file->format, &st) == 0) {
+        key = wasora_cache_stat_hash(&st, key);
+      }
+    }
+  }
+
+  return key;
+}
+
+// the inputs of a run are the parameters the outer loops (PARAMETRIC, FIT
+// and MINIMIZE) set before calling wasora_standard_run() plus the flag that
+// tells the initial outer step (where assignments to parameters do apply)
+static int wasora_memo_setup(void) {
+
+  history_t *history;
+  int i, j;
+
+  memo.initialized = 1;
+  memo.n_key = 0;
+
+  // plugins keep their results out of our sight and the outer loops
+  // need the sensitivities that only an actual integration computes
+  if (wasora.i_plugin != 0 || wasora_dae.n_sensitivities != 0) {
+    return WASORA_RUNTIME_OK;
+  }
+  if (wasora.parametric.dimensions + wasora.fit.p + wasora.min.n == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  memo.n_key = wasora.parametric.dimensions + wasora.fit.p + wasora.min.n + 1;
+  memo.key_var = calloc(memo.n_key, sizeof(var_t *));
+  memo.key = calloc(memo.n_key, sizeof(double));
+  j = 0;
+  for (i = 0; i < wasora.parametric.dimensions; i++) {
+    memo.key_var[j++] = wasora.parametric.variable[i];
+  }
+  for (i = 0; i < wasora.fit.p; i++) {
+    memo.key_var[j++] = wasora.fit.param[i];
+  }
+  for (i = 0; i < wasora.min.n; i++) {
+    memo.key_var[j++] = wasora.min.x[i];
+  }
+  memo.key_var[j] = wasora_special_var(in_outer_initial);
+
+  memo.n_histories = 0;
+  LL_FOREACH(wasora.histories, history) {
+    memo.n_histories++;
+  }
+
+  // a persisted run is only good for the very same input and arguments
+  if ((memo.file_key = wasora_cache_input_key()) == 0 && wasora.memo.file_path != NULL) {
+    // without an input file we cannot tell if the stored runs still apply
+    free(wasora.memo.file_path);
+    wasora.memo.file_path = NULL;
+  }
+  for (j = 0; j < memo.n_key; j++) {
+    memo.file_key = wasora_cache_hash(memo.key_var[j]->name, strlen(memo.key_var[j]->name)+1, memo.file_key);
+  }
+  memo.file_key = wasora_memo_files_key(memo.file_key);
+
+  return WASORA_RUNTIME_OK;
+}
+
+static cache_memo_entry_t *wasora_memo_entry_alloc(void) {
+
+  cache_memo_entry_t *entry;
+
+  entry = calloc(1, sizeof(cache_memo_entry_t));
+  entry->key = malloc(memo.n_key * sizeof(double));
+  entry->arena = malloc(3*wasora.arena.size * sizeof(double));
+  if (memo.n_histories != 0) {
+    entry->history_size = calloc(memo.n_histories, sizeof(int));
+    entry->history_argument = calloc(memo.n_histories, sizeof(double *));
+    entry->history_value = calloc(memo.n_histories, sizeof(double *));
+  }
+
+  return entry;
+}
+
+static void wasora_memo_entry_free(cache_memo_entry_t *entry) {
+
+  int i;
+
+  for (i = 0; i < memo.n_histories; i++) {
+    free(entry->history_argument[i]);
+    free(entry->history_value[i]);
+  }
+  free(entry->history_size);
+  free(entry->history_argument);
+  free(entry->history_value);
+  free(entry->arena);
+  free(entry->key);
+  free(entry);
+
+  return;
+}
+
+// the record in the file is the entry laid out flat preceded by its length
+static char *wasora_memo_entry_pack(cache_memo_entry_t *entry, size_t *length) {
+
+  char *record, *p;
+  size_t size;
+  int i;
+
+  size = sizeof(size_t) + (memo.n_key + 3*wasora.arena.size) * sizeof(double);
+  for (i = 0; i < memo.n_histories; i++) {
+    size += sizeof(int) + 2*entry->history_size[i] * sizeof(double);
+  }
+
+  p = record = malloc(size);
+  *length = size - sizeof(size_t);
+  memcpy(p, length, sizeof(size_t));                                p += sizeof(size_t);
+  memcpy(p, entry->key, memo.n_key * sizeof(double));               p += memo.n_key * sizeof(double);
+  memcpy(p, entry->arena, 3*wasora.arena.size * sizeof(double));    p += 3*wasora.arena.size * sizeof(double);
+  for (i = 0; i < memo.n_histories; i++) {
+    memcpy(p, &entry->history_size[i], sizeof(int));                 p += sizeof(int);
+    memcpy(p, entry->history_argument[i], entry->history_size[i] * sizeof(double));  p += entry->history_size[i] * sizeof(double);
+    memcpy(p, entry->history_value[i], entry->history_size[i] * sizeof(double));     p += entry->history_size[i] * sizeof(double);
+  }
+  *length = size;
+
+  return record;
+}
+
+// the inverse of the above without the length, returns NULL if it does not fit
+static cache_memo_entry_t *wasora_memo_entry_unpack(const char *p, size_t length) {
+
+  cache_memo_entry_t *entry;
+  const char *end = p + length;
+  size_t size;
+  int i;
+
+  size = (memo.n_key + 3*wasora.arena.size) * sizeof(double);
+  if (length < size) {
+    return NULL;
+  }
+
+  entry = wasora_memo_entry_alloc();
+  memcpy(entry->key, p, memo.n_key * sizeof(double));             p += memo.n_key * sizeof(double);
+  memcpy(entry->arena, p, 3*wasora.arena.size * sizeof(double));  p += 3*wasora.arena.size * sizeof(double);
+  for (i = 0; i < memo.n_histories; i++) {
+    if (end - p < sizeof(int)) {
+      wasora_memo_entry_free(entry);
+      return NULL;
+    }
+    memcpy(&entry->history_size[i], p, sizeof(int));                p += sizeof(int);
+    if (entry->history_size[i] < 0 || end - p < 2*entry->history_size[i] * sizeof(double)) {
+      entry->history_size[i] = 0;
+      wasora_memo_entry_free(entry);
+      return NULL;
+    }
+    if (entry->history_size[i] != 0) {
+      entry->history_argument[i] = malloc(entry->history_size[i] * sizeof(double));
+      entry->history_value[i] = malloc(entry->history_size[i] * sizeof(double));
+      memcpy(entry->history_argument[i], p, entry->history_size[i] * sizeof(double));  p += entry->history_size[i] * sizeof(double);
+      memcpy(entry->history_value[i], p, entry->history_size[i] * sizeof(double));     p += entry->history_size[i] * sizeof(double);
+    }
+  }
+
+  return entry;
+}
+
+static int wasora_memo_read(int fd, void *buffer, size_t n) {
+
+  ssize_t r;
+  char *p = buffer;
+
+  while (n > 0) {
+    if ((r = read(fd, p, n)) <= 0) {
+      if (r < 0 && errno == EINTR) {
+        continue;
+      }
+      return 0;
+    }
+    p += r;
+    n -= r;
+  }
+
+  return 1;
+}
+
+static int wasora_memo_write(int fd, const void *buffer, size_t n) {
+
+  ssize_t r;
+  const char *p = buffer;
+
+  while (n > 0) {
+    if ((r = write(fd, p, n)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 0;
+    }
+    p += r;
+    n -= r;
+  }
+
+  return 1;
+}
+
+// reads the runs stored by previous invocations (or by our daughters), if the
+// file belongs to another input it is truncated and we start all over again
+static int wasora_memo_load(void) {
+
+  cache_memo_header_t header, stored;
+  cache_memo_entry_t *entry, *existing;
+  char *record;
+  size_t length;
+  int fd;
+
+  if ((fd = open(wasora.memo.file_path, O_RDWR | O_CREAT, 0600)) < 0) {
+    wasora_push_error_message("cannot open memoization file '%s': %s", wasora.memo.file_path, strerror(errno));
+    return WASORA_RUNTIME_ERROR;
+  }
+  flock(fd, LOCK_EX);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CACHE_MEMO_MAGIC, 8);
+  header.key = memo.file_key;
+  header.arena_size = wasora.arena.size;
+  header.n_key = memo.n_key;
+  header.n_histories = memo.n_histories;
+
+  if (wasora_memo_read(fd, &stored, sizeof(stored)) == 0 || memcmp(&stored, &header, sizeof(header)) != 0) {
+    if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0 || wasora_memo_write(fd, &header, sizeof(header)) == 0) {
+      wasora_push_error_message("cannot write memoization file '%s': %s", wasora.memo.file_path, strerror(errno));
+      flock(fd, LOCK_UN);
+      close(fd);
+      return WASORA_RUNTIME_ERROR;
+    }
+  } else {
+    // a truncated last record (someone was killed while writing) is just ignored
+    while (wasora_memo_read(fd, &length, sizeof(size_t))) {
+      record = malloc(length);
+      if (wasora_memo_read(fd, record, length) == 0) {
+        free(record);
+        break;
+      }
+      if ((entry = wasora_memo_entry_unpack(record, length)) != NULL) {
+        HASH_FIND(hh, memo.entries, entry->key, memo.n_key * sizeof(double), existing);
+        if (existing == NULL) {
+          HASH_ADD_KEYPTR(hh, memo.entries, entry->key, memo.n_key * sizeof(double), entry);
+        } else {
+          wasora_memo_entry_free(entry);
+        }
+      }
+      free(record);
+    }
+  }
+
+  flock(fd, LOCK_UN);
+  close(fd);
+
+  return WASORA_RUNTIME_OK;
+}
+
+// appends a record, the file is opened each time because daughter processes
+// share the open file description (and thus the lock) with their parent
+static int wasora_memo_append(cache_memo_entry_t *entry) {
+
+  char *record;
+  size_t length;
+  int fd;
+
+  if ((fd = open(wasora.memo.file_path, O_WRONLY | O_APPEND)) < 0) {
+    wasora_push_error_message("cannot open memoization file '%s': %s", wasora.memo.file_path, strerror(errno));
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  record = wasora_memo_entry_pack(entry, &length);
+  flock(fd, LOCK_EX);
+  if (wasora_memo_write(fd, record, length) == 0) {
+    wasora_push_error_message("cannot write memoization file '%s': %s", wasora.memo.file_path, strerror(errno));
+    flock(fd, LOCK_UN);
+    close(fd);
+    free(record);
+    return WASORA_RUNTIME_ERROR;
+  }
+  flock(fd, LOCK_UN);
+  close(fd);
+  free(record);
+
+  return WASORA_RUNTIME_OK;
+}
+
+// the special variables live in the arena as well, the ones that describe
+// the run (time, done, step_transient, etc) are left as the skipped run left
+// them but the counters and flags of the outer loop (and those of the process)
+// belong to the caller, that has just set them
+static void wasora_memo_arena_restore(const double *arena) {
+
+  var_t *keep[] = {
+    wasora_special_var(done_outer),
+    wasora_special_var(step_outer),
+    wasora_special_var(step_inner),
+    wasora_special_var(in_outer_initial),
+    wasora_special_var(ncores),
+    wasora_special_var(pid),
+  };
+  int n = sizeof(keep)/sizeof(var_t *);
+  double saved[3*n];
+  int i;
+
+  for (i = 0; i < n; i++) {
+    saved[3*i+0] = wasora_value(keep[i]);
+    saved[3*i+1] = keep[i]->initial_static[0];
+    saved[3*i+2] = keep[i]->initial_transient[0];
+  }
+
+  wasora_arena_restore(arena);
+
+  for (i = 0; i < n; i++) {
+    wasora_value(keep[i]) = saved[3*i+0];
+    keep[i]->initial_static[0] = saved[3*i+1];
+    keep[i]->initial_transient[0] = saved[3*i+2];
+  }
+
+  return;
+}
+
+// a PARAMETRIC point is meant to print its own results, which a hit can give
+// back only if the run was a single static step: then whatever it printed came
+// out of the arena it left behind (up to assignments placed after the PRINTs)
+static int wasora_memo_replayable(void) {
+  return (int)wasora_value(wasora_special_var(step_transient)) == 0 &&
+         (int)rint(wasora_value(wasora_special_var(static_steps))) <= 1;
+}
+
+// prints again what the stored run printed, with the flags of the step as
+// they were while the instructions were executed and not as they ended up
+static int wasora_memo_replay(void) {
+
+  var_t *flag[] = {
+    wasora_special_var(in_static),
+    wasora_special_var(in_static_first),
+    wasora_special_var(step_static),
+    wasora_special_var(done_static),
+    wasora_special_var(done),
+    wasora_special_var(in_transient),
+    wasora_special_var(in_transient_first),
+  };
+  double during[] = {1, 1, 1, 0, 0, 0, 0};
+  int n = sizeof(flag)/sizeof(var_t *);
+  double saved[n];
+  int i;
+
+  for (i = 0; i < n; i++) {
+    saved[i] = wasora_value(flag[i]);
+    wasora_value(flag[i]) = during[i];
+  }
+
+  wasora_call(wasora_instructions_replay_output());
+
+  for (i = 0; i < n; i++) {
+    wasora_value(flag[i]) = saved[i];
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+// looks for a previous run with exactly the same bits in the inputs and if
+// there is one, puts back what it computed (the arena and the histories)
+// instead of running again, the instructions are not executed so a memoized
+// FIT or MINIMIZE run prints nothing but a PARAMETRIC one replays its output
+int wasora_memo_lookup(int *hit) {
+
+  cache_memo_entry_t *entry;
+  history_t *history;
+  int i;
+
+  *hit = 0;
+  if (wasora.memo.enabled == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  if (memo.initialized == 0) {
+    wasora_call(wasora_memo_setup());
+    if (memo.n_key != 0 && wasora.memo.file_path != NULL) {
+      wasora_call(wasora_memo_load());
+    }
+  }
+
+  // the last run of FIT and MINIMIZE is the one meant to print the results
+  if (memo.n_key == 0 || (wasora.parametric_mode == 0 && (int)wasora_var(wasora_special_var(done_outer)))) {
+    memo.pending = 0;
+    return WASORA_RUNTIME_OK;
+  }
+
+  for (i = 0; i < memo.n_key; i++) {
+    memo.key[i] = wasora_value(memo.key_var[i]);
+  }
+
+  HASH_FIND(hh, memo.entries, memo.key, memo.n_key * sizeof(double), entry);
+  if (entry == NULL) {
+    memo.pending = 1;
+    return WASORA_RUNTIME_OK;
+  }
+
+  memo.pending = 0;
+  wasora_memo_arena_restore(entry->arena);
+
+  i = 0;
+  LL_FOREACH(wasora.histories, history) {
+    wasora_history_set(history, entry->history_size[i], entry->history_argument[i], entry->history_value[i]);
+    i++;
+  }
+
+  if (wasora.parametric_mode) {
+    wasora_call(wasora_memo_replay());
+  }
+
+  *hit = 1;
+  return WASORA_RUNTIME_OK;
+}
+
+// stores what the run that just finished left behind
+int wasora_memo_store(void) {
+
+  cache_memo_entry_t *entry;
+  history_t *history;
+  int i;
+
+  if (memo.pending == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+  memo.pending = 0;
+  if (wasora.parametric_mode && wasora_memo_replayable() == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  entry = wasora_memo_entry_alloc();
+  memcpy(entry->key, memo.key, memo.n_key * sizeof(double));
+  wasora_arena_save(entry->arena);
+
+  i = 0;
+  LL_FOREACH(wasora.histories, history) {
+    entry->history_size[i] = history->n;
+    if (entry->history_size[i] != 0) {
+      entry->history_argument[i] = malloc(entry->history_size[i] * sizeof(double));
+      entry->history_value[i] = malloc(entry->history_size[i] * sizeof(double));
+      wasora_history_get(history, entry->history_argument[i], entry->history_value[i]);
+    }
+    i++;
+  }
+
+  HASH_ADD_KEYPTR(hh, memo.entries, entry->key, memo.n_key * sizeof(double), entry);
+
+  if (wasora.memo.file_path != NULL) {
+    wasora_call(wasora_memo_append(entry));
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+void wasora_memo_finalize(void) {
+
+  cache_memo_entry_t *entry, *tmp;
+
+  HASH_ITER(hh, memo.entries, entry, tmp) {
+    HASH_DEL(memo.entries, entry);
+    wasora_memo_entry_free(entry);
+  }
+
+  free(memo.key_var);
+  free(memo.key);
+  memo.key_var = NULL;
+  memo.key = NULL;
+  memo.initialized = 0;
+  memo.n_key = 0;
+  wasora_free(wasora.memo.file_path);
+
+  return;
+}
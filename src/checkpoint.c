@@ -0,0 +1,649 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora checkpoint and restart of transient runs
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#ifndef _WASORA_H_
+#include "wasora.h"
+#endif
+
+#include <errno.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "builtindecl.h"
+
+#define CHECKPOINT_MAGIC  "waschk02"
+#define CHECKPOINT_RNG    -1
+
+// the builtins that keep state from one step to the next in factor->aux
+static struct {
+  double (*routine)(factor_t *);
+  int size;
+} checkpoint_stateful[] = {
+  {&builtin_last,              3},
+  {&builtin_d_dt,              3},
+  {&builtin_integral_dt,       4},
+  {&builtin_integral_euler_dt, 2},
+  {&builtin_lag,               3},
+  {&builtin_lag_euler,         5},
+  {&builtin_lag_bilinear,      5},
+  {&builtin_limit_dt,          3},
+  {&builtin_threshold_max,     1},
+  {&builtin_threshold_min,     1},
+  {&builtin_random,            CHECKPOINT_RNG},
+  {&builtin_random_gauss,      CHECKPOINT_RNG},
+  {NULL,                       0}
+};
+
+// the counts are there to detect a checkpoint of another input
+typedef struct {
+  char magic[8];
+  unsigned long key;
+  size_t arena_size;
+  int n_vectors;
+  int n_matrices;
+  int n_histories;
+  int n_prints;
+  int n_checkpoints;
+  int n_stateful;
+  int n_files;
+} checkpoint_header_t;
+
+
+static int wasora_checkpoint_stateful_size(factor_t *factor) {
+
+  int i;
+
+  if (factor->builtin_function == NULL) {
+    return 0;
+  }
+  for (i = 0; checkpoint_stateful[i].routine != NULL; i++) {
+    if (checkpoint_stateful[i].routine == factor->builtin_function->routine) {
+      return checkpoint_stateful[i].size;
+    }
+  }
+
+  return 0;
+}
+
+// called for each token of each parsed expression, the token arrays are
+// not moved after parsing so we can keep pointers to them
+void wasora_checkpoint_register_factor(factor_t *factor) {
+
+  if (wasora_checkpoint_stateful_size(factor) == 0) {
+    return;
+  }
+
+  wasora.checkpoint.stateful = realloc(wasora.checkpoint.stateful, (wasora.checkpoint.n_stateful+1) * sizeof(factor_t *));
+  wasora.checkpoint.stateful[wasora.checkpoint.n_stateful++] = factor;
+
+  return;
+}
+
+void wasora_checkpoint_unregister_factor(factor_t *factor) {
+
+  int i;
+
+  for (i = 0; i < wasora.checkpoint.n_stateful; i++) {
+    if (wasora.checkpoint.stateful[i] == factor) {
+      memmove(&wasora.checkpoint.stateful[i], &wasora.checkpoint.stateful[i+1], (wasora.checkpoint.n_stateful-i-1) * sizeof(factor_t *));
+      wasora.checkpoint.n_stateful--;
+      return;
+    }
+  }
+
+  return;
+}
+
+
+static char *wasora_checkpoint_path(const char *given) {
+
+  char *path;
+
+  if (given != NULL) {
+    return strdup(given);
+  } else if (wasora.checkpoint.file_path != NULL) {
+    return strdup(wasora.checkpoint.file_path);
+  } else if (wasora.argv != NULL && strcmp(wasora.argv[wasora.optind], "-") != 0) {
+    if (asprintf(&path, "%s.chk", wasora.argv[wasora.optind]) == -1) {
+      return NULL;
+    }
+    return path;
+  }
+
+  return strdup("wasora.chk");
+}
+
+static void wasora_checkpoint_header(checkpoint_header_t *header) {
+
+  vector_t *vector;
+  matrix_t *matrix;
+  history_t *history;
+  print_t *print;
+  checkpoint_t *checkpoint;
+  file_t *file;
+
+  memset(header, 0, sizeof(checkpoint_header_t));
+  memcpy(header->magic, CHECKPOINT_MAGIC, 8);
+  header->key = wasora_cache_input_key();
+  header->arena_size = wasora.arena.size;
+  for (vector = wasora.vectors; vector != NULL; vector = vector->hh.next) {
+    header->n_vectors++;
+  }
+  for (matrix = wasora.matrices; matrix != NULL; matrix = matrix->hh.next) {
+    header->n_matrices++;
+  }
+  LL_FOREACH(wasora.histories, history) {
+    header->n_histories++;
+  }
+  LL_FOREACH(wasora.prints, print) {
+    header->n_prints++;
+  }
+  LL_FOREACH(wasora.checkpoint.checkpoints, checkpoint) {
+    header->n_checkpoints++;
+  }
+  header->n_stateful = wasora.checkpoint.n_stateful;
+  for (file = wasora.files; file != NULL; file = file->hh.next) {
+    header->n_files++;
+  }
+
+  return;
+}
+
+
+// vectors and matrices that did not make it to the arena go on their own
+static int wasora_checkpoint_vector_outside(vector_t *vector) {
+  return vector->initialized && vector->realloced == 0 && wasora_arena_contains(gsl_vector_ptr(wasora_value_ptr(vector), 0)) == 0;
+}
+
+static int wasora_checkpoint_matrix_outside(matrix_t *matrix) {
+  return matrix->initialized && matrix->realloced == 0 && wasora_arena_contains(gsl_matrix_ptr(wasora_value_ptr(matrix), 0, 0)) == 0;
+}
+
+// writes everything needed to continue the transient from the end of the
+// current step, this is run in a forked child so the parent can go on
+static int wasora_checkpoint_dump(FILE *out) {
+
+  checkpoint_header_t header;
+  vector_t *vector;
+  matrix_t *matrix;
+  history_t *history;
+  print_t *print;
+  checkpoint_t *checkpoint;
+  file_t *file;
+  gsl_vector *v[3];
+  gsl_matrix *m[3];
+  factor_t *factor;
+  double last_step = 0;
+  double *t, *y;
+  long offset;
+  size_t size;
+  int i, j, k, n;
+
+  wasora_checkpoint_header(&header);
+  fwrite(&header, sizeof(header), 1, out);
+
+  fwrite(wasora.arena.block, sizeof(double), 3*wasora.arena.size, out);
+
+  for (vector = wasora.vectors; vector != NULL; vector = vector->hh.next) {
+    n = wasora_checkpoint_vector_outside(vector) ? vector->size : 0;
+    fwrite(&n, sizeof(int), 1, out);
+    if (n != 0) {
+      v[0] = wasora_value_ptr(vector);
+      v[1] = vector->initial_static;
+      v[2] = vector->initial_transient;
+      for (k = 0; k < 3; k++) {
+        for (i = 0; i < n; i++) {
+          fwrite(gsl_vector_ptr(v[k], i), sizeof(double), 1, out);
+        }
+      }
+    }
+  }
+
+  for (matrix = wasora.matrices; matrix != NULL; matrix = matrix->hh.next) {
+    n = wasora_checkpoint_matrix_outside(matrix) ? matrix->rows*matrix->cols : 0;
+    fwrite(&n, sizeof(int), 1, out);
+    if (n != 0) {
+      m[0] = wasora_value_ptr(matrix);
+      m[1] = matrix->initial_static;
+      m[2] = matrix->initial_transient;
+      for (k = 0; k < 3; k++) {
+        for (i = 0; i < matrix->rows; i++) {
+          for (j = 0; j < matrix->cols; j++) {
+            fwrite(gsl_matrix_ptr(m[k], i, j), sizeof(double), 1, out);
+          }
+        }
+      }
+    }
+  }
+
+  offset = (wasora.time_path != NULL) ? (long)(wasora.current_time_path - wasora.time_path) : 0;
+  fwrite(&offset, sizeof(long), 1, out);
+
+#ifdef HAVE_IDA
+  if (wasora_dae.system != NULL) {
+    realtype h;
+    if (IDAGetLastStep(wasora_dae.system, &h) == IDA_SUCCESS) {
+      last_step = h;
+    }
+  }
+#endif
+  fwrite(&last_step, sizeof(double), 1, out);
+
+  LL_FOREACH(wasora.histories, history) {
+    fwrite(&history->n, sizeof(int), 1, out);
+    if (history->n != 0) {
+      t = malloc(history->n * sizeof(double));
+      y = malloc(history->n * sizeof(double));
+      wasora_history_get(history, t, y);
+      fwrite(t, sizeof(double), history->n, out);
+      fwrite(y, sizeof(double), history->n, out);
+      free(t);
+      free(y);
+    }
+  }
+
+  LL_FOREACH(wasora.prints, print) {
+    fwrite(&print->last_static_step, sizeof(int), 1, out);
+    fwrite(&print->last_step, sizeof(int), 1, out);
+    fwrite(&print->last_time, sizeof(double), 1, out);
+    fwrite(&print->last_header_step, sizeof(int), 1, out);
+    fwrite(&print->header_already_printed, sizeof(int), 1, out);
+  }
+
+  LL_FOREACH(wasora.checkpoint.checkpoints, checkpoint) {
+    fwrite(&checkpoint->last_step, sizeof(int), 1, out);
+    fwrite(&checkpoint->last_time, sizeof(double), 1, out);
+  }
+
+  for (i = 0; i < wasora.checkpoint.n_stateful; i++) {
+    factor = wasora.checkpoint.stateful[i];
+    n = (factor->aux != NULL) ? wasora_checkpoint_stateful_size(factor) : 0;
+    fwrite(&n, sizeof(int), 1, out);
+    if (n == CHECKPOINT_RNG) {
+      size = gsl_rng_size((gsl_rng *)factor->aux);
+      fwrite(&size, sizeof(size_t), 1, out);
+      fwrite(gsl_rng_state((gsl_rng *)factor->aux), 1, size, out);
+    } else if (n > 0) {
+      fwrite(factor->aux, sizeof(double), n, out);
+    }
+  }
+
+  // the parent flushed everything before forking so the offsets are right
+  for (file = wasora.files; file != NULL; file = file->hh.next) {
+    offset = -1;
+    if (file->pointer != NULL && fileno(file->pointer) > 2 && file->mode != NULL && strpbrk(file->mode, "wa+") != NULL) {
+      offset = ftell(file->pointer);
+    }
+    fwrite(&offset, sizeof(long), 1, out);
+    if (offset >= 0) {
+      n = strlen(file->path);
+      fwrite(&n, sizeof(int), 1, out);
+      fwrite(file->path, 1, n, out);
+    }
+  }
+
+  return ferror(out) ? WASORA_RUNTIME_ERROR : WASORA_RUNTIME_OK;
+}
+
+static int wasora_checkpoint_write_file(const char *path) {
+
+  FILE *out;
+  char *tmp;
+  int status;
+
+  // written under a temporary name so a crash while writing
+  // leaves the previous checkpoint untouched
+  if (asprintf(&tmp, "%s.%d", path, (int)getpid()) == -1) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  if ((out = fopen(tmp, "w")) == NULL) {
+    wasora_push_error_message("cannot write checkpoint '%s': %s", tmp, strerror(errno));
+    free(tmp);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  status = wasora_checkpoint_dump(out);
+  if (fflush(out) != 0 || fsync(fileno(out)) != 0) {
+    status = WASORA_RUNTIME_ERROR;
+  }
+  if (fclose(out) != 0 || status != WASORA_RUNTIME_OK || rename(tmp, path) != 0) {
+    wasora_push_error_message("cannot write checkpoint '%s': %s", path, strerror(errno));
+    unlink(tmp);
+    free(tmp);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  free(tmp);
+  return WASORA_RUNTIME_OK;
+}
+
+// waits for the daughter that is writing the last checkpoint, if any
+int wasora_checkpoint_wait(void) {
+
+  int status = 0;
+  pid_t pid;
+
+  if (wasora.checkpoint.writer > 0) {
+    while ((pid = waitpid(wasora.checkpoint.writer, &status, 0)) == -1 && errno == EINTR);
+    wasora.checkpoint.writer = 0;
+    if (pid == -1) {
+      wasora_push_error_message("cannot wait for the checkpoint writer: %s", strerror(errno));
+      return WASORA_RUNTIME_ERROR;
+    }
+    if (WIFEXITED(status) == 0 || WEXITSTATUS(status) != 0) {
+      wasora_push_error_message("the checkpoint could not be written");
+      return WASORA_RUNTIME_ERROR;
+    }
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+// takes the snapshot asked for by a CHECKPOINT instruction during this step,
+// a daughter process writes the copy-on-write image of our memory while
+// we go on with the next steps
+int wasora_checkpoint_write(void) {
+
+  char *path;
+  pid_t pid;
+
+  wasora.checkpoint.pending = 0;
+  wasora_call(wasora_checkpoint_wait());
+
+  if ((path = wasora_checkpoint_path(NULL)) == NULL) {
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  // flush before forking so the daughter neither duplicates our
+  // buffers nor misses what is still in them when computing offsets
+  fflush(NULL);
+
+  if ((pid = fork()) == 0) {
+    if (wasora_checkpoint_write_file(path) != WASORA_RUNTIME_OK) {
+      wasora_pop_errors();
+      _exit(EXIT_FAILURE);
+    }
+    _exit(EXIT_SUCCESS);
+  } else if (pid < 0) {
+    // no daughter, we do it ourselves
+    if (wasora_checkpoint_write_file(path) != WASORA_RUNTIME_OK) {
+      free(path);
+      return WASORA_RUNTIME_ERROR;
+    }
+  } else {
+    wasora.checkpoint.writer = pid;
+  }
+
+  free(path);
+  return WASORA_RUNTIME_OK;
+}
+
+
+static int wasora_checkpoint_read(FILE *in, void *buffer, size_t size, size_t n) {
+  return fread(buffer, size, n, in) == n;
+}
+
+#define wasora_checkpoint_read_or_fail(in, buffer, size, n) \
+  if (wasora_checkpoint_read((in), (buffer), (size), (n)) == 0) { \
+    wasora_push_error_message("checkpoint '%s' is truncated", path); \
+    fclose(in); \
+    free(path); \
+    return WASORA_RUNTIME_ERROR; \
+  }
+
+// puts back the state saved by wasora_checkpoint_write() so the transient
+// loop continues with the step that follows the one it was taken at
+int wasora_checkpoint_restore(void) {
+
+  checkpoint_header_t header, stored;
+  vector_t *vector;
+  matrix_t *matrix;
+  history_t *history;
+  print_t *print;
+  checkpoint_t *checkpoint;
+  file_t *file;
+  gsl_vector *v[3];
+  gsl_matrix *m[3];
+  factor_t *factor;
+  FILE *in;
+  char *path;
+  double last_step;
+  double *t, *y;
+  long offset;
+  size_t size;
+  int i, j, k, n;
+
+  wasora.checkpoint.restart = 0;
+
+  if (wasora.parametric.dimensions != 0 || wasora.fit.p != 0 || wasora.min.n != 0) {
+    wasora_push_error_message("PARAMETRIC, FIT and MINIMIZE runs cannot be restarted");
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  if ((path = wasora_checkpoint_path(wasora.checkpoint.restart_path)) == NULL) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  if ((in = fopen(path, "r")) == NULL) {
+    wasora_push_error_message("cannot open checkpoint '%s': %s", path, strerror(errno));
+    free(path);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  wasora_checkpoint_header(&header);
+  wasora_checkpoint_read_or_fail(in, &stored, sizeof(stored), 1);
+  if (memcmp(&stored, &header, sizeof(header)) != 0) {
+    wasora_push_error_message("checkpoint '%s' was not written by this input", path);
+    fclose(in);
+    free(path);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  wasora_checkpoint_read_or_fail(in, wasora.arena.block, sizeof(double), 3*wasora.arena.size);
+
+  for (vector = wasora.vectors; vector != NULL; vector = vector->hh.next) {
+    wasora_checkpoint_read_or_fail(in, &n, sizeof(int), 1);
+    if (n != 0) {
+      if (vector->initialized == 0) {
+        wasora_call(wasora_vector_init(vector));
+      }
+      v[0] = wasora_value_ptr(vector);
+      v[1] = vector->initial_static;
+      v[2] = vector->initial_transient;
+      for (k = 0; k < 3; k++) {
+        for (i = 0; i < n; i++) {
+          wasora_checkpoint_read_or_fail(in, gsl_vector_ptr(v[k], i), sizeof(double), 1);
+        }
+      }
+    }
+  }
+
+  for (matrix = wasora.matrices; matrix != NULL; matrix = matrix->hh.next) {
+    wasora_checkpoint_read_or_fail(in, &n, sizeof(int), 1);
+    if (n != 0) {
+      if (matrix->initialized == 0) {
+        wasora_call(wasora_matrix_init(matrix));
+      }
+      m[0] = wasora_value_ptr(matrix);
+      m[1] = matrix->initial_static;
+      m[2] = matrix->initial_transient;
+      for (k = 0; k < 3; k++) {
+        for (i = 0; i < matrix->rows; i++) {
+          for (j = 0; j < matrix->cols; j++) {
+            wasora_checkpoint_read_or_fail(in, gsl_matrix_ptr(m[k], i, j), sizeof(double), 1);
+          }
+        }
+      }
+    }
+  }
+
+  wasora_checkpoint_read_or_fail(in, &offset, sizeof(long), 1);
+  if (wasora.time_path != NULL) {
+    wasora.current_time_path = wasora.time_path + offset;
+  }
+
+  wasora_checkpoint_read_or_fail(in, &last_step, sizeof(double), 1);
+
+  LL_FOREACH(wasora.histories, history) {
+    wasora_checkpoint_read_or_fail(in, &n, sizeof(int), 1);
+    if (n < 0) {
+      wasora_push_error_message("checkpoint '%s' is corrupted", path);
+      fclose(in);
+      free(path);
+      return WASORA_RUNTIME_ERROR;
+    }
+    t = malloc((n+1) * sizeof(double));
+    y = malloc((n+1) * sizeof(double));
+    if (wasora_checkpoint_read(in, t, sizeof(double), n) == 0 || wasora_checkpoint_read(in, y, sizeof(double), n) == 0) {
+      free(t);
+      free(y);
+      wasora_push_error_message("checkpoint '%s' is truncated", path);
+      fclose(in);
+      free(path);
+      return WASORA_RUNTIME_ERROR;
+    }
+    wasora_history_set(history, n, t, y);
+    free(t);
+    free(y);
+  }
+
+  LL_FOREACH(wasora.prints, print) {
+    wasora_checkpoint_read_or_fail(in, &print->last_static_step, sizeof(int), 1);
+    wasora_checkpoint_read_or_fail(in, &print->last_step, sizeof(int), 1);
+    wasora_checkpoint_read_or_fail(in, &print->last_time, sizeof(double), 1);
+    wasora_checkpoint_read_or_fail(in, &print->last_header_step, sizeof(int), 1);
+    wasora_checkpoint_read_or_fail(in, &print->header_already_printed, sizeof(int), 1);
+  }
+
+  LL_FOREACH(wasora.checkpoint.checkpoints, checkpoint) {
+    wasora_checkpoint_read_or_fail(in, &checkpoint->last_step, sizeof(int), 1);
+    wasora_checkpoint_read_or_fail(in, &checkpoint->last_time, sizeof(double), 1);
+  }
+
+  for (i = 0; i < wasora.checkpoint.n_stateful; i++) {
+    factor = wasora.checkpoint.stateful[i];
+    wasora_checkpoint_read_or_fail(in, &n, sizeof(int), 1);
+    if (n == CHECKPOINT_RNG) {
+      wasora_checkpoint_read_or_fail(in, &size, sizeof(size_t), 1);
+      if (factor->aux == NULL) {
+        factor->aux = (double *)gsl_rng_alloc(DEFAULT_RANDOM_METHOD);
+      }
+      if (gsl_rng_size((gsl_rng *)factor->aux) != size) {
+        wasora_push_error_message("checkpoint '%s' has a random generator of a different kind", path);
+        fclose(in);
+        free(path);
+        return WASORA_RUNTIME_ERROR;
+      }
+      wasora_checkpoint_read_or_fail(in, gsl_rng_state((gsl_rng *)factor->aux), 1, size);
+    } else if (n > 0) {
+      if (factor->aux == NULL) {
+        factor->aux = malloc(n * sizeof(double));
+      }
+      wasora_checkpoint_read_or_fail(in, factor->aux, sizeof(double), n);
+    }
+  }
+
+  // the output files are cut where they were at the checkpoint and appended
+  for (file = wasora.files; file != NULL; file = file->hh.next) {
+    wasora_checkpoint_read_or_fail(in, &offset, sizeof(long), 1);
+    if (offset >= 0) {
+      wasora_checkpoint_read_or_fail(in, &n, sizeof(int), 1);
+      file->path = realloc(file->path, n+1);
+      wasora_checkpoint_read_or_fail(in, file->path, 1, n);
+      file->path[n] = '\0';
+
+      if (file->pointer != NULL) {
+        fclose(file->pointer);
+      }
+      if ((file->pointer = fopen(file->path, "r+")) == NULL || ftruncate(fileno(file->pointer), offset) != 0 || fseek(file->pointer, offset, SEEK_SET) != 0) {
+        wasora_push_error_message("cannot reopen '%s' at offset %ld: %s", file->path, offset, strerror(errno));
+        fclose(in);
+        free(path);
+        return WASORA_RUNTIME_ERROR;
+      }
+    }
+  }
+
+  fclose(in);
+  free(path);
+
+  // ida starts over from the saved phase space with the last step it took
+  // (its internal history is not accessible through the public api)
+  if (wasora_dae.daes != NULL) {
+    wasora_call(wasora_dae_init());
+#ifdef HAVE_IDA
+    if (last_step > 0 && IDASetInitStep(wasora_dae.system, last_step) != IDA_SUCCESS) {
+      return WASORA_RUNTIME_ERROR;
+    }
+#endif
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+// the instruction only marks the snapshot, it is taken after the whole step
+// so the restart does not miss what the instructions that follow do
+int wasora_instruction_checkpoint(void *arg) {
+
+  checkpoint_t *checkpoint = (checkpoint_t *)arg;
+
+  if ((int)(wasora_var(wasora_special_var(in_static)))) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  if (checkpoint->skip_step.n_tokens != 0 &&
+      ((int)(wasora_value(wasora_special_var(step_transient))) - checkpoint->last_step) < wasora_evaluate_expression(&checkpoint->skip_step)) {
+    return WASORA_RUNTIME_OK;
+  }
+  if (checkpoint->skip_time.n_tokens != 0 &&
+      (wasora_var(wasora_special_var(time)) - checkpoint->last_time) < wasora_evaluate_expression(&checkpoint->skip_time)) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  checkpoint->last_step = (int)(wasora_value(wasora_special_var(step_transient)));
+  checkpoint->last_time = wasora_var(wasora_special_var(time));
+  wasora.checkpoint.pending = 1;
+
+  return WASORA_RUNTIME_OK;
+}
+
+void wasora_checkpoint_finalize(void) {
+
+  checkpoint_t *checkpoint, *tmp;
+
+  if (wasora_checkpoint_wait() != WASORA_RUNTIME_OK) {
+    wasora_pop_errors();
+  }
+
+  LL_FOREACH_SAFE(wasora.checkpoint.checkpoints, checkpoint, tmp) {
+    wasora_destroy_expression(&checkpoint->skip_step);
+    wasora_destroy_expression(&checkpoint->skip_time);
+    LL_DELETE(wasora.checkpoint.checkpoints, checkpoint);
+    free(checkpoint);
+  }
+
+  wasora_free(wasora.checkpoint.stateful);
+  wasora.checkpoint.n_stateful = 0;
+  wasora_free(wasora.checkpoint.file_path);
+  wasora_free(wasora.checkpoint.restart_path);
+
+  return;
+}
@@ -173,10 +173,10 @@ void wasora_free_var(var_t *var) {
   
   if (is_alias == 0) {
     if (var->realloced == 0) {
-      free(wasora_value_ptr(var));
+      wasora_arena_free(wasora_value_ptr(var));
     }
-    free(var->initial_transient);
-    free(var->initial_static);
+    wasora_arena_free(var->initial_transient);
+    wasora_arena_free(var->initial_static);
     free(var->name);
   }
 
@@ -384,6 +384,14 @@ void wasora_free_dae(void) {
 
 #ifdef HAVE_IDA
   dae_t *dae, *tmp;
+  event_t *event, *event_tmp;
+  
+  LL_FOREACH_SAFE(wasora_dae.events, event, event_tmp) {
+    wasora_destroy_expression(&event->condition);
+    LL_DELETE(wasora_dae.events, event);
+    free(event);
+  }
+  wasora_dae.n_events = 0;
   
   if (wasora_dae.daes != NULL) {
     LL_FOREACH_SAFE(wasora_dae.daes, dae, tmp) {
@@ -397,6 +405,8 @@ void wasora_free_dae(void) {
     }
   }
 
+  wasora_dae_free_sensitivities();
+  
   if (wasora_dae.system != NULL) {
     IDAFree(&wasora_dae.system);
     wasora_dae.system = NULL;
@@ -432,6 +442,7 @@ void wasora_free_assignments(void) {
     wasora_destroy_expression(&assignment->j_max);
     wasora_destroy_expression(&assignment->col);
     wasora_destroy_expression(&assignment->row);
+    free(assignment->others);
     
     LL_DELETE(wasora.assignments, assignment);
     free(assignment);
@@ -448,8 +459,11 @@ void wasora_free_instructions(void) {
     if (instruction->argument_alloced) {
       free(instruction->argument);
     }
+    free(instruction->file);
     free(instruction);
   }
+  wasora_free(wasora.flat_instructions);
+  wasora.n_flat_instructions = 0;
   
   return;
 }
@@ -464,6 +478,9 @@ void wasora_destroy_expression(expr_t *expr) {
   }
   
   for (i = 0; i < expr->n_tokens; i++) {
+    if (expr->token[i].builtin_function != NULL) {
+      wasora_checkpoint_unregister_factor(&expr->token[i]);
+    }
     if (expr->token[i].arg != NULL) {
       switch (expr->token[i].type) {
         case EXPR_VECTOR:
@@ -496,6 +513,9 @@ void wasora_destroy_expression(expr_t *expr) {
     if (expr->token[i].vector != NULL || expr->token[i].builtin_vectorfunction != NULL) {
       free(expr->token[i].vector_arg);
     }
+    if ((expr->token[i].type & EXPR_BASICTYPE_MASK) == EXPR_BUILTIN_FUNCTIONAL) {
+      wasora_free_functional_aux(&expr->token[i]);
+    }
     if (expr->token[i].aux != NULL) {
       free(expr->token[i].aux);
     }
@@ -519,6 +539,11 @@ void wasora_finalize(void) {
 
   int i, j;
 
+  // el reporte del profiler tiene que ir antes de liberar nada
+  if (wasora_profile_report() != WASORA_RUNTIME_OK) {
+    wasora_pop_errors();
+  }
+
   for (i = 0; i < wasora.i_plugin; i++) {
     wasora.plugin[i].finalize();
   }
@@ -526,6 +551,11 @@ void wasora_finalize(void) {
     free(wasora.plugin);
   }
   
+  wasora_jit_finalize();
+  wasora_memo_finalize();
+  wasora_checkpoint_finalize();
+  mesh_vtu_finalize();
+  
   if (wasora.min.n != 0) {
     if (wasora.min.guess != NULL) {
       for (j = wasora.min.n-1; j >= 0; j--) {
@@ -542,6 +572,8 @@ void wasora_finalize(void) {
     
     wasora_destroy_expression(&wasora.min.gradtol);
     wasora_destroy_expression(&wasora.min.tol);
+    wasora_destroy_expression(&wasora.min.multistart);
+    wasora_destroy_expression(&wasora.min.basin_radius);
     
     free(wasora.min.x);
   }
@@ -575,6 +607,7 @@ void wasora_finalize(void) {
   wasora_free_vars();
   wasora_free_vectors();
   wasora_free_matrices();  
+  wasora_arena_finalize();
 
   wasora_free_m4();
   
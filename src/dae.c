@@ -23,12 +23,22 @@
 #include "wasora.h"
 #endif
 
+#if HAVE_IDA
+static int wasora_dae_dual_residuals(int n_wrt, double **wrt, double *d);
+#endif
+#if HAVE_IDAS
+static int wasora_dae_sensitivity_init(void);
+static void wasora_dae_store_sensitivities(void);
+#endif
+
 int wasora_dae_init(void) {
   
 #ifdef HAVE_IDA
-  int i, k, l;
+  int i, j, k, l;
+  int *direction;
   phase_object_t *phase_object;
   dae_t *dae;
+  event_t *event;
   
   // primero calculamos el tamanio del phase space
   wasora_dae.dimension = 0;
@@ -107,6 +117,37 @@ int wasora_dae_init(void) {
     }
   }
 
+  // y las sensibilidades, si es que nos las pidieron
+  if (wasora_dae.n_sensitivities != 0) {
+    wasora_dae.phase_sensitivity = malloc(wasora_dae.n_sensitivities*wasora_dae.dimension * sizeof(double *));
+    for (j = 0; j < wasora_dae.n_sensitivities; j++) {
+      i = j*wasora_dae.dimension;
+      LL_FOREACH(wasora_dae.phase_objects, phase_object) {
+        if (phase_object->variable != NULL) {
+          wasora_dae.phase_sensitivity[i++] = wasora_value_ptr(phase_object->variable_sensitivity[j]);
+          
+        } else if (phase_object->vector != NULL) {
+          if (!phase_object->vector_sensitivity[j]->initialized) {
+            wasora_call(wasora_vector_init(phase_object->vector_sensitivity[j]));
+          }
+          for (k = 0; k < phase_object->vector->size; k++) {
+            wasora_dae.phase_sensitivity[i++] = gsl_vector_ptr(wasora_value_ptr(phase_object->vector_sensitivity[j]), k);
+          }
+          
+        } else if (phase_object->matrix != NULL) {
+          if (!phase_object->matrix_sensitivity[j]->initialized) {
+            wasora_call(wasora_matrix_init(phase_object->matrix_sensitivity[j]));
+          }
+          for (k = 0; k < phase_object->matrix->rows; k++) {
+            for (l = 0; l < phase_object->matrix->cols; l++) {
+              wasora_dae.phase_sensitivity[i++] = gsl_matrix_ptr(wasora_value_ptr(phase_object->matrix_sensitivity[j]), k, l);
+            }
+          }
+        }
+      }
+    }
+  }
+
   // procesamos las DAEs
   i = 0;
   LL_FOREACH(wasora_dae.daes, dae) {
@@ -243,6 +284,20 @@ int wasora_dae_init(void) {
     return WASORA_RUNTIME_ERROR;
   }
 #endif
+
+  // si todos los residuos se pueden derivar con numeros duales le damos
+  // a IDA el jacobiano exacto en lugar de que lo estime por diferencias
+  if (wasora_dae_dual_jacobian(1.0, NULL) == WASORA_RUNTIME_OK) {
+#if IDA_VERSION == 2
+    if (IDADlsSetDenseJacFn(wasora_dae.system, wasora_ida_dae_jacobian) != IDA_SUCCESS) {
+      return WASORA_RUNTIME_ERROR;
+    }
+#elif IDA_VERSION == 3
+    if (IDADlsSetJacFn(wasora_dae.system, wasora_ida_dae_jacobian) != IDA_SUCCESS) {
+      return WASORA_RUNTIME_ERROR;
+    }
+#endif
+  }
   
   if (IDASetInitStep(wasora_dae.system, wasora_var(wasora_special_var(dt))) != IDA_SUCCESS) {
     return WASORA_RUNTIME_ERROR;
@@ -253,6 +308,29 @@ int wasora_dae_init(void) {
     }
   }
   
+  // los eventos van a la funcion de rootfinding de IDA
+  if (wasora_dae.n_events != 0) {
+    if (IDARootInit(wasora_dae.system, wasora_dae.n_events, wasora_ida_dae_root) != IDA_SUCCESS) {
+      return WASORA_RUNTIME_ERROR;
+    }
+    direction = malloc(wasora_dae.n_events * sizeof(int));
+    i = 0;
+    LL_FOREACH(wasora_dae.events, event) {
+      direction[i++] = event->direction;
+    }
+    j = IDASetRootDirection(wasora_dae.system, direction);
+    free(direction);
+    if (j != IDA_SUCCESS) {
+      return WASORA_RUNTIME_ERROR;
+    }
+  }
+  
+#if HAVE_IDAS
+  if (wasora_dae.n_sensitivities != 0) {
+    wasora_call(wasora_dae_sensitivity_init());
+  }
+#endif
+  
   return WASORA_RUNTIME_OK;
 #else
 
@@ -280,12 +358,204 @@ int wasora_dae_ic(void) {
     }
   }  
   
+ #if HAVE_IDAS
+  if (wasora_dae.yS != NULL) {
+    // IDACalcIC also makes the initial sensitivities consistent
+    if (wasora_dae.initial_conditions_mode != as_provided && IDAGetSensConsistentIC(wasora_dae.system, wasora_dae.yS, wasora_dae.ypS) != IDA_SUCCESS) {
+      wasora_push_error_message("cannot retrieve the initial sensitivities");
+      return WASORA_RUNTIME_ERROR;
+    }
+    wasora_dae_store_sensitivities();
+  }
+ #endif
+#endif
+  return WASORA_RUNTIME_OK;
+}
+
+// copies the sensitivities at the last time returned by IDASolve to the
+// d<x>_d<p> objects and, if needed, appends them to their time history
+int wasora_dae_get_sensitivities(void) {
+  
+#if HAVE_IDAS
+  realtype t;
+  
+  if (wasora_dae.yS == NULL) {
+    return WASORA_RUNTIME_OK;
+  }
+  
+  if (IDAGetSens(wasora_dae.system, &t, wasora_dae.yS) != IDA_SUCCESS) {
+    wasora_push_error_message("cannot retrieve the sensitivities at t = %g", wasora_var(wasora_special_var(time)));
+    return WASORA_RUNTIME_ERROR;
+  }
+  wasora_dae_store_sensitivities();
+#endif
+  
+  return WASORA_RUNTIME_OK;
+}
+
+// puts the phase space (and the sensitivities, if any) at time t, which has
+// to be within the last step ida took, using its interpolating polynomial
+int wasora_dae_interpolate(double t) {
+  
+#ifdef HAVE_IDA
+  int k;
+  
+  if (IDAGetDky(wasora_dae.system, t, 0, wasora_dae.x) != IDA_SUCCESS ||
+      IDAGetDky(wasora_dae.system, t, 1, wasora_dae.dxdt) != IDA_SUCCESS) {
+    wasora_push_error_message("cannot interpolate the DAE solution at t = %g", t);
+    return WASORA_RUNTIME_ERROR;
+  }
+  for (k = 0; k < wasora_dae.dimension; k++) {
+    *(wasora_dae.phase_value[k]) = NV_DATA_S(wasora_dae.x)[k];
+    *(wasora_dae.phase_derivative[k]) = NV_DATA_S(wasora_dae.dxdt)[k];
+  }
+  
+ #if HAVE_IDAS
+  if (wasora_dae.yS != NULL) {
+    if (IDAGetSensDky(wasora_dae.system, t, 0, wasora_dae.yS) != IDA_SUCCESS) {
+      wasora_push_error_message("cannot interpolate the sensitivities at t = %g", t);
+      return WASORA_RUNTIME_ERROR;
+    }
+    wasora_dae_store_sensitivities();
+  }
+ #endif
+#endif
+  
+  return WASORA_RUNTIME_OK;
+}
+
+// restarts the integration after an event from the state the instructions
+// left at the time of the event, which may have a discontinuity
+int wasora_dae_reinit(void) {
+  
+#ifdef HAVE_IDA
+  int err, k;
+  
+ #if HAVE_IDAS
+  if (wasora_dae.yS != NULL && IDAGetSensDky(wasora_dae.system, wasora_var(wasora_special_var(time)), 1, wasora_dae.ypS) != IDA_SUCCESS) {
+    wasora_push_error_message("cannot retrieve the derivatives of the sensitivities at t = %g", wasora_var(wasora_special_var(time)));
+    return WASORA_RUNTIME_ERROR;
+  }
+ #endif
+  
+  for (k = 0; k < wasora_dae.dimension; k++) {
+    NV_DATA_S(wasora_dae.x)[k] = *(wasora_dae.phase_value[k]);
+    NV_DATA_S(wasora_dae.dxdt)[k] = *(wasora_dae.phase_derivative[k]);
+  }
+  
+  if (IDAReInit(wasora_dae.system, wasora_var(wasora_special_var(time)), wasora_dae.x, wasora_dae.dxdt) != IDA_SUCCESS) {
+    wasora_push_error_message("cannot re-initialize the DAE solver at t = %g", wasora_var(wasora_special_var(time)));
+    return WASORA_RUNTIME_ERROR;
+  }
+ #if HAVE_IDAS
+  if (wasora_dae.yS != NULL && IDASensReInit(wasora_dae.system, IDA_STAGGERED, wasora_dae.yS, wasora_dae.ypS) != IDA_SUCCESS) {
+    wasora_push_error_message("cannot re-initialize the sensitivities at t = %g", wasora_var(wasora_special_var(time)));
+    return WASORA_RUNTIME_ERROR;
+  }
+ #endif
+  
+  // the algebraic variables and the derivatives may have jumped as well
+  if (wasora_dae.initial_conditions_mode == from_variables) {
+    if ((err = IDACalcIC(wasora_dae.system, IDA_YA_YDP_INIT, wasora_var(wasora_special_var(time)) + wasora_var(wasora_special_var(dt)))) != IDA_SUCCESS) {
+      wasora_push_error_message("error computing consistent conditions after the event at t = %g, error = %d", wasora_var(wasora_special_var(time)), err);
+      return WASORA_RUNTIME_ERROR;
+    }
+    if (IDAGetConsistentIC(wasora_dae.system, wasora_dae.x, wasora_dae.dxdt) != IDA_SUCCESS) {
+      return WASORA_RUNTIME_ERROR;
+    }
+    for (k = 0; k < wasora_dae.dimension; k++) {
+      *(wasora_dae.phase_value[k]) = NV_DATA_S(wasora_dae.x)[k];
+      *(wasora_dae.phase_derivative[k]) = NV_DATA_S(wasora_dae.dxdt)[k];
+    }
+ #if HAVE_IDAS
+    if (wasora_dae.yS != NULL && IDAGetSensConsistentIC(wasora_dae.system, wasora_dae.yS, wasora_dae.ypS) != IDA_SUCCESS) {
+      return WASORA_RUNTIME_ERROR;
+    }
+ #endif
+  }
 #endif
+  
   return WASORA_RUNTIME_OK;
 }
 
+// linear interpolation of the history of the sensitivity with respect to the
+// j-th parameter, constant outside the integrated range
+double wasora_dae_sensitivity_history(int j, double t) {
+  
+  int i;
+  int n = wasora_dae.sensitivity_history.n;
+  double *time = wasora_dae.sensitivity_history.time;
+  double *value;
+  
+  if (n == 0) {
+    return 0;
+  }
+  value = wasora_dae.sensitivity_history.value[j];
+  
+  if (t <= time[0]) {
+    return value[0];
+  } else if (t >= time[n-1]) {
+    return value[n-1];
+  }
+  
+  i = gsl_interp_bsearch(time, t, 0, n-1);
+  if (time[i+1] == time[i]) {
+    return value[i+1];
+  }
+  
+  return value[i] + (value[i+1]-value[i]) * (t-time[i])/(time[i+1]-time[i]);
+}
+
+void wasora_dae_free_sensitivities(void) {
+  
+  int j;
+  
+#if HAVE_IDAS
+  if (wasora_dae.yS != NULL) {
+    N_VDestroyVectorArray_Serial(wasora_dae.yS, wasora_dae.n_sensitivities);
+    N_VDestroyVectorArray_Serial(wasora_dae.ypS, wasora_dae.n_sensitivities);
+    wasora_dae.yS = NULL;
+    wasora_dae.ypS = NULL;
+  }
+#endif
+  
+  if (wasora_dae.sensitivity_history.value != NULL) {
+    for (j = 0; j < wasora_dae.n_sensitivities; j++) {
+      free(wasora_dae.sensitivity_history.value[j]);
+    }
+  }
+  wasora_free(wasora_dae.sensitivity_history.value);
+  wasora_free(wasora_dae.sensitivity_history.time);
+  wasora_dae.sensitivity_history.size = 0;
+  wasora_dae.sensitivity_history.n = 0;
+  
+  wasora_free(wasora_dae.phase_sensitivity);
+  
+  return;
+}
+
 
 #ifdef HAVE_IDA
+// the event expressions evaluated at the state IDA asks for
+int wasora_ida_dae_root(realtype t, N_Vector yy, N_Vector yp, realtype *gout, void *params) {
+  
+  int i, k;
+  event_t *event;
+  
+  wasora_var(wasora_special_var(time)) = t;
+  for (k = 0; k < wasora_dae.dimension; k++) {
+    *(wasora_dae.phase_value[k]) = NV_DATA_S(yy)[k];
+    *(wasora_dae.phase_derivative[k]) = NV_DATA_S(yp)[k];
+  }
+  
+  i = 0;
+  LL_FOREACH(wasora_dae.events, event) {
+    gout[i++] = wasora_evaluate_expression(&event->condition);
+  }
+  
+  return 0;
+}
+
 int wasora_ida_dae(realtype t, N_Vector yy, N_Vector yp, N_Vector rr, void *params) {
 
   int i, j, k;
@@ -296,6 +566,10 @@ int wasora_ida_dae(realtype t, N_Vector yy, N_Vector yp, N_Vector rr, void *para
   //  si hay residuos que dependen explicitamente del tiempo
   wasora_var(wasora_special_var(time)) = t;
 
+  if (wasora.profile.enabled) {
+    wasora_profile_push(wasora_profile_entry("residual", "IDA residual"));
+  }
+  
   // copiamos el estado del solver de IDA a wasora
   for (k = 0; k < wasora_dae.dimension; k++) {
     *(wasora_dae.phase_value[k]) = NV_DATA_S(yy)[k];
@@ -335,6 +609,10 @@ int wasora_ida_dae(realtype t, N_Vector yy, N_Vector yp, N_Vector rr, void *para
     }
   }
   
+  if (wasora.profile.enabled) {
+    wasora_profile_pop();
+  }
+  
 #else
  int wasora_ida_dae(void) {
 #endif
@@ -343,6 +621,343 @@ int wasora_ida_dae(realtype t, N_Vector yy, N_Vector yp, N_Vector rr, void *para
 
 }
 
+
+#ifdef HAVE_IDA
+// evalua las derivadas de todos los residuos con respecto a los n_wrt valores
+// apuntados por wrt con numeros duales y las deja en d (por filas)
+// si d es NULL solamente verifica que todos los residuos se puedan derivar
+static int wasora_dae_dual_residuals(int n_wrt, double **wrt, double *d) {
+
+  int i, j, k;
+  int status = WASORA_RUNTIME_OK;
+  double *row;
+  double value;
+  dae_t *dae;
+  
+  row = malloc(n_wrt * sizeof(double));
+  
+  k = 0;
+  LL_FOREACH(wasora_dae.daes, dae) {
+    for (i = (dae->i_max == 0) ? 0 : dae->i_min; status == WASORA_RUNTIME_OK && i < ((dae->i_max == 0) ? 1 : dae->i_max); i++) {
+      if (dae->i_max != 0) {
+        wasora_var(wasora_special_var(i)) = (double)i+1;
+      }
+      for (j = (dae->j_max == 0) ? 0 : dae->j_min; status == WASORA_RUNTIME_OK && j < ((dae->j_max == 0) ? 1 : dae->j_max); j++) {
+        if (dae->j_max != 0) {
+          wasora_var(wasora_special_var(j)) = (double)j+1;
+        }
+        
+        if ((status = wasora_evaluate_expression_dual(&dae->residual, n_wrt, wrt, &value, row)) == WASORA_RUNTIME_OK && d != NULL) {
+          memcpy(d + k*n_wrt, row, n_wrt * sizeof(double));
+        }
+        k++;
+      }
+    }
+  }
+  
+  free(row);
+  
+  return status;
+}
+
+// evalua dF/dy + cj dF/dy' con numeros duales y lo deja en jac (por filas)
+// si jac es NULL solamente verifica que todos los residuos se puedan derivar
+int wasora_dae_dual_jacobian(double cj, double *jac) {
+
+  int k, l;
+  int n = wasora_dae.dimension;
+  int status;
+  double **wrt;
+  double *d;
+  
+  // las semillas son primero las variables y despues sus derivadas
+  wrt = malloc(2*n * sizeof(double *));
+  for (l = 0; l < n; l++) {
+    wrt[l] = wasora_dae.phase_value[l];
+    wrt[n+l] = wasora_dae.phase_derivative[l];
+  }
+  
+  d = (jac != NULL) ? malloc(n*2*n * sizeof(double)) : NULL;
+  if ((status = wasora_dae_dual_residuals(2*n, wrt, d)) == WASORA_RUNTIME_OK && jac != NULL) {
+    for (k = 0; k < n; k++) {
+      for (l = 0; l < n; l++) {
+        jac[k*n + l] = d[k*2*n + l] + cj*d[k*2*n + n+l];
+      }
+    }
+  }
+  
+  free(d);
+  free(wrt);
+  
+  return status;
+}
+
+#if IDA_VERSION == 2
+int wasora_ida_dae_jacobian(long int N, realtype t, realtype cj, N_Vector yy, N_Vector yp, N_Vector rr, DlsMat J, void *params, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+#elif IDA_VERSION == 3
+int wasora_ida_dae_jacobian(realtype t, realtype cj, N_Vector yy, N_Vector yp, N_Vector rr, SUNMatrix J, void *params, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+#endif
+
+  int k, l;
+  int n = wasora_dae.dimension;
+  double *jac;
+  
+  wasora_var(wasora_special_var(time)) = t;
+  for (k = 0; k < n; k++) {
+    *(wasora_dae.phase_value[k]) = NV_DATA_S(yy)[k];
+    *(wasora_dae.phase_derivative[k]) = NV_DATA_S(yp)[k];
+  }
+  
+  jac = malloc(n*n * sizeof(double));
+  // the residuals could be differentiated when the callback was registered so
+  // this should not happen, anyway a positive value asks IDA to retry with a
+  // smaller step instead of giving up
+  if (wasora_dae_dual_jacobian(cj, jac) != WASORA_RUNTIME_OK) {
+    free(jac);
+    return 1;
+  }
+  
+  for (k = 0; k < n; k++) {
+    for (l = 0; l < n; l++) {
+#if IDA_VERSION == 2
+      DENSE_ELEM(J, k, l) = jac[k*n + l];
+#elif IDA_VERSION == 3
+      SM_ELEMENT_D(J, k, l) = jac[k*n + l];
+#endif
+    }
+  }
+  
+  free(jac);
+  
+  return 0;
+}
+#endif
+
+
+#if HAVE_IDAS
+// the seeds for the sensitivities are the phase space, its derivatives and the parameters
+static double **wasora_dae_sensitivity_wrt(void) {
+  
+  int n = wasora_dae.dimension;
+  int l;
+  double **wrt;
+  
+  wrt = malloc((2*n + wasora_dae.n_sensitivities) * sizeof(double *));
+  for (l = 0; l < n; l++) {
+    wrt[l] = wasora_dae.phase_value[l];
+    wrt[n+l] = wasora_dae.phase_derivative[l];
+  }
+  for (l = 0; l < wasora_dae.n_sensitivities; l++) {
+    wrt[2*n+l] = wasora_value_ptr(wasora_dae.sensitivity_parameter[l]);
+  }
+  
+  return wrt;
+}
+
+// if the initial conditions are given as they are, the initial values of
+// the differential objects do not depend on the parameters so we solve
+// dF/dy yS + dF/dy' ypS + dF/dp = 0 for the derivatives of the differential
+// components and for the values of the algebraic ones
+static void wasora_dae_sensitivity_ic(double *d) {
+
+  int n = wasora_dae.dimension;
+  int n_wrt = 2*n + wasora_dae.n_sensitivities;
+  int *differential;
+  int j, k, l, signum;
+  gsl_matrix *M;
+  gsl_vector *b, *z;
+  gsl_permutation *perm;
+  
+  // a component is differential if its derivative appears in the residuals
+  differential = calloc(n, sizeof(int));
+  for (k = 0; k < n; k++) {
+    for (l = 0; l < n; l++) {
+      if (d[k*n_wrt + n+l] != 0) {
+        differential[l] = 1;
+      }
+    }
+  }
+  
+  M = gsl_matrix_alloc(n, n);
+  for (k = 0; k < n; k++) {
+    for (l = 0; l < n; l++) {
+      gsl_matrix_set(M, k, l, d[k*n_wrt + (differential[l] ? n+l : l)]);
+    }
+  }
+  
+  perm = gsl_permutation_alloc(n);
+  gsl_linalg_LU_decomp(M, perm, &signum);
+  // if the system is singular we just start from zero and let IDA correct
+  if (gsl_linalg_LU_det(M, signum) != 0) {
+    b = gsl_vector_alloc(n);
+    z = gsl_vector_alloc(n);
+    for (j = 0; j < wasora_dae.n_sensitivities; j++) {
+      for (k = 0; k < n; k++) {
+        gsl_vector_set(b, k, -d[k*n_wrt + 2*n+j]);
+      }
+      gsl_linalg_LU_solve(M, perm, b, z);
+      for (l = 0; l < n; l++) {
+        if (differential[l]) {
+          NV_DATA_S(wasora_dae.ypS[j])[l] = gsl_vector_get(z, l);
+        } else {
+          NV_DATA_S(wasora_dae.yS[j])[l] = gsl_vector_get(z, l);
+        }
+      }
+    }
+    gsl_vector_free(z);
+    gsl_vector_free(b);
+  }
+  
+  gsl_permutation_free(perm);
+  gsl_matrix_free(M);
+  free(differential);
+  
+  return;
+}
+
+static int wasora_dae_sensitivity_init(void) {
+
+  int Ns = wasora_dae.n_sensitivities;
+  int n = wasora_dae.dimension;
+  int dual;
+  int j;
+  int *plist;
+  double *pbar;
+  double **wrt;
+  double *d;
+  double *p;
+  
+  wasora_dae.yS = N_VCloneVectorArray_Serial(Ns, wasora_dae.x);
+  wasora_dae.ypS = N_VCloneVectorArray_Serial(Ns, wasora_dae.x);
+  for (j = 0; j < Ns; j++) {
+    N_VConst(0, wasora_dae.yS[j]);
+    N_VConst(0, wasora_dae.ypS[j]);
+  }
+  
+  // if the residuals can be differentiated with dual numbers, we give IDAS
+  // the exact right-hand side of the sensitivity equations
+  wrt = wasora_dae_sensitivity_wrt();
+  d = malloc(n*(2*n+Ns) * sizeof(double));
+  if ((dual = (wasora_dae_dual_residuals(2*n+Ns, wrt, d) == WASORA_RUNTIME_OK)) && wasora_dae.initial_conditions_mode == as_provided) {
+    wasora_dae_sensitivity_ic(d);
+  }
+  free(d);
+  free(wrt);
+  
+  if (IDASensInit(wasora_dae.system, Ns, IDA_STAGGERED, dual ? wasora_ida_dae_sensitivity : NULL, wasora_dae.yS, wasora_dae.ypS) != IDA_SUCCESS) {
+    wasora_push_error_message("cannot initialize the sensitivity equations");
+    return WASORA_RUNTIME_ERROR;
+  }
+  
+  plist = malloc(Ns * sizeof(int));
+  pbar = malloc(Ns * sizeof(double));
+  for (j = 0; j < Ns; j++) {
+    pbar[j] = (wasora_value(wasora_dae.sensitivity_parameter[j]) != 0) ? fabs(wasora_value(wasora_dae.sensitivity_parameter[j])) : 1.0;
+    // otherwise IDAS perturbs the parameters in place to compute difference
+    // quotients, it sees them as offsets from the start of the arena
+    plist[j] = wasora_value_ptr(wasora_dae.sensitivity_parameter[j]) - wasora.arena.value;
+    if (dual == 0 && (wasora.arena.value == NULL || plist[j] < 0 || plist[j] >= wasora.arena.size)) {
+      wasora_push_error_message("parameter '%s' cannot be perturbed to compute its sensitivity", wasora_dae.sensitivity_parameter[j]->name);
+      free(plist);
+      free(pbar);
+      return WASORA_RUNTIME_ERROR;
+    }
+  }
+  p = dual ? NULL : wasora.arena.value;
+  if (IDASetSensParams(wasora_dae.system, p, pbar, dual ? NULL : plist) != IDA_SUCCESS) {
+    free(plist);
+    free(pbar);
+    return WASORA_RUNTIME_ERROR;
+  }
+  free(plist);
+  free(pbar);
+  
+  if (IDASensEEtolerances(wasora_dae.system) != IDA_SUCCESS) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  if (IDASetSensErrCon(wasora_dae.system, 1) != IDA_SUCCESS) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  
+  return WASORA_RUNTIME_OK;
+}
+
+// right-hand side of the sensitivity equations dF/dy yS + dF/dy' ypS + dF/dp
+int wasora_ida_dae_sensitivity(int Ns, realtype t, N_Vector yy, N_Vector yp, N_Vector rr, N_Vector *yS, N_Vector *ypS, N_Vector *rrS, void *params, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+  
+  int j, k, l;
+  int n = wasora_dae.dimension;
+  int n_wrt = 2*n + Ns;
+  double **wrt;
+  double *d;
+  double sum;
+  
+  wasora_var(wasora_special_var(time)) = t;
+  for (k = 0; k < n; k++) {
+    *(wasora_dae.phase_value[k]) = NV_DATA_S(yy)[k];
+    *(wasora_dae.phase_derivative[k]) = NV_DATA_S(yp)[k];
+  }
+  
+  wrt = wasora_dae_sensitivity_wrt();
+  d = malloc(n*n_wrt * sizeof(double));
+  if (wasora_dae_dual_residuals(n_wrt, wrt, d) != WASORA_RUNTIME_OK) {
+    free(d);
+    free(wrt);
+    return 1;
+  }
+  
+  for (j = 0; j < Ns; j++) {
+    for (k = 0; k < n; k++) {
+      sum = d[k*n_wrt + 2*n+j];
+      for (l = 0; l < n; l++) {
+        sum += d[k*n_wrt + l]*NV_DATA_S(yS[j])[l] + d[k*n_wrt + n+l]*NV_DATA_S(ypS[j])[l];
+      }
+      NV_DATA_S(rrS[j])[k] = sum;
+    }
+  }
+  
+  free(d);
+  free(wrt);
+  
+  return 0;
+}
+
+static void wasora_dae_store_sensitivities(void) {
+  
+  int j, k;
+  int n = wasora_dae.dimension;
+  int offset;
+  
+  for (j = 0; j < wasora_dae.n_sensitivities; j++) {
+    for (k = 0; k < n; k++) {
+      *(wasora_dae.phase_sensitivity[j*n + k]) = NV_DATA_S(wasora_dae.yS[j])[k];
+    }
+  }
+  
+  if (wasora_dae.sensitivity_history.phase_object != NULL) {
+    if (wasora_dae.sensitivity_history.n >= wasora_dae.sensitivity_history.size) {
+      wasora_dae.sensitivity_history.size = (wasora_dae.sensitivity_history.size == 0) ? 256 : 2*wasora_dae.sensitivity_history.size;
+      wasora_dae.sensitivity_history.time = realloc(wasora_dae.sensitivity_history.time, wasora_dae.sensitivity_history.size * sizeof(double));
+      if (wasora_dae.sensitivity_history.value == NULL) {
+        wasora_dae.sensitivity_history.value = calloc(wasora_dae.n_sensitivities, sizeof(double *));
+      }
+      for (j = 0; j < wasora_dae.n_sensitivities; j++) {
+        wasora_dae.sensitivity_history.value[j] = realloc(wasora_dae.sensitivity_history.value[j], wasora_dae.sensitivity_history.size * sizeof(double));
+      }
+    }
+    
+    offset = wasora_dae.sensitivity_history.phase_object->offset;
+    wasora_dae.sensitivity_history.time[wasora_dae.sensitivity_history.n] = wasora_var(wasora_special_var(time));
+    for (j = 0; j < wasora_dae.n_sensitivities; j++) {
+      wasora_dae.sensitivity_history.value[j][wasora_dae.sensitivity_history.n] = NV_DATA_S(wasora_dae.yS[j])[offset];
+    }
+    wasora_dae.sensitivity_history.n++;
+  }
+  
+  return;
+}
+#endif
+
 // instruccion dummy
 int wasora_instruction_dae(void *arg) {
   
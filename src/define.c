@@ -40,7 +40,7 @@ void wasora_realloc_variable_ptr(var_t *var, double *newptr, int copy_contents)
   
   // si el puntero es de wasora, lo liberamos
   if (var->realloced == 0) {
-    free(wasora_value_ptr(var));
+    wasora_arena_free(wasora_value_ptr(var));
   }
   
   var->realloced = 1;
@@ -59,8 +59,8 @@ void wasora_realloc_vector_ptr(vector_t *vector, double *newptr, int copy_conten
     memcpy(newptr, oldptr, vector->size * sizeof(double));
   }
 
-  // si el puntero es de wasora, lo liberamos
-  if (vector->realloced == 0) {
+  // si el puntero es de wasora, lo liberamos (salvo que este en la arena)
+  if (vector->realloced == 0 && wasora_arena_contains(oldptr) == 0) {
     if (wasora_value_ptr(vector)->stride != 1) {
       wasora_push_error_message("vector '%s' cannot be realloced: stride not equal to 1", vector->name);
       wasora_runtime_error();
@@ -94,7 +94,7 @@ void wasora_realloc_matrix_ptr(matrix_t *matrix, double *newptr, int copy_conten
   }
   
   // si el puntero es de wasora, lo liberamos
-  if (matrix->realloced == 0) {
+  if (matrix->realloced == 0 && wasora_arena_contains(oldptr) == 0) {
     free(oldptr);
   }
   
@@ -280,6 +280,8 @@ instruction_t *wasora_define_instruction(int (*routine)(void *), void *argument)
 
   instruction->routine = routine;
   instruction->argument = argument;
+  instruction->file = (wasora.parsing_file != NULL) ? strdup(wasora.parsing_file) : NULL;
+  instruction->line = wasora.parsing_line;
   if (wasora.active_conditional_block != NULL) {
     if (wasora.active_conditional_block->else_of == NULL && wasora.active_conditional_block->first_true_instruction == NULL) {
       wasora.active_conditional_block->first_true_instruction = instruction;
@@ -0,0 +1,517 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora forward-mode automatic differentiation of expressions
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#ifndef _WASORA_H_
+#include "wasora.h"
+#endif
+
+#include "builtindecl.h"
+
+extern const char operators[];
+
+static int wasora_dual_builtin(factor_t *factor, int n, double **wrt, double *value, double *d);
+static int wasora_dual_function(factor_t *factor, int n, double **wrt, double *value, double *d);
+
+// looks for the seed whose value lives at ptr, the last ones win so the
+// arguments of nested functions shadow outer variables with the same name
+static int wasora_dual_seed(int n, double **wrt, const double *ptr) {
+  int k;
+
+  for (k = n-1; k >= 0; k--) {
+    if (wrt[k] == ptr) {
+      return k;
+    }
+  }
+
+  return -1;
+}
+
+
+// evaluates the expression and its n derivatives with respect to the values
+// pointed by wrt (variables, vector or matrix elements) in a single pass
+// it returns WASORA_RUNTIME_ERROR without any error message if the expression
+// contains something that cannot be differentiated (i.e. functionals or
+// builtins with memory such as lag or integral_dt) so the caller can fall back
+// to finite differences
+int wasora_evaluate_expression_dual(expr_t *expr, int n, double **wrt, double *value, double *derivative) {
+
+  int i, k;
+  int level;
+  int n_tokens;
+  int index_i, index_j;
+  int seed;
+  int status = WASORA_RUNTIME_OK;
+  double p, e;
+  double *d, *dP, *dE;
+  factor_t *token;
+  factor_t *E,*P;
+
+  *value = 0;
+  for (k = 0; k < n; k++) {
+    derivative[k] = 0;
+  }
+
+  if (expr == NULL || (token = expr->token) == NULL || (n_tokens = expr->n_tokens) == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  // the tangents of each token, one after the other
+  d = calloc(n_tokens*n+1, sizeof(double));
+
+  for (i = 0; status == WASORA_RUNTIME_OK && i < n_tokens; i++) {
+    token[i].tmp_level = token[i].level;
+    seed = -1;
+
+    switch(token[i].type & EXPR_BASICTYPE_MASK) {
+      case EXPR_OPERATOR:
+        // operators are applied below in the reduction, their tangents stay at zero
+      break;
+
+      case EXPR_CONSTANT:
+        token[i].value = token[i].constant;
+      break;
+
+      case EXPR_VARIABLE:
+        switch (token[i].type) {
+          case EXPR_VARIABLE | EXPR_CURRENT:
+            token[i].value = wasora_value(token[i].variable);
+            seed = wasora_dual_seed(n, wrt, wasora_value_ptr(token[i].variable));
+          break;
+          case EXPR_VARIABLE | EXPR_INITIAL_TRANSIENT:
+            token[i].value = token[i].variable->initial_transient[0];
+          break;
+          case EXPR_VARIABLE | EXPR_INITIAL_STATIC:
+            token[i].value = token[i].variable->initial_static[0];
+          break;
+        }
+      break;
+
+      case EXPR_VECTOR:
+        if (!token[i].vector->initialized && wasora_vector_init(token[i].vector) != WASORA_RUNTIME_OK) {
+          status = WASORA_RUNTIME_ERROR;
+          break;
+        }
+
+        index_i = lrint(wasora_evaluate_expression(&token[i].arg[0]));
+        if (index_i <= 0 || index_i > token[i].vector->size) {
+          status = WASORA_RUNTIME_ERROR;
+          break;
+        }
+
+        switch (token[i].type) {
+          case EXPR_VECTOR | EXPR_CURRENT:
+            token[i].value = wasora_vector_get(token[i].vector, index_i-1);
+            seed = wasora_dual_seed(n, wrt, gsl_vector_ptr(wasora_value_ptr(token[i].vector), index_i-1));
+          break;
+          case EXPR_VECTOR | EXPR_INITIAL_TRANSIENT:
+            token[i].value = wasora_vector_get_initial_transient(token[i].vector, index_i-1);
+          break;
+          case EXPR_VECTOR | EXPR_INITIAL_STATIC:
+            token[i].value = wasora_vector_get_initial_static(token[i].vector, index_i-1);
+          break;
+        }
+      break;
+
+      case EXPR_MATRIX:
+        if (!token[i].matrix->initialized && wasora_matrix_init(token[i].matrix) != WASORA_RUNTIME_OK) {
+          status = WASORA_RUNTIME_ERROR;
+          break;
+        }
+
+        index_i = lrint(wasora_evaluate_expression(&token[i].arg[0]));
+        index_j = lrint(wasora_evaluate_expression(&token[i].arg[1]));
+        if (index_i <= 0 || index_i > token[i].matrix->rows || index_j <= 0 || index_j > token[i].matrix->cols) {
+          status = WASORA_RUNTIME_ERROR;
+          break;
+        }
+
+        switch (token[i].type) {
+          case EXPR_MATRIX | EXPR_CURRENT:
+            token[i].value = gsl_matrix_get(wasora_value_ptr(token[i].matrix), index_i-1, index_j-1);
+            seed = wasora_dual_seed(n, wrt, gsl_matrix_ptr(wasora_value_ptr(token[i].matrix), index_i-1, index_j-1));
+          break;
+          case EXPR_MATRIX | EXPR_INITIAL_TRANSIENT:
+            token[i].value = gsl_matrix_get(token[i].matrix->initial_transient, index_i-1, index_j-1);
+          break;
+          case EXPR_MATRIX | EXPR_INITIAL_STATIC:
+            token[i].value = gsl_matrix_get(token[i].matrix->initial_static, index_i-1, index_j-1);
+          break;
+        }
+      break;
+
+      case EXPR_BUILTIN_FUNCTION:
+        status = wasora_dual_builtin(&token[i], n, wrt, &token[i].value, &d[i*n]);
+      break;
+      case EXPR_FUNCTION:
+        status = wasora_dual_function(&token[i], n, wrt, &token[i].value, &d[i*n]);
+      break;
+      default:
+        // vector functions and functionals
+        status = WASORA_RUNTIME_ERROR;
+      break;
+    }
+
+    if (seed >= 0) {
+      d[i*n + seed] = 1;
+    }
+  }
+
+  if (status != WASORA_RUNTIME_OK) {
+    free(d);
+    return status;
+  }
+
+  level = 0;
+  for (i = 0; i < n_tokens; i++) {
+    if (token[i].level > level) {
+      level = token[i].level;
+    }
+  }
+
+  // same reduction as wasora_evaluate_expression() carrying the tangents along
+  while (level > 0) {
+
+    for (E = P = token; E != &token[n_tokens]; E->tmp_level != 0 && !E->oper?P=E:0,++E) {
+      if (E->tmp_level == level && E->oper != 0) {
+        char op = operators[(E++)->oper-1];
+
+        p = P->value;
+        e = E->value;
+        dP = &d[(P-token)*n];
+        dE = &d[(E-token)*n];
+
+        switch(op) {
+          case '&':
+          case '|':
+          case '=':
+          case '!':
+          case '<':
+          case '>':
+            // logical operators are piecewise constant
+            if (op == '&') {
+              P->value = (int)p & (int)e;
+            } else if (op == '|') {
+              P->value = (int)p | (int)e;
+            } else if (op == '<') {
+              P->value = p < e;
+            } else if (op == '>') {
+              P->value = p > e;
+            } else {
+              if (fabs(p) < 1 || fabs(e) < 1) {
+                P->value = (fabs(p - e) < wasora_var(wasora_special_var(zero)));
+              } else {
+                P->value = (gsl_fcmp(p, e, wasora_var(wasora_special_var(zero))) == 0);
+              }
+              if (op == '!') {
+                P->value = !P->value;
+              }
+            }
+            for (k = 0; k < n; k++) {
+              dP[k] = 0;
+            }
+          break;
+          case '+':
+            P->value = p + e;
+            for (k = 0; k < n; k++) {
+              dP[k] += dE[k];
+            }
+          break;
+          case '-':
+            P->value = p - e;
+            for (k = 0; k < n; k++) {
+              dP[k] -= dE[k];
+            }
+          break;
+          case '*':
+            P->value = p * e;
+            for (k = 0; k < n; k++) {
+              dP[k] = dP[k]*e + p*dE[k];
+            }
+          break;
+          case '/':
+            P->value = p / e;
+            for (k = 0; k < n; k++) {
+              dP[k] = (dP[k]*e - p*dE[k])/(e*e);
+            }
+          break;
+          case '^':
+            P->value = pow(p, e);
+            for (k = 0; k < n; k++) {
+              if (dE[k] != 0 && p > 0) {
+                dP[k] = P->value * (dE[k]*log(p) + e*dP[k]/p);
+              } else if (dP[k] != 0) {
+                dP[k] = e*pow(p, e-1)*dP[k];
+              }
+            }
+          break;
+        }
+        E->tmp_level = 0;
+      }
+    }
+
+    level--;
+
+  }
+
+  *value = token[0].value;
+  for (k = 0; k < n; k++) {
+    derivative[k] = d[k];
+  }
+
+  free(d);
+
+  return WASORA_RUNTIME_OK;
+
+}
+
+
+static int wasora_dual_builtin(factor_t *factor, int n, double **wrt, double *value, double *d) {
+
+  double (*routine)(factor_t *) = factor->builtin_function->routine;
+  double u[MINMAX_ARGS];
+  double du[MINMAX_ARGS*n+1];
+  double eps, f1;
+  int n_args, i, j, k;
+
+  for (k = 0; k < n; k++) {
+    d[k] = 0;
+  }
+
+  // piecewise-constant functions have zero derivative and no memory
+  // so they can be evaluated as usual
+  if (routine == builtin_ceil || routine == builtin_floor || routine == builtin_round ||
+      routine == builtin_heaviside || routine == builtin_sgn || routine == builtin_not ||
+      routine == builtin_equal || routine == builtin_is_even || routine == builtin_is_odd ||
+      routine == builtin_is_in_interval) {
+    *value = routine(factor);
+    return WASORA_RUNTIME_OK;
+  }
+
+  // if has to evaluate only the branch it takes
+  if (routine == builtin_if) {
+    wasora_call(wasora_evaluate_expression_dual(&factor->arg[0], n, wrt, &u[0], du));
+    eps = (factor->arg[3].n_tokens != 0) ? wasora_evaluate_expression(&factor->arg[3]) : 1e-16;
+    i = (fabs(u[0]) > eps) ? 1 : 2;
+    if (factor->arg[i].n_tokens != 0) {
+      return wasora_evaluate_expression_dual(&factor->arg[i], n, wrt, value, d);
+    }
+    *value = (i == 1) ? 1.0 : 0.0;
+    return WASORA_RUNTIME_OK;
+  }
+
+  if (!(routine == builtin_abs  || routine == builtin_asin || routine == builtin_acos  ||
+        routine == builtin_atan || routine == builtin_cos  || routine == builtin_cosh  ||
+        routine == builtin_exp  || routine == builtin_log  || routine == builtin_sin   ||
+        routine == builtin_sinh || routine == builtin_sqrt || routine == builtin_tan   ||
+        routine == builtin_tanh || routine == builtin_j0   || routine == builtin_atan2 ||
+        routine == builtin_mod  || routine == builtin_min  || routine == builtin_max   ||
+        routine == builtin_limit)) {
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  for (n_args = 0; n_args < factor->builtin_function->max_arguments && factor->arg[n_args].n_tokens != 0; n_args++) {
+    wasora_call(wasora_evaluate_expression_dual(&factor->arg[n_args], n, wrt, &u[n_args], &du[n_args*n]));
+  }
+
+  if (routine == builtin_atan2) {
+    *value = atan2(u[0], u[1]);
+    for (k = 0; k < n; k++) {
+      d[k] = (u[1]*du[k] - u[0]*du[n+k])/(u[0]*u[0] + u[1]*u[1]);
+    }
+    return WASORA_RUNTIME_OK;
+
+  } else if (routine == builtin_mod) {
+    if (u[1] == 0) {
+      *value = 0;
+    } else {
+      *value = u[0] - floor(u[0]/u[1])*u[1];
+      for (k = 0; k < n; k++) {
+        d[k] = du[k] - floor(u[0]/u[1])*du[n+k];
+      }
+    }
+    return WASORA_RUNTIME_OK;
+
+  } else if (routine == builtin_min || routine == builtin_max || routine == builtin_limit) {
+    // the derivative is the one of the argument that is selected
+    j = 0;
+    if (routine == builtin_limit) {
+      j = (u[0] < u[1]) ? 1 : ((u[0] > u[2]) ? 2 : 0);
+    } else {
+      for (i = 1; i < n_args; i++) {
+        if ((routine == builtin_min && u[i] < u[j]) || (routine == builtin_max && u[i] > u[j])) {
+          j = i;
+        }
+      }
+    }
+    *value = u[j];
+    for (k = 0; k < n; k++) {
+      d[k] = du[j*n+k];
+    }
+    return WASORA_RUNTIME_OK;
+  }
+
+  // one-argument functions, f1 is the derivative with respect to the argument
+  if (routine == builtin_abs) {
+    *value = fabs(u[0]);
+    f1 = (u[0] > 0) ? 1 : ((u[0] < 0) ? -1 : 0);
+  } else if (routine == builtin_asin) {
+    *value = asin(u[0]);
+    f1 = 1.0/sqrt(1-u[0]*u[0]);
+  } else if (routine == builtin_acos) {
+    *value = acos(u[0]);
+    f1 = -1.0/sqrt(1-u[0]*u[0]);
+  } else if (routine == builtin_atan) {
+    *value = atan(u[0]);
+    f1 = 1.0/(1+u[0]*u[0]);
+  } else if (routine == builtin_cos) {
+    *value = cos(u[0]);
+    f1 = -sin(u[0]);
+  } else if (routine == builtin_cosh) {
+    *value = cosh(u[0]);
+    f1 = sinh(u[0]);
+  } else if (routine == builtin_exp) {
+    *value = exp(u[0]);
+    f1 = *value;
+  } else if (routine == builtin_log) {
+    *value = log(u[0]);
+    f1 = 1.0/u[0];
+  } else if (routine == builtin_sin) {
+    *value = sin(u[0]);
+    f1 = cos(u[0]);
+  } else if (routine == builtin_sinh) {
+    *value = sinh(u[0]);
+    f1 = cosh(u[0]);
+  } else if (routine == builtin_sqrt) {
+    *value = sqrt(u[0]);
+    f1 = 0.5/(*value);
+  } else if (routine == builtin_tan) {
+    *value = tan(u[0]);
+    f1 = 1 + (*value)*(*value);
+  } else if (routine == builtin_tanh) {
+    *value = tanh(u[0]);
+    f1 = 1 - (*value)*(*value);
+  } else {
+    // j0
+    *value = gsl_sf_bessel_J0(u[0]);
+    f1 = -gsl_sf_bessel_J1(u[0]);
+  }
+
+  for (k = 0; k < n; k++) {
+    d[k] = f1 * du[k];
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+// partial derivative of a non-algebraic function with respect to its i-th argument
+static double wasora_dual_function_partial(function_t *function, const double *a, int i) {
+
+  double a_pert[function->n_arguments];
+  double h, y_plus, y_minus;
+
+  // one-dimensional interpolated data know their own derivative
+  if (function->n_arguments == 1 && function->interp != NULL && function->data_size > 1 &&
+      a[0] >= function->data_argument[0][0] && a[0] <= function->data_argument[0][function->data_size-1]) {
+    return gsl_interp_eval_deriv(function->interp, function->data_argument[0], function->data_value, a[0], function->interp_accel);
+  }
+
+  // multidimensional interpolation, meshes and routines by centered differences
+  memcpy(a_pert, a, function->n_arguments*sizeof(double));
+  h = DEFAULT_DERIVATIVE_STEP * ((fabs(a[i]) > 1) ? fabs(a[i]) : 1);
+  a_pert[i] = a[i] + h;
+  y_plus = wasora_evaluate_function(function, a_pert);
+  a_pert[i] = a[i] - h;
+  y_minus = wasora_evaluate_function(function, a_pert);
+
+  return (y_plus - y_minus)/(2*h);
+}
+
+
+static int wasora_dual_function(factor_t *factor, int n, double **wrt, double *value, double *d) {
+
+  function_t *function = factor->function;
+  int m = function->n_arguments;
+  double a[m];
+  double da[m*n+1];
+  double dfda;
+  int i, k, nonzero;
+
+  for (k = 0; k < n; k++) {
+    d[k] = 0;
+  }
+
+  for (i = 0; i < m; i++) {
+    wasora_call(wasora_evaluate_expression_dual(&factor->arg[i], n, wrt, &a[i], &da[i*n]));
+  }
+
+  if (function->algebraic_expression.n_tokens != 0) {
+    // chain rule: the body is differentiated with respect to the original
+    // seeds and to its own arguments at the same time
+    double *wrt_ext[n+m];
+    double d_ext[n+m];
+    double old[m];
+    int status;
+
+    memcpy(wrt_ext, wrt, n*sizeof(double *));
+    for (i = 0; i < m; i++) {
+      wrt_ext[n+i] = wasora_value_ptr(function->var_argument[i]);
+      old[i] = wasora_value(function->var_argument[i]);
+      wasora_value(function->var_argument[i]) = a[i];
+    }
+
+    status = wasora_evaluate_expression_dual(&function->algebraic_expression, n+m, wrt_ext, value, d_ext);
+
+    for (i = 0; i < m; i++) {
+      wasora_value(function->var_argument[i]) = old[i];
+    }
+    if (status != WASORA_RUNTIME_OK) {
+      return status;
+    }
+
+    for (k = 0; k < n; k++) {
+      d[k] = d_ext[k];
+      for (i = 0; i < m; i++) {
+        d[k] += d_ext[n+i] * da[i*n+k];
+      }
+    }
+
+  } else {
+
+    *value = wasora_evaluate_function(function, a);
+    for (i = 0; i < m; i++) {
+      nonzero = 0;
+      for (k = 0; k < n; k++) {
+        if (da[i*n+k] != 0) {
+          nonzero = 1;
+        }
+      }
+      if (nonzero) {
+        dfda = wasora_dual_function_partial(function, a, i);
+        for (k = 0; k < n; k++) {
+          d[k] += dfda * da[i*n+k];
+        }
+      }
+    }
+  }
+
+  return WASORA_RUNTIME_OK;
+}
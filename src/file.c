@@ -24,6 +24,8 @@
 #include <errno.h>
 #include <string.h>
 #include <libgen.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 
 #ifndef _WASORA_H_
@@ -137,7 +139,12 @@ int wasora_instruction_open_file(void *arg) {
       wasora_push_error_message("unknown open mode for file '%s' ('%s')", file->name, file->path);
       return WASORA_RUNTIME_ERROR;
     }
-    if ((file->pointer = wasora_fopen(file->path, file->mode)) == NULL) {
+    if (wasora.mute_output && strcmp(file->mode, "r") != 0) {
+      file->pointer = fopen("/dev/null", "w");
+    } else {
+      file->pointer = wasora_fopen(file->path, file->mode);
+    }
+    if (file->pointer == NULL) {
       wasora_push_error_message("'%s' when opening file '%s' with mode '%s'", strerror(errno), file->path, file->mode);
       return WASORA_RUNTIME_ERROR;
     }
@@ -188,3 +195,29 @@ FILE *wasora_fopen(const char *filepath, const char *mode) {
   return handle;
   
 }
+
+// forked daughters that re-run the input for somebody else (the perturbed
+// runs of a fit, the local searches of a multi-start minimization) should
+// not write anything, so the standard output, the files already open for
+// writing and the ones they would open later all go to /dev/null
+int wasora_mute_output(void) {
+
+  file_t *file, *tmp;
+  int null;
+
+  if ((null = open("/dev/null", O_WRONLY)) == -1) {
+    wasora_push_error_message("cannot open /dev/null: %s", strerror(errno));
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  wasora.mute_output = 1;
+  dup2(null, STDOUT_FILENO);
+  HASH_ITER(hh, wasora.files, file, tmp) {
+    if (file->pointer != NULL && file->mode != NULL && strcmp(file->mode, "r") != 0 && fileno(file->pointer) > STDERR_FILENO) {
+      dup2(null, fileno(file->pointer));
+    }
+  }
+  close(null);
+
+  return WASORA_RUNTIME_OK;
+}
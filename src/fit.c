@@ -21,6 +21,10 @@
  */
 
 #include <stdio.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #ifndef _WASORA_H_
 #include "wasora.h"
@@ -39,7 +43,26 @@ int wasora_fit_run(void) {
   gsl_multifit_function_fdf f;
   gsl_matrix *covar = gsl_matrix_alloc (wasora.fit.p, wasora.fit.p);
   gsl_matrix *J = gsl_matrix_alloc(wasora.fit.n, wasora.fit.p); 
+  history_t *history;
+  phase_object_t *phase_object;
     
+  // with sensitivities and without explicit gradients, the fitted function
+  // has to be the history of a phase-space variable whose sensitivities we keep
+  if (wasora.fit.sensitivities && wasora.fit.gradient == NULL) {
+    LL_FOREACH(wasora.histories, history) {
+      if (history->function == wasora.fit.function) {
+        LL_FOREACH(wasora_dae.phase_objects, phase_object) {
+          if (phase_object->variable == history->variable) {
+            wasora_dae.sensitivity_history.phase_object = phase_object;
+          }
+        }
+      }
+    }
+    if (wasora_dae.sensitivity_history.phase_object == NULL) {
+      wasora_push_error_message("FIT with SENSITIVITIES needs either GRADIENT or '%s' to be the HISTORY of a phase-space variable", wasora.fit.function->name);
+      return WASORA_RUNTIME_ERROR;
+    }
+  }
 
   wasora_value(wasora_special_var(in_outer_initial)) = 1;
   wasora_value(wasora_special_var(step_outer)) = 0;
@@ -53,6 +76,19 @@ int wasora_fit_run(void) {
     gsl_vector_set(param, i, wasora_value(wasora.fit.param[i]));
   }
   
+  // pasos del gradiente numerico y lo que vale el modelo en cada paso
+  wasora.fit.h = malloc(wasora.fit.p * sizeof(double));
+  wasora.fit.model_param = malloc(wasora.fit.p * sizeof(double));
+  for (i = 0; i < wasora.fit.p; i++) {
+    wasora.fit.h[i] = DEFAULT_NLIN_FIT_GRAD_H;
+    wasora.fit.model_param[i] = GSL_NAN;
+  }
+  wasora.fit.model = calloc(wasora.fit.n, sizeof(double));
+  
+  // si no hay que volver a correr y la funcion es algebraica, el jacobiano
+  // sale exacto y en una sola pasada con numeros duales
+  wasora.fit.dual = (wasora.fit.norerun && wasora.fit.gradient == NULL && wasora.fit.function->algebraic_expression.n_tokens != 0);
+  
   f.f = &wasora_gsl_fit_f;
   f.df = &wasora_gsl_fit_df;
   f.fdf = &wasora_gsl_fit_fdf;
@@ -121,6 +157,13 @@ int wasora_fit_run(void) {
     }
   }
 
+  free(wasora.fit.model);
+  free(wasora.fit.model_param);
+  free(wasora.fit.h);
+  wasora.fit.model = NULL;
+  wasora.fit.model_param = NULL;
+  wasora.fit.h = NULL;
+  
   gsl_multifit_fdfsolver_free(s);
   gsl_matrix_free(covar);
   gsl_matrix_free(J);
@@ -177,9 +220,13 @@ int wasora_fit_compute_f(gsl_vector *f) {
       }
     }
     if (in_range) {
-      gsl_vector_set(f, j, wasora_evaluate_function(wasora.fit.function, x) - wasora.fit.data->data_value[j]);
+      wasora.fit.model[j] = wasora_evaluate_function(wasora.fit.function, x);
+      gsl_vector_set(f, j, wasora.fit.model[j] - wasora.fit.data->data_value[j]);
     }
   }
+  for (i = 0; i < wasora.fit.p; i++) {
+    wasora.fit.model_param[i] = wasora_value(wasora.fit.param[i]);
+  }
 
   if (range_min != NULL) {
     free(range_min);
@@ -226,22 +273,22 @@ void wasora_fit_compute_analytical_df(gsl_matrix *J) {
   return;
 }
 
-int wasora_fit_compute_numerical_df(gsl_matrix *J) {
+int wasora_fit_compute_dual_df(gsl_matrix *J) {
 
-  int i, j, k;
-  int in_range;
-  double *x;
+  int i, j, k, in_range;
   double *range_min = NULL;
   double *range_max = NULL;
-  double yprime;
-  double *y_plus, *y_minus;
-  double orig_p;
-
-  y_plus = calloc(wasora.fit.n, sizeof(double));
-  y_minus = calloc(wasora.fit.n, sizeof(double));
-
-  x = malloc(wasora.fit.data->n_arguments*sizeof(double));
+  double **wrt;
+  double *df;
+  double y;
+  int status = WASORA_RUNTIME_OK;
 
+  wrt = malloc(wasora.fit.p*sizeof(double *));
+  df = malloc(wasora.fit.p*sizeof(double));
+  for (k = 0; k < wasora.fit.p; k++) {
+    wrt[k] = wasora_value_ptr(wasora.fit.param[k]);
+  }
+  
   if (wasora.fit.range.min != NULL && wasora.fit.range.max != NULL) {
     range_min = malloc(wasora.fit.data->n_arguments*sizeof(double));
     range_max = malloc(wasora.fit.data->n_arguments*sizeof(double));
@@ -251,84 +298,295 @@ int wasora_fit_compute_numerical_df(gsl_matrix *J) {
       range_max[i] = wasora_evaluate_expression(&wasora.fit.range.max[i]);
     }
   }
-  
-  for (k = 0; k < wasora.fit.p; k++) {
-    
-    // ponemos p + delta _p
-    orig_p = wasora_value(wasora.fit.param[k]);
-    if (fabs(orig_p) > wasora_var(wasora_special_var(zero))) {
-      wasora_value(wasora.fit.param[k]) = (1+DEFAULT_NLIN_FIT_GRAD_H)*orig_p;
+
+  for (j = 0; status == WASORA_RUNTIME_OK && j < wasora.fit.n; j++) {
+    in_range = 1;
+    for (i = 0; i < wasora.fit.data->n_arguments; i++) {
+      wasora_value(wasora.fit.function->var_argument[i]) = wasora.fit.data->data_argument[i][j];
+      if (range_min != NULL && (wasora.fit.data->data_argument[i][j] < range_min[i] || wasora.fit.data->data_argument[i][j] > range_max[i])) {
+        in_range = 0;
+      }
+    }
+
+    if (in_range) {
+      if ((status = wasora_evaluate_expression_dual(&wasora.fit.function->algebraic_expression, wasora.fit.p, wrt, &y, df)) == WASORA_RUNTIME_OK) {
+        for (k = 0; k < wasora.fit.p; k++) {
+          gsl_matrix_set(J, j, k, df[k]);
+        }
+      }
     } else {
-      wasora_value(wasora.fit.param[k]) = +DEFAULT_NLIN_FIT_GRAD_H;
+      // the points out of the range do not contribute to the residuals
+      for (k = 0; k < wasora.fit.p; k++) {
+        gsl_matrix_set(J, j, k, 0);
+      }
     }
-    
-    if (wasora.fit.norerun == 0) {
-      wasora_value(wasora_special_var(step_inner)) += 1;      
-      wasora_call(wasora_standard_run());
+  }
+  
+  if (range_min != NULL) {
+    free(range_min);
+    free(range_max);
+  }
+  free(df);
+  free(wrt);
+  
+  return status;
+}
+
+// valores del modelo en los puntos de los datos que estan dentro del rango
+static void wasora_fit_evaluate_model(double *y, const double *range_min, const double *range_max) {
+
+  int i, j;
+  int in_range;
+  double *x;
+
+  x = malloc(wasora.fit.data->n_arguments*sizeof(double));
+  for (j = 0; j < wasora.fit.n; j++) {
+    in_range = 1;
+    for (i = 0; i < wasora.fit.data->n_arguments; i++) {
+      x[i] = wasora.fit.data->data_argument[i][j];
+      if (range_min != NULL && (x[i] < range_min[i] || x[i] > range_max[i])) {
+        in_range = 0;
+      }
+    }
+    if (in_range) {
+      y[j] = wasora_evaluate_function(wasora.fit.function, x);
     }
+  }
+  free(x);
 
-    // y evaluamos para todos los tiempos
-    for (j = 0; j < wasora.fit.n; j++) {
-      in_range = 1;
-      for (i = 0; i < wasora.fit.data->n_arguments; i++) {
-        x[i] = wasora.fit.data->data_argument[i][j];
-        if (range_min != NULL && (wasora.fit.data->data_argument[i][j] < range_min[i] || wasora.fit.data->data_argument[i][j] > range_max[i])) {
-          in_range = 0;
-        }
+  return;
+}
+
+// the perturbed value of the k-th parameter, sign is +1 or -1
+static double wasora_fit_perturbed(int k, double orig_p, int sign) {
+
+  if (fabs(orig_p) > wasora_var(wasora_special_var(zero))) {
+    return (1+sign*wasora.fit.h[k])*orig_p;
+  }
+
+  return sign*wasora.fit.h[k];
+}
+
+// runs the 2p perturbed models in up to max_daughters forked processes that
+// leave the model values in shared memory, y[i] is for parameter i/2 and
+// sign plus if i is even or minus if i is odd
+static int wasora_fit_perturbed_runs_parallel(double **y, const double *range_min, const double *range_max) {
+
+  double *shared;
+  double step_inner;
+  size_t size;
+  pid_t pid;
+  int status;
+  int running, failed;
+  int i, k;
+
+  size = 2*wasora.fit.p * wasora.fit.n * sizeof(double);
+  if ((shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+    wasora_push_error_message("cannot map shared memory for the fit gradient: %s", strerror(errno));
+    return WASORA_RUNTIME_ERROR;
+  }
+  memset(shared, 0, size);
+
+  // so the daughters do not inherit (and write again) what is in our buffers
+  fflush(NULL);
+
+  step_inner = wasora_value(wasora_special_var(step_inner));
+  running = 0;
+  failed = 0;
+  for (i = 0; i < 2*wasora.fit.p; i++) {
+
+    if (running == wasora.fit.max_daughters) {
+      if (wait(&status) != -1) {
+        running--;
+        failed |= !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      }
+    }
+
+    if ((pid = fork()) == 0) {
+      // the output of the perturbed runs would get mixed up
+      if (wasora_mute_output() != WASORA_RUNTIME_OK) {
+        _exit(1);
       }
-      if (in_range) {
-        y_plus[j] = wasora_evaluate_function(wasora.fit.function, x);
+      k = i/2;
+      wasora_value(wasora.fit.param[k]) = wasora_fit_perturbed(k, wasora_value(wasora.fit.param[k]), (i % 2 == 0) ? +1 : -1);
+      wasora_value(wasora_special_var(step_inner)) = step_inner + i+1;
+      status = wasora_standard_run();
+      if (status == WASORA_RUNTIME_OK) {
+        wasora_fit_evaluate_model(shared + i*wasora.fit.n, range_min, range_max);
       }
+      fflush(NULL);
+      _exit((status == WASORA_RUNTIME_OK) ? 0 : 1);
+
+    } else if (pid == -1) {
+      wasora_push_error_message("'%s' when forking", strerror(errno));
+      failed = 1;
+      break;
     }
+    running++;
+  }
 
-    // ponemos p - delta _p
-    if (fabs(orig_p) > wasora_var(wasora_special_var(zero))) {
-      wasora_value(wasora.fit.param[k]) = (1-DEFAULT_NLIN_FIT_GRAD_H)*orig_p;
-    } else {
-      wasora_value(wasora.fit.param[k]) = -DEFAULT_NLIN_FIT_GRAD_H;
+  // esperamos a los que nos quedan
+  while (running > 0 && wait(&status) != -1) {
+    running--;
+    failed |= !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  wasora_value(wasora_special_var(step_inner)) = step_inner + 2*wasora.fit.p;
+
+  if (failed == 0) {
+    for (i = 0; i < 2*wasora.fit.p; i++) {
+      memcpy(y[i], shared + i*wasora.fit.n, wasora.fit.n * sizeof(double));
     }
+  }
+  munmap(shared, size);
+
+  if (failed) {
+    wasora_push_error_message("perturbed run for the fit gradient did not exit succesfully");
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+int wasora_fit_compute_numerical_df(gsl_matrix *J) {
+
+  int i, j, k;
+  double *range_min = NULL;
+  double *range_max = NULL;
+  double **y;
+  double orig_p, delta;
+  double first, second, ratio;
+  int model_valid;
+
+  y = malloc(2*wasora.fit.p * sizeof(double *));
+  for (i = 0; i < 2*wasora.fit.p; i++) {
+    y[i] = calloc(wasora.fit.n, sizeof(double));
+  }
+
+  if (wasora.fit.range.min != NULL && wasora.fit.range.max != NULL) {
+    range_min = malloc(wasora.fit.data->n_arguments*sizeof(double));
+    range_max = malloc(wasora.fit.data->n_arguments*sizeof(double));
     
-    if (wasora.fit.norerun == 0) {
-      wasora_value(wasora_special_var(step_inner)) += 1;      
-      wasora_call(wasora_standard_run());
+    for (i = 0; i < wasora.fit.data->n_arguments; i++) {
+      range_min[i] = wasora_evaluate_expression(&wasora.fit.range.min[i]);
+      range_max[i] = wasora_evaluate_expression(&wasora.fit.range.max[i]);
+    }
+  }
+  
+  if (wasora.fit.norerun == 0 && wasora.fit.max_daughters > 1) {
+    wasora_call(wasora_fit_perturbed_runs_parallel(y, range_min, range_max));
+    
+  } else {
+    for (i = 0; i < 2*wasora.fit.p; i++) {
+      // ponemos p + delta_p o p - delta_p y evaluamos para todos los puntos
+      k = i/2;
+      orig_p = wasora_value(wasora.fit.param[k]);
+      wasora_value(wasora.fit.param[k]) = wasora_fit_perturbed(k, orig_p, (i % 2 == 0) ? +1 : -1);
+
+      if (wasora.fit.norerun == 0) {
+        wasora_value(wasora_special_var(step_inner)) += 1;      
+        wasora_call(wasora_standard_run());
+      }
+      wasora_fit_evaluate_model(y[i], range_min, range_max);
+
+      // volvemos a poner p como estaba
+      wasora_value(wasora.fit.param[k]) = orig_p;
+    }
+  }
+
+  // the model at the current parameters is what wasora_fit_compute_f() left
+  model_valid = (wasora.fit.model != NULL);
+  for (k = 0; k < wasora.fit.p; k++) {
+    if (wasora.fit.model_param[k] != wasora_value(wasora.fit.param[k])) {
+      model_valid = 0;
     }
+  }
 
+  for (k = 0; k < wasora.fit.p; k++) {
+    orig_p = wasora_value(wasora.fit.param[k]);
+    delta = wasora_fit_perturbed(k, orig_p, +1) - orig_p;
     for (j = 0; j < wasora.fit.n; j++) {
-      in_range = 1;
-      for (i = 0; i < wasora.fit.data->n_arguments; i++) {
-        x[i] = wasora.fit.data->data_argument[i][j];
-        if (range_min != NULL && (wasora.fit.data->data_argument[i][j] < range_min[i] || wasora.fit.data->data_argument[i][j] > range_max[i])) {
-          in_range = 0;
-        }
+      gsl_matrix_set(J, j, k, (y[2*k][j] - y[2*k+1][j])/(2*delta)); 
+    }
+    
+    // if we know the model at the current parameters we compare the
+    // second-order term against the first-order one to adapt the step
+    if (model_valid) {
+      first = 0;
+      second = 0;
+      for (j = 0; j < wasora.fit.n; j++) {
+        first += gsl_pow_2(y[2*k][j] - y[2*k+1][j]);
+        second += gsl_pow_2(y[2*k][j] - 2*wasora.fit.model[j] + y[2*k+1][j]);
       }
-      if (in_range) {
-        y_minus[j] = wasora_evaluate_function(wasora.fit.function, x);
+      ratio = (first > 0) ? sqrt(second/first) : 0;
+      if (first == 0 || ratio < 1e-2) {
+        wasora.fit.h[k] = GSL_MIN(2*wasora.fit.h[k], DEFAULT_NLIN_FIT_GRAD_H_MAX);
+      } else if (ratio > 1e-1) {
+        wasora.fit.h[k] = GSL_MAX(0.5*wasora.fit.h[k], DEFAULT_NLIN_FIT_GRAD_H_MIN);
       }
     }
+  }
 
-    // volvemosa poner p como estaba
-    wasora_value(wasora.fit.param[k]) = orig_p;
+  if (range_min != NULL) {
+    free(range_min);
+    free(range_max);
+  }
+  
+  for (i = 0; i < 2*wasora.fit.p; i++) {
+    free(y[i]);
+  }
+  free(y);
 
-    for (j = 0; j < wasora.fit.n; j++) {
-      if (fabs(orig_p) > wasora_var(wasora_special_var(zero))) {
-        yprime = (y_plus[j] - y_minus[j])/(2*DEFAULT_NLIN_FIT_GRAD_H*orig_p);
-      } else {
-        yprime = (y_plus[j] - y_minus[j])/(2*DEFAULT_NLIN_FIT_GRAD_H);
+  return WASORA_RUNTIME_OK;
+}
+
+
+// the jacobian comes from the sensitivities integrated in the last run so
+// we only need to run again if the parameters changed since then
+int wasora_fit_compute_sensitivity_df(gsl_matrix *J) {
+
+  int i, j, k, in_range;
+  double *range_min = NULL;
+  double *range_max = NULL;
+
+  if (wasora.fit.range.min != NULL && wasora.fit.range.max != NULL) {
+    range_min = malloc(wasora.fit.data->n_arguments*sizeof(double));
+    range_max = malloc(wasora.fit.data->n_arguments*sizeof(double));
+    
+    for (i = 0; i < wasora.fit.data->n_arguments; i++) {
+      range_min[i] = wasora_evaluate_expression(&wasora.fit.range.min[i]);
+      range_max[i] = wasora_evaluate_expression(&wasora.fit.range.max[i]);
+    }
+  }
+  
+  for (k = 0; k < wasora.fit.p; k++) {
+    if (wasora.fit.model_param[k] != wasora_value(wasora.fit.param[k])) {
+      wasora_value(wasora_special_var(step_inner)) += 1;
+      wasora_call(wasora_standard_run());
+      wasora_fit_evaluate_model(wasora.fit.model, range_min, range_max);
+      for (i = 0; i < wasora.fit.p; i++) {
+        wasora.fit.model_param[i] = wasora_value(wasora.fit.param[i]);
       }
+      break;
+    }
+  }
   
-      gsl_matrix_set (J, j, k, yprime); 
+  if (wasora.fit.gradient != NULL) {
+    wasora_fit_compute_analytical_df(J);
+    
+  } else {
+    // a history has only one argument, the time
+    for (j = 0; j < wasora.fit.n; j++) {
+      in_range = (range_min == NULL || (wasora.fit.data->data_argument[0][j] >= range_min[0] && wasora.fit.data->data_argument[0][j] <= range_max[0]));
+      for (k = 0; k < wasora.fit.p; k++) {
+        gsl_matrix_set(J, j, k, in_range ? wasora_dae_sensitivity_history(k, wasora.fit.data->data_argument[0][j]) : 0);
+      }
     }
-      
   }
-
+  
   if (range_min != NULL) {
     free(range_min);
     free(range_max);
   }
-  
-  free(x);
-  free(y_minus);
-  free(y_plus);
 
   return WASORA_RUNTIME_OK;
 }
@@ -347,9 +605,13 @@ int wasora_gsl_fit_df(const gsl_vector *param, void *data, gsl_matrix *J) {
 
   wasora_fit_read_params_from_solver(param);  
 
-  if (wasora.fit.gradient != NULL) {
+  if (wasora.fit.sensitivities) {
+    wasora_fit_compute_sensitivity_df(J);
+  } else if (wasora.fit.gradient != NULL) {
     wasora_fit_compute_analytical_df(J);
-  } else {
+  } else if (wasora.fit.dual == 0 || wasora_fit_compute_dual_df(J) != WASORA_RUNTIME_OK) {
+    // si la funcion tiene algo que no sabemos derivar no lo volvemos a intentar
+    wasora.fit.dual = 0;
     wasora_fit_compute_numerical_df(J);
   }
   
@@ -362,9 +624,13 @@ int wasora_gsl_fit_fdf(const gsl_vector *param, void *data, gsl_vector *f, gsl_m
   wasora_fit_read_params_from_solver(param);  
   wasora_fit_compute_f(f);
   
-  if (wasora.fit.gradient != NULL) {
+  if (wasora.fit.sensitivities) {
+    wasora_fit_compute_sensitivity_df(J);
+  } else if (wasora.fit.gradient != NULL) {
     wasora_fit_compute_analytical_df(J);
-  } else {
+  } else if (wasora.fit.dual == 0 || wasora_fit_compute_dual_df(J) != WASORA_RUNTIME_OK) {
+    // si la funcion tiene algo que no sabemos derivar no lo volvemos a intentar
+    wasora.fit.dual = 0;
     wasora_fit_compute_numerical_df(J);
   }
 
@@ -66,3 +66,144 @@ int wasora_instruction_else(void *arg) {
 int wasora_instruction_endif(void *arg) {
   return WASORA_RUNTIME_OK;
 }
+
+
+// indice a donde hay que ir para ejecutar la instruccion, salteando ENDIFs
+static int wasora_instruction_target(instruction_t *instruction) {
+  
+  while (instruction != NULL && instruction->routine == wasora_instruction_endif) {
+    instruction = instruction->next;
+  }
+  
+  return (instruction != NULL) ? instruction->index : wasora.n_flat_instructions;
+}
+
+// bajamos la lista de instrucciones a un arreglo contiguo donde los IF
+// tienen sus dos destinos precalculados y los ELSE y ENDIF son saltos
+int wasora_instructions_flatten(void) {
+  
+  instruction_t *instruction;
+  flat_instruction_t *flat;
+  conditional_block_t *conditional_block;
+  int i;
+  
+  wasora_free(wasora.flat_instructions);
+  wasora.n_flat_instructions = 0;
+  LL_FOREACH(wasora.instructions, instruction) {
+    instruction->index = wasora.n_flat_instructions++;
+  }
+  
+  if (wasora.n_flat_instructions == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+  
+  wasora.flat_instructions = calloc(wasora.n_flat_instructions, sizeof(flat_instruction_t));
+  
+  i = 0;
+  LL_FOREACH(wasora.instructions, instruction) {
+    flat = &wasora.flat_instructions[i++];
+    flat->instruction = instruction;
+    flat->routine = instruction->routine;
+    flat->argument = instruction->argument;
+    
+    if (instruction->routine == wasora_instruction_if) {
+      conditional_block = (conditional_block_t *)instruction->argument;
+      flat->conditional_block = conditional_block;
+      flat->jump_true = wasora_instruction_target(conditional_block->first_true_instruction);
+      // si hay un ELSE vamos directo a su cuerpo
+      if (conditional_block->first_false_instruction != NULL && conditional_block->first_false_instruction->routine == wasora_instruction_else) {
+        flat->jump_false = wasora_instruction_target(((conditional_block_t *)conditional_block->first_false_instruction->argument)->first_false_instruction);
+      } else {
+        flat->jump_false = wasora_instruction_target(conditional_block->first_false_instruction);
+      }
+      
+    } else if (instruction->routine == wasora_instruction_else) {
+      // solamente llegamos a un ELSE cayendo desde el cuerpo verdadero del IF
+      conditional_block = (conditional_block_t *)instruction->argument;
+      flat->routine = NULL;
+      flat->jump_false = wasora_instruction_target(conditional_block->first_true_instruction);
+      
+    } else if (instruction->routine == wasora_instruction_endif) {
+      flat->routine = NULL;
+      flat->jump_false = instruction->index+1;
+    }
+  }
+  
+  return WASORA_RUNTIME_OK;
+}
+
+// the instructions that only write out what is already computed
+static int wasora_instruction_is_output(int (*routine)(void *)) {
+  return routine == wasora_instruction_print ||
+         routine == wasora_instruction_print_function ||
+         routine == wasora_instruction_print_vector;
+}
+
+// recorre las instrucciones aplanadas desde first hasta (sin incluir) last
+// siguiendo los saltos, si only_output es distinto de cero solamente ejecuta
+// las que imprimen y se saltea el resto
+static int wasora_instructions_walk(int first, int last, int only_output) {
+  
+  flat_instruction_t *flat;
+  int i = first;
+  int status, condition;
+  
+  if (wasora.flat_instructions == NULL) {
+    wasora_call(wasora_instructions_flatten());
+  }
+  
+  while (i < last) {
+    flat = &wasora.flat_instructions[i];
+    
+    if (flat->conditional_block == NULL) {
+      if (flat->routine != NULL && only_output && !wasora_instruction_is_output(flat->routine)) {
+        i++;
+      } else if (flat->routine != NULL) {
+        wasora.ip = flat->instruction;
+        if (wasora.profile.enabled) {
+          wasora_profile_push(wasora_profile_instruction_entry(flat->instruction));
+          status = flat->routine(flat->argument);
+          wasora_profile_pop();
+          wasora_call(status);
+        } else {
+          wasora_call(flat->routine(flat->argument));
+        }
+        i++;
+      } else {
+        i = flat->jump_false;
+      }
+      
+    } else {
+      if (wasora.profile.enabled) {
+        wasora_profile_push(wasora_profile_instruction_entry(flat->instruction));
+        condition = (int)wasora_evaluate_expression(flat->conditional_block->condition);
+        wasora_profile_pop();
+      } else {
+        condition = (int)wasora_evaluate_expression(flat->conditional_block->condition);
+      }
+      
+      if (condition) {
+        flat->conditional_block->evaluated_to_true = 1;
+        flat->conditional_block->evaluated_to_false = 0;
+        i = flat->jump_true;
+      } else {
+        flat->conditional_block->evaluated_to_true = 0;
+        flat->conditional_block->evaluated_to_false = 1;
+        i = flat->jump_false;
+      }
+    }
+  }
+  
+  return WASORA_RUNTIME_OK;
+}
+
+// ejecuta las instrucciones aplanadas desde first hasta (sin incluir) last
+int wasora_instructions_run(int first, int last) {
+  return wasora_instructions_walk(first, last, 0);
+}
+
+// goes through the whole program but only prints, so a memoized run writes
+// out again what it wrote the first time out of the arena it left behind
+int wasora_instructions_replay_output(void) {
+  return wasora_instructions_walk(0, wasora.n_flat_instructions, 1);
+}
@@ -61,7 +61,13 @@ double wasora_evaluate_factor_function(factor_t *token) {
     // para no tener que hacer malloc y frees todo el tiempo, para un solo argumento lo
     // hacemos diferente
     x0 = wasora_evaluate_expression(&token->arg[0]);
-    y = wasora_evaluate_function(token->function, &x0);
+    if (wasora.profile.enabled) {
+      wasora_profile_push(wasora_profile_function_entry(token->function));
+      y = wasora_evaluate_function(token->function, &x0);
+      wasora_profile_pop();
+    } else {
+      y = wasora_evaluate_function(token->function, &x0);
+    }
 
   } else {
 
@@ -72,7 +78,13 @@ double wasora_evaluate_factor_function(factor_t *token) {
       x[i] = wasora_evaluate_expression(&token->arg[i]);
     }
 
-    y = wasora_evaluate_function(token->function, x);
+    if (wasora.profile.enabled) {
+      wasora_profile_push(wasora_profile_function_entry(token->function));
+      y = wasora_evaluate_function(token->function, x);
+      wasora_profile_pop();
+    } else {
+      y = wasora_evaluate_function(token->function, x);
+    }
 
     free(x);
     
@@ -89,6 +101,34 @@ double wasora_evaluate_factor_function(factor_t *token) {
 }
 
 
+// returns true if the vectors a function takes its data from might have changed
+// since the last call, either because some instruction wrote them or because
+// the step or the time changed (the dae solver, plugins and i/o write them
+// without bumping their versions)
+static int wasora_function_vectors_changed(function_t *function) {
+
+  double stamp[6];
+  int i;
+
+  stamp[0] = (function->vector_value != NULL) ? function->vector_value->version : 0;
+  for (i = 0; i < function->n_arguments; i++) {
+    stamp[0] += function->vector_argument[i]->version;
+  }
+  stamp[1] = wasora_var(wasora_special_var(step_outer));
+  stamp[2] = wasora_var(wasora_special_var(step_inner));
+  stamp[3] = wasora_var(wasora_special_var(step_static));
+  stamp[4] = wasora_var(wasora_special_var(step_transient));
+  stamp[5] = wasora_var(wasora_special_var(time));
+
+  if (memcmp(stamp, function->rectangular_mesh_stamp, sizeof(stamp)) == 0) {
+    return 0;
+  }
+  memcpy(function->rectangular_mesh_stamp, stamp, sizeof(stamp));
+
+  return 1;
+}
+
+
 int wasora_function_init(function_t *function) {
   
   int i, j, k;
@@ -200,6 +240,15 @@ int wasora_function_init(function_t *function) {
         } else {
           function->shepard_exponent = DEFAULT_SHEPARD_EXPONENT;
         }
+        if (function->expr_shepard_neighbors.n_tokens != 0) {
+          function->shepard_neighbors = round(wasora_evaluate_expression(&function->expr_shepard_neighbors));
+          if (function->shepard_neighbors < 1) {
+            wasora_push_error_message("SHEPARD_NEIGHBORS of function '%s' has to be positive", function->name);
+            return WASORA_RUNTIME_ERROR;
+          }
+        } else {
+          function->shepard_neighbors = DEFAULT_SHEPARD_NEIGHBORS;
+        }
 
         if (function->n_arguments == 2) {
 
@@ -307,13 +356,54 @@ int wasora_function_init(function_t *function) {
               }
             }
           }
+          
+          // strides para pasar de los indices de cada direccion al indice escalar
+          // (lo mismo que hace wasora_structured_scalar_index pero una sola vez)
+          function->rectangular_mesh_stride = malloc(function->n_arguments*sizeof(int));
+          step = 1;
+          if (function->x_increases_first) {
+            for (i = 0; i < function->n_arguments; i++) {
+              function->rectangular_mesh_stride[i] = step;
+              step *= function->rectangular_mesh_size[i];
+            }
+          } else {
+            for (i = function->n_arguments-1; i >= 0; i--) {
+              function->rectangular_mesh_stride[i] = step;
+              step *= function->rectangular_mesh_size[i];
+            }
+          }
+          
+          // si los puntos de una direccion estan equiespaciados guardamos el delta
+          // y al evaluar calculamos el intervalo con aritmetica en lugar de biseccion
+          function->rectangular_mesh_delta = calloc(function->n_arguments, sizeof(double));
+          for (i = 0; i < function->n_arguments; i++) {
+            double *point = function->rectangular_mesh_point[i];
+            int n = function->rectangular_mesh_size[i];
+            double delta = (point[n-1] - point[0])/(n-1);
+            int uniform = (delta > 0);
+            
+            for (j = 1; uniform && j < n; j++) {
+              if (fabs(point[j] - (point[0] + j*delta)) > 1e-6*delta) {
+                uniform = 0;
+              }
+            }
+            
+            function->rectangular_mesh_delta[i] = (uniform) ? delta : 0;
+          }
         }
       }
     
-      if (function->rectangular_mesh == 0 && function->multidim_interp == bilinear) {
+      if (function->rectangular_mesh == 0 && (function->multidim_interp == bilinear || function->multidim_interp == rectangular_spline || function->multidim_interp == rectangular_steffen)) {
         wasora_push_error_message("rectangular interpolation of function '%s' needs a rectangular mesh", function->name);
         return WASORA_RUNTIME_ERROR;
       }
+      
+      if (function->multidim_interp == rectangular_spline || function->multidim_interp == rectangular_steffen) {
+        wasora_call(wasora_function_init_rectangular_cubic(function));
+        if (function->type == type_pointwise_vector) {
+          wasora_function_vectors_changed(function);
+        }
+      }
 
   /*
       if (function->n_arguments > 3 && function->multidim_interp == rectangle) {
@@ -337,6 +427,9 @@ int wasora_function_init(function_t *function) {
         }
 
         free(point);
+        
+      } else if (function->n_arguments > 1 && function->multidim_interp == shepard_knn) {
+        function->shepard_index = shepard_index_create(function->n_arguments, function->data_size, function->data_argument);
       }
     }
   }
@@ -344,6 +437,67 @@ int wasora_function_init(function_t *function) {
   return WASORA_RUNTIME_OK;  
 }
 
+// busca el intervalo de la direccion i de una malla rectangular que contiene a x_i
+// (el mismo que encuentra la biseccion) y devuelve uno si x_i es un punto de la definicion
+static inline int wasora_function_rectangular_locate(function_t *function, int i, double x_i, int *c) {
+  
+  const double *point = function->rectangular_mesh_point[i];
+  int n = function->rectangular_mesh_size[i];
+  double delta = function->rectangular_mesh_delta[i];
+  double s;
+  int a, b, k;
+  
+  if (delta != 0) {
+    // equiespaciado, vamos directo y despues corregimos el redondeo
+    s = floor((x_i - point[0])/delta);
+    if (s > n-1) {
+      k = n-1;
+    } else if (s >= 0) {
+      k = (int)s;
+    } else {
+      k = 0;
+    }
+    while (k > 0 && point[k] > x_i) {
+      k--;
+    }
+    while (k < n-1 && point[k+1] <= x_i) {
+      k++;
+    }
+    
+  } else {
+    a = 0;
+    b = n;
+    while ((b-a) > 1) {
+      k = (a+b)/2;
+      if (point[k] > x_i) {
+        b = k;
+      } else {
+        a = k;
+      }
+    }
+    k = a;
+  }
+  
+  *c = k;
+  return (gsl_fcmp(point[k], x_i, function->multidim_threshold) == 0);
+}
+
+// calcula la coordenada normalizada en [-1:1] dentro del intervalo c de la direccion i,
+// teniendo en cuenta que capaz nos pidieron extrapolar
+static inline double wasora_function_rectangular_r(function_t *function, int i, double x_i, int *c) {
+  
+  const double *point = function->rectangular_mesh_point[i];
+  
+  if (x_i < point[0]) {
+    return -1;
+  } else if (*c == function->rectangular_mesh_size[i]-1) {
+    (*c)--;
+    return 1;
+  }
+  
+  return -1 + 2*(x_i - point[*c])/(point[*c+1] - point[*c]);
+}
+
 // evalua una function en el punto *x
 double wasora_evaluate_function(function_t *function, const double *x) {
 
@@ -486,10 +640,12 @@ double wasora_evaluate_function(function_t *function, const double *x) {
       double den = 0;
       double w_i, y_i, dist2, diff;
       double dist;
-      double *x_i = malloc(function->n_arguments*sizeof(double));
+      double x_i[function->n_arguments];
+      // el radio agrandado vale solo para esta evaluacion
+      double radius = function->shepard_radius;
       
       do {
-        presults = kd_nearest_range(function->kd, x, function->shepard_radius);
+        presults = kd_nearest_range(function->kd, x, radius);
         while (kd_res_end(presults) == 0) {
           n++;
           y_i = *((double *)kd_res_item(presults, x_i));
@@ -506,7 +662,7 @@ double wasora_evaluate_function(function_t *function, const double *x) {
           } else {
 //            w_i = (function->shepard_exponent == 2)? 1.0/dist2 : 1.0/pow(dist2, 0.5*function->shepard_exponent);
             dist = sqrt(dist2);
-            w_i = pow((function->shepard_radius-dist)/(function->shepard_radius*dist), function->shepard_exponent);
+            w_i = pow((radius-dist)/(radius*dist), function->shepard_exponent);
             num += w_i * y_i;
             den += w_i;
           }
@@ -516,7 +672,7 @@ double wasora_evaluate_function(function_t *function, const double *x) {
         
         // si no encontramos ningun punto, duplicamos el radio
         if (n == 0) {
-          function->shepard_radius *= 2;
+          radius *= 2;
         }
       } while (n == 0);
 
@@ -524,101 +680,155 @@ double wasora_evaluate_function(function_t *function, const double *x) {
       if (flag == 0) {
         if (den == 0) {
           if (function->n_arguments == 3) {
-            wasora_push_error_message("no definition point found in a range %g around point (%g,%g,%g), try a larger SHEPARD_RADIUS", function->shepard_radius, x[0], x[1], x[2]);
+            wasora_push_error_message("no definition point found in a range %g around point (%g,%g,%g), try a larger SHEPARD_RADIUS", radius, x[0], x[1], x[2]);
           } else {
-            wasora_push_error_message("no definition point found in a range %g around point, try a larger SHEPARD_RADIUS", function->shepard_radius);
+            wasora_push_error_message("no definition point found in a range %g around point, try a larger SHEPARD_RADIUS", radius);
           }
         }
         y = num/den;
       }
-      free(x_i);
     
+    } else if (function->multidim_interp == shepard_knn) {
+      y = wasora_function_shepard_knn(function, x);
+      
     } else if (function->multidim_interp == bilinear && function->rectangular_mesh_size != NULL) {
 
+      const double *v = function->data_value;
+      const int *stride = function->rectangular_mesh_stride;
+      int n = function->n_arguments;
       // flag que indica si nos pidieron un punto de la definicion
       int flag;
-      int *ctilde;
-      double shape;
+      int base;
+      
+      // indices del intervalo y coordenadas normalizadas a [-1:1]
+      // (en el stack, esto se llama en los loops mas internos)
+      int c[n];
+      double r[n];
       
-      // indices para la biseccion
-      int *a;
-      int *b;
-      int *c;
-      // coordenadas normalizadas a [-1:1]
-      double *r;
-
-      a = malloc(function->n_arguments*sizeof(int));
-      b = malloc(function->n_arguments*sizeof(int));
-      c = malloc(function->n_arguments*sizeof(int));
-      r = malloc(function->n_arguments*sizeof(double));
-
       flag = 1;  // suponemos que nos pidieron un punto del problema
-      for (i = 0; i < function->n_arguments; i++) {
-
-        a[i] = 0;
-        b[i] = function->rectangular_mesh_size[i];
-
-        while ((b[i]-a[i]) > 1) {
-          c[i] = floor(0.5*(a[i]+b[i]));
-
-          if (function->rectangular_mesh_point[i][c[i]] > x[i]) {
-            b[i] = c[i];
-          } else {
-            a[i] = c[i];
-          }
-        }
-
-        c[i] = floor(0.5*(a[i]+b[i]));
-        if (gsl_fcmp(function->rectangular_mesh_point[i][c[i]], x[i], function->multidim_threshold) != 0) {
-          flag = 0;
-        }
-
+      base = 0;
+      for (i = 0; i < n; i++) {
+        flag &= wasora_function_rectangular_locate(function, i, x[i], &c[i]);
+        base += stride[i]*c[i];
       }
 
       if (flag) {
         // nos pidieron un punto de la definicion
-        y = function->data_value[wasora_structured_scalar_index(function->n_arguments, function->rectangular_mesh_size, c, function->x_increases_first)];
+        y = v[base];
       } else {
         // tenemos que interpolar
-        for (i = 0; i < function->n_arguments; i++) {
-          // calculamos las coordenadas normalizadas en [-1:1], teniendo en cuenta
-          // que capaz nos pidieron extrapolar
-          if (x[i] < function->rectangular_mesh_point[i][0]) {
-            r[i] = -1;
-          } else if (c[i] == function->rectangular_mesh_size[i]-1) {
-            c[i]--;
-            r[i] = 1;
-          } else {
-            r[i] = -1 + 2*(x[i] - function->rectangular_mesh_point[i][c[i]])/(function->rectangular_mesh_point[i][c[i]+1] - function->rectangular_mesh_point[i][c[i]]);
-          } 
-         
+        base = 0;
+        for (i = 0; i < n; i++) {
+          r[i] = wasora_function_rectangular_r(function, i, x[i], &c[i]);
+          base += stride[i]*c[i];
         }
-
-        y = 0;
-        ctilde = malloc(function->n_arguments * sizeof(int));
-        for (i = 0; i < (1<<function->n_arguments); i++)  {
-          shape = 1;
-          for (j = 0; j < function->n_arguments; j++) {
-            // el desarrollo binario de i nos dice si hay que sumar uno o no al indice
-            ctilde[j] = c[j] + ((i & (1<<j)) != 0);
-            // y tambien como es el termino correspondiente a la funcion de forma
-            shape *= ((i & (1<<j)) == 0) ? (1.0-r[j]) : (1.0+r[j]);
+        
+        if (n == 2) {
+          y = 0.25 * ((1.0-r[0])*(1.0-r[1]) * v[base] +
+                      (1.0+r[0])*(1.0-r[1]) * v[base+stride[0]] +
+                      (1.0-r[0])*(1.0+r[1]) * v[base+stride[1]] +
+                      (1.0+r[0])*(1.0+r[1]) * v[base+stride[0]+stride[1]]);
+          
+        } else if (n == 3) {
+          y = 0.125 * ((1.0-r[0])*(1.0-r[1])*(1.0-r[2]) * v[base] +
+                       (1.0+r[0])*(1.0-r[1])*(1.0-r[2]) * v[base+stride[0]] +
+                       (1.0-r[0])*(1.0+r[1])*(1.0-r[2]) * v[base+stride[1]] +
+                       (1.0+r[0])*(1.0+r[1])*(1.0-r[2]) * v[base+stride[0]+stride[1]] +
+                       (1.0-r[0])*(1.0-r[1])*(1.0+r[2]) * v[base+stride[2]] +
+                       (1.0+r[0])*(1.0-r[1])*(1.0+r[2]) * v[base+stride[0]+stride[2]] +
+                       (1.0-r[0])*(1.0+r[1])*(1.0+r[2]) * v[base+stride[1]+stride[2]] +
+                       (1.0+r[0])*(1.0+r[1])*(1.0+r[2]) * v[base+stride[0]+stride[1]+stride[2]]);
+          
+        } else {
+          double shape;
+          y = 0;
+          for (i = 0; i < (1<<n); i++)  {
+            shape = 1;
+            index = base;
+            for (j = 0; j < n; j++) {
+              // el desarrollo binario de i nos dice si hay que sumar uno o no al indice
+              // y tambien como es el termino correspondiente a la funcion de forma
+              if (i & (1<<j)) {
+                index += stride[j];
+                shape *= (1.0+r[j]);
+              } else {
+                shape *= (1.0-r[j]);
+              }
+            }
+            y += shape * v[index];
           }
-          index = wasora_structured_scalar_index(function->n_arguments, function->rectangular_mesh_size, ctilde, function->x_increases_first);
-          y += shape * function->data_value[index];
+          y *= 1.0/(1<<n);
         }
-        
-        y *= 1.0/(1<<function->n_arguments);
-        free(ctilde);
-        
       }
 
-      free(r);
-      free(c);
-      free(b);
-      free(a);
 
+    } else if ((function->multidim_interp == rectangular_spline || function->multidim_interp == rectangular_steffen) && function->rectangular_mesh_coef != NULL) {
 
+      int n = function->n_arguments;
+      int N = 1<<n;
+      const int *stride = function->rectangular_mesh_stride;
+      const double *coef;
+      int flag;
+      int base, node;
+      int cm, dm;
+      double t, h, w;
+      
+      // indices del intervalo, coordenadas normalizadas y las cuatro
+      // funciones de hermite de cada direccion
+      int c[n];
+      double r[n];
+      double b[n][4];
+      
+      // si los datos vienen de vectores pueden haber cambiado
+      if (function->type == type_pointwise_vector && wasora_function_vectors_changed(function)) {
+        if (wasora_function_init_rectangular_cubic(function) != WASORA_RUNTIME_OK) {
+          wasora_runtime_error();
+        }
+      }
+      
+      flag = 1;
+      base = 0;
+      for (i = 0; i < n; i++) {
+        flag &= wasora_function_rectangular_locate(function, i, x[i], &c[i]);
+        base += stride[i]*c[i];
+      }
+      
+      if (flag) {
+        y = function->data_value[base];
+      } else {
+        base = 0;
+        for (i = 0; i < n; i++) {
+          r[i] = wasora_function_rectangular_r(function, i, x[i], &c[i]);
+          base += stride[i]*c[i];
+          
+          t = 0.5*(r[i]+1);
+          h = function->rectangular_mesh_point[i][c[i]+1] - function->rectangular_mesh_point[i][c[i]];
+          b[i][0] = (1+2*t)*(1-t)*(1-t);    // valor en c
+          b[i][1] = t*t*(3-2*t);            // valor en c+1
+          b[i][2] = h*t*(1-t)*(1-t);        // derivada en c
+          b[i][3] = h*t*t*(t-1);            // derivada en c+1
+        }
+        
+        // sumamos sobre las 2^n esquinas y las 2^n derivadas de cada esquina
+        y = 0;
+        for (cm = 0; cm < N; cm++) {
+          node = base;
+          for (j = 0; j < n; j++) {
+            if (cm & (1<<j)) {
+              node += stride[j];
+            }
+          }
+          coef = function->rectangular_mesh_coef + node*N;
+          for (dm = 0; dm < N; dm++) {
+            w = coef[dm];
+            for (j = 0; j < n; j++) {
+              w *= b[j][2*((dm>>j)&1) + ((cm>>j)&1)];
+            }
+            y += w;
+          }
+        }
+      }
+      
 /*   
     } else if (function->multidim_interp == triangle) {
 
@@ -852,3 +1062,95 @@ int wasora_structured_scalar_index(int n_dims, int *size, int *index, int x_incr
   return scalar_index;
   
 }
+
+
+// precalcula las derivadas parciales y cruzadas en cada punto de una malla rectangular
+// derivando sucesivamente en cada direccion con splines (o con steffen, en cuyo
+// caso las derivadas cruzadas se ponen a cero para no perder la monotonia)
+int wasora_function_init_rectangular_cubic(function_t *function) {
+
+  int n = function->n_arguments;
+  int N = 1<<n;
+  const gsl_interp_type *type;
+  gsl_interp *interp;
+  double *point;
+  double *y;
+  size_t k;
+  int size, stride;
+  int dm, src, j, m;
+  
+  if (n > 16) {
+    wasora_push_error_message("too many arguments in function '%s' for cubic interpolation", function->name);
+    return WASORA_RUNTIME_ERROR;
+  }
+  
+  if (function->rectangular_mesh_coef == NULL) {
+    // alineado a la linea de cache para que los 2^n coeficientes de cada punto vengan juntos
+    if (posix_memalign((void **)&function->rectangular_mesh_coef, 64, function->data_size*N*sizeof(double)) != 0) {
+      wasora_push_error_message("cannot allocate interpolation coefficients for function '%s'", function->name);
+      return WASORA_RUNTIME_ERROR;
+    }
+  }
+  
+  for (k = 0; k < function->data_size; k++) {
+    function->rectangular_mesh_coef[k*N] = function->data_value[k];
+  }
+  
+  for (dm = 1; dm < N; dm++) {
+    
+    if (function->multidim_interp == rectangular_steffen && (dm & (dm-1)) != 0) {
+      for (k = 0; k < function->data_size; k++) {
+        function->rectangular_mesh_coef[k*N + dm] = 0;
+      }
+      continue;
+    }
+    
+    // derivamos en la direccion j lo que ya tenemos derivado en las otras
+    for (j = 0; (dm & (1<<j)) == 0; j++);
+    src = dm & ~(1<<j);
+    
+    point = function->rectangular_mesh_point[j];
+    size = function->rectangular_mesh_size[j];
+    stride = function->rectangular_mesh_stride[j];
+    
+    if (size < 3) {
+      type = gsl_interp_linear;
+    } else if (function->multidim_interp == rectangular_spline) {
+      type = gsl_interp_cspline;
+    } else {
+#if (GSL_MAJOR_VERSION < 2)  
+      type = gsl_interp_linear;
+#else
+      type = gsl_interp_steffen;
+#endif
+    }
+    
+    interp = gsl_interp_alloc(type, size);
+    y = malloc(size*sizeof(double));
+    
+    for (k = 0; k < function->data_size; k++) {
+      // solo los puntos donde empieza una linea en la direccion j
+      if ((k/stride) % size != 0) {
+        continue;
+      }
+      
+      for (m = 0; m < size; m++) {
+        y[m] = function->rectangular_mesh_coef[(k+m*stride)*N + src];
+      }
+      if (gsl_interp_init(interp, point, y, size) != GSL_SUCCESS) {
+        wasora_push_error_message("cannot build interpolation for function '%s', are the definition points sorted?", function->name);
+        free(y);
+        gsl_interp_free(interp);
+        return WASORA_RUNTIME_ERROR;
+      }
+      for (m = 0; m < size; m++) {
+        function->rectangular_mesh_coef[(k+m*stride)*N + dm] = gsl_interp_eval_deriv(interp, point, y, point[m], NULL);
+      }
+    }
+    
+    free(y);
+    gsl_interp_free(interp);
+  }
+  
+  return WASORA_RUNTIME_OK;
+}
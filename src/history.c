@@ -24,80 +24,215 @@
 #include "wasora.h"
 #endif
 
-// agrega el valor actual de una variable a la funcion historia
+// the physical position in the ring buffer of the i-th oldest point
+static inline int wasora_history_index(history_t *history, int i) {
+  int j = history->head + i;
+  return (j < history->size) ? j : j - history->size;
+}
+
+// makes room for at least size points keeping the current ones, the oldest
+// one is moved back to the beginning of the buffer
+static void wasora_history_grow(history_t *history, int size) {
+
+  double *time;
+  double *value;
+  int i;
+
+  time = malloc(size * sizeof(double));
+  value = malloc(size * sizeof(double));
+  for (i = 0; i < history->n; i++) {
+    time[i] = history->time[wasora_history_index(history, i)];
+    value[i] = history->value[wasora_history_index(history, i)];
+  }
+
+  free(history->time);
+  free(history->value);
+  history->time = time;
+  history->value = value;
+  history->size = size;
+  history->head = 0;
+
+  return;
+}
+
+// drops the oldest point
+static void wasora_history_drop(history_t *history) {
+
+  history->head = wasora_history_index(history, 1);
+  history->n--;
+  if (history->last_hit > 0) {
+    history->last_hit--;
+  }
+
+  return;
+}
+
+// agrega el valor actual de una variable a la historia
 int wasora_instruction_history(void *arg) {
   history_t *history = (history_t *)arg;
+  double t = wasora_var(wasora_special_var(time));
+  int size;
 
-  if (history->function->data_size == 0) {
+  if (history->initialized == 0) {
     wasora_init_history(history);
+  }
+
+  // los pasos estaticos (y cualquier otro paso que no avance el tiempo)
+  // pisan el ultimo punto porque las abscisas tienen que estar ordenadas
+  if (history->n != 0 && t <= history->time[wasora_history_index(history, history->n-1)]) {
+    history->value[wasora_history_index(history, history->n-1)] = wasora_value(history->variable);
+    return WASORA_RUNTIME_OK;
+  }
+
+  // we keep the last point before the window so we can still interpolate at its edge
+  if (history->window > 0) {
+    while (history->n > 2 && history->time[wasora_history_index(history, 1)] <= t - history->window) {
+      wasora_history_drop(history);
     }
-  
-  if (history->position >= history->function->data_size) {
-    history->function->data_size *= 2;
-    history->function->data_argument[0] = realloc(history->function->data_argument[0], sizeof(double)*history->function->data_size);
-    history->function->data_value = realloc(history->function->data_value, sizeof(double)*history->function->data_size);
   }
 
-  // OJO! function->size es el maximo tamanio esperado
-  //      history->position es la cantidad de puntos conocidos
-  history->function->data_argument[0][history->position] = wasora_var(wasora_special_var(time));
-  history->function->data_value[history->position] = wasora_value(history->variable);
+  if (history->n == history->size) {
+    if (history->max != 0 && history->n >= history->max) {
+      wasora_history_drop(history);
+    } else {
+      size = 2*history->size;
+      if (history->max != 0 && size > history->max) {
+        size = history->max;
+      }
+      wasora_history_grow(history, size);
+    }
+  }
 
-  history->position++;
+  history->time[wasora_history_index(history, history->n)] = t;
+  history->value[wasora_history_index(history, history->n)] = wasora_value(history->variable);
+  history->n++;
 
-//  gsl_interp_init(history->function->interp, history->function->data_argument[0], history->function->data_value, history->function->data_size);
-  
   return WASORA_RUNTIME_OK;
 }
 
-// inicializa una historia
+// inicializa una historia vacia
 void wasora_init_history(history_t *history) {
 
-  int j;
   int size;
-  
-  if (wasora_var(wasora_special_var(dt)) != 0) {
-    size = (size_t)5*fabs(1+wasora_value(wasora_special_var(end_time))/wasora_value(wasora_special_var(dt)));
-  } else {
-    size = 5;
+
+  history->window = (history->expr_window.n_tokens != 0) ? wasora_evaluate_expression(&history->expr_window) : 0;
+  history->max = (history->expr_max_points.n_tokens != 0) ? (int)wasora_evaluate_expression(&history->expr_max_points) : 0;
+  if (history->max < 0) {
+    history->max = 0;
+  } else if (history->max == 1) {
+    // with less than two points we cannot interpolate
+    history->max = 2;
   }
 
-  history->function->data_size = size;
-  history->function->interp_type = DEFAULT_INTERPOLATION;
+  history->head = 0;
+  history->n = 0;
+  history->last_hit = 0;
 
-  history->function->data_argument = malloc(sizeof(double *));
-  history->function->data_argument[0] = calloc(size, sizeof(double));
-  history->function->data_value = calloc(size, sizeof(double));
+  size = DEFAULT_HISTORY_SIZE;
+  if (history->max != 0 && size > history->max) {
+    size = history->max;
+  }
+  if (history->size < size) {
+    wasora_history_grow(history, size);
+  }
+
+  history->initialized = 1;
 
-  // inicializamos para menos infinito todo igual a lo que habia en t = 0
-  // 5 valores porque es lo minimo que quiere akima
-  history->function->data_argument[0][0] = -wasora_var(wasora_special_var(infinite));
-  history->function->data_argument[0][1] = -0.8*wasora_var(wasora_special_var(infinite));
-  history->function->data_argument[0][2] = -0.6*wasora_var(wasora_special_var(infinite));
-  history->function->data_argument[0][3] = -0.4*wasora_var(wasora_special_var(infinite));
-  history->function->data_argument[0][4] = -0.2*wasora_var(wasora_special_var(infinite));
+  return;
+}
 
-  history->function->data_value[0] = history->variable->initial_transient[0];
-  history->function->data_value[1] = history->variable->initial_transient[0];
-  history->function->data_value[2] = history->variable->initial_transient[0];
-  history->function->data_value[3] = history->variable->initial_transient[0];
-  history->function->data_value[4] = history->variable->initial_transient[0];
+// evaluates the history function, i.e. interpolates linearly in time and
+// returns the values at the ends if asked for points outside the buffer
+double wasora_history_evaluate(const double *x, function_t *function) {
+
+  history_t *history = (history_t *)function->params;
+  double t = x[0];
+  double t_i, t_j;
+  int i, a, b, k;
+
+  if (history->n == 0) {
+    return history->variable->initial_transient[0];
+  } else if (t <= history->time[history->head]) {
+    return history->value[history->head];
+  } else if (t >= history->time[wasora_history_index(history, history->n-1)]) {
+    return history->value[wasora_history_index(history, history->n-1)];
+  }
 
-  history->position = 5;
+  // delay queries move forward (at most) one point per step so we
+  // first try the interval of the last lookup and its two neighbors
+  i = history->last_hit;
+  if (i > history->n-2) {
+    i = history->n-2;
+  }
+  if (t < history->time[wasora_history_index(history, i)]) {
+    if (i > 0 && t >= history->time[wasora_history_index(history, i-1)]) {
+      i--;
+    } else {
+      i = -1;
+    }
+  } else if (t >= history->time[wasora_history_index(history, i+1)]) {
+    if (i+2 < history->n && t < history->time[wasora_history_index(history, i+2)]) {
+      i++;
+    } else {
+      i = -1;
+    }
+  }
 
-  // pero ademas tenemos que llenar los lugares que faltan con infinitos porque
-  // las absisas tienen que estar ordenadas
-  for (j = history->position; j < history->function->data_size; j++) {
-    history->function->data_argument[0][j] = wasora_var(wasora_special_var(infinite))*(1+1e-3*j);
+  if (i == -1) {
+    a = 0;
+    b = history->n-1;
+    while ((b-a) > 1) {
+      k = (a+b)/2;
+      if (history->time[wasora_history_index(history, k)] > t) {
+        b = k;
+      } else {
+        a = k;
+      }
+    }
+    i = a;
   }
+  history->last_hit = i;
+
+  t_i = history->time[wasora_history_index(history, i)];
+  t_j = history->time[wasora_history_index(history, i+1)];
+
+  return history->value[wasora_history_index(history, i)] + (t-t_i)/(t_j-t_i) *
+         (history->value[wasora_history_index(history, i+1)] - history->value[wasora_history_index(history, i)]);
+}
+
+// copies the points from the oldest to the newest, t and y have to hold history->n doubles
+void wasora_history_get(history_t *history, double *t, double *y) {
 
+  int i;
 
-  history->function->interp = gsl_interp_alloc(&history->function->interp_type, history->function->data_size);
-  history->function->interp_accel = gsl_interp_accel_alloc();
-  
-  gsl_interp_init(history->function->interp, history->function->data_argument[0], history->function->data_value, history->function->data_size);
+  for (i = 0; i < history->n; i++) {
+    t[i] = history->time[wasora_history_index(history, i)];
+    y[i] = history->value[wasora_history_index(history, i)];
+  }
 
   return;
-  
 }
 
+// replaces the contents of the history with n points ordered in time
+void wasora_history_set(history_t *history, int n, const double *t, const double *y) {
+
+  wasora_init_history(history);
+
+  // if there are more points than allowed we keep the newest ones
+  if (history->max != 0 && n > history->max) {
+    t += n - history->max;
+    y += n - history->max;
+    n = history->max;
+  }
+  if (history->size < n) {
+    wasora_history_grow(history, n);
+  }
+
+  if (n != 0) {
+    memcpy(history->time, t, n * sizeof(double));
+    memcpy(history->value, y, n * sizeof(double));
+  }
+  history->n = n;
+
+  return;
+}
@@ -176,6 +176,13 @@ int wasora_init_before_parser(void) {
   wasora_special_var(max_dt) = wasora_define_variable("max_dt");
   
 
+///va+output_dt+name output_dt
+///va+output_dt+desc If non-zero, the DAE solver takes steps as large as the error bounds allow and the
+///va+output_dt+desc instructions are executed only every `output_dt` units of time (and at the `TIME_PATH` entries),
+///va+output_dt+desc with the phase space interpolated to those times. It cannot be used together with `min_dt`.
+  wasora_special_var(output_dt) = wasora_define_variable("output_dt");
+  
+
 ///va+i+name i
 ///va+i+desc Dummy index, used mainly in vector and matrix row subindex expressions.
   wasora_special_var(i) = wasora_define_variable("i");
@@ -296,6 +303,9 @@ int wasora_init_after_parser(void) {
     wasora_push_error_message("conditional block not closed");
     return WASORA_RUNTIME_ERROR;
   }
+  
+  // ya sabemos (casi) todos los simbolos asi que los ponemos juntitos
+  wasora_call(wasora_arena_init());
     
   
 #ifdef HAVE_READLINE
@@ -315,6 +325,12 @@ int wasora_init_after_parser(void) {
   // demanda, i.e. la primera vez que se necesita evaluar una funcion interpolada
   // se hace el init en tiempo de ejecucion
   
+  // aplanamos las instrucciones (los plugins ya definieron las suyas)
+  wasora_call(wasora_instructions_flatten());
+  
+  // si nos pidieron --jit compilamos las expresiones a codigo nativo
+  wasora_call(wasora_jit_init());
+  
   return WASORA_RUNTIME_OK;
 }
 
@@ -350,6 +366,8 @@ int wasora_init_before_run(void) {
     }
   }
   
+  wasora_dae_free_sensitivities();
+  
   if (wasora_dae.system != NULL) {
     IDAFree(&wasora_dae.system);
     wasora_dae.system = NULL;
@@ -369,17 +387,12 @@ int wasora_init_before_run(void) {
   }  
 #endif  
   
+  // the buffers are kept for the next run, they are emptied on its first step
   LL_FOREACH(wasora.histories, history) {
-    history->function->data_size = 0;
-    history->position = 0;
-
-    if (history->function->data_value != NULL) {
-      free(history->function->data_value);
-    }
-    if (history->function->data_argument != NULL) {
-      free(history->function->data_argument[0]);
-      free(history->function->data_argument);
-    }
+    history->initialized = 0;
+    history->head = 0;
+    history->n = 0;
+    history->last_hit = 0;
   }  
 
   LL_FOREACH(wasora.prints, print) {
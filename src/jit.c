@@ -0,0 +1,505 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora native-code compilation of expressions
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#ifndef _WASORA_H_
+#include "wasora.h"
+#endif
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "builtindecl.h"
+
+extern const char operators[];
+
+// the source of the translation unit grows as expressions are translated
+typedef struct {
+  char *text;
+  size_t length;
+  size_t size;
+} jit_source_t;
+
+// builtins that are pure functions of their arguments and can never raise
+// errors by themselves so they can be called directly from libm
+static struct {
+  double (*routine)(factor_t *);
+  const char *name;
+  int n_arguments;
+} jit_math[] = {
+  {&builtin_abs,   "fabs",  1},
+  {&builtin_sin,   "sin",   1},
+  {&builtin_cos,   "cos",   1},
+  {&builtin_tan,   "tan",   1},
+  {&builtin_sinh,  "sinh",  1},
+  {&builtin_cosh,  "cosh",  1},
+  {&builtin_tanh,  "tanh",  1},
+  {&builtin_atan,  "atan",  1},
+  {&builtin_atan2, "atan2", 2},
+  {&builtin_exp,   "wasora_jit_exp", 1},
+  {NULL,           NULL,    0}
+};
+
+// the generated code reads variables through a table of pointers to the
+// var_t->value pointers (so re-pointed variables keep working) and falls back
+// to wasora_evaluate_factor() for everything that is not plain arithmetic
+static const char jit_prologue[] = "\
+/* generated by wasora --jit, do not edit */\n\
+#include <math.h>\n\
+\n\
+void **wasora_jit_table;\n\
+\n\
+#define V(k) (**(double **)wasora_jit_table[k])\n\
+#define F(k) (((double (*)(void *))wasora_jit_table[0])(wasora_jit_table[k]))\n\
+\n\
+static inline double wasora_jit_div(double a, double b) {\n\
+  return (b != 0) ? a/b : NAN;\n\
+}\n\
+\n\
+static inline double wasora_jit_pow(double a, double b) {\n\
+  return (a != 0 || b != 0) ? pow(a, b) : NAN;\n\
+}\n\
+\n\
+static inline double wasora_jit_exp(double x) {\n\
+  return (x < -7.0839641853226408e+02) ? 0 : exp(x);\n\
+}\n\
+\n\
+static inline double wasora_jit_equal(double a, double b, double zero) {\n\
+  int e;\n\
+  double delta;\n\
+  if (fabs(a) < 1 || fabs(b) < 1) {\n\
+    return fabs(a - b) < zero;\n\
+  }\n\
+  frexp((fabs(a) > fabs(b)) ? a : b, &e);\n\
+  delta = ldexp(zero, e);\n\
+  return (a - b <= delta && a - b >= -delta);\n\
+}\n\
+\n";
+
+
+static void wasora_jit_append(jit_source_t *source, const char *format, ...) {
+
+  va_list ap;
+  int n;
+
+  do {
+    va_start(ap, format);
+    n = vsnprintf(source->text + source->length, source->size - source->length, format, ap);
+    va_end(ap);
+
+    if (source->length + n < source->size) {
+      source->length += n;
+      return;
+    }
+
+    source->size = 2*source->size + n;
+    source->text = realloc(source->text, source->size);
+  } while (1);
+
+}
+
+// returns the index of ptr in the table of pointers, adding it if needed
+static int wasora_jit_table_index(void *ptr) {
+
+  int k;
+
+  for (k = 0; k < wasora.jit.n_table; k++) {
+    if (wasora.jit.table[k] == ptr) {
+      return k;
+    }
+  }
+
+  wasora.jit.table = realloc(wasora.jit.table, (wasora.jit.n_table+1) * sizeof(void *));
+  wasora.jit.table[wasora.jit.n_table] = ptr;
+
+  return wasora.jit.n_table++;
+}
+
+static char *wasora_jit_expression(expr_t *expr);
+
+// C code for a single token
+static char *wasora_jit_factor(factor_t *factor) {
+
+  char *code = NULL;
+  char *arg[2];
+  int k;
+
+  switch (factor->type & EXPR_BASICTYPE_MASK) {
+    case EXPR_CONSTANT:
+      if (gsl_finite(factor->constant)) {
+        // hexadecimal floating-point constants are exact
+        if (asprintf(&code, "(%a)", factor->constant) == -1) {
+          return NULL;
+        }
+        return code;
+      }
+    break;
+
+    case EXPR_VARIABLE:
+      switch (factor->type) {
+        case EXPR_VARIABLE | EXPR_CURRENT:
+          k = wasora_jit_table_index(&factor->variable->value);
+        break;
+        case EXPR_VARIABLE | EXPR_INITIAL_TRANSIENT:
+          k = wasora_jit_table_index(&factor->variable->initial_transient);
+        break;
+        case EXPR_VARIABLE | EXPR_INITIAL_STATIC:
+          k = wasora_jit_table_index(&factor->variable->initial_static);
+        break;
+        default:
+          k = -1;
+        break;
+      }
+      if (k >= 0) {
+        if (asprintf(&code, "V(%d)", k) == -1) {
+          return NULL;
+        }
+        return code;
+      }
+    break;
+
+    case EXPR_BUILTIN_FUNCTION:
+      for (k = 0; jit_math[k].routine != NULL; k++) {
+        if (factor->builtin_function->routine == jit_math[k].routine) {
+          break;
+        }
+      }
+      if (jit_math[k].routine != NULL) {
+        arg[0] = wasora_jit_expression(&factor->arg[0]);
+        arg[1] = (jit_math[k].n_arguments == 2) ? wasora_jit_expression(&factor->arg[1]) : NULL;
+        if ((jit_math[k].n_arguments == 2 && asprintf(&code, "%s(%s, %s)", jit_math[k].name, arg[0], arg[1]) == -1) ||
+            (jit_math[k].n_arguments == 1 && asprintf(&code, "%s(%s)", jit_math[k].name, arg[0]) == -1)) {
+          code = NULL;
+        }
+        free(arg[0]);
+        free(arg[1]);
+        return code;
+      }
+    break;
+  }
+
+  // vectors, matrices, functions, functionals and builtins with memory
+  // are evaluated by the interpreter on a token-by-token basis
+  if (asprintf(&code, "F(%d)", wasora_jit_table_index(factor)) == -1) {
+    return NULL;
+  }
+
+  return code;
+}
+
+
+// C code for a whole expression, the reduction mimics wasora_evaluate_expression()
+// but instead of numbers it combines the strings of each token
+static char *wasora_jit_expression(expr_t *expr) {
+
+  int i;
+  int level;
+  int n_tokens;
+  int zero;
+  char *code;
+  char **c;
+  char *result;
+  factor_t *token;
+  factor_t *E,*P;
+
+  if (expr == NULL || (token = expr->token) == NULL || (n_tokens = expr->n_tokens) == 0) {
+    return strdup("0.0");
+  }
+
+  c = calloc(n_tokens, sizeof(char *));
+  level = 0;
+  for (i = 0; i < n_tokens; i++) {
+    token[i].tmp_level = token[i].level;
+    c[i] = wasora_jit_factor(&token[i]);
+    if (token[i].level > level) {
+      level = token[i].level;
+    }
+  }
+
+  zero = wasora_jit_table_index(&wasora_special_var(zero)->value);
+
+  while (level > 0) {
+
+    for (E = P = token; E != &token[n_tokens]; E->tmp_level != 0 && !E->oper?P=E:0,++E) {
+      if (E->tmp_level == level && E->oper != 0) {
+        char op = operators[(E++)->oper-1];
+        char *p = c[P-token];
+        char *e = c[E-token];
+
+        switch(op) {
+          case '&':
+          case '|':
+            i = asprintf(&code, "((double)((int)(%s) %c (int)(%s)))", p, op, e);
+          break;
+          case '=':
+            i = asprintf(&code, "wasora_jit_equal(%s, %s, V(%d))", p, e, zero);
+          break;
+          case '!':
+            i = asprintf(&code, "(1.0 - wasora_jit_equal(%s, %s, V(%d)))", p, e, zero);
+          break;
+          case '<':
+          case '>':
+            i = asprintf(&code, "((double)(%s %c %s))", p, op, e);
+          break;
+          case '/':
+            i = asprintf(&code, "wasora_jit_div(%s, %s)", p, e);
+          break;
+          case '^':
+            i = asprintf(&code, "wasora_jit_pow(%s, %s)", p, e);
+          break;
+          default:
+            i = asprintf(&code, "(%s %c %s)", p, op, e);
+          break;
+        }
+        free(c[P-token]);
+        c[P-token] = (i == -1) ? NULL : code;
+        E->tmp_level = 0;
+      }
+    }
+
+    level--;
+  }
+
+  result = c[0];
+  for (i = 1; i < n_tokens; i++) {
+    free(c[i]);
+  }
+  free(c);
+
+  return (result != NULL) ? result : strdup("F(0)");
+}
+
+
+// the expressions that are evaluated over and over again
+static void wasora_jit_add(expr_t ***list, int *n, expr_t *expr) {
+  int i;
+
+  if (expr == NULL || expr->n_tokens == 0) {
+    return;
+  }
+  for (i = 0; i < *n; i++) {
+    if ((*list)[i] == expr) {
+      return;
+    }
+  }
+
+  *list = realloc(*list, (*n+1) * sizeof(expr_t *));
+  (*list)[(*n)++] = expr;
+
+  return;
+}
+
+
+// runs the compiler without a shell in between, $CC and the flags are split
+// at blanks (so CC="ccache gcc" works) and nothing else is interpreted
+static int wasora_jit_compile(const char *compiler, const char *path_c, const char *path_so) {
+
+  char *line;
+  char **argv = NULL;
+  char *token;
+  pid_t pid;
+  int argc = 0;
+  int status = -1;
+  int fd;
+
+  if (asprintf(&line, "%s %s", compiler, DEFAULT_JIT_CFLAGS) == -1) {
+    return -1;
+  }
+  argv = calloc(strlen(line)/2 + 6, sizeof(char *));
+  for (token = strtok(line, " \t"); token != NULL; token = strtok(NULL, " \t")) {
+    argv[argc++] = token;
+  }
+  argv[argc++] = "-o";
+  argv[argc++] = (char *)path_so;
+  argv[argc++] = (char *)path_c;
+  argv[argc++] = "-lm";
+  argv[argc] = NULL;
+
+  if ((pid = fork()) == 0) {
+    // no compiler, no cry, but no noise either
+    if ((fd = open("/dev/null", O_WRONLY)) != -1) {
+      dup2(fd, STDOUT_FILENO);
+      dup2(fd, STDERR_FILENO);
+      close(fd);
+    }
+    execvp(argv[0], argv);
+    _exit(127);
+  } else if (pid > 0) {
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+      status = -1;
+    } else {
+      status = WEXITSTATUS(status);
+    }
+  }
+
+  free(argv);
+  free(line);
+
+  return status;
+}
+
+
+int wasora_jit_init(void) {
+
+  expr_t **list = NULL;
+  jit_source_t source;
+  assignment_t *assignment;
+  conditional_block_t *conditional_block;
+  function_t *function;
+  dae_t *dae;
+  FILE *file;
+  void **table_symbol;
+  char *code;
+  char *compiler;
+  char *dir = NULL;
+  char *path_c = NULL;
+  char *path_tmp = NULL;
+  char *path_so = NULL;
+  struct stat st;
+  unsigned long hash;
+  int n = 0;
+  int fd;
+  int i;
+
+  if (wasora.jit.enabled == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  LL_FOREACH(wasora.assignments, assignment) {
+    wasora_jit_add(&list, &n, &assignment->rhs);
+  }
+  LL_FOREACH(wasora.conditional_blocks, conditional_block) {
+    wasora_jit_add(&list, &n, conditional_block->condition);
+  }
+  LL_FOREACH(wasora_dae.daes, dae) {
+    wasora_jit_add(&list, &n, &dae->residual);
+  }
+  for (function = wasora.functions; function != NULL; function = function->hh.next) {
+    wasora_jit_add(&list, &n, &function->algebraic_expression);
+  }
+
+  if (n == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  // the first entry of the table is the interpreter fallback
+  wasora.jit.n_table = 0;
+  wasora_jit_table_index((void *)wasora_evaluate_factor);
+
+  source.size = sizeof(jit_prologue) + 256*n;
+  source.text = malloc(source.size);
+  source.length = 0;
+  wasora_jit_append(&source, "%s", jit_prologue);
+  for (i = 0; i < n; i++) {
+    code = wasora_jit_expression(list[i]);
+    wasora_jit_append(&source, "double wasora_jit_%d(void) {\n  return %s;\n}\n\n", i, code);
+    free(code);
+  }
+
+  // the source is a function of the input only (the table is rebuilt in the
+  // same order at each run) so its hash, together with everything else that
+  // changes the object (compiler, flags and our own version), is the key of the cache
+  compiler = (getenv("CC") != NULL) ? getenv("CC") : DEFAULT_JIT_COMPILER;
+  hash = wasora_cache_hash(source.text, source.length, 0xcbf29ce484222325UL);
+  hash = wasora_cache_hash(compiler, strlen(compiler)+1, hash);
+  hash = wasora_cache_hash(DEFAULT_JIT_CFLAGS, strlen(DEFAULT_JIT_CFLAGS)+1, hash);
+  hash = wasora_cache_hash(PACKAGE_VERSION, strlen(PACKAGE_VERSION)+1, hash);
+
+  // the compiled objects go to $WASORA_JIT_CACHE, $XDG_CACHE_HOME/wasora or ~/.cache/wasora,
+  // which is private to the user, if there is no such directory we do not compile at all
+  if ((dir = wasora_cache_dir("WASORA_JIT_CACHE")) == NULL ||
+      asprintf(&path_so, "%s/wasora-jit-%016lx.so", dir, hash) == -1) {
+    goto fallback;
+  }
+
+  if (lstat(path_so, &st) != 0) {
+    // both temporary files get unique names that nobody else can take from us
+    if (asprintf(&path_c, "%s/wasora-jit-XXXXXX.c", dir) == -1 ||
+        asprintf(&path_tmp, "%s/wasora-jit-XXXXXX.so", dir) == -1) {
+      goto fallback;
+    }
+    if ((fd = mkstemps(path_c, 2)) == -1) {
+      goto fallback;
+    }
+    if ((file = fdopen(fd, "w")) == NULL) {
+      close(fd);
+      unlink(path_c);
+      goto fallback;
+    }
+    fwrite(source.text, 1, source.length, file);
+    fclose(file);
+    if ((fd = mkstemps(path_tmp, 3)) == -1) {
+      unlink(path_c);
+      goto fallback;
+    }
+    close(fd);
+
+    // no compiler, no cry: we just keep on interpreting
+    i = wasora_jit_compile(compiler, path_c, path_tmp);
+    unlink(path_c);
+    if (i != 0 || rename(path_tmp, path_so) != 0) {
+      unlink(path_tmp);
+      goto fallback;
+    }
+  } else if (!S_ISREG(st.st_mode) || st.st_uid != getuid()) {
+    // we only load what we ourselves have compiled
+    goto fallback;
+  }
+
+  if ((wasora.jit.handle = wasora_dlopen(path_so)) == NULL ||
+      (table_symbol = dlsym(wasora.jit.handle, "wasora_jit_table")) == NULL) {
+    goto fallback;
+  }
+  *table_symbol = wasora.jit.table;
+
+  for (i = 0; i < n; i++) {
+    if (asprintf(&code, "wasora_jit_%d", i) != -1) {
+      *(void **)(&list[i]->jit) = dlsym(wasora.jit.handle, code);
+      free(code);
+    }
+  }
+
+fallback:
+  free(path_tmp);
+  free(path_c);
+  free(path_so);
+  free(dir);
+  free(source.text);
+  free(list);
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+void wasora_jit_finalize(void) {
+
+  if (wasora.jit.handle != NULL) {
+    dlclose(wasora.jit.handle);
+    wasora.jit.handle = NULL;
+  }
+  wasora_free(wasora.jit.table);
+  wasora.jit.n_table = 0;
+
+  return;
+}
@@ -99,3 +99,177 @@ int wasora_matrix_init(matrix_t *matrix) {
   return WASORA_RUNTIME_OK;
 
 }
+
+
+// los productos, transpuestas y sistemas lineales van directo a blas/linalg
+// sobre la memoria de las gsl_matrix asi que cuestan lo que cuesta la libreria
+static int wasora_matrix_check_init(matrix_t *matrix) {
+  if (matrix != NULL && !matrix->initialized) {
+    wasora_call(wasora_matrix_init(matrix));
+  }
+  return WASORA_RUNTIME_OK;
+}
+
+static int wasora_vector_check_init(vector_t *vector) {
+  if (vector != NULL && !vector->initialized) {
+    wasora_call(wasora_vector_init(vector));
+  }
+  return WASORA_RUNTIME_OK;
+}
+
+int wasora_instruction_matrix_multiply(void *arg) {
+
+  matrix_multiply_t *multiply = (matrix_multiply_t *)arg;
+  gsl_matrix *A, *B, *C;
+  gsl_vector *x, *y;
+  double alpha = (multiply->alpha.n_tokens != 0) ? wasora_evaluate_expression(&multiply->alpha) : 1.0;
+  double beta = (multiply->beta.n_tokens != 0) ? wasora_evaluate_expression(&multiply->beta) : 0.0;
+  size_t rows_A, cols_A, rows_B, cols_B;
+
+  wasora_call(wasora_matrix_check_init(multiply->A));
+  wasora_call(wasora_matrix_check_init(multiply->B));
+  wasora_call(wasora_matrix_check_init(multiply->C));
+  wasora_call(wasora_vector_check_init(multiply->x));
+  wasora_call(wasora_vector_check_init(multiply->y));
+
+  A = wasora_value_ptr(multiply->A);
+  rows_A = (multiply->transpose_A) ? A->size2 : A->size1;
+  cols_A = (multiply->transpose_A) ? A->size1 : A->size2;
+
+  if (multiply->y != NULL) {
+    // matriz por vector
+    x = wasora_value_ptr(multiply->x);
+    y = wasora_value_ptr(multiply->y);
+    if (cols_A != x->size || rows_A != y->size) {
+      wasora_push_error_message("cannot multiply a %ldx%ld matrix '%s' by vector '%s' of size %ld into vector '%s' of size %ld",
+                                rows_A, cols_A, multiply->A->name, multiply->x->name, x->size, multiply->y->name, y->size);
+      return WASORA_RUNTIME_ERROR;
+    }
+
+    if (multiply->x == multiply->y) {
+      if (multiply->tmp_vector == NULL) {
+        multiply->tmp_vector = gsl_vector_alloc(y->size);
+      }
+      gsl_vector_memcpy(multiply->tmp_vector, y);
+      gsl_blas_dgemv((multiply->transpose_A) ? CblasTrans : CblasNoTrans, alpha, A, multiply->tmp_vector, beta, y);
+    } else {
+      gsl_blas_dgemv((multiply->transpose_A) ? CblasTrans : CblasNoTrans, alpha, A, x, beta, y);
+    }
+    wasora_check_initial_vector(multiply->y);
+
+  } else {
+    // matriz por matriz
+    B = wasora_value_ptr(multiply->B);
+    C = wasora_value_ptr(multiply->C);
+    rows_B = (multiply->transpose_B) ? B->size2 : B->size1;
+    cols_B = (multiply->transpose_B) ? B->size1 : B->size2;
+    if (cols_A != rows_B || rows_A != C->size1 || cols_B != C->size2) {
+      wasora_push_error_message("cannot multiply a %ldx%ld matrix '%s' by a %ldx%ld matrix '%s' into a %ldx%ld matrix '%s'",
+                                rows_A, cols_A, multiply->A->name, rows_B, cols_B, multiply->B->name, C->size1, C->size2, multiply->C->name);
+      return WASORA_RUNTIME_ERROR;
+    }
+
+    if (multiply->C == multiply->A || multiply->C == multiply->B) {
+      if (multiply->tmp_matrix == NULL) {
+        multiply->tmp_matrix = gsl_matrix_alloc(C->size1, C->size2);
+      }
+      gsl_matrix_memcpy(multiply->tmp_matrix, C);
+      gsl_blas_dgemm((multiply->transpose_A) ? CblasTrans : CblasNoTrans, (multiply->transpose_B) ? CblasTrans : CblasNoTrans,
+                     alpha, (multiply->C == multiply->A) ? multiply->tmp_matrix : A, (multiply->C == multiply->B) ? multiply->tmp_matrix : B, beta, C);
+    } else {
+      gsl_blas_dgemm((multiply->transpose_A) ? CblasTrans : CblasNoTrans, (multiply->transpose_B) ? CblasTrans : CblasNoTrans,
+                     alpha, A, B, beta, C);
+    }
+    wasora_check_initial_matrix(multiply->C);
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+int wasora_instruction_matrix_transpose(void *arg) {
+
+  matrix_transpose_t *transpose = (matrix_transpose_t *)arg;
+
+  wasora_call(wasora_matrix_check_init(transpose->A));
+  wasora_call(wasora_matrix_check_init(transpose->result));
+
+  if (transpose->result == transpose->A) {
+    if (transpose->A->rows != transpose->A->cols) {
+      wasora_push_error_message("cannot transpose non-square matrix '%s' in place", transpose->A->name);
+      return WASORA_RUNTIME_ERROR;
+    }
+    gsl_matrix_transpose(wasora_value_ptr(transpose->A));
+
+  } else {
+    if (transpose->result->rows != transpose->A->cols || transpose->result->cols != transpose->A->rows) {
+      wasora_push_error_message("cannot transpose a %dx%d matrix '%s' into a %dx%d matrix '%s'",
+                                transpose->A->rows, transpose->A->cols, transpose->A->name, transpose->result->rows, transpose->result->cols, transpose->result->name);
+      return WASORA_RUNTIME_ERROR;
+    }
+    gsl_matrix_transpose_memcpy(wasora_value_ptr(transpose->result), wasora_value_ptr(transpose->A));
+  }
+  wasora_check_initial_matrix(transpose->result);
+
+  return WASORA_RUNTIME_OK;
+}
+
+int wasora_instruction_matrix_solve(void *arg) {
+
+  matrix_solve_t *solve = (matrix_solve_t *)arg;
+  gsl_error_handler_t *handler;
+  int signum;
+  int status;
+
+  wasora_call(wasora_matrix_check_init(solve->A));
+  wasora_call(wasora_vector_check_init(solve->b));
+  wasora_call(wasora_vector_check_init(solve->x));
+
+  if (solve->A->rows != solve->A->cols || solve->A->rows != solve->b->size || solve->A->rows != solve->x->size) {
+    wasora_push_error_message("cannot solve a %dx%d system with matrix '%s', right-hand side '%s' of size %d and solution '%s' of size %d",
+                              solve->A->rows, solve->A->cols, solve->A->name, solve->b->name, solve->b->size, solve->x->name, solve->x->size);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  // la factorizacion se reusa solamente si la matriz es constante, pero
+  // una matriz constante se puede asignar en el primer paso de cada corrida
+  // (parametricas, fit, etc) asi que ahi factorizamos de nuevo
+  if (solve->factorized == 0 || solve->A->constant == 0 ||
+      ((int)(wasora_var(wasora_special_var(step_static))) == 1 && (int)(wasora_var(wasora_special_var(step_transient))) == 0)) {
+    if (solve->factor == NULL) {
+      solve->factor = gsl_matrix_alloc(solve->A->rows, solve->A->cols);
+      solve->permutation = gsl_permutation_alloc(solve->A->rows);
+    }
+    gsl_matrix_memcpy(solve->factor, wasora_value_ptr(solve->A));
+
+    // que un sistema singular sea un error de wasora y no un abort de la gsl
+    handler = gsl_set_error_handler_off();
+    if (solve->method == matrix_solve_cholesky) {
+      status = gsl_linalg_cholesky_decomp(solve->factor);
+    } else {
+      status = gsl_linalg_LU_decomp(solve->factor, solve->permutation, &signum);
+    }
+    gsl_set_error_handler(handler);
+
+    if (status != GSL_SUCCESS) {
+      wasora_push_error_message("cannot factorize matrix '%s': %s", solve->A->name, gsl_strerror(status));
+      return WASORA_RUNTIME_ERROR;
+    }
+    solve->factorized = 1;
+  }
+
+  handler = gsl_set_error_handler_off();
+  if (solve->method == matrix_solve_cholesky) {
+    status = gsl_linalg_cholesky_solve(solve->factor, wasora_value_ptr(solve->b), wasora_value_ptr(solve->x));
+  } else {
+    status = gsl_linalg_LU_solve(solve->factor, solve->permutation, wasora_value_ptr(solve->b), wasora_value_ptr(solve->x));
+  }
+  gsl_set_error_handler(handler);
+
+  if (status != GSL_SUCCESS) {
+    wasora_push_error_message("cannot solve system with matrix '%s': %s", solve->A->name, gsl_strerror(status));
+    return WASORA_RUNTIME_ERROR;
+  }
+  wasora_check_initial_vector(solve->x);
+
+  return WASORA_RUNTIME_OK;
+}
@@ -233,17 +233,13 @@ int mesh_alloc_gauss(gauss_t *gauss, element_type_t *element_type, int V) {
 
 int mesh_init_shape_at_gauss(gauss_t *gauss, element_type_t *element_type) {
   
-  int v, j, m;
+  int v;
   
+  // the rows of the freshly-allocated dhdr matrices are contiguous so the
+  // derivatives can be written right into them as dhdr[j*dim+m]
   for (v = 0; v < gauss->V; v++) {
-    for (j = 0; j < element_type->nodes; j++) {
-
-      gauss->h[v][j] = element_type->h(j, gauss->r[v]);
-      for (m = 0; m < element_type->dim; m++) {
-        gsl_matrix_set(gauss->dhdr[v], j, m, element_type->dhdr(j, m, gauss->r[v]));
-      }
-      
-    }
+    element_type->h_all(gauss->r[v], gauss->h[v]);
+    element_type->dhdr_all(gauss->r[v], gauss->dhdr[v]->data);
   }
   
   return WASORA_RUNTIME_OK;
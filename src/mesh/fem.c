@@ -154,10 +154,17 @@ double mesh_determinant(gsl_matrix *A) {
 }
 
 // calcula los gradientes de las h con respecto a las x evaluadas en r
+// (sin tocar el heap, todo lo intermedio vive en el stack)
 void mesh_compute_dhdx(element_t *element, double *r, gsl_matrix *drdx_ref, gsl_matrix *dhdx) {
 
-  gsl_matrix *dxdr;
+  double dhdr[MESH_MAX_NODES_PER_ELEMENT*MESH_MAX_DIM];
+  double dxdr_data[MESH_MAX_DIM*MESH_MAX_DIM] = {0};
+  double drdx_data[MESH_MAX_DIM*MESH_MAX_DIM] = {0};
+  gsl_matrix_view dxdr_view;
+  gsl_matrix_view drdx_view;
   gsl_matrix *drdx;
+  double sum;
+  int dim = element->type->dim;
   int j, m, m_prime;
   
   if (drdx_ref != NULL) {
@@ -166,28 +173,25 @@ void mesh_compute_dhdx(element_t *element, double *r, gsl_matrix *drdx_ref, gsl_
     
   } else {
     // sino la calculamos
-    drdx = gsl_matrix_calloc(element->type->dim, element->type->dim);
-    dxdr = gsl_matrix_calloc(element->type->dim, element->type->dim);
+    dxdr_view = gsl_matrix_view_array(dxdr_data, dim, dim);
+    drdx_view = gsl_matrix_view_array(drdx_data, dim, dim);
+    drdx = &drdx_view.matrix;
     
-    mesh_compute_dxdr(element, r, dxdr);
-    mesh_inverse(dxdr, drdx);
+    mesh_compute_dxdr(element, r, &dxdr_view.matrix);
+    mesh_inverse(&dxdr_view.matrix, drdx);
   }
   
-  
-  gsl_matrix_set_zero(dhdx);
+  element->type->dhdr_all(r, dhdr);
   for (j = 0; j < element->type->nodes; j++) {
-    for (m = 0; m < element->type->dim; m++) {
-      for (m_prime = 0; m_prime < element->type->dim; m_prime++) {
-        gsl_matrix_add_to_element(dhdx, j, m, element->type->dhdr(j, m_prime, r) * gsl_matrix_get(drdx, m_prime, m));
+    for (m = 0; m < dim; m++) {
+      sum = 0;
+      for (m_prime = 0; m_prime < dim; m_prime++) {
+        sum += dhdr[j*dim+m_prime] * gsl_matrix_get(drdx, m_prime, m);
       }
+      gsl_matrix_set(dhdx, j, m, sum);
     }
   }
 
-  if (drdx_ref == NULL) {
-    gsl_matrix_free(drdx);
-    gsl_matrix_free(dxdr);
-  }
-  
   return;
 
 }
@@ -247,11 +251,7 @@ void mesh_compute_dhdx_at_gauss(element_t *element, int v, int integration) {
 
 void mesh_compute_h(element_t *element, double *r, double *h) {
 
-  int j;
-
-  for (j = 0; j < element->type->nodes; j++) {
-    h[j] = element->type->h(j, r);
-  }
+  element->type->h_all(r, h);
 
   return;
 
@@ -298,13 +298,16 @@ void mesh_compute_drdx_at_gauss(element_t *element, int v, int integration) {
 
 void mesh_compute_dxdr(element_t *element, double *r, gsl_matrix *dxdr) {
 
+  double dhdr[MESH_MAX_NODES_PER_ELEMENT*MESH_MAX_DIM];
+  int dim = element->type->dim;
   int m, m_prime, j;
   
   // OJO! esto solo camina en elementos volumetricos, ver dxdr_at_gauss
-  for (m = 0; m < element->type->dim; m++) {
-    for (m_prime = 0; m_prime < element->type->dim; m_prime++) {
+  element->type->dhdr_all(r, dhdr);
+  for (m = 0; m < dim; m++) {
+    for (m_prime = 0; m_prime < dim; m_prime++) {
       for (j = 0; j < element->type->nodes; j++) {
-        gsl_matrix_add_to_element(dxdr, m, m_prime, element->type->dhdr(j, m_prime, r) * element->node[j]->x[m]);
+        gsl_matrix_add_to_element(dxdr, m, m_prime, dhdr[j*dim+m_prime] * element->node[j]->x[m]);
       }
     }
   }
@@ -315,14 +318,16 @@ void mesh_compute_dxdr(element_t *element, double *r, gsl_matrix *dxdr) {
 
 void mesh_compute_x(element_t *element, double *r, double *x) {
 
+  double h[MESH_MAX_NODES_PER_ELEMENT];
   int j, m;
 
   
   // solo para elementos volumetricos
+  element->type->h_all(r, h);
   for (m = 0; m < 3; m++) {
     x[m] = 0;
     for (j = 0; j < element->type->nodes; j++) {
-      x[m] += element->type->h(j, r) * element->node[j]->x[m];
+      x[m] += h[j] * element->node[j]->x[m];
     }
   }
 
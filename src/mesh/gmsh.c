@@ -19,6 +19,7 @@
  *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
  *------------------- ------------  ----    --------  --     -       -         -
  */
+#define _GNU_SOURCE
 #include <wasora.h>
 #include <thirdparty/kdtree.h>
 
@@ -26,6 +27,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+// binary msh 2.2 files have the same structure as the ASCII ones but the
+// numbers of the nodes, elements and data blocks go as raw bytes
+static int mesh_gmsh_read_int(FILE *file, int binary, int *value) {
+  return binary ? (fread(value, sizeof(int), 1, file) == 1) : (fscanf(file, "%d", value) == 1);
+}
+
+static int mesh_gmsh_read_double(FILE *file, int binary, double *value) {
+  return binary ? (fread(value, sizeof(double), 1, file) == 1) : (fscanf(file, "%lf", value) == 1);
+}
 
 
 int mesh_gmsh_readmesh(mesh_t *mesh) {
@@ -41,6 +51,10 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
   int i, j, k, l;
   int version_maj;
   int version_min;
+  int binary = 0;
+  int one;
+  int header[3];
+  int block;
   int blocks, geometrical, tag, dimension, parametric, num;
   int first, second; // this are buffers because 4.0 and 4.1 swapped tag,dim to dim,tag
   int type, physical;
@@ -80,12 +94,18 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
         return WASORA_RUNTIME_ERROR;
       }
   
-      // el tipo (0 = ASCII)
+      // el tipo (0 = ASCII, 1 = binary)
       if (fscanf(mesh->file->pointer, "%s", buffer) == 0) {
         return WASORA_RUNTIME_ERROR;
       }
-      if (strcmp("0", buffer) != 0) {
-        wasora_push_error_message("mesh '%s' is binary, only ASCII files are supported", mesh->file->path);
+      if (strcmp("1", buffer) == 0) {
+        binary = 1;
+        if (version_maj != 2) {
+          wasora_push_error_message("mesh '%s' is binary, only ASCII files or binary version 2.2 are supported", mesh->file->path);
+          return WASORA_RUNTIME_ERROR;
+        }
+      } else if (strcmp("0", buffer) != 0) {
+        wasora_push_error_message("mesh '%s' has an unknown file type '%s'", mesh->file->path, buffer);
         return WASORA_RUNTIME_ERROR;
       }
   
@@ -93,18 +113,29 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
       if (fscanf(mesh->file->pointer, "%s", buffer) == 0) {
         return WASORA_RUNTIME_ERROR;
       }
-/*      
-      if (strcmp("8", buffer) != 0) {
+      if (binary && strcmp("8", buffer) != 0) {
         wasora_push_error_message("mesh '%s' has an incompatible data size '%s', only 8-byte files are supported", mesh->file->path, buffer);
         return WASORA_RUNTIME_ERROR;
       }
-*/
+
       // el newline
       if (fgets(buffer, BUFFER_SIZE-1, mesh->file->pointer) == NULL) {
         wasora_push_error_message("corrupted mesh '%s'", mesh->file->path);
         return WASORA_RUNTIME_ERROR;
       } 
       
+      // in binary files an integer one tells the endianness and then comes another newline
+      if (binary) {
+        if (fread(&one, sizeof(int), 1, mesh->file->pointer) != 1 || fgets(buffer, BUFFER_SIZE-1, mesh->file->pointer) == NULL) {
+          wasora_push_error_message("corrupted mesh '%s'", mesh->file->path);
+          return WASORA_RUNTIME_ERROR;
+        }
+        if (one != 1) {
+          wasora_push_error_message("binary mesh '%s' was written with a different endianness", mesh->file->path);
+          return WASORA_RUNTIME_ERROR;
+        }
+      }
+      
       // la linea $EndMeshFormat
       if (fgets(buffer, BUFFER_SIZE-1, mesh->file->pointer) == NULL) {
         wasora_push_error_message("corrupted mesh '%s'", mesh->file->path);
@@ -310,13 +341,18 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
         }
 
         mesh->node = calloc(mesh->n_nodes, sizeof(node_t));
+        
+        // the binary data starts after the newline
+        if (binary && fgets(buffer, BUFFER_SIZE-1, mesh->file->pointer) == NULL) {
+          wasora_push_error_message("corrupted mesh file '%s'", mesh->file->path);
+          return WASORA_RUNTIME_ERROR;
+        }
 
         for (j = 0; j < mesh->n_nodes; j++) {
-          if (fscanf(mesh->file->pointer, "%d %lf %lf %lf",
-                  &tag,
-                  &mesh->node[j].x[0],
-                  &mesh->node[j].x[1],
-                  &mesh->node[j].x[2]) < 4) {
+          if (mesh_gmsh_read_int(mesh->file->pointer, binary, &tag) == 0 ||
+              mesh_gmsh_read_double(mesh->file->pointer, binary, &mesh->node[j].x[0]) == 0 ||
+              mesh_gmsh_read_double(mesh->file->pointer, binary, &mesh->node[j].x[1]) == 0 ||
+              mesh_gmsh_read_double(mesh->file->pointer, binary, &mesh->node[j].x[2]) == 0) {
             return WASORA_RUNTIME_ERROR;
           }
           
@@ -501,10 +537,32 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
           return -2;
         }
         mesh->element = calloc(mesh->n_elements, sizeof(element_t));
+        
+        if (binary && fgets(buffer, BUFFER_SIZE-1, mesh->file->pointer) == NULL) {
+          wasora_push_error_message("corrupted mesh file '%s'", mesh->file->path);
+          return WASORA_RUNTIME_ERROR;
+        }
 
+        block = 0;
         for (i = 0; i < mesh->n_elements; i++) {
 
-          if (fscanf(mesh->file->pointer, "%d %d %d", &tag, &type, &ntags) < 3) {
+          if (binary) {
+            // binary elements come in blocks of the same type, each one with
+            // a header (type, number of elements in the block, number of tags)
+            if (block == 0) {
+              if (fread(header, sizeof(int), 3, mesh->file->pointer) != 3 || header[1] <= 0 || header[2] < 0) {
+                wasora_push_error_message("corrupted mesh file '%s'", mesh->file->path);
+                return WASORA_RUNTIME_ERROR;
+              }
+              block = header[1];
+            }
+            block--;
+            type = header[0];
+            ntags = header[2];
+            if (fread(&tag, sizeof(int), 1, mesh->file->pointer) != 1) {
+              return WASORA_RUNTIME_ERROR;
+            }
+          } else if (fscanf(mesh->file->pointer, "%d %d %d", &tag, &type, &ntags) < 3) {
             return WASORA_RUNTIME_ERROR;
           }
 
@@ -535,7 +593,7 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
           if (ntags > 0) {
             tags = malloc(ntags * sizeof(int));
             for (k = 0; k < ntags; k++) {
-              if (fscanf(mesh->file->pointer, "%d", &tags[k]) == 0) {
+              if (mesh_gmsh_read_int(mesh->file->pointer, binary, &tags[k]) == 0) {
                 return WASORA_RUNTIME_ERROR;
               }
             }
@@ -560,7 +618,7 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
           
           mesh->element[i].node = calloc(mesh->element[i].type->nodes, sizeof(node_t *));
           for (j = 0; j < mesh->element[i].type->nodes; j++) {
-            if (fscanf(mesh->file->pointer, "%d", &node) < 1) {
+            if (mesh_gmsh_read_int(mesh->file->pointer, binary, &node) == 0) {
               return WASORA_RUNTIME_ERROR;
             }
             if (mesh->sparse == 0 && (node < 1 || node > mesh->n_nodes)) {
@@ -732,11 +790,6 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
         }
       }
       
-      // si no tenemos funcion seguimos de largo e inogramos todo el bloque
-      if (function == NULL) {
-        continue;
-      }
-      
       // real-tags
       if (fscanf(mesh->file->pointer, "%d", &n_real_tags) == 0) {
         wasora_push_error_message("error reading file");
@@ -749,11 +802,6 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
         wasora_push_error_message("error reading file");
         return WASORA_RUNTIME_ERROR;
       }
-      // we read only data for t = 0
-      if (time != 0) {
-        continue;
-      }
-      
       // integer-tags
       if (fscanf(mesh->file->pointer, "%d", &n_integer_tags) == 0) {
         wasora_push_error_message("error reading file");
@@ -775,7 +823,19 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
         return WASORA_RUNTIME_ERROR;
       }
       
-      if (dofs != 1 || nodes != mesh->n_nodes) {
+      if (binary && fgets(buffer, BUFFER_SIZE-1, mesh->file->pointer) == NULL) {
+        wasora_push_error_message("error reading file");
+        return WASORA_RUNTIME_ERROR;
+      }
+      
+      // we read only scalar data for t = 0 of functions we know about,
+      // the skip is postponed until here because a binary block has to be
+      // jumped over as a whole and for that we need its size
+      if (function == NULL || time != 0 || dofs != 1 || nodes != mesh->n_nodes) {
+        if (binary && fseek(mesh->file->pointer, (long)nodes * (sizeof(int) + dofs*sizeof(double)), SEEK_CUR) != 0) {
+          wasora_push_error_message("error reading file");
+          return WASORA_RUNTIME_ERROR;
+        }
         continue;
       }
       
@@ -792,7 +852,7 @@ int mesh_gmsh_readmesh(mesh_t *mesh) {
       }  
       
       for (j = 0; j < nodes; j++) {
-        if (fscanf(mesh->file->pointer, "%d %lf", &node, &value) == 0) {
+        if (mesh_gmsh_read_int(mesh->file->pointer, binary, &node) == 0 || mesh_gmsh_read_double(mesh->file->pointer, binary, &value) == 0) {
           wasora_push_error_message("error reading file");
           return WASORA_RUNTIME_ERROR;
         }
@@ -927,9 +987,24 @@ int mesh_gmsh_write_header(FILE *file) {
   return WASORA_RUNTIME_OK;
 }
 
-int mesh_gmsh_write_mesh(mesh_t *mesh, int no_physical_names, FILE *file) {
+// the integer one lets the reader figure out the endianness
+int mesh_gmsh_write_header_binary(FILE *file) {
+  int one = 1;
+  
+  fprintf(file, "$MeshFormat\n");
+  fprintf(file, "2.2 1 8\n");
+  fwrite(&one, sizeof(int), 1, file);
+  fprintf(file, "\n$EndMeshFormat\n");
+
+  return WASORA_RUNTIME_OK;
+}
+
+static int mesh_gmsh_write_mesh_format(mesh_t *mesh, int no_physical_names, int binary, FILE *file) {
   
   int i, j, n;
+  int first, tags;
+  char *buffer, *p;
+  size_t size;
   physical_entity_t *physical_entity;
 
   if (no_physical_names == 0) {
@@ -949,33 +1024,77 @@ int mesh_gmsh_write_mesh(mesh_t *mesh, int no_physical_names, FILE *file) {
   
   fprintf(file, "$Nodes\n");
   fprintf(file, "%d\n", mesh->n_nodes);
-  for (i = 0; i < mesh->n_nodes; i++) {
-    fprintf(file, "%d %g %g %g\n", mesh->node[i].tag, mesh->node[i].x[0], mesh->node[i].x[1], mesh->node[i].x[2]);
+  if (binary) {
+    // tag and three coordinates per node, all of them in a single write
+    size = sizeof(int) + 3*sizeof(double);
+    buffer = malloc(mesh->n_nodes * size);
+    for (i = 0; i < mesh->n_nodes; i++) {
+      p = buffer + i*size;
+      memcpy(p, &mesh->node[i].tag, sizeof(int));
+      memcpy(p + sizeof(int), mesh->node[i].x, 3*sizeof(double));
+    }
+    fwrite(buffer, size, mesh->n_nodes, file);
+    free(buffer);
+    fprintf(file, "\n");
+  } else {
+    for (i = 0; i < mesh->n_nodes; i++) {
+      fprintf(file, "%d %g %g %g\n", mesh->node[i].tag, mesh->node[i].x[0], mesh->node[i].x[1], mesh->node[i].x[2]);
+    }
   }
   fprintf(file, "$EndNodes\n");
 
   fprintf(file, "$Elements\n");
   fprintf(file, "%d\n", mesh->n_elements);
-  for (i = 0; i < mesh->n_elements; i++) {
-    fprintf(file, "%d ", mesh->element[i].tag);
-    fprintf(file, "%d ", mesh->element[i].type->id);
-
-    // in principle we shuold write the detailed information about entities and parititons
-//    fprintf(file, "%d ", mesh->element[i].ntags);
-    
-    // but for now only two tags are enough:
-    // the first one is the physical entity and the second one ought to be the geometrical entity
-    // if there is no such information, then we just duplicate the physical entity tag
-    if (mesh->element[i].physical_entity != NULL) {
-      fprintf(file, "2 %d %d", mesh->element[i].physical_entity->tag, mesh->element[i].physical_entity->tag);
-    } else {
-      fprintf(file, "2 0 0");
-    }
-    // los nodos
-    for (j = 0; j < mesh->element[i].type->nodes; j++) {
-      fprintf(file, " %d", mesh->element[i].node[j]->tag);
+  if (binary) {
+    // blocks of consecutive elements of the same type, each one with a header
+    // (type, number of elements, number of tags) and then tag, tags and nodes
+    first = 0;
+    while (first < mesh->n_elements) {
+      for (n = first+1; n < mesh->n_elements && mesh->element[n].type == mesh->element[first].type; n++);
+      
+      size = (1 + 2 + mesh->element[first].type->nodes) * sizeof(int);
+      buffer = malloc(3*sizeof(int) + (n-first) * size);
+      ((int *)buffer)[0] = mesh->element[first].type->id;
+      ((int *)buffer)[1] = n-first;
+      ((int *)buffer)[2] = 2;
+      for (i = first; i < n; i++) {
+        int *element = (int *)(buffer + 3*sizeof(int) + (i-first)*size);
+        tags = (mesh->element[i].physical_entity != NULL) ? mesh->element[i].physical_entity->tag : 0;
+        element[0] = mesh->element[i].tag;
+        element[1] = tags;
+        element[2] = tags;
+        for (j = 0; j < mesh->element[i].type->nodes; j++) {
+          element[3+j] = mesh->element[i].node[j]->tag;
+        }
+      }
+      fwrite(buffer, 1, 3*sizeof(int) + (n-first) * size, file);
+      free(buffer);
+      first = n;
     }
     fprintf(file, "\n");
+    
+  } else {
+    for (i = 0; i < mesh->n_elements; i++) {
+      fprintf(file, "%d ", mesh->element[i].tag);
+      fprintf(file, "%d ", mesh->element[i].type->id);
+
+      // in principle we shuold write the detailed information about entities and parititons
+  //    fprintf(file, "%d ", mesh->element[i].ntags);
+
+      // but for now only two tags are enough:
+      // the first one is the physical entity and the second one ought to be the geometrical entity
+      // if there is no such information, then we just duplicate the physical entity tag
+      if (mesh->element[i].physical_entity != NULL) {
+        fprintf(file, "2 %d %d", mesh->element[i].physical_entity->tag, mesh->element[i].physical_entity->tag);
+      } else {
+        fprintf(file, "2 0 0");
+      }
+      // los nodos
+      for (j = 0; j < mesh->element[i].type->nodes; j++) {
+        fprintf(file, " %d", mesh->element[i].node[j]->tag);
+      }
+      fprintf(file, "\n");
+    }
   }
   fprintf(file, "$EndElements\n");
   
@@ -983,168 +1102,262 @@ int mesh_gmsh_write_mesh(mesh_t *mesh, int no_physical_names, FILE *file) {
   
 }
 
+int mesh_gmsh_write_mesh(mesh_t *mesh, int no_physical_names, FILE *file) {
+  return mesh_gmsh_write_mesh_format(mesh, no_physical_names, 0, file);
+}
 
-int mesh_gmsh_write_scalar(mesh_post_t *mesh_post, function_t *function, centering_t centering) {
+int mesh_gmsh_write_mesh_binary(mesh_t *mesh, int no_physical_names, FILE *file) {
+  return mesh_gmsh_write_mesh_format(mesh, no_physical_names, 1, file);
+}
 
-  int i;
-  mesh_t *mesh;
-  
-  if (mesh_post->mesh != NULL) {
-    mesh = mesh_post->mesh;
-  } else if (function != NULL) {
-    mesh = function->mesh;
-  } else {
-    wasora_push_error_message("do not know which mesh to apply to post-process function '%s'", function->name);
-    return WASORA_RUNTIME_ERROR;
-  }
 
+// value of a function at the j-th node or cell, pointwise data is read directly
+static double mesh_gmsh_value(mesh_t *mesh, function_t *function, centering_t centering, int j) {
+  
   if (centering == centering_cells) {
-    fprintf(mesh_post->file->pointer, "$ElementData\n");
-    if (mesh->n_cells == 0) {
-      wasora_call(mesh_element2cell(mesh));
+    if (function->type == type_pointwise_mesh_cell && function->mesh == mesh && function->data_size == mesh->n_cells) {
+      return function->data_value[j];
     }
-  } else {
-    fprintf(mesh_post->file->pointer, "$NodeData\n");
+    return wasora_evaluate_function(function, mesh->cell[j].x);
+  }
+  
+  if (function->type == type_pointwise_mesh_node && function->mesh == mesh && function->data_size == mesh->n_nodes) {
+    return (function->data_value != NULL) ? function->data_value[j] : 0;
   }
+  return wasora_evaluate_function(function, mesh->node[j].x);
+}
+
+// a $NodeData or $ElementData block of an already-evaluated field
+static int mesh_gmsh_write_data(mesh_post_t *mesh_post, mesh_t *mesh, const char *name, int components, centering_t centering, const double *values) {
+
+  FILE *file = mesh_post->file->pointer;
+  char *buffer, *p;
+  size_t size;
+  int i, g, n;
+  int tag;
+  
+  n = (centering == centering_cells) ? mesh->n_cells : mesh->n_nodes;
+  fprintf(file, (centering == centering_cells) ? "$ElementData\n" : "$NodeData\n");
 
   // one string tag
-  fprintf(mesh_post->file->pointer, "1\n");
+  fprintf(file, "1\n");
   // the name of the vew
-  fprintf(mesh_post->file->pointer, "\"%s\"\n", function->name);
+  fprintf(file, "\"%s\"\n", name);
   // the other one (optional) is the interpolation scheme
   
   // one real tag (only one)
-  fprintf(mesh_post->file->pointer, "1\n");                          
+  fprintf(file, "1\n");                          
   // time
-  fprintf(mesh_post->file->pointer, "%g\n", wasora_value(wasora_special_var(time)));
+  fprintf(file, "%g\n", wasora_value(wasora_special_var(time)));
 
   // thre integer tags
-  fprintf(mesh_post->file->pointer, "3\n");
+  fprintf(file, "3\n");
   // timestep
-  fprintf(mesh_post->file->pointer, "%d\n", (int)((wasora_var(wasora_special_var(end_time)) != 0) ? wasora_var(wasora_special_var(step_transient)) : wasora_value(wasora_special_var(step_static))));
-  // number of data per node: uno (scalar)
-  fprintf(mesh_post->file->pointer, "%d\n", 1);
-
-  if (centering == centering_cells) {
-    // number of data
-    fprintf(mesh_post->file->pointer, "%d\n", mesh->n_cells);
-
-    if (function->type == type_pointwise_mesh_cell && function->mesh == mesh) {
-      for (i = 0; i < function->data_size; i++) {
-        fprintf(mesh_post->file->pointer, "%d %g\n", mesh->cell[i].element->tag, function->data_value[i]);
-      }
-    } else {
-      for (i = 0; i < mesh->n_cells; i++) {
-        fprintf(mesh_post->file->pointer, "%d %g\n", mesh->cell[i].element->tag, wasora_evaluate_function(function, mesh->cell[i].x));
+  fprintf(file, "%d\n", (int)((wasora_var(wasora_special_var(end_time)) != 0) ? wasora_var(wasora_special_var(step_transient)) : wasora_value(wasora_special_var(step_static))));
+  // number of data per node
+  fprintf(file, "%d\n", components);
+  // number of data
+  fprintf(file, "%d\n", n);
+
+  if (mesh_post->binary) {
+    // the whole block goes in a single write
+    size = sizeof(int) + components*sizeof(double);
+    buffer = malloc(n * size);
+    for (i = 0; i < n; i++) {
+      p = buffer + i*size;
+      tag = (centering == centering_cells) ? mesh->cell[i].element->tag : mesh->node[i].tag;
+      memcpy(p, &tag, sizeof(int));
+      memcpy(p + sizeof(int), values + i*components, components*sizeof(double));
+    }
+    fwrite(buffer, size, n, file);
+    free(buffer);
+    fprintf(file, "\n");
+  } else {
+    for (i = 0; i < n; i++) {
+      fprintf(file, "%d", (centering == centering_cells) ? mesh->cell[i].element->tag : mesh->node[i].tag);
+      for (g = 0; g < components; g++) {
+        fprintf(file, " %g", values[i*components + g]);
       }
+      fprintf(file, "\n");
     }
-    fprintf(mesh_post->file->pointer, "$EndElementData\n");
-    
-  } else  {
-    
-    // number of data
-    fprintf(mesh_post->file->pointer, "%d\n", mesh->n_nodes);              
+  }
   
-    if (function->type == type_pointwise_mesh_node && function->mesh == mesh) {
-      for (i = 0; i < function->data_size; i++) {
-        fprintf(mesh_post->file->pointer, "%d %g\n", mesh->node[i].tag, function->data_value[i]);
-      }
-    } else {
-      for (i = 0; i < mesh->n_nodes; i++) {
-        fprintf(mesh_post->file->pointer, "%d %g\n", mesh->node[i].tag, wasora_evaluate_function(function, mesh->node[i].x));
-      }
+  fprintf(file, (centering == centering_cells) ? "$EndElementData\n" : "$EndNodeData\n");
+  
+  return WASORA_RUNTIME_OK;
+}
+
+static mesh_t *mesh_gmsh_post_mesh(mesh_post_t *mesh_post, function_t *function, centering_t centering) {
+  
+  mesh_t *mesh;
+  
+  if (mesh_post->mesh != NULL) {
+    mesh = mesh_post->mesh;
+  } else if (function != NULL) {
+    mesh = function->mesh;
+  } else {
+    wasora_push_error_message("do not know which mesh to apply to post-process");
+    return NULL;
+  }
+  
+  if (centering == centering_cells && mesh->n_cells == 0) {
+    if (mesh_element2cell(mesh) != WASORA_RUNTIME_OK) {
+      return NULL;
     }
-    fprintf(mesh_post->file->pointer, "$EndNodeData\n");    
   }
   
-  fflush(mesh_post->file->pointer);
+  return mesh;
+}
+
+
+int mesh_gmsh_write_scalar(mesh_post_t *mesh_post, function_t *function, centering_t centering) {
+
+  mesh_t *mesh;
+  double *values;
+  int j, n;
   
+  if ((mesh = mesh_gmsh_post_mesh(mesh_post, function, centering)) == NULL) {
+    return WASORA_RUNTIME_ERROR;
+  }
 
+  n = (centering == centering_cells) ? mesh->n_cells : mesh->n_nodes;
+  values = malloc(n * sizeof(double));
+  for (j = 0; j < n; j++) {
+    values[j] = mesh_gmsh_value(mesh, function, centering, j);
+  }
+  wasora_call(mesh_gmsh_write_data(mesh_post, mesh, function->name, 1, centering, values));
+  free(values);
+  
+  fflush(mesh_post->file->pointer);
+  
   return WASORA_RUNTIME_OK;
 
 }
 
 int mesh_gmsh_write_vector(mesh_post_t *mesh_post, function_t **function, centering_t centering) {
 
-  int i, j;
   mesh_t *mesh;
+  double *values;
+  char *name;
+  int j, g, n;
   
-  if (mesh_post->mesh != NULL) {
-    mesh = mesh_post->mesh;
-  } else if (function != NULL) {
-    mesh = function[0]->mesh;
-  } else {
+  if ((mesh = mesh_gmsh_post_mesh(mesh_post, function[0], centering)) == NULL) {
     return WASORA_RUNTIME_ERROR;
   }
 
-  if (centering == centering_cells) {
-    fprintf(mesh_post->file->pointer, "$ElementData\n");
-    if (mesh->n_cells == 0) {
-      wasora_call(mesh_element2cell(mesh));
+  n = (centering == centering_cells) ? mesh->n_cells : mesh->n_nodes;
+  values = malloc(3*n * sizeof(double));
+  for (j = 0; j < n; j++) {
+    for (g = 0; g < 3; g++) {
+      values[3*j+g] = mesh_gmsh_value(mesh, function[g], centering, j);
     }
-  } else {
-    fprintf(mesh_post->file->pointer, "$NodeData\n");
   }
-
-  // un tag de string  
-  fprintf(mesh_post->file->pointer, "1\n");
-  // nombre de la vista
-  fprintf(mesh_post->file->pointer, "\"%s_%s_%s\"\n", function[0]->name, function[1]->name, function[2]->name);
-  // la otra (opcional) es el esquema de interpolacion
   
-  // un tag real (el unico)  
-  fprintf(mesh_post->file->pointer, "1\n");                          
-  // tiempo
-  fprintf(mesh_post->file->pointer, "%g\n", (wasora_var(wasora_special_var(end_time)) != 0) ? wasora_value(wasora_special_var(time)) : wasora_value(wasora_special_var(step_static)));
+  if (asprintf(&name, "%s_%s_%s", function[0]->name, function[1]->name, function[2]->name) == -1) {
+    free(values);
+    return WASORA_RUNTIME_ERROR;
+  }
+  wasora_call(mesh_gmsh_write_data(mesh_post, mesh, name, 3, centering, values));
+  free(name);
+  free(values);
+ 
+  fflush(mesh_post->file->pointer);
 
-  // tres tags enteros
-  fprintf(mesh_post->file->pointer, "3\n");
-  // timestep
-  fprintf(mesh_post->file->pointer, "%d\n", (int)((wasora_var(wasora_special_var(end_time)) != 0) ? wasora_var(wasora_special_var(step_transient)) : wasora_value(wasora_special_var(step_static))));
-  // cantidad de datos por punto: 3 (un vector)
-  fprintf(mesh_post->file->pointer, "%d\n", 3);
+  return WASORA_RUNTIME_OK;
 
-  if (centering == centering_cells) {
-    for (i = 0; i < mesh->n_cells; i++) {
-      fprintf(mesh_post->file->pointer, "%d %g %g %g\n", mesh->cell[i].element->index,
-                                                         wasora_evaluate_function(function[0], mesh->cell[i].x),
-                                                         wasora_evaluate_function(function[1], mesh->cell[i].x),
-                                                         wasora_evaluate_function(function[2], mesh->cell[i].x));
-    }
-    fprintf(mesh_post->file->pointer, "$EndElementData\n");
-  } else {
-    // numero de datos
-    fprintf(mesh_post->file->pointer, "%d\n", mesh->n_nodes);              
+}
+
+// all the fields of the post evaluated in a single pass over the nodes (and
+// another one over the cells) into a staging buffer, then one block per field
+int mesh_gmsh_write_fields(mesh_post_t *mesh_post) {
   
-    for (j = 0; j < mesh->n_nodes; j++) {
-      fprintf(mesh_post->file->pointer, "%d ", mesh->node[j].tag);
-      
-      if (function[0]->type == type_pointwise_mesh_node && function[0]->data_size == mesh_post->mesh->n_nodes) {
-        fprintf(mesh_post->file->pointer, "%g ", function[0]->data_value[j]);
+  mesh_post_dist_t *mesh_post_dist;
+  mesh_t *mesh;
+  double *staging;
+  char *name;
+  size_t *offset;
+  int *components;
+  int n_fields, width;
+  int c, f, g, j, n;
+  centering_t centering[2] = {centering_nodes, centering_cells};
+  
+  n_fields = 0;
+  LL_FOREACH(mesh_post->mesh_post_dists, mesh_post_dist) {
+    n_fields++;
+  }
+  if (n_fields == 0) {
+    return WASORA_RUNTIME_OK;
+  }
+  offset = calloc(n_fields, sizeof(size_t));
+  components = calloc(n_fields, sizeof(int));
+  
+  for (c = 0; c < 2; c++) {
+    
+    // the layout of the staging buffer: each field is contiguous
+    width = 0;
+    mesh = NULL;
+    f = 0;
+    LL_FOREACH(mesh_post->mesh_post_dists, mesh_post_dist) {
+      if ((mesh_post_dist->centering == centering_cells) == (centering[c] == centering_cells)) {
+        components[f] = (mesh_post_dist->scalar != NULL) ? 1 : 3;
+        width += components[f];
+        if (mesh == NULL && (mesh = mesh_gmsh_post_mesh(mesh_post, (mesh_post_dist->scalar != NULL) ? mesh_post_dist->scalar : mesh_post_dist->vector[0], centering[c])) == NULL) {
+          return WASORA_RUNTIME_ERROR;
+        }
       } else {
-        fprintf(mesh_post->file->pointer, "%g ", wasora_evaluate_function(function[0], mesh->node[j].x));
+        components[f] = 0;
       }
-
-      if (function[1]->type == type_pointwise_mesh_node && function[1]->data_size == mesh_post->mesh->n_nodes) {
-        fprintf(mesh_post->file->pointer, "%g ", function[1]->data_value[j]);
-      } else {
-        fprintf(mesh_post->file->pointer, "%g ", wasora_evaluate_function(function[1], mesh->node[j].x));
+      f++;
+    }
+    if (width == 0) {
+      continue;
+    }
+    
+    n = (centering[c] == centering_cells) ? mesh->n_cells : mesh->n_nodes;
+    staging = malloc(n * width * sizeof(double));
+    f = 0;
+    width = 0;
+    LL_FOREACH(mesh_post->mesh_post_dists, mesh_post_dist) {
+      offset[f] = (size_t)n * width;
+      width += components[f];
+      f++;
+    }
+    
+    for (j = 0; j < n; j++) {
+      f = 0;
+      LL_FOREACH(mesh_post->mesh_post_dists, mesh_post_dist) {
+        if (components[f] == 1) {
+          staging[offset[f] + j] = mesh_gmsh_value(mesh, mesh_post_dist->scalar, centering[c], j);
+        } else if (components[f] == 3) {
+          for (g = 0; g < 3; g++) {
+            staging[offset[f] + 3*j+g] = mesh_gmsh_value(mesh, mesh_post_dist->vector[g], centering[c], j);
+          }
+        }
+        f++;
       }
-
-      if (function[2]->type == type_pointwise_mesh_node && function[2]->data_size == mesh_post->mesh->n_nodes) {
-        fprintf(mesh_post->file->pointer, "%g\n", function[2]->data_value[j]);
-      } else {
-        fprintf(mesh_post->file->pointer, "%g\n", wasora_evaluate_function(function[2], mesh->node[j].x));
+    }
+    
+    f = 0;
+    LL_FOREACH(mesh_post->mesh_post_dists, mesh_post_dist) {
+      if (components[f] == 1) {
+        wasora_call(mesh_gmsh_write_data(mesh_post, mesh, mesh_post_dist->scalar->name, 1, centering[c], staging + offset[f]));
+      } else if (components[f] == 3) {
+        if (asprintf(&name, "%s_%s_%s", mesh_post_dist->vector[0]->name, mesh_post_dist->vector[1]->name, mesh_post_dist->vector[2]->name) == -1) {
+          return WASORA_RUNTIME_ERROR;
+        }
+        wasora_call(mesh_gmsh_write_data(mesh_post, mesh, name, 3, centering[c], staging + offset[f]));
+        free(name);
       }
+      f++;
     }
-    fprintf(mesh_post->file->pointer, "$EndNodeData\n");
+    free(staging);
   }
- 
+  
+  free(components);
+  free(offset);
   fflush(mesh_post->file->pointer);
   
-
   return WASORA_RUNTIME_OK;
-
 }
 
 
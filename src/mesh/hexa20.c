@@ -45,6 +45,8 @@ int mesh_hexa20_init(void) {
   element_type->nodes_per_face = 8;
   element_type->h = mesh_hexa20_h;
   element_type->dhdr = mesh_hexa20_dhdr;
+  element_type->h_all = mesh_hexa20_h_all;
+  element_type->dhdr_all = mesh_hexa20_dhdr_all;
   element_type->point_in_element = mesh_point_in_hexahedron;
   element_type->element_volume = mesh_hexahedron_vol;
 
@@ -562,3 +564,84 @@ double mesh_hexa20_dhdr(int j, int m, double *vec_r) {
 
 }
 
+
+// all the shape functions and all their derivatives in a single pass
+// local coordinates of the nodes, the first eight are the corners and the
+// other twelve sit at the middle of the edges (so one of their coordinates is zero)
+static const double mesh_hexa20_node[20][3] = {
+  {-1, -1, -1}, {+1, -1, -1}, {+1, +1, -1}, {-1, +1, -1},
+  {-1, -1, +1}, {+1, -1, +1}, {+1, +1, +1}, {-1, +1, +1},
+  { 0, -1, -1}, {-1,  0, -1}, {-1, -1,  0}, {+1,  0, -1},
+  {+1, -1,  0}, { 0, +1, -1}, {+1, +1,  0}, {-1, +1,  0},
+  { 0, -1, +1}, {-1,  0, +1}, {+1,  0, +1}, { 0, +1, +1}
+};
+
+void mesh_hexa20_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+  const double *n;
+  int j;
+
+  for (j = 0; j < 8; j++) {
+    n = mesh_hexa20_node[j];
+    h[j] = (1+n[0]*r)*(1+n[1]*s)*(1+n[2]*t)*(n[0]*r+n[1]*s+n[2]*t-2)/8.0;
+  }
+  for (j = 8; j < 20; j++) {
+    n = mesh_hexa20_node[j];
+    h[j] = ((n[0] == 0) ? (1-r*r) : (1+n[0]*r)) *
+           ((n[1] == 0) ? (1-s*s) : (1+n[1]*s)) *
+           ((n[2] == 0) ? (1-t*t) : (1+n[2]*t)) / 4.0;
+  }
+
+  return;
+}
+
+void mesh_hexa20_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+  double fr, fs, ft;
+  double dfr, dfs, dft;
+  const double *n;
+  int j;
+
+  for (j = 0; j < 8; j++) {
+    n = mesh_hexa20_node[j];
+    fr = 1+n[0]*r;
+    fs = 1+n[1]*s;
+    ft = 1+n[2]*t;
+    dhdr[3*j+0] = n[0]*fs*ft*(2*n[0]*r+n[1]*s+n[2]*t-1)/8.0;
+    dhdr[3*j+1] = n[1]*fr*ft*(n[0]*r+2*n[1]*s+n[2]*t-1)/8.0;
+    dhdr[3*j+2] = n[2]*fr*fs*(n[0]*r+n[1]*s+2*n[2]*t-1)/8.0;
+  }
+  for (j = 8; j < 20; j++) {
+    n = mesh_hexa20_node[j];
+    if (n[0] == 0) {
+      fr = 1-r*r;
+      dfr = -2*r;
+    } else {
+      fr = 1+n[0]*r;
+      dfr = n[0];
+    }
+    if (n[1] == 0) {
+      fs = 1-s*s;
+      dfs = -2*s;
+    } else {
+      fs = 1+n[1]*s;
+      dfs = n[1];
+    }
+    if (n[2] == 0) {
+      ft = 1-t*t;
+      dft = -2*t;
+    } else {
+      ft = 1+n[2]*t;
+      dft = n[2];
+    }
+    dhdr[3*j+0] = dfr*fs*ft/4.0;
+    dhdr[3*j+1] = fr*dfs*ft/4.0;
+    dhdr[3*j+2] = fr*fs*dft/4.0;
+  }
+
+  return;
+}
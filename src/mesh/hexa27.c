@@ -45,6 +45,8 @@ int mesh_hexa27_init(void) {
   element_type->nodes_per_face = 9;
   element_type->h = mesh_hexa27_h;
   element_type->dhdr = mesh_hexa27_dhdr;
+  element_type->h_all = mesh_hexa27_h_all;
+  element_type->dhdr_all = mesh_hexa27_dhdr_all;
   element_type->point_in_element = mesh_point_in_hexahedron;
   element_type->element_volume = mesh_hexahedron_vol;
 
@@ -731,3 +733,47 @@ double mesh_hexa27_dhdr(int j, int m, double *vec_r) {
 
 }
 
+
+// all the shape functions and all their derivatives in a single pass
+// the 27-node hexahedron is the tensor product of three three-node lines,
+// these tables say which 1d function (0 = minus, 1 = plus, 2 = center) each node takes
+static const int mesh_hexa27_ir[27] = {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 1, 1, 2, 1, 0, 2, 0, 1, 2, 2, 2, 0, 1, 2, 2, 2};
+static const int mesh_hexa27_is[27] = {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 2, 0, 1, 1, 1, 0, 2, 2, 1, 2, 0, 2, 2, 1, 2, 2};
+static const int mesh_hexa27_it[27] = {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 2, 0, 2, 0, 2, 2, 1, 1, 1, 1, 0, 2, 2, 2, 2, 1, 2};
+
+void mesh_hexa27_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+  double lr[3] = {0.5*r*(r-1), 0.5*r*(r+1), 1-r*r};
+  double ls[3] = {0.5*s*(s-1), 0.5*s*(s+1), 1-s*s};
+  double lt[3] = {0.5*t*(t-1), 0.5*t*(t+1), 1-t*t};
+  int j;
+
+  for (j = 0; j < 27; j++) {
+    h[j] = lr[mesh_hexa27_ir[j]] * ls[mesh_hexa27_is[j]] * lt[mesh_hexa27_it[j]];
+  }
+
+  return;
+}
+
+void mesh_hexa27_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+  double lr[3] = {0.5*r*(r-1), 0.5*r*(r+1), 1-r*r};
+  double ls[3] = {0.5*s*(s-1), 0.5*s*(s+1), 1-s*s};
+  double lt[3] = {0.5*t*(t-1), 0.5*t*(t+1), 1-t*t};
+  double dlr[3] = {r-0.5, r+0.5, -2*r};
+  double dls[3] = {s-0.5, s+0.5, -2*s};
+  double dlt[3] = {t-0.5, t+0.5, -2*t};
+  int j;
+
+  for (j = 0; j < 27; j++) {
+    dhdr[3*j+0] = dlr[mesh_hexa27_ir[j]] * ls[mesh_hexa27_is[j]] * lt[mesh_hexa27_it[j]];
+    dhdr[3*j+1] = lr[mesh_hexa27_ir[j]] * dls[mesh_hexa27_is[j]] * lt[mesh_hexa27_it[j]];
+    dhdr[3*j+2] = lr[mesh_hexa27_ir[j]] * ls[mesh_hexa27_is[j]] * dlt[mesh_hexa27_it[j]];
+  }
+
+  return;
+}
@@ -44,6 +44,8 @@ int mesh_hexa8_init(void) {
   element_type->nodes_per_face = 4;
   element_type->h = mesh_hexa8_h;
   element_type->dhdr = mesh_hexa8_dhdr;
+  element_type->h_all = mesh_hexa8_h_all;
+  element_type->dhdr_all = mesh_hexa8_dhdr_all;
   element_type->point_in_element = mesh_point_in_hexahedron;
   element_type->element_volume = mesh_hexahedron_vol;
 
@@ -762,3 +764,45 @@ double mesh_hexahedron_vol(element_t *element) {
  return element->volume;
 
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_hexa8_h_all(const double *vec_r, double *h) {
+  double rm = 1-vec_r[0];
+  double rp = 1+vec_r[0];
+  double sm = 1-vec_r[1];
+  double sp = 1+vec_r[1];
+  double tm = 1-vec_r[2];
+  double tp = 1+vec_r[2];
+
+  h[0] = 1.0/8.0*rm*sm*tm;
+  h[1] = 1.0/8.0*rp*sm*tm;
+  h[2] = 1.0/8.0*rp*sp*tm;
+  h[3] = 1.0/8.0*rm*sp*tm;
+  h[4] = 1.0/8.0*rm*sm*tp;
+  h[5] = 1.0/8.0*rp*sm*tp;
+  h[6] = 1.0/8.0*rp*sp*tp;
+  h[7] = 1.0/8.0*rm*sp*tp;
+
+  return;
+}
+
+void mesh_hexa8_dhdr_all(const double *vec_r, double *dhdr) {
+  double rm = 1-vec_r[0];
+  double rp = 1+vec_r[0];
+  double sm = 1-vec_r[1];
+  double sp = 1+vec_r[1];
+  double tm = 1-vec_r[2];
+  double tp = 1+vec_r[2];
+
+  dhdr[0]  = -1.0/8.0*sm*tm;   dhdr[1]  = -1.0/8.0*rm*tm;   dhdr[2]  = -1.0/8.0*rm*sm;
+  dhdr[3]  = +1.0/8.0*sm*tm;   dhdr[4]  = -1.0/8.0*rp*tm;   dhdr[5]  = -1.0/8.0*rp*sm;
+  dhdr[6]  = +1.0/8.0*sp*tm;   dhdr[7]  = +1.0/8.0*rp*tm;   dhdr[8]  = -1.0/8.0*rp*sp;
+  dhdr[9]  = -1.0/8.0*sp*tm;   dhdr[10] = +1.0/8.0*rm*tm;   dhdr[11] = -1.0/8.0*rm*sp;
+  dhdr[12] = -1.0/8.0*sm*tp;   dhdr[13] = -1.0/8.0*rm*tp;   dhdr[14] = +1.0/8.0*rm*sm;
+  dhdr[15] = +1.0/8.0*sm*tp;   dhdr[16] = -1.0/8.0*rp*tp;   dhdr[17] = +1.0/8.0*rp*sm;
+  dhdr[18] = +1.0/8.0*sp*tp;   dhdr[19] = +1.0/8.0*rp*tp;   dhdr[20] = +1.0/8.0*rp*sp;
+  dhdr[21] = -1.0/8.0*sp*tp;   dhdr[22] = +1.0/8.0*rm*tp;   dhdr[23] = +1.0/8.0*rm*sp;
+
+  return;
+}
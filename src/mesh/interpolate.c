@@ -82,23 +82,25 @@ double mesh_interpolate_function_node(struct function_t *function, const double
   y = 0;
   if (function->spatial_derivative_of == NULL) {
     
+    double h[MESH_MAX_NODES_PER_ELEMENT];
+    
+    element->type->h_all(r, h);
     for (j = 0; j < element->type->nodes; j++) {
-      y += element->type->h(j, r) * function->data_value[element->node[j]->index_mesh];    
+      y += h[j] * function->data_value[element->node[j]->index_mesh];    
     }
     
   } else {
     
-    gsl_matrix *dhdx = gsl_matrix_alloc(element->type->nodes, element->type->dim);
+    double dhdx_data[MESH_MAX_NODES_PER_ELEMENT*MESH_MAX_DIM];
+    gsl_matrix_view dhdx = gsl_matrix_view_array(dhdx_data, element->type->nodes, element->type->dim);
     
-    mesh_compute_dhdx(element, r, NULL, dhdx);
+    mesh_compute_dhdx(element, r, NULL, &dhdx.matrix);
       
     for (j = 0; j < element->type->nodes; j++) {
-      y += gsl_matrix_get(dhdx, j, function->spatial_derivative_with_respect_to)
+      y += gsl_matrix_get(&dhdx.matrix, j, function->spatial_derivative_with_respect_to)
             * function->spatial_derivative_of->data_value[element->node[j]->index_mesh];
     }
     
-    gsl_matrix_free(dhdx);
-    
   }  
   
   return y;
@@ -171,14 +173,16 @@ int mesh_interp_residual(const gsl_vector *test, void *params, gsl_vector *resid
 
   int i, j;
   double xi;
+  double h[MESH_MAX_NODES_PER_ELEMENT];
   
   element_t *element = ((struct mesh_interp_params *)params)->element;
   const double *x = ((struct mesh_interp_params *)params)->x;
 
+  element->type->h_all(gsl_vector_const_ptr(test, 0), h);
   for (i = 0; i < element->type->dim; i++) {
     xi = x[i];
     for (j = 0; j< element->type->nodes; j++) {
-      xi -= element->type->h(j, (double *)gsl_vector_const_ptr(test, 0)) * element->node[j]->x[i];
+      xi -= h[j] * element->node[j]->x[i];
     }
     gsl_vector_set(residual, i, xi);
   }
@@ -192,16 +196,17 @@ int mesh_interp_jacob(const gsl_vector *test, void *params, gsl_matrix *J) {
 
   int i, j, k;
   double xi;
+  double dhdr[MESH_MAX_NODES_PER_ELEMENT*MESH_MAX_DIM];
   
   element_t *element = ((struct mesh_interp_params *)params)->element;
 
+  element->type->dhdr_all(gsl_vector_const_ptr(test, 0), dhdr);
   for (i = 0; i < element->type->dim; i++) {
     for (j = 0; j < element->type->dim; j++) {
       xi = 0;
       for (k = 0; k < element->type->nodes; k++) {
         // es negativo por como definimos el residuo
-        // el cast explicito es para sacarnos de encima el const
-        xi -= element->type->dhdr(k, j, (double *)gsl_vector_const_ptr(test, 0)) * element->node[k]->x[i];
+        xi -= dhdr[k*element->type->dim+j] * element->node[k]->x[i];
       }
       gsl_matrix_set(J, i, j, xi);
     }
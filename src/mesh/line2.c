@@ -44,6 +44,8 @@ int mesh_line2_init(void) {
   element_type->nodes_per_face = 1;
   element_type->h = mesh_line2_h;
   element_type->dhdr = mesh_line2_dhdr;
+  element_type->h_all = mesh_line2_h_all;
+  element_type->dhdr_all = mesh_line2_dhdr_all;
   element_type->point_in_element = mesh_point_in_line;
   element_type->element_volume = mesh_line_vol;
 
@@ -196,3 +198,22 @@ double mesh_line_vol(element_t *element) {
   }  
   return element->volume;
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_line2_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+
+  h[0] = 0.5*(1-r);
+  h[1] = 0.5*(1+r);
+
+  return;
+}
+
+void mesh_line2_dhdr_all(const double *vec_r, double *dhdr) {
+
+  dhdr[0] = -0.5;
+  dhdr[1] = +0.5;
+
+  return;
+}
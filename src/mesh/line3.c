@@ -44,6 +44,8 @@ int mesh_line3_init(void) {
   element_type->nodes_per_face = 1;
   element_type->h = mesh_line3_h;
   element_type->dhdr = mesh_line3_dhdr;
+  element_type->h_all = mesh_line3_h_all;
+  element_type->dhdr_all = mesh_line3_dhdr_all;
   element_type->point_in_element = mesh_point_in_line;
   element_type->element_volume = mesh_line_vol;
 
@@ -143,3 +145,25 @@ double mesh_line3_dhdr(int k, int m, double *vec_r) {
 
   return 0;
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_line3_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+
+  h[0] = 0.5*r*(r-1);
+  h[1] = 0.5*r*(r+1);
+  h[2] = (1+r)*(1-r);
+
+  return;
+}
+
+void mesh_line3_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+
+  dhdr[0] = r-0.5;
+  dhdr[1] = r+0.5;
+  dhdr[2] = -2*r;
+
+  return;
+}
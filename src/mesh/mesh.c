@@ -441,8 +441,16 @@ int mesh_free(mesh_t *mesh) {
 
   physical_entity_t *physical_entity;
   element_list_item_t *element_item, *element_tmp;
+  mesh_transfer_t *mesh_transfer;
   int i, j, d, v;
   
+  // the transfer operators that involve this mesh are not valid anymore
+  LL_FOREACH(wasora_mesh.transfers, mesh_transfer) {
+    if (mesh_transfer->mesh == mesh || mesh_transfer->function->mesh == mesh) {
+      mesh_transfer_free(mesh_transfer);
+    }
+  }
+  
   if (mesh->cell != NULL) {
     for (i = 0; i < mesh->n_cells; i++) {
       if (mesh->cell[i].index != NULL) {
@@ -65,7 +65,7 @@ int wasora_mesh_parse_line(char *line) {
 ///kw+MESH+detail Either a file identifier (defined previously with a `FILE` keyword) or a file path should be given.
 ///kw+MESH+detail The format is read from the extension, which should be either
 ///kw+MESH+detail @
-///kw+MESH+detail  * `.msh` [Gmsh ASCII format](http:\/\/gmsh.info/doc/texinfo/gmsh.html#MSH-file-format), versions 2.2, 4.0 or 4.1
+///kw+MESH+detail  * `.msh` [Gmsh ASCII format](http:\/\/gmsh.info/doc/texinfo/gmsh.html#MSH-file-format), versions 2.2, 4.0 or 4.1 (version 2.2 can also be binary)
 ///kw+MESH+detail  * `.vtk` [ASCII legacy VTK](https:\/\/lorensen.github.io/VTKExamples/site/VTKFileFormats/)
 ///kw+MESH+detail  * `.frd` [CalculiX’s FRD ASCII output](https:\/\/web.mit.edu/calculix_v2.7/CalculiX/cgx_2.7/doc/cgx/node4.html))
 ///kw+MESH+detail @
@@ -342,12 +342,38 @@ int wasora_mesh_parse_line(char *line) {
         } else if (strcasecmp(token, "NOMESH") == 0 || strcasecmp(token, "NO_MESH") == 0) {
           mesh_post->no_mesh = 1;
 
-///kw+MESH_POST+usage [ FORMAT { gmsh | vtk } ]
+///kw+MESH_POST+usage [ FORMAT { gmsh | vtk | vtu } ]
         } else if (strcasecmp(token, "FORMAT") == 0) {
-          char *keywords[] = {"gmsh", "vtk", ""};
-          int values[] = {post_format_gmsh, post_format_vtk, 0};
+          char *keywords[] = {"gmsh", "vtk", "vtu", ""};
+          int values[] = {post_format_gmsh, post_format_vtk, post_format_vtu, 0};
           wasora_call(wasora_parser_keywords_ints(keywords, values, (int *)&mesh_post->format));
 
+///kw+MESH_POST+usage [ BINARY ]
+///kw+MESH_POST+detail With `BINARY` the `gmsh` format writes the mesh and the data blocks as binary MSH 2.2.
+        } else if (strcasecmp(token, "BINARY") == 0) {
+          mesh_post->binary = 1;
+
+///kw+MESH_POST+usage [ ENCODING { raw | zlib } ]
+///kw+MESH_POST+detail The `vtu` format writes XML VTK files with the data appended in binary form,
+///kw+MESH_POST+detail either `raw` (default) or compressed with `zlib`.
+///kw+MESH_POST+detail In transient problems or if the file name ends in `.pvd`, each step goes to
+///kw+MESH_POST+detail a new file `<base>-<step>.vtu` and an index `<base>.pvd` with the times is updated.
+        } else if (strcasecmp(token, "ENCODING") == 0) {
+          char *keywords[] = {"raw", "zlib", ""};
+          int values[] = {post_encoding_raw, post_encoding_zlib, 0};
+          wasora_call(wasora_parser_keywords_ints(keywords, values, (int *)&mesh_post->encoding));
+#ifndef HAVE_LIBZ
+          if (mesh_post->encoding == post_encoding_zlib) {
+            wasora_push_error_message("wasora was compiled without zlib");
+            return WASORA_PARSER_ERROR;
+          }
+#endif
+
+///kw+MESH_POST+usage [ ASYNC ]
+///kw+MESH_POST+detail With `ASYNC` the `vtu` files are written by a background thread while the computation goes on.
+        } else if (strcasecmp(token, "ASYNC") == 0) {
+          mesh_post->async = 1;
+
 ///kw+MESH_POST+usage [ CELLS | ]
         } else if (strcasecmp(token, "CELLS") == 0) {
           mesh_post->centering = centering_cells;
@@ -429,6 +455,8 @@ int wasora_mesh_parse_line(char *line) {
           mesh_post->format = post_format_gmsh;
         } else if (strcasecmp(ext, ".vtk") == 0) {
           mesh_post->format = post_format_vtk;
+        } else if (strcasecmp(ext, ".vtu") == 0 || strcasecmp(ext, ".pvd") == 0) {
+          mesh_post->format = post_format_vtu;
         } else {
           wasora_push_error_message("unknown extension '%s' and no FORMAT given", ext);
           return WASORA_PARSER_ERROR;
@@ -437,10 +465,11 @@ int wasora_mesh_parse_line(char *line) {
         
       switch (mesh_post->format) {
         case post_format_gmsh:
-          mesh_post->write_header = mesh_gmsh_write_header;
-          mesh_post->write_mesh = mesh_gmsh_write_mesh;
+          mesh_post->write_header = (mesh_post->binary) ? mesh_gmsh_write_header_binary : mesh_gmsh_write_header;
+          mesh_post->write_mesh = (mesh_post->binary) ? mesh_gmsh_write_mesh_binary : mesh_gmsh_write_mesh;
           mesh_post->write_scalar = mesh_gmsh_write_scalar;
           mesh_post->write_vector = mesh_gmsh_write_vector;
+          mesh_post->write_fields = mesh_gmsh_write_fields;
         break;
         case post_format_vtk:
           mesh_post->write_header = mesh_vtk_write_header;
@@ -448,6 +477,10 @@ int wasora_mesh_parse_line(char *line) {
           mesh_post->write_scalar = mesh_vtk_write_scalar;
           mesh_post->write_vector = mesh_vtk_write_vector;
         break;
+        case post_format_vtu:
+          mesh_post->write_scalar = mesh_vtu_write_scalar;
+          mesh_post->write_vector = mesh_vtu_write_vector;
+        break;
         default:
           return WASORA_PARSER_ERROR;
         break;
@@ -618,6 +651,80 @@ int wasora_mesh_parse_line(char *line) {
       wasora_define_instruction(wasora_instruction_mesh_fill_vector, mesh_fill_vector);
       return WASORA_PARSER_OK;
       
+// --- MESH_TRANSFER ------------------------------------------------------
+///kw+MESH_TRANSFER+usage MESH_TRANSFER
+///kw+MESH_TRANSFER+desc Transfers a function defined over the nodes of a mesh to the nodes or cells of another mesh.
+    } else if (strcasecmp(token, "MESH_TRANSFER") == 0) {
+      mesh_transfer_t *mesh_transfer = calloc(1, sizeof(mesh_transfer_t));
+      
+      while ((token = wasora_get_next_token(NULL)) != NULL) {
+///kw+MESH_TRANSFER+usage FUNCTION <function>
+///kw+MESH_TRANSFER+detail The source function has to be a point-wise function defined over the nodes of a mesh,
+///kw+MESH_TRANSFER+detail for example one read with `READ_FUNCTION` or `READ_SCALAR` in `MESH`.
+        if (strcasecmp(token, "FUNCTION") == 0) {
+          wasora_call(wasora_parser_function(&mesh_transfer->function));
+
+///kw+MESH_TRANSFER+usage VECTOR <vector>
+///kw+MESH_TRANSFER+detail The vector to be filled needs to be already defined and to have either the number of nodes
+///kw+MESH_TRANSFER+detail or of cells of the target mesh depending on `NODES` or `CELLS` (default is nodes).
+        } else if (strcasecmp(token, "VECTOR") == 0) {
+          wasora_call(wasora_parser_vector(&mesh_transfer->vector));
+          
+///kw+MESH_TRANSFER+usage [ MESH <target_mesh> ]
+///kw+MESH_TRANSFER+detail If no `MESH` is given, the main mesh is the target.
+        } else if (strcasecmp(token, "MESH") == 0) {
+          char *mesh_name;
+          wasora_call(wasora_parser_string(&mesh_name));
+          if ((mesh_transfer->mesh = wasora_get_mesh_ptr(mesh_name)) == NULL) {
+            wasora_push_error_message("unknown mesh '%s'", mesh_name);
+            free(mesh_name);
+            return WASORA_PARSER_ERROR;
+          }
+          free(mesh_name);
+          
+///kw+MESH_TRANSFER+usage [ NODES
+        } else if (strcasecmp(token, "NODES") == 0) {
+          mesh_transfer->centering = centering_nodes;
+///kw+MESH_TRANSFER+usage | CELLS ]
+        } else if (strcasecmp(token, "CELLS") == 0) {
+          mesh_transfer->centering = centering_cells;
+          wasora_mesh.need_cells = 1;
+
+///kw+MESH_TRANSFER+detail The first time the instruction is executed, a sparse interpolation operator holding the
+///kw+MESH_TRANSFER+detail source nodes and shape-function weights for each target point is built.
+///kw+MESH_TRANSFER+detail Further executions only perform a sparse matrix-vector product with the current nodal
+///kw+MESH_TRANSFER+detail values of the source function. The operator is re-built only if one of the meshes is re-read.
+        } else {
+          wasora_push_error_message("unknown keyword '%s'", token);
+          return WASORA_PARSER_ERROR;
+        }
+      }
+      
+      if (mesh_transfer->mesh == NULL) {
+        if ((mesh_transfer->mesh = wasora_mesh.main_mesh) == NULL) {
+          wasora_push_error_message("no MESH defined for MESH_TRANSFER");
+          return WASORA_PARSER_ERROR;
+        }
+      }
+      
+      if (mesh_transfer->function == NULL) {
+        wasora_push_error_message("no FUNCTION given to MESH_TRANSFER");
+        return WASORA_PARSER_ERROR;
+      }
+      
+      if (mesh_transfer->vector == NULL) {
+        wasora_push_error_message("no VECTOR given to MESH_TRANSFER");
+        return WASORA_PARSER_ERROR;
+      }
+      
+      if (mesh_transfer->centering == centering_default) {
+        mesh_transfer->centering = centering_nodes;
+      }
+      
+      LL_APPEND(wasora_mesh.transfers, mesh_transfer);
+      wasora_define_instruction(wasora_instruction_mesh_transfer, mesh_transfer);
+      return WASORA_PARSER_OK;
+      
 // --- MESH_FIND_MINMAX ------------------------------------------------------
     } else if (strcasecmp(token, "MESH_FIND_MINMAX") == 0) {
       
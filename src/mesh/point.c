@@ -40,6 +40,8 @@ int mesh_one_node_point_init(void) {
   element_type->nodes_per_face = 0;
   element_type->h = mesh_one_node_point_h;
   element_type->dhdr = mesh_one_node_point_dhdr;
+  element_type->h_all = mesh_one_node_point_h_all;
+  element_type->dhdr_all = mesh_one_node_point_dhdr_all;
   element_type->element_volume = mesh_point_vol;
   element_type->point_in_element = NULL;
   
@@ -68,3 +70,15 @@ double mesh_one_node_point_dhdr(int i, int j, double *vec_r) {
 double mesh_point_vol(element_t *element) {
   return 0;
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_one_node_point_h_all(const double *r, double *h) {
+  h[0] = 1;
+  return;
+}
+
+void mesh_one_node_point_dhdr_all(const double *r, double *dhdr) {
+  // a point has no local coordinates so there is nothing to differentiate
+  return;
+}
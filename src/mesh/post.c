@@ -33,25 +33,28 @@ int wasora_instruction_mesh_post(void *arg) {
     return WASORA_RUNTIME_OK;
   }
   
-  if (wasora_special_var(end_time) == 0) {
-    // close the file and open it again
-    if (mesh_post->file->pointer != NULL) {
-      wasora_call(wasora_instruction_close_file(mesh_post->file));
-    }
-    wasora_call(wasora_instruction_open_file(mesh_post->file));  
-  } else {
-    if (mesh_post->file->pointer == NULL) {
+  // vtu collects the arrays in memory and writes one file per step by itself
+  if (mesh_post->format != post_format_vtu) {
+    if (wasora_special_var(end_time) == 0) {
+      // close the file and open it again
+      if (mesh_post->file->pointer != NULL) {
+        wasora_call(wasora_instruction_close_file(mesh_post->file));
+      }
       wasora_call(wasora_instruction_open_file(mesh_post->file));  
-    }
-  }  
+    } else {
+      if (mesh_post->file->pointer == NULL) {
+        wasora_call(wasora_instruction_open_file(mesh_post->file));  
+      }
+    }  
 
 
-  if (ftell(mesh_post->file->pointer) == 0) {
-    wasora_call(mesh_post->write_header(mesh_post->file->pointer));
-    if (mesh_post->no_mesh == 0) {
-      wasora_call(mesh_post->write_mesh(mesh_post->mesh, mesh_post->no_physical_names, mesh_post->file->pointer));
+    if (ftell(mesh_post->file->pointer) == 0) {
+      wasora_call(mesh_post->write_header(mesh_post->file->pointer));
+      if (mesh_post->no_mesh == 0) {
+        wasora_call(mesh_post->write_mesh(mesh_post->mesh, mesh_post->no_physical_names, mesh_post->file->pointer));
+      }
+      mesh_post->point_init = 0;
     }
-    mesh_post->point_init = 0;
   }
 
   LL_FOREACH(mesh_post->mesh_post_dists, mesh_post_dist) {
@@ -63,16 +66,25 @@ int wasora_instruction_mesh_post(void *arg) {
       if (mesh_post_dist->scalar->initialized == 0) {
         wasora_call(wasora_function_init(mesh_post_dist->scalar));
       }
-      wasora_call(mesh_post->write_scalar(mesh_post, mesh_post_dist->scalar, mesh_post_dist->centering));
-    } else {
+      if (mesh_post->write_fields == NULL) {
+        wasora_call(mesh_post->write_scalar(mesh_post, mesh_post_dist->scalar, mesh_post_dist->centering));
+      }
+    } else if (mesh_post->write_fields == NULL) {
       wasora_call(mesh_post->write_vector(mesh_post, mesh_post_dist->vector, mesh_post_dist->centering));
     }
     // TODO: tensores
   }
   
+  // all the fields in a single pass over the mesh
+  if (mesh_post->write_fields != NULL) {
+    wasora_call(mesh_post->write_fields(mesh_post));
+  }
+  
   // as vtk does not support multiple time steps, it is better to close the file now
   if (mesh_post->format == post_format_vtk) {
     wasora_call(wasora_instruction_close_file(mesh_post->file));
+  } else if (mesh_post->format == post_format_vtu) {
+    wasora_call(mesh_vtu_write_step(mesh_post));
   }
   // for .msh we leave that to the user, to user CLOSE or whatever explicitly
 
@@ -44,6 +44,8 @@ int mesh_prism15_init(void) {
   element_type->nodes_per_face = 8;   // Ojo aca que en nodos por cara pusimos el maximo valor (8) ya que depende de la cara
   element_type->h = mesh_prism15_h;
   element_type->dhdr = mesh_prism15_dhdr;
+  element_type->h_all = mesh_prism15_h_all;
+  element_type->dhdr_all = mesh_prism15_dhdr_all;
   element_type->point_in_element = mesh_point_in_prism;
   element_type->element_volume = mesh_prism_vol;
 
@@ -376,4 +378,100 @@ double mesh_prism15_dhdr(int j, int m, double *vec_r) {
 
   return 0;
 
-}
\ No newline at end of file
+}
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_prism15_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+  double u = 1-r-s;
+
+  h[0]  = (t-1)*u*(t+2*s+2*r)/2;
+  h[1]  = r*(1-t)*(2*r-2-t)/2;
+  h[2]  = s*(1-t)*(2*s-2-t)/2;
+  h[3]  = (-t-1)*u*(-t+2*s+2*r)/2;
+  h[4]  = r*(1+t)*(2*r-2+t)/2;
+  h[5]  = s*(1+t)*(2*s-2+t)/2;
+  h[6]  = 2*r*u*(1-t);
+  h[7]  = 2*s*u*(1-t);
+  h[8]  = u*(1-t*t);
+  h[9]  = 2*s*r*(1-t);
+  h[10] = r*(1-t*t);
+  h[11] = s*(1-t*t);
+  h[12] = 2*r*u*(1+t);
+  h[13] = 2*s*u*(1+t);
+  h[14] = 2*s*r*(1+t);
+
+  return;
+}
+
+void mesh_prism15_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+  double u = 1-r-s;
+
+  dhdr[0]  = (t-1)*(2*u-t-2*s-2*r)/2;
+  dhdr[1]  = (t-1)*(2*u-t-2*s-2*r)/2;
+  dhdr[2]  = u*(2*t+2*s+2*r-1)/2;
+
+  dhdr[3]  = (1-t)*(4*r-2-t)/2;
+  dhdr[4]  = 0;
+  dhdr[5]  = r*(2*t-2*r+1)/2;
+
+  dhdr[6]  = 0;
+  dhdr[7]  = (1-t)*(4*s-2-t)/2;
+  dhdr[8]  = s*(2*t-2*s+1)/2;
+
+  dhdr[9]  = -(1+t)*(2*u+t-2*s-2*r)/2;
+  dhdr[10] = -(1+t)*(2*u+t-2*s-2*r)/2;
+  dhdr[11] = u*(2*t-2*s-2*r+1)/2;
+
+  dhdr[12] = (1+t)*(4*r-2+t)/2;
+  dhdr[13] = 0;
+  dhdr[14] = r*(2*r+2*t-1)/2;
+
+  dhdr[15] = 0;
+  dhdr[16] = (1+t)*(4*s-2+t)/2;
+  dhdr[17] = s*(2*s+2*t-1)/2;
+
+  dhdr[18] = 2*(u-r)*(1-t);
+  dhdr[19] = -2*r*(1-t);
+  dhdr[20] = -2*r*u;
+
+  dhdr[21] = -2*s*(1-t);
+  dhdr[22] = 2*(u-s)*(1-t);
+  dhdr[23] = -2*s*u;
+
+  dhdr[24] = -(1-t*t);
+  dhdr[25] = -(1-t*t);
+  dhdr[26] = -2*u*t;
+
+  dhdr[27] = 2*s*(1-t);
+  dhdr[28] = 2*r*(1-t);
+  dhdr[29] = -2*r*s;
+
+  dhdr[30] = 1-t*t;
+  dhdr[31] = 0;
+  dhdr[32] = -2*r*t;
+
+  dhdr[33] = 0;
+  dhdr[34] = 1-t*t;
+  dhdr[35] = -2*s*t;
+
+  dhdr[36] = 2*(u-r)*(1+t);
+  dhdr[37] = -2*r*(1+t);
+  dhdr[38] = 2*r*u;
+
+  dhdr[39] = -2*s*(1+t);
+  dhdr[40] = 2*(u-s)*(1+t);
+  dhdr[41] = 2*s*u;
+
+  dhdr[42] = 2*s*(1+t);
+  dhdr[43] = 2*r*(1+t);
+  dhdr[44] = 2*r*s;
+
+  return;
+}
@@ -44,6 +44,8 @@ int mesh_prism6_init(void) {
   element_type->nodes_per_face = 4;   // Ojo aca que en nodos por cara pusimos el maximo valor (4) ya que depende de la cara
   element_type->h = mesh_prism6_h;
   element_type->dhdr = mesh_prism6_dhdr;
+  element_type->h_all = mesh_prism6_h_all;
+  element_type->dhdr_all = mesh_prism6_dhdr_all;
   element_type->point_in_element = mesh_point_in_prism;
   element_type->element_volume = mesh_prism_vol;
 
@@ -454,3 +456,39 @@ double mesh_prism_vol(element_t *element) {
   return element->volume;
 
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_prism6_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double u = 1-r-s;
+  double tm = 1-vec_r[2];
+  double tp = 1+vec_r[2];
+
+  h[0] = 0.5*u*tm;
+  h[1] = 0.5*r*tm;
+  h[2] = 0.5*s*tm;
+  h[3] = 0.5*u*tp;
+  h[4] = 0.5*r*tp;
+  h[5] = 0.5*s*tp;
+
+  return;
+}
+
+void mesh_prism6_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double u = 1-r-s;
+  double tm = 1-vec_r[2];
+  double tp = 1+vec_r[2];
+
+  dhdr[0]  = -0.5*tm;   dhdr[1]  = -0.5*tm;   dhdr[2]  = -0.5*u;
+  dhdr[3]  = +0.5*tm;   dhdr[4]  = 0;         dhdr[5]  = -0.5*r;
+  dhdr[6]  = 0;         dhdr[7]  = +0.5*tm;   dhdr[8]  = -0.5*s;
+  dhdr[9]  = -0.5*tp;   dhdr[10] = -0.5*tp;   dhdr[11] = +0.5*u;
+  dhdr[12] = +0.5*tp;   dhdr[13] = 0;         dhdr[14] = +0.5*r;
+  dhdr[15] = 0;         dhdr[16] = +0.5*tp;   dhdr[17] = +0.5*s;
+
+  return;
+}
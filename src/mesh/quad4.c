@@ -42,6 +42,8 @@ int mesh_quad4_init(void) {
   element_type->nodes_per_face = 2;
   element_type->h = mesh_quad4_h;
   element_type->dhdr = mesh_quad4_dhdr;
+  element_type->h_all = mesh_quad4_h_all;
+  element_type->dhdr_all = mesh_quad4_dhdr_all;
   element_type->point_in_element = mesh_point_in_quadrangle;
   element_type->element_volume = mesh_quad_vol;
 
@@ -331,3 +333,32 @@ double mesh_quad_vol(element_t *element) {
   return element->volume;
 }
 
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_quad4_h_all(const double *vec_r, double *h) {
+  double rm = 1-vec_r[0];
+  double rp = 1+vec_r[0];
+  double sm = 1-vec_r[1];
+  double sp = 1+vec_r[1];
+
+  h[0] = 0.25*rm*sm;
+  h[1] = 0.25*rp*sm;
+  h[2] = 0.25*rp*sp;
+  h[3] = 0.25*rm*sp;
+
+  return;
+}
+
+void mesh_quad4_dhdr_all(const double *vec_r, double *dhdr) {
+  double rm = 1-vec_r[0];
+  double rp = 1+vec_r[0];
+  double sm = 1-vec_r[1];
+  double sp = 1+vec_r[1];
+
+  dhdr[0] = -0.25*sm;    dhdr[1] = -0.25*rm;
+  dhdr[2] = +0.25*sm;    dhdr[3] = -0.25*rp;
+  dhdr[4] = +0.25*sp;    dhdr[5] = +0.25*rp;
+  dhdr[6] = -0.25*sp;    dhdr[7] = +0.25*rm;
+
+  return;
+}
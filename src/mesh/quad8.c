@@ -43,6 +43,8 @@ int mesh_quad8_init(void) {
   element_type->nodes_per_face = 3;
   element_type->h = mesh_quad8_h;
   element_type->dhdr = mesh_quad8_dhdr;
+  element_type->h_all = mesh_quad8_h_all;
+  element_type->dhdr_all = mesh_quad8_dhdr_all;
   element_type->point_in_element = mesh_point_in_quadrangle;
   element_type->element_volume = mesh_quad_vol;
 
@@ -234,3 +236,45 @@ double mesh_quad8_dhdr(int j, int m, double *vec_r) {
   return 0;
 
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_quad8_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double rm = 1-r;
+  double rp = 1+r;
+  double sm = 1-s;
+  double sp = 1+s;
+
+  h[0] = rm*sm*(-1-r-s)/4.0;
+  h[1] = rp*sm*(-1+r-s)/4.0;
+  h[2] = rp*sp*(-1+r+s)/4.0;
+  h[3] = rm*sp*(-1-r+s)/4.0;
+  h[4] = (1-r*r)*sm/2.0;
+  h[5] = rp*(1-s*s)/2.0;
+  h[6] = (1-r*r)*sp/2.0;
+  h[7] = rm*(1-s*s)/2.0;
+
+  return;
+}
+
+void mesh_quad8_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double rm = 1-r;
+  double rp = 1+r;
+  double sm = 1-s;
+  double sp = 1+s;
+
+  dhdr[0]  = sm*(2*r+s)/4.0;     dhdr[1]  = rm*(r+2*s)/4.0;
+  dhdr[2]  = sm*(2*r-s)/4.0;     dhdr[3]  = rp*(2*s-r)/4.0;
+  dhdr[4]  = sp*(2*r+s)/4.0;     dhdr[5]  = rp*(r+2*s)/4.0;
+  dhdr[6]  = sp*(2*r-s)/4.0;     dhdr[7]  = rm*(2*s-r)/4.0;
+  dhdr[8]  = -r*sm;              dhdr[9]  = -(1-r*r)/2.0;
+  dhdr[10] = (1-s*s)/2.0;        dhdr[11] = -s*rp;
+  dhdr[12] = -r*sp;              dhdr[13] = (1-r*r)/2.0;
+  dhdr[14] = -(1-s*s)/2.0;       dhdr[15] = -s*rm;
+
+  return;
+}
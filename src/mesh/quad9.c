@@ -43,6 +43,8 @@ int mesh_quad9_init(void) {
   element_type->nodes_per_face = 3;
   element_type->h = mesh_quad9_h;
   element_type->dhdr = mesh_quad9_dhdr;
+  element_type->h_all = mesh_quad9_h_all;
+  element_type->dhdr_all = mesh_quad9_dhdr_all;
   element_type->point_in_element = mesh_point_in_quadrangle;
   element_type->element_volume = mesh_quad_vol;
 
@@ -253,3 +255,41 @@ double mesh_quad9_dhdr(int j, int m, double *vec_r) {
 
 
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+// the nine-node quadrangle is the tensor product of two three-node lines,
+// these tables say which 1d function (0 = minus, 1 = plus, 2 = center) each node takes
+static const int mesh_quad9_ir[9] = {0, 1, 1, 0, 2, 1, 2, 0, 2};
+static const int mesh_quad9_is[9] = {0, 0, 1, 1, 0, 2, 1, 2, 2};
+
+void mesh_quad9_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double lr[3] = {0.5*r*(r-1), 0.5*r*(r+1), 1-r*r};
+  double ls[3] = {0.5*s*(s-1), 0.5*s*(s+1), 1-s*s};
+  int j;
+
+  for (j = 0; j < 9; j++) {
+    h[j] = lr[mesh_quad9_ir[j]] * ls[mesh_quad9_is[j]];
+  }
+
+  return;
+}
+
+void mesh_quad9_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double lr[3] = {0.5*r*(r-1), 0.5*r*(r+1), 1-r*r};
+  double ls[3] = {0.5*s*(s-1), 0.5*s*(s+1), 1-s*s};
+  double dlr[3] = {r-0.5, r+0.5, -2*r};
+  double dls[3] = {s-0.5, s+0.5, -2*s};
+  int j;
+
+  for (j = 0; j < 9; j++) {
+    dhdr[2*j+0] = dlr[mesh_quad9_ir[j]] * ls[mesh_quad9_is[j]];
+    dhdr[2*j+1] = lr[mesh_quad9_ir[j]] * dls[mesh_quad9_is[j]];
+  }
+
+  return;
+}
@@ -44,6 +44,8 @@ int mesh_tet10_init(void) {
   element_type->nodes_per_face = 6;
   element_type->h = mesh_tet10_h;
   element_type->dhdr = mesh_tet10_dhdr;
+  element_type->h_all = mesh_tet10_h_all;
+  element_type->dhdr_all = mesh_tet10_dhdr_all;
   element_type->point_in_element = mesh_point_in_tetrahedron;
   element_type->element_volume = mesh_tetrahedron_vol;
 
@@ -415,3 +417,44 @@ double mesh_tet10_dhdr(int j, int m, double *vec_r) {
 
 }
 
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_tet10_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+  double u = 1-r-s-t;
+
+  h[0] = u*(2*u-1);
+  h[1] = r*(2*r-1);
+  h[2] = s*(2*s-1);
+  h[3] = t*(2*t-1);
+  h[4] = 4*u*r;
+  h[5] = 4*r*s;
+  h[6] = 4*s*u;
+  h[7] = 4*u*t;
+  h[8] = 4*s*t;
+  h[9] = 4*r*t;
+
+  return;
+}
+
+void mesh_tet10_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+  double u = 1-r-s-t;
+
+  dhdr[0]  = 1-4*u;     dhdr[1]  = 1-4*u;     dhdr[2]  = 1-4*u;
+  dhdr[3]  = 4*r-1;     dhdr[4]  = 0;         dhdr[5]  = 0;
+  dhdr[6]  = 0;         dhdr[7]  = 4*s-1;     dhdr[8]  = 0;
+  dhdr[9]  = 0;         dhdr[10] = 0;         dhdr[11] = 4*t-1;
+  dhdr[12] = 4*(u-r);   dhdr[13] = -4*r;      dhdr[14] = -4*r;
+  dhdr[15] = 4*s;       dhdr[16] = 4*r;       dhdr[17] = 0;
+  dhdr[18] = -4*s;      dhdr[19] = 4*(u-s);   dhdr[20] = -4*s;
+  dhdr[21] = -4*t;      dhdr[22] = -4*t;      dhdr[23] = 4*(u-t);
+  dhdr[24] = 0;         dhdr[25] = 4*t;       dhdr[26] = 4*s;
+  dhdr[27] = 4*t;       dhdr[28] = 0;         dhdr[29] = 4*r;
+
+  return;
+}
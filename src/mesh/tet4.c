@@ -43,6 +43,8 @@ int mesh_tet4_init(void) {
   element_type->nodes_per_face = 3;
   element_type->h = mesh_tet4_h;
   element_type->dhdr = mesh_tet4_dhdr;
+  element_type->h_all = mesh_tet4_h_all;
+  element_type->dhdr_all = mesh_tet4_dhdr_all;
   element_type->point_in_element = mesh_point_in_tetrahedron;
   element_type->element_volume = mesh_tetrahedron_vol;
 
@@ -432,3 +434,29 @@ double mesh_tetrahedron_vol(element_t *element) {
   
  
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_tet4_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double t = vec_r[2];
+
+  h[0] = 1-r-s-t;
+  h[1] = r;
+  h[2] = s;
+  h[3] = t;
+
+  return;
+}
+
+void mesh_tet4_dhdr_all(const double *vec_r, double *dhdr) {
+
+  // dhdr[j*3+m], the derivatives are constant
+  dhdr[0] = -1;  dhdr[1]  = -1;  dhdr[2]  = -1;
+  dhdr[3] = +1;  dhdr[4]  = 0;   dhdr[5]  = 0;
+  dhdr[6] = 0;   dhdr[7]  = +1;  dhdr[8]  = 0;
+  dhdr[9] = 0;   dhdr[10] = 0;   dhdr[11] = +1;
+
+  return;
+}
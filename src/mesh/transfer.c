@@ -0,0 +1,213 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora's mesh-to-mesh field transfer routines
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#include <wasora.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// appends one non-zero to the operator, growing the arrays as needed
+static void mesh_transfer_append(mesh_transfer_t *mesh_transfer, int *size, int *nnz, int col, double weight) {
+
+  if (*nnz == *size) {
+    *size *= 2;
+    mesh_transfer->col = realloc(mesh_transfer->col, *size * sizeof(int));
+    mesh_transfer->weight = realloc(mesh_transfer->weight, *size * sizeof(double));
+  }
+
+  mesh_transfer->col[*nnz] = col;
+  mesh_transfer->weight[*nnz] = weight;
+  (*nnz)++;
+
+  return;
+}
+
+// computes the weights that interpolate the source function at the point x,
+// i.e. the same thing mesh_interpolate_function_node() does but without the data
+static int mesh_transfer_build_row(mesh_transfer_t *mesh_transfer, const double *x, int *size, int *nnz) {
+
+  double r[3] = {0, 0, 0};
+  double dist2 = 0;
+  function_t *function = mesh_transfer->function;
+  mesh_t *source = function->mesh;
+  node_t *nearest_node;
+  element_t *element;
+  double h[MESH_MAX_NODES_PER_ELEMENT];
+  double dhdx_data[MESH_MAX_NODES_PER_ELEMENT*MESH_MAX_DIM];
+  gsl_matrix_view dhdx;
+  int j;
+
+  nearest_node = mesh_find_nearest_node(source, x);
+
+  switch (source->spatial_dimensions) {
+    case 1:
+      dist2 = gsl_pow_2(fabs(x[0]-nearest_node->x[0]));
+    break;
+    case 2:
+      dist2 = mesh_subtract_squared_module2d(x, nearest_node->x);
+    break;
+    case 3:
+      dist2 = mesh_subtract_squared_module(x, nearest_node->x);
+    break;
+  }
+
+  // derivatives are never "exactly at a node" so we only shortcut plain values
+  if (function->spatial_derivative_of == NULL && dist2 < gsl_pow_2(function->multidim_threshold)) {
+    mesh_transfer_append(mesh_transfer, size, nnz, nearest_node->index_mesh, 1.0);
+    return WASORA_RUNTIME_OK;
+  }
+
+  if ((element = mesh_find_element(source, nearest_node, x)) == NULL) {
+    // same fallback as the pointwise interpolation for values, i.e. the nearest
+    // node, but a node value is not a derivative so those get an empty row (zero)
+    if (function->spatial_derivative_of == NULL) {
+      mesh_transfer_append(mesh_transfer, size, nnz, nearest_node->index_mesh, 1.0);
+    }
+    return WASORA_RUNTIME_OK;
+  }
+
+  if (mesh_interp_solve_for_r(element, x, r) != WASORA_RUNTIME_OK) {
+    // an empty row evaluates to zero, as mesh_interpolate_function_node() does
+    return WASORA_RUNTIME_OK;
+  }
+
+  if (function->spatial_derivative_of == NULL) {
+    element->type->h_all(r, h);
+    for (j = 0; j < element->type->nodes; j++) {
+      mesh_transfer_append(mesh_transfer, size, nnz, element->node[j]->index_mesh, h[j]);
+    }
+  } else {
+    dhdx = gsl_matrix_view_array(dhdx_data, element->type->nodes, element->type->dim);
+    mesh_compute_dhdx(element, r, NULL, &dhdx.matrix);
+    for (j = 0; j < element->type->nodes; j++) {
+      mesh_transfer_append(mesh_transfer, size, nnz, element->node[j]->index_mesh, gsl_matrix_get(&dhdx.matrix, j, function->spatial_derivative_with_respect_to));
+    }
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+int mesh_transfer_build(mesh_transfer_t *mesh_transfer) {
+
+  mesh_t *mesh = mesh_transfer->mesh;
+  int i;
+  int size, nnz;
+
+  mesh_transfer_free(mesh_transfer);
+
+  mesh_transfer->n_rows = (mesh_transfer->centering == centering_cells) ? mesh->n_cells : mesh->n_nodes;
+  mesh_transfer->row = malloc((mesh_transfer->n_rows+1) * sizeof(int));
+
+  // first guess: each point falls inside an element of the source mesh
+  size = mesh_transfer->n_rows * ((mesh_transfer->function->mesh->max_nodes_per_element > 0) ? mesh_transfer->function->mesh->max_nodes_per_element : 1);
+  if (size == 0) {
+    size = 1;
+  }
+  mesh_transfer->col = malloc(size * sizeof(int));
+  mesh_transfer->weight = malloc(size * sizeof(double));
+
+  nnz = 0;
+  for (i = 0; i < mesh_transfer->n_rows; i++) {
+    mesh_transfer->row[i] = nnz;
+    wasora_call(mesh_transfer_build_row(mesh_transfer, (mesh_transfer->centering == centering_cells) ? mesh->cell[i].x : mesh->node[i].x, &size, &nnz));
+  }
+  mesh_transfer->row[mesh_transfer->n_rows] = nnz;
+
+  mesh_transfer->built = 1;
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+void mesh_transfer_free(mesh_transfer_t *mesh_transfer) {
+
+  wasora_free(mesh_transfer->row);
+  wasora_free(mesh_transfer->col);
+  wasora_free(mesh_transfer->weight);
+  mesh_transfer->n_rows = 0;
+  mesh_transfer->built = 0;
+
+  return;
+}
+
+
+int wasora_instruction_mesh_transfer(void *arg) {
+
+  mesh_transfer_t *mesh_transfer = (mesh_transfer_t *)arg;
+  function_t *function = mesh_transfer->function;
+  vector_t *vector = mesh_transfer->vector;
+  double *data;
+  double y;
+  int i, k;
+
+  if (function->mesh == NULL || function->mesh->initialized == 0 || mesh_transfer->mesh->initialized == 0) {
+    wasora_push_error_message("MESH_TRANSFER of function '%s' needs both meshes to be already read", function->name);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  // the type is known only after the mesh has been read
+  if (function->type != type_pointwise_mesh_node) {
+    wasora_push_error_message("function '%s' is not defined over the nodes of a mesh", function->name);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  if (!function->initialized) {
+    wasora_call(wasora_function_init(function));
+  }
+
+  // check if the time is the correct one
+  if (function->name_in_mesh != NULL && function->mesh->format == mesh_format_gmsh
+      && function->mesh_time < wasora_var_value(wasora_special_var(t))-0.001*wasora_var_value(wasora_special_var(dt))) {
+    wasora_call(mesh_gmsh_update_function(function, wasora_var_value(wasora_special_var(t)), wasora_var_value(wasora_special_var(dt))));
+    function->mesh_time = wasora_var_value(wasora_special_var(t));
+  }
+
+  // the operator depends only on the geometry, so it is built once
+  // and thrown away by mesh_free() if either mesh is re-read
+  if (mesh_transfer->built == 0) {
+    wasora_call(mesh_transfer_build(mesh_transfer));
+  }
+
+  if (!vector->initialized) {
+    wasora_call(wasora_vector_init(vector));
+  }
+  if (vector->size != mesh_transfer->n_rows) {
+    wasora_push_error_message("size mismatch between mesh '%s' %s (%d) and vector '%s' size (%d)", mesh_transfer->mesh->name, (mesh_transfer->centering == centering_cells) ? "cells" : "nodes", mesh_transfer->n_rows, vector->name, vector->size);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  data = (function->spatial_derivative_of != NULL) ? function->spatial_derivative_of->data_value : function->data_value;
+  if (data == NULL) {
+    gsl_vector_set_zero(wasora_value_ptr(vector));
+    return WASORA_RUNTIME_OK;
+  }
+
+  for (i = 0; i < mesh_transfer->n_rows; i++) {
+    y = 0;
+    for (k = mesh_transfer->row[i]; k < mesh_transfer->row[i+1]; k++) {
+      y += mesh_transfer->weight[k] * data[mesh_transfer->col[k]];
+    }
+    gsl_vector_set(wasora_value_ptr(vector), i, y);
+  }
+
+  return WASORA_RUNTIME_OK;
+}
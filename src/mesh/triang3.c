@@ -40,6 +40,8 @@ int mesh_triang3_init(void) {
   element_type->nodes_per_face = 2;
   element_type->h = mesh_triang3_h;
   element_type->dhdr = mesh_triang3_dhdr;
+  element_type->h_all = mesh_triang3_h_all;
+  element_type->dhdr_all = mesh_triang3_dhdr_all;
   element_type->point_in_element = mesh_point_in_triangle;
   element_type->element_volume = mesh_triang_vol;
 
@@ -256,3 +258,26 @@ double mesh_triang_vol(element_t *element) {
   }  
   return element->volume;
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_triang3_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+
+  h[0] = 1-r-s;
+  h[1] = r;
+  h[2] = s;
+
+  return;
+}
+
+void mesh_triang3_dhdr_all(const double *vec_r, double *dhdr) {
+
+  // dhdr[j*2+m], the derivatives are constant
+  dhdr[0] = -1;  dhdr[1] = -1;
+  dhdr[2] = +1;  dhdr[3] = 0;
+  dhdr[4] = 0;   dhdr[5] = +1;
+
+  return;
+}
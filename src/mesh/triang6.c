@@ -39,6 +39,8 @@ int mesh_triang6_init(void) {
   element_type->nodes_per_face = 3;
   element_type->h = mesh_triang6_h;
   element_type->dhdr = mesh_triang6_dhdr;
+  element_type->h_all = mesh_triang6_h_all;
+  element_type->dhdr_all = mesh_triang6_dhdr_all;
   element_type->point_in_element = mesh_point_in_triangle;
   element_type->element_volume = mesh_triang_vol;
 
@@ -227,3 +229,35 @@ double mesh_triang6_dhdr(int j, int m, double *vec_r) {
 
 
 }
+
+
+// all the shape functions and all their derivatives in a single pass
+void mesh_triang6_h_all(const double *vec_r, double *h) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double u = 1-r-s;
+
+  h[0] = u*(2*u-1);
+  h[1] = r*(2*r-1);
+  h[2] = s*(2*s-1);
+  h[3] = 4*u*r;
+  h[4] = 4*r*s;
+  h[5] = 4*s*u;
+
+  return;
+}
+
+void mesh_triang6_dhdr_all(const double *vec_r, double *dhdr) {
+  double r = vec_r[0];
+  double s = vec_r[1];
+  double u = 1-r-s;
+
+  dhdr[0]  = 1-4*u;      dhdr[1]  = 1-4*u;
+  dhdr[2]  = 4*r-1;      dhdr[3]  = 0;
+  dhdr[4]  = 0;          dhdr[5]  = 4*s-1;
+  dhdr[6]  = 4*(u-r);    dhdr[7]  = -4*r;
+  dhdr[8]  = 4*s;        dhdr[9]  = 4*r;
+  dhdr[10] = -4*s;       dhdr[11] = 4*(u-s);
+
+  return;
+}
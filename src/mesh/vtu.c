@@ -0,0 +1,601 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora's mesh-related xml vtu (binary) and pvd routines
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#define _GNU_SOURCE
+#include <wasora.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+// uncompressed size of each of the blocks zlib-encoded arrays are split into
+#define VTU_ZLIB_BLOCK   (1<<16)
+
+// one DataArray already encoded as it goes into the appended section,
+// i.e. with its UInt64 header (and compressed if asked for)
+typedef struct vtu_array_t vtu_array_t;
+struct vtu_array_t {
+  char *name;
+  const char *type;
+  int components;
+
+  size_t size;
+  unsigned char *data;
+
+  vtu_array_t *next;
+};
+
+// a whole .vtu file in memory so that another thread can dump it
+typedef struct {
+  char *path;
+  char *data;
+  size_t size;
+  int errnum;
+} vtu_buffer_t;
+
+struct mesh_vtu_t {
+  int step;
+  int n_points;
+  int n_cells;
+
+  // the geometry is encoded only once and re-emitted as is in every step
+  vtu_array_t *geometry;
+  vtu_array_t *point_data;
+  vtu_array_t *cell_data;
+
+  // entries of the .pvd time series
+  int n_entries;
+  double *entry_time;
+  char **entry_file;
+
+  vtu_buffer_t *pending;
+#ifdef HAVE_LIBPTHREAD
+  pthread_t thread;
+#endif
+};
+
+
+static mesh_vtu_t *mesh_vtu_state(mesh_post_t *mesh_post) {
+
+  if (mesh_post->vtu == NULL) {
+    mesh_post->vtu = calloc(1, sizeof(mesh_vtu_t));
+  }
+
+  return mesh_post->vtu;
+}
+
+static void mesh_vtu_free_arrays(vtu_array_t **list) {
+
+  vtu_array_t *array, *tmp;
+
+  LL_FOREACH_SAFE(*list, array, tmp) {
+    LL_DELETE(*list, array);
+    free(array->name);
+    free(array->data);
+    free(array);
+  }
+
+  return;
+}
+
+static vtu_array_t *mesh_vtu_array(mesh_post_t *mesh_post, const char *name, const char *type, int components, const void *values, size_t bytes) {
+
+  vtu_array_t *array;
+  uint64_t header;
+
+  array = calloc(1, sizeof(vtu_array_t));
+  array->name = (name != NULL) ? strdup(name) : NULL;
+  array->type = type;
+  array->components = components;
+
+#ifdef HAVE_LIBZ
+  if (mesh_post->encoding == post_encoding_zlib) {
+    // vtkZLibDataCompressor: number of blocks, size of the blocks, size of the
+    // last one (zero if it is full), the compressed sizes and then the blocks
+    uint64_t n_blocks = (bytes + VTU_ZLIB_BLOCK-1)/VTU_ZLIB_BLOCK;
+    uint64_t *block_header = calloc(3+n_blocks, sizeof(uint64_t));
+    unsigned char *out;
+    uLongf out_size;
+    size_t in_size;
+    uint64_t b;
+
+    block_header[0] = n_blocks;
+    block_header[1] = (n_blocks > 0) ? VTU_ZLIB_BLOCK : 0;
+    block_header[2] = bytes % VTU_ZLIB_BLOCK;
+
+    array->data = malloc((3+n_blocks)*sizeof(uint64_t) + n_blocks*compressBound(VTU_ZLIB_BLOCK));
+    out = array->data + (3+n_blocks)*sizeof(uint64_t);
+    for (b = 0; b < n_blocks; b++) {
+      in_size = (b < n_blocks-1 || block_header[2] == 0) ? VTU_ZLIB_BLOCK : block_header[2];
+      out_size = compressBound(in_size);
+      compress2(out, &out_size, (const Bytef *)values + b*VTU_ZLIB_BLOCK, in_size, Z_DEFAULT_COMPRESSION);
+      block_header[3+b] = out_size;
+      out += out_size;
+    }
+    memcpy(array->data, block_header, (3+n_blocks)*sizeof(uint64_t));
+    array->size = out - array->data;
+    free(block_header);
+
+    return array;
+  }
+#endif
+
+  header = bytes;
+  array->size = sizeof(uint64_t) + bytes;
+  array->data = malloc(array->size);
+  memcpy(array->data, &header, sizeof(uint64_t));
+  memcpy(array->data + sizeof(uint64_t), values, bytes);
+
+  return array;
+}
+
+
+// points, connectivity, offsets and types of the bulk elements
+static int mesh_vtu_geometry(mesh_post_t *mesh_post, mesh_t *mesh) {
+
+  mesh_vtu_t *vtu = mesh_vtu_state(mesh_post);
+  element_t *element;
+  double *points;
+  int32_t *connectivity;
+  int32_t *offsets;
+  uint8_t *types;
+  int size, n_cells;
+  int i, j, k, l;
+
+  points = malloc(3*mesh->n_nodes * sizeof(double));
+  for (j = 0; j < mesh->n_nodes; j++) {
+    points[3*j+0] = mesh->node[j].x[0];
+    points[3*j+1] = mesh->node[j].x[1];
+    points[3*j+2] = mesh->node[j].x[2];
+  }
+
+  size = 0;
+  n_cells = 0;
+  for (i = 0; i < mesh->n_elements; i++) {
+    if (mesh->element[i].type->dim == mesh->bulk_dimensions) {
+      size += mesh->element[i].type->nodes;
+      n_cells++;
+    }
+  }
+
+  connectivity = malloc(size * sizeof(int32_t));
+  offsets = malloc(n_cells * sizeof(int32_t));
+  types = malloc(n_cells * sizeof(uint8_t));
+
+  k = 0;
+  l = 0;
+  for (i = 0; i < mesh->n_elements; i++) {
+    element = &mesh->element[i];
+    if (element->type->dim == mesh->bulk_dimensions) {
+      for (j = 0; j < element->type->nodes; j++) {
+        // same reordering as in the legacy vtk writer
+        switch (element->type->id) {
+          case ELEMENT_TYPE_HEXAHEDRON27:
+            connectivity[k++] = element->node[hexa27fromgmsh[j]]->index_mesh;
+          break;
+          case ELEMENT_TYPE_HEXAHEDRON20:
+            connectivity[k++] = element->node[hexa20fromgmsh[j]]->index_mesh;
+          break;
+          case ELEMENT_TYPE_TETRAHEDRON10:
+            connectivity[k++] = element->node[(j == 8) ? 9 : ((j == 9) ? 8 : j)]->index_mesh;
+          break;
+          default:
+            connectivity[k++] = element->node[j]->index_mesh;
+          break;
+        }
+      }
+      offsets[l] = k;
+      types[l] = vtkfromgmsh_types[element->type->id];
+      l++;
+    }
+  }
+
+  mesh_vtu_free_arrays(&vtu->geometry);
+  LL_APPEND(vtu->geometry, mesh_vtu_array(mesh_post, NULL, "Float64", 3, points, 3*mesh->n_nodes * sizeof(double)));
+  LL_APPEND(vtu->geometry, mesh_vtu_array(mesh_post, "connectivity", "Int32", 1, connectivity, size * sizeof(int32_t)));
+  LL_APPEND(vtu->geometry, mesh_vtu_array(mesh_post, "offsets", "Int32", 1, offsets, n_cells * sizeof(int32_t)));
+  LL_APPEND(vtu->geometry, mesh_vtu_array(mesh_post, "types", "UInt8", 1, types, n_cells * sizeof(uint8_t)));
+  vtu->n_points = mesh->n_nodes;
+  vtu->n_cells = n_cells;
+
+  free(types);
+  free(offsets);
+  free(connectivity);
+  free(points);
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+static double mesh_vtu_value(mesh_post_t *mesh_post, mesh_t *mesh, function_t *function, centering_t centering, int j) {
+
+  if (centering == centering_cells) {
+    if (function->type == type_pointwise_mesh_cell && function->data_size == mesh->n_cells) {
+      return function->data_value[j];
+    }
+    return wasora_evaluate_function(function, mesh->cell[j].x);
+  }
+
+  if (function->type == type_pointwise_mesh_node && function->data_size == mesh->n_nodes) {
+    return (function->data_value != NULL) ? function->data_value[j] : 0;
+  }
+  return wasora_evaluate_function(function, mesh->node[j].x);
+}
+
+int mesh_vtu_write_scalar(mesh_post_t *mesh_post, function_t *function, centering_t centering) {
+
+  mesh_vtu_t *vtu = mesh_vtu_state(mesh_post);
+  mesh_t *mesh;
+  double *values;
+  int j, n;
+
+  if (mesh_post->mesh != NULL) {
+    mesh = mesh_post->mesh;
+  } else if (function != NULL) {
+    mesh = function->mesh;
+  } else {
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  wasora_function_init(function);
+  n = (centering == centering_cells) ? mesh->n_cells : mesh->n_nodes;
+  values = malloc(n * sizeof(double));
+  for (j = 0; j < n; j++) {
+    values[j] = mesh_vtu_value(mesh_post, mesh, function, centering, j);
+  }
+
+  if (centering == centering_cells) {
+    LL_APPEND(vtu->cell_data, mesh_vtu_array(mesh_post, function->name, "Float64", 1, values, n * sizeof(double)));
+  } else {
+    LL_APPEND(vtu->point_data, mesh_vtu_array(mesh_post, function->name, "Float64", 1, values, n * sizeof(double)));
+  }
+  free(values);
+
+  return WASORA_RUNTIME_OK;
+}
+
+int mesh_vtu_write_vector(mesh_post_t *mesh_post, function_t **function, centering_t centering) {
+
+  mesh_vtu_t *vtu = mesh_vtu_state(mesh_post);
+  mesh_t *mesh;
+  double *values;
+  char *name;
+  int j, n, g;
+
+  if (mesh_post->mesh != NULL) {
+    mesh = mesh_post->mesh;
+  } else if (function[0] != NULL) {
+    mesh = function[0]->mesh;
+  } else {
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  for (g = 0; g < 3; g++) {
+    wasora_function_init(function[g]);
+  }
+  n = (centering == centering_cells) ? mesh->n_cells : mesh->n_nodes;
+  values = malloc(3*n * sizeof(double));
+  for (j = 0; j < n; j++) {
+    for (g = 0; g < 3; g++) {
+      values[3*j+g] = mesh_vtu_value(mesh_post, mesh, function[g], centering, j);
+    }
+  }
+
+  if (asprintf(&name, "%s_%s_%s", function[0]->name, function[1]->name, function[2]->name) == -1) {
+    free(values);
+    return WASORA_RUNTIME_ERROR;
+  }
+  if (centering == centering_cells) {
+    LL_APPEND(vtu->cell_data, mesh_vtu_array(mesh_post, name, "Float64", 3, values, 3*n * sizeof(double)));
+  } else {
+    LL_APPEND(vtu->point_data, mesh_vtu_array(mesh_post, name, "Float64", 3, values, 3*n * sizeof(double)));
+  }
+  free(name);
+  free(values);
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+static void mesh_vtu_data_array(FILE *file, vtu_array_t *array, size_t *offset) {
+
+  fprintf(file, "        <DataArray type=\"%s\"", array->type);
+  if (array->name != NULL) {
+    fprintf(file, " Name=\"%s\"", array->name);
+  }
+  fprintf(file, " NumberOfComponents=\"%d\" format=\"appended\" offset=\"%lu\"/>\n", array->components, (unsigned long)(*offset));
+  *offset += array->size;
+
+  return;
+}
+
+// the xml header with the offsets of each array followed by the raw appended data
+static vtu_buffer_t *mesh_vtu_buffer(mesh_post_t *mesh_post, const char *path) {
+
+  mesh_vtu_t *vtu = mesh_vtu_state(mesh_post);
+  vtu_buffer_t *buffer;
+  vtu_array_t *array;
+  FILE *file;
+  size_t offset;
+  uint16_t one = 1;
+
+  buffer = calloc(1, sizeof(vtu_buffer_t));
+  buffer->path = strdup(path);
+  if ((file = open_memstream(&buffer->data, &buffer->size)) == NULL) {
+    wasora_push_error_message("cannot create memory stream for '%s': %s", path, strerror(errno));
+    free(buffer->path);
+    free(buffer);
+    return NULL;
+  }
+
+  fprintf(file, "<?xml version=\"1.0\"?>\n");
+  fprintf(file, "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\"%s>\n",
+                (*(uint8_t *)&one) ? "LittleEndian" : "BigEndian",
+                (mesh_post->encoding == post_encoding_zlib) ? " compressor=\"vtkZLibDataCompressor\"" : "");
+  fprintf(file, "  <UnstructuredGrid>\n");
+  fprintf(file, "    <Piece NumberOfPoints=\"%d\" NumberOfCells=\"%d\">\n", vtu->n_points, vtu->n_cells);
+
+  offset = 0;
+  if (vtu->point_data != NULL) {
+    fprintf(file, "      <PointData>\n");
+    LL_FOREACH(vtu->point_data, array) {
+      mesh_vtu_data_array(file, array, &offset);
+    }
+    fprintf(file, "      </PointData>\n");
+  }
+  if (vtu->cell_data != NULL) {
+    fprintf(file, "      <CellData>\n");
+    LL_FOREACH(vtu->cell_data, array) {
+      mesh_vtu_data_array(file, array, &offset);
+    }
+    fprintf(file, "      </CellData>\n");
+  }
+
+  fprintf(file, "      <Points>\n");
+  mesh_vtu_data_array(file, vtu->geometry, &offset);
+  fprintf(file, "      </Points>\n");
+  fprintf(file, "      <Cells>\n");
+  LL_FOREACH(vtu->geometry->next, array) {
+    mesh_vtu_data_array(file, array, &offset);
+  }
+  fprintf(file, "      </Cells>\n");
+  fprintf(file, "    </Piece>\n");
+  fprintf(file, "  </UnstructuredGrid>\n");
+
+  fprintf(file, "  <AppendedData encoding=\"raw\">\n   _");
+  LL_FOREACH(vtu->point_data, array) {
+    fwrite(array->data, 1, array->size, file);
+  }
+  LL_FOREACH(vtu->cell_data, array) {
+    fwrite(array->data, 1, array->size, file);
+  }
+  LL_FOREACH(vtu->geometry, array) {
+    fwrite(array->data, 1, array->size, file);
+  }
+  fprintf(file, "\n  </AppendedData>\n");
+  fprintf(file, "</VTKFile>\n");
+  fclose(file);
+
+  return buffer;
+}
+
+// this one may run in another thread so it cannot push error messages
+static void *mesh_vtu_dump(void *arg) {
+
+  vtu_buffer_t *buffer = (vtu_buffer_t *)arg;
+  FILE *file;
+
+  if ((file = fopen(buffer->path, "w")) == NULL) {
+    buffer->errnum = errno;
+    return NULL;
+  }
+  if (fwrite(buffer->data, 1, buffer->size, file) != buffer->size) {
+    buffer->errnum = errno;
+  }
+  if (fclose(file) != 0 && buffer->errnum == 0) {
+    buffer->errnum = errno;
+  }
+
+  return NULL;
+}
+
+static int mesh_vtu_finish(vtu_buffer_t *buffer) {
+
+  int status = WASORA_RUNTIME_OK;
+
+  if (buffer->errnum != 0) {
+    wasora_push_error_message("cannot write '%s': %s", buffer->path, strerror(buffer->errnum));
+    status = WASORA_RUNTIME_ERROR;
+  }
+  free(buffer->data);
+  free(buffer->path);
+  free(buffer);
+
+  return status;
+}
+
+// waits for the file being written in background (if any)
+static int mesh_vtu_join(mesh_vtu_t *vtu) {
+
+  vtu_buffer_t *buffer = vtu->pending;
+
+  if (buffer == NULL) {
+    return WASORA_RUNTIME_OK;
+  }
+
+#ifdef HAVE_LIBPTHREAD
+  pthread_join(vtu->thread, NULL);
+#endif
+  vtu->pending = NULL;
+
+  return mesh_vtu_finish(buffer);
+}
+
+static int mesh_vtu_write_pvd(mesh_vtu_t *vtu, const char *base) {
+
+  FILE *file;
+  char *path;
+  int i;
+
+  if (asprintf(&path, "%s.pvd", base) == -1) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  if ((file = fopen(path, "w")) == NULL) {
+    wasora_push_error_message("cannot open '%s': %s", path, strerror(errno));
+    free(path);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  fprintf(file, "<?xml version=\"1.0\"?>\n");
+  fprintf(file, "<VTKFile type=\"Collection\" version=\"1.0\">\n");
+  fprintf(file, "  <Collection>\n");
+  for (i = 0; i < vtu->n_entries; i++) {
+    fprintf(file, "    <DataSet timestep=\"%.17g\" part=\"0\" file=\"%s\"/>\n", vtu->entry_time[i], vtu->entry_file[i]);
+  }
+  fprintf(file, "  </Collection>\n");
+  fprintf(file, "</VTKFile>\n");
+  fclose(file);
+  free(path);
+
+  return WASORA_RUNTIME_OK;
+}
+
+int mesh_vtu_write_step(mesh_post_t *mesh_post) {
+
+  mesh_vtu_t *vtu = mesh_vtu_state(mesh_post);
+  vtu_buffer_t *buffer;
+  mesh_t *mesh = mesh_post->mesh;
+  char *path, *base, *ext, *vtu_path;
+  const char *slash;
+  int series;
+
+  // a muted daughter does not write anything
+  if (wasora.mute_output) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  if ((path = wasora_evaluate_string(mesh_post->file->format, mesh_post->file->n_args, mesh_post->file->arg)) == NULL) {
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  // if the file name ends in .pvd or we are in a transient we write a time series
+  base = strdup(path);
+  series = (wasora_var(wasora_special_var(end_time)) != 0);
+  if ((ext = strrchr(base, '.')) != NULL && (strcasecmp(ext, ".vtu") == 0 || strcasecmp(ext, ".pvd") == 0)) {
+    series |= (strcasecmp(ext, ".pvd") == 0);
+    *ext = '\0';
+  }
+
+  if (vtu->geometry == NULL || vtu->n_points != mesh->n_nodes) {
+    wasora_call(mesh_vtu_geometry(mesh_post, mesh));
+  }
+
+  if (series) {
+    if (asprintf(&vtu_path, "%s-%06d.vtu", base, vtu->step) == -1) {
+      return WASORA_RUNTIME_ERROR;
+    }
+  } else {
+    if (asprintf(&vtu_path, "%s.vtu", base) == -1) {
+      return WASORA_RUNTIME_ERROR;
+    }
+  }
+
+  if ((buffer = mesh_vtu_buffer(mesh_post, vtu_path)) == NULL) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  mesh_vtu_free_arrays(&vtu->point_data);
+  mesh_vtu_free_arrays(&vtu->cell_data);
+
+  // only one file in flight so memory stays bounded
+  wasora_call(mesh_vtu_join(vtu));
+#ifdef HAVE_LIBPTHREAD
+  if (mesh_post->async) {
+    if (pthread_create(&vtu->thread, NULL, mesh_vtu_dump, buffer) == 0) {
+      vtu->pending = buffer;
+    } else {
+      mesh_vtu_dump(buffer);
+      wasora_call(mesh_vtu_finish(buffer));
+    }
+  } else {
+    mesh_vtu_dump(buffer);
+    wasora_call(mesh_vtu_finish(buffer));
+  }
+#else
+  mesh_vtu_dump(buffer);
+  wasora_call(mesh_vtu_finish(buffer));
+#endif
+
+  if (series) {
+    // the pvd refers to the vtus relative to its own location
+    slash = strrchr(vtu_path, '/');
+    vtu->entry_time = realloc(vtu->entry_time, (vtu->n_entries+1) * sizeof(double));
+    vtu->entry_file = realloc(vtu->entry_file, (vtu->n_entries+1) * sizeof(char *));
+    vtu->entry_time[vtu->n_entries] = (wasora_var(wasora_special_var(end_time)) != 0) ? wasora_value(wasora_special_var(time)) : vtu->step;
+    vtu->entry_file[vtu->n_entries] = strdup((slash != NULL) ? slash+1 : vtu_path);
+    vtu->n_entries++;
+    wasora_call(mesh_vtu_write_pvd(vtu, base));
+  }
+  vtu->step++;
+
+  free(vtu_path);
+  free(base);
+  free(path);
+
+  return WASORA_RUNTIME_OK;
+}
+
+
+// waits for the background writers and frees everything
+void mesh_vtu_finalize(void) {
+
+  mesh_post_t *mesh_post;
+  mesh_vtu_t *vtu;
+  int i;
+
+  LL_FOREACH(wasora_mesh.posts, mesh_post) {
+    if ((vtu = mesh_post->vtu) != NULL) {
+      if (mesh_vtu_join(vtu) != WASORA_RUNTIME_OK) {
+        wasora_pop_errors();
+      }
+      mesh_vtu_free_arrays(&vtu->geometry);
+      mesh_vtu_free_arrays(&vtu->point_data);
+      mesh_vtu_free_arrays(&vtu->cell_data);
+      for (i = 0; i < vtu->n_entries; i++) {
+        free(vtu->entry_file[i]);
+      }
+      free(vtu->entry_file);
+      free(vtu->entry_time);
+      free(vtu);
+      mesh_post->vtu = NULL;
+    }
+  }
+
+  return;
+}
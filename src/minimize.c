@@ -20,14 +20,26 @@
  *------------------- ------------  ----    --------  --     -       -         -
  */
 
+#include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 #ifndef _WASORA_H_
 #include "wasora.h"
 #endif
 
+// a local minimum found by the multi-start search and how many starts fell into it
+typedef struct {
+  double *x;
+  double f;
+  int starts;
+} min_basin_t;
+
+static int wasora_min_multistart(gsl_vector *x);
+
 
 int wasora_min_run(void) {
   
@@ -48,8 +60,22 @@ int wasora_min_run(void) {
     }
 //  }
  
+  // si no hay que volver a correr y la funcion es algebraica, el gradiente
+  // sale exacto y en una sola pasada con numeros duales
+  wasora.min.dual = (wasora.min.norerun && wasora.min.gradient == NULL && wasora.min.function->algebraic_expression.n_tokens != 0);
+  
+  // argumentos con los que se integraron las sensibilidades
+  if (wasora.min.sensitivities) {
+    wasora.min.x_run = malloc(wasora.min.n * sizeof(double));
+    for (i = 0; i < wasora.min.n; i++) {
+      wasora.min.x_run[i] = GSL_NAN;
+    }
+  }
+  
   // llamamos a quien corresponda
-  if (wasora.min.f_type != NULL) {
+  if (wasora.min.multistart.n_tokens != 0) {
+    wasora_call(wasora_min_multistart(x));
+  } else if (wasora.min.f_type != NULL) {
     wasora_min_multiminf(x);
   } else if (wasora.min.fdf_type != NULL) {
     wasora_min_multiminfdf(x);
@@ -81,12 +107,259 @@ int wasora_min_run(void) {
   if (x != NULL) {
     gsl_vector_free(x);
   }
+  if (wasora.min.x_run != NULL) {
+    wasora_free(wasora.min.x_run);
+  }
 
   return WASORA_RUNTIME_OK;
   
 }
 
 
+// the local search from the starting point in x, which is left at the minimum
+static double wasora_min_local_search(gsl_vector *x) {
+  
+  if (wasora.min.fdf_type != NULL) {
+    return wasora_min_multiminfdf(x);
+  }
+  
+  return wasora_min_multiminf(x);
+}
+
+// distance between two points normalized with the MIN-MAX box
+static double wasora_min_normalized_distance(const double *a, const double *b, const double *min, const double *max) {
+  
+  int i;
+  double d2 = 0;
+  
+  for (i = 0; i < wasora.min.n; i++) {
+    d2 += gsl_pow_2((a[i]-b[i])/(max[i]-min[i]));
+  }
+  
+  return sqrt(d2);
+}
+
+static int wasora_min_compare_basins(const void *a, const void *b) {
+  double fa = ((const min_basin_t *)a)->f;
+  double fb = ((const min_basin_t *)b)->f;
+  return (fa < fb) ? -1 : ((fa > fb) ? 1 : 0);
+}
+
+// global search: local searches started from quasi-random points of the
+// MIN-MAX box, up to max_daughters of them at the same time in forked
+// processes that leave their minima in shared memory, each batch taking into
+// account what the previous ones found so starts that lie close to a known
+// minimum or to a start that already converged are skipped
+static int wasora_min_multistart(gsl_vector *x) {
+
+  int n = wasora.min.n;
+  int n_starts, n_daughters, n_batch, n_drawn, n_done, n_basins, n_pruned;
+  int i, j, b;
+  int status, failed;
+  double radius;
+  double *min, *max;
+  double *start, *u;
+  double *shared;
+  size_t size;
+  int *batch;
+  pid_t *pid;
+  gsl_qrng *q;
+  min_basin_t *basin;
+
+  n_starts = (int)wasora_evaluate_expression(&wasora.min.multistart);
+  radius = (wasora.min.basin_radius.n_tokens != 0) ? wasora_evaluate_expression(&wasora.min.basin_radius) : DEFAULT_MINIMIZER_BASIN_RADIUS;
+  n_daughters = (wasora.min.max_daughters > 1) ? wasora.min.max_daughters : 1;
+  if (n_starts < 1) {
+    wasora_push_error_message("MULTISTART needs at least one starting point");
+    return WASORA_RUNTIME_ERROR;
+  }
+  
+  if (wasora.min.multistart_type == NULL) {
+    wasora.min.multistart_type = gsl_qrng_sobol;
+  }
+  if (n > wasora.min.multistart_type->max_dimension) {
+    wasora_push_error_message("quasi-random generator '%s' cannot handle %d dimensions", wasora.min.multistart_type->name, n);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  min = malloc(n * sizeof(double));
+  max = malloc(n * sizeof(double));
+  for (i = 0; i < n; i++) {
+    min[i] = wasora_evaluate_expression(&wasora.min.range.min[i]);
+    max[i] = wasora_evaluate_expression(&wasora.min.range.max[i]);
+    if (max[i] <= min[i]) {
+      wasora_push_error_message("MAX (%e) has to be greater than MIN (%e) for multi-start", max[i], min[i]);
+      free(min);
+      free(max);
+      return WASORA_RUNTIME_ERROR;
+    }
+  }
+  
+  // each daughter leaves a flag, the value and the location of its minimum
+  size = n_daughters*(n+2) * sizeof(double);
+  if ((shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+    wasora_push_error_message("cannot map shared memory for the multi-start search: %s", strerror(errno));
+    free(min);
+    free(max);
+    return WASORA_RUNTIME_ERROR;
+  }
+  
+  q = gsl_qrng_alloc(wasora.min.multistart_type, n);
+  start = malloc(n_starts*n * sizeof(double));
+  u = malloc(n * sizeof(double));
+  batch = malloc(n_daughters * sizeof(int));
+  pid = malloc(n_daughters * sizeof(pid_t));
+  basin = calloc(n_starts, sizeof(min_basin_t));
+  n_drawn = 0;
+  n_done = 0;
+  n_basins = 0;
+  n_pruned = 0;
+  failed = 0;
+  while (n_drawn < n_starts && failed == 0) {
+    
+    // the next batch of starting points that are worth trying, they are
+    // stored right after the ones already done
+    n_batch = 0;
+    while (n_batch < n_daughters && n_drawn < n_starts) {
+      double *candidate = start + (n_done+n_batch)*n;
+      
+      gsl_qrng_get(q, u);
+      n_drawn++;
+      for (i = 0; i < n; i++) {
+        candidate[i] = min[i] + u[i]*(max[i]-min[i]);
+      }
+      
+      status = 0;
+      for (b = 0; status == 0 && b < n_basins; b++) {
+        status = (wasora_min_normalized_distance(candidate, basin[b].x, min, max) < radius);
+      }
+      for (j = 0; status == 0 && j < n_done; j++) {
+        status = (wasora_min_normalized_distance(candidate, start + j*n, min, max) < radius);
+      }
+      
+      if (status) {
+        n_pruned++;
+      } else {
+        batch[n_batch] = n_done+n_batch;
+        n_batch++;
+      }
+    }
+    
+    if (n_batch == 0) {
+      break;
+    }
+    
+    fflush(NULL);
+    memset(shared, 0, size);
+    for (j = 0; j < n_batch; j++) {
+      for (i = 0; i < n; i++) {
+        gsl_vector_set(x, i, start[batch[j]*n + i]);
+        wasora_value(wasora.min.x[i]) = start[batch[j]*n + i];
+      }
+      
+      if (n_daughters == 1) {
+        shared[j*(n+2) + 1] = wasora_min_local_search(x);
+        for (i = 0; i < n; i++) {
+          shared[j*(n+2) + 2+i] = gsl_vector_get(x, i);
+        }
+        shared[j*(n+2) + 0] = 1;
+        
+      } else if ((pid[j] = fork()) == 0) {
+        // the intermediate steps and the output of concurrent searches would get mixed up
+        wasora.min.verbose = 0;
+        if (wasora_mute_output() != WASORA_RUNTIME_OK) {
+          _exit(1);
+        }
+        shared[j*(n+2) + 1] = wasora_min_local_search(x);
+        for (i = 0; i < n; i++) {
+          shared[j*(n+2) + 2+i] = gsl_vector_get(x, i);
+        }
+        shared[j*(n+2) + 0] = 1;
+        fflush(NULL);
+        _exit(0);
+        
+      } else if (pid[j] == -1) {
+        wasora_push_error_message("'%s' when forking", strerror(errno));
+        failed = 1;
+        n_batch = j;
+      }
+    }
+    
+    // esperamos a todas las hijas del lote
+    if (n_daughters > 1) {
+      for (j = 0; j < n_batch; j++) {
+        if (waitpid(pid[j], &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          failed = 1;
+        }
+      }
+    }
+    
+    // merge the minima with the basins we already know
+    for (j = 0; j < n_batch; j++) {
+      double *result = shared + j*(n+2);
+      if (result[0] == 0 || gsl_finite(result[1]) == 0) {
+        continue;
+      }
+      for (b = 0; b < n_basins; b++) {
+        if (wasora_min_normalized_distance(result+2, basin[b].x, min, max) < radius) {
+          break;
+        }
+      }
+      if (b == n_basins) {
+        basin[b].x = malloc(n * sizeof(double));
+        basin[b].f = GSL_POSINF;
+        n_basins++;
+      }
+      basin[b].starts++;
+      if (result[1] < basin[b].f) {
+        basin[b].f = result[1];
+        memcpy(basin[b].x, result+2, n * sizeof(double));
+      }
+    }
+    n_done += n_batch;
+  }
+  
+  if (failed) {
+    wasora_push_error_message("local search of the multi-start minimization did not exit succesfully");
+  } else if (n_basins == 0) {
+    wasora_push_error_message("no local search of the multi-start minimization converged");
+    failed = 1;
+  } else {
+    qsort(basin, n_basins, sizeof(min_basin_t), wasora_min_compare_basins);
+    for (i = 0; i < n; i++) {
+      gsl_vector_set(x, i, basin[0].x[i]);
+    }
+    
+    if (wasora.min.verbose && wasora.rank == 0) {
+      printf("# %d local searches (%d starts pruned), %d distinct minima\n", n_done, n_pruned, n_basins);
+      for (b = 0; b < n_basins; b++) {
+        printf("# %d\t", b+1);
+        for (i = 0; i < n; i++) {
+          printf("% .3e ", basin[b].x[i]);
+        }
+        printf("\t%s = %g\tstarts = %d\n", wasora.min.function->name, basin[b].f, basin[b].starts);
+      }
+      fflush(stdout);
+    }
+  }
+  
+  for (b = 0; b < n_basins; b++) {
+    free(basin[b].x);
+  }
+  free(basin);
+  free(pid);
+  free(batch);
+  free(u);
+  free(start);
+  free(max);
+  free(min);
+  munmap(shared, size);
+  gsl_qrng_free(q);
+  
+  return (failed) ? WASORA_RUNTIME_ERROR : WASORA_RUNTIME_OK;
+}
+
+
 void wasora_min_read_params_from_solver(const gsl_vector *x) {
 
   int i;
@@ -110,6 +383,9 @@ double wasora_min_compute_f(const double *x) {
       wasora_runtime_error();
       return 0;
     }
+    if (wasora.min.x_run != NULL) {
+      memcpy(wasora.min.x_run, x, wasora.min.n*sizeof(double));
+    }
   }
 
   y = wasora_evaluate_function(wasora.min.function, x);
@@ -136,6 +412,178 @@ void wasora_min_compute_analytical_df(const double *x, gsl_vector *g) {
   return;
 }
 
+int wasora_min_compute_dual_df(const double *x, gsl_vector *g) {
+
+  int i;
+  double y;
+  double **wrt;
+  double *df;
+  int status;
+
+  wrt = malloc(wasora.min.n*sizeof(double *));
+  df = malloc(wasora.min.n*sizeof(double));
+
+  // igualamos los argumentos de la funcion al vector x y derivamos con respecto a ellos
+  for (i = 0; i < wasora.min.n; i++) {
+    wasora_value(wasora.min.function->var_argument[i]) = x[i];
+    wrt[i] = wasora_value_ptr(wasora.min.function->var_argument[i]);
+  }
+
+  if ((status = wasora_evaluate_expression_dual(&wasora.min.function->algebraic_expression, wasora.min.n, wrt, &y, df)) == WASORA_RUNTIME_OK) {
+    for (i = 0; i < wasora.min.n; i++) {
+      gsl_vector_set(g, i, df[i]);
+    }
+  }
+  
+  free(df);
+  free(wrt);
+  
+  return status;
+}
+
+// the chain rule through the phase space is exact only if the objective reads
+// nothing but the arguments of the functions it goes through and the phase
+// space, any other variable may have been computed by instructions (say an
+// integral_dt or a HISTORY) that depend on the parameters in ways the
+// sensitivities know nothing about
+static int wasora_min_depends_only_on_phase_space(expr_t *expr, function_t *function) {
+
+  phase_object_t *phase_object;
+  factor_t *token;
+  int i, j, n, found;
+
+  for (i = 0; i < expr->n_tokens; i++) {
+    token = &expr->token[i];
+
+    // initial values, vector functions and functionals cannot be followed
+    if ((token->type & ~EXPR_BASICTYPE_MASK) != EXPR_CURRENT) {
+      return 0;
+    }
+
+    found = 0;
+    switch (token->type & EXPR_BASICTYPE_MASK) {
+      case EXPR_OPERATOR:
+      case EXPR_CONSTANT:
+        found = 1;
+        n = 0;
+      break;
+      case EXPR_VARIABLE:
+        for (j = 0; function != NULL && j < function->n_arguments; j++) {
+          found |= (token->variable == function->var_argument[j]);
+        }
+        LL_FOREACH(wasora_dae.phase_objects, phase_object) {
+          found |= (phase_object->variable != NULL && token->variable == phase_object->variable);
+        }
+        n = 0;
+      break;
+      case EXPR_VECTOR:
+        LL_FOREACH(wasora_dae.phase_objects, phase_object) {
+          found |= (phase_object->vector != NULL && token->vector == phase_object->vector);
+        }
+        n = 1;
+      break;
+      case EXPR_MATRIX:
+        LL_FOREACH(wasora_dae.phase_objects, phase_object) {
+          found |= (phase_object->matrix != NULL && token->matrix == phase_object->matrix);
+        }
+        n = 2;
+      break;
+      case EXPR_BUILTIN_FUNCTION:
+        found = 1;
+        n = token->builtin_function->max_arguments;
+      break;
+      case EXPR_FUNCTION:
+        // the data of pointwise functions defined in the input or in files do not change
+        if (token->function->algebraic_expression.n_tokens != 0) {
+          found = wasora_min_depends_only_on_phase_space(&token->function->algebraic_expression, token->function);
+        } else {
+          found = (token->function->type == type_pointwise_data || token->function->type == type_pointwise_file);
+        }
+        n = token->function->n_arguments;
+      break;
+      default:
+        n = 0;
+      break;
+    }
+
+    if (found == 0) {
+      return 0;
+    }
+
+    if (token->arg != NULL) {
+      for (j = 0; j < n; j++) {
+        if (wasora_min_depends_only_on_phase_space(&token->arg[j], function) == 0) {
+          return 0;
+        }
+      }
+    }
+  }
+
+  return 1;
+}
+
+// the gradient comes from the sensitivities integrated in the last run
+// (which we repeat only if the arguments changed since then) either through
+// the explicit GRADIENT expressions or through the chain rule with respect
+// to the phase space at the end of the transient
+int wasora_min_compute_sensitivity_df(const double *x, gsl_vector *g) {
+
+  int i, k;
+  int n = wasora_dae.dimension;
+  int status;
+  double y;
+  double sum;
+  double **wrt;
+  double *df;
+  
+  // without explicit gradients we need an objective we can follow, otherwise
+  // the caller goes on with finite differences
+  if (wasora.min.gradient == NULL && wasora_min_depends_only_on_phase_space(&wasora.min.function->algebraic_expression, wasora.min.function) == 0) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  
+  for (i = 0; i < wasora.min.n; i++) {
+    if (wasora.min.x_run[i] != x[i]) {
+      wasora_value(wasora_special_var(step_inner)) += 1;
+      wasora_call(wasora_standard_run());
+      memcpy(wasora.min.x_run, x, wasora.min.n*sizeof(double));
+      break;
+    }
+  }
+  
+  if (wasora.min.gradient != NULL) {
+    wasora_min_compute_analytical_df(x, g);
+    return WASORA_RUNTIME_OK;
+  } else if (wasora.min.function->algebraic_expression.n_tokens == 0 || wasora_dae.phase_sensitivity == NULL) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  
+  wrt = malloc((wasora.min.n+n)*sizeof(double *));
+  df = malloc((wasora.min.n+n)*sizeof(double));
+  for (i = 0; i < wasora.min.n; i++) {
+    wasora_value(wasora.min.function->var_argument[i]) = x[i];
+    wrt[i] = wasora_value_ptr(wasora.min.function->var_argument[i]);
+  }
+  for (k = 0; k < n; k++) {
+    wrt[wasora.min.n+k] = wasora_dae.phase_value[k];
+  }
+  
+  if ((status = wasora_evaluate_expression_dual(&wasora.min.function->algebraic_expression, wasora.min.n+n, wrt, &y, df)) == WASORA_RUNTIME_OK) {
+    for (i = 0; i < wasora.min.n; i++) {
+      sum = df[i];
+      for (k = 0; k < n; k++) {
+        sum += df[wasora.min.n+k] * *(wasora_dae.phase_sensitivity[i*n + k]);
+      }
+      gsl_vector_set(g, i, sum);
+    }
+  }
+  
+  free(df);
+  free(wrt);
+  
+  return status;
+}
+
 int wasora_min_compute_numerical_df(const double *x, gsl_vector *g) {
   
   int i;
@@ -196,9 +644,13 @@ void wasora_gsl_min_df(const gsl_vector *x, void *params, gsl_vector *g) {
   
   wasora_min_read_params_from_solver(x);  
 
-  if (wasora.min.gradient != NULL) {
+  if (wasora.min.sensitivities && wasora_min_compute_sensitivity_df(gsl_vector_const_ptr(x, 0), g) == WASORA_RUNTIME_OK) {
+    ; // listo
+  } else if (wasora.min.gradient != NULL) {
     wasora_min_compute_analytical_df(gsl_vector_const_ptr(x, 0), g);
-  } else {
+  } else if (wasora.min.dual == 0 || wasora_min_compute_dual_df(gsl_vector_const_ptr(x, 0), g) != WASORA_RUNTIME_OK) {
+    // si la funcion tiene algo que no sabemos derivar no lo volvemos a intentar
+    wasora.min.dual = 0;
     wasora_min_compute_numerical_df(gsl_vector_const_ptr(x, 0), g);
   }
   
@@ -211,9 +663,13 @@ void wasora_gsl_min_fdf(const gsl_vector *x, void *params, double *f, gsl_vector
   wasora_min_read_params_from_solver(x);  
   *f = wasora_min_compute_f(gsl_vector_const_ptr(x, 0));
   
-  if (wasora.min.gradient != NULL) {
+  if (wasora.min.sensitivities && wasora_min_compute_sensitivity_df(gsl_vector_const_ptr(x, 0), g) == WASORA_RUNTIME_OK) {
+    ; // listo
+  } else if (wasora.min.gradient != NULL) {
     wasora_min_compute_analytical_df(gsl_vector_const_ptr(x, 0), g);
-  } else {
+  } else if (wasora.min.dual == 0 || wasora_min_compute_dual_df(gsl_vector_const_ptr(x, 0), g) != WASORA_RUNTIME_OK) {
+    // si la funcion tiene algo que no sabemos derivar no lo volvemos a intentar
+    wasora.min.dual = 0;
     wasora_min_compute_numerical_df(gsl_vector_const_ptr(x, 0), g);
   }
 
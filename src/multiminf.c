@@ -25,7 +25,7 @@
 #endif
 
 
-void wasora_min_multiminf(gsl_vector *x) {
+double wasora_min_multiminf(gsl_vector *x) {
   
   int i;
   int max_iters;
@@ -33,6 +33,7 @@ void wasora_min_multiminf(gsl_vector *x) {
   int gslstatus = GSL_SUCCESS;
   double size = 0;
   double tol;
+  double y;
 
   gsl_multimin_fminimizer *f_s;
   gsl_multimin_function f;
@@ -74,11 +75,12 @@ void wasora_min_multiminf(gsl_vector *x) {
   } while (gslstatus == GSL_CONTINUE && iter < max_iters);
 
   gsl_vector_memcpy(x, f_s->x);
+  y = f_s->fval;
   
   gsl_vector_free(ss);
   gsl_multimin_fminimizer_free(f_s);
      
-  return;
+  return y;
   
 }
 
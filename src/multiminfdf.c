@@ -25,12 +25,13 @@
 #endif
 
 
-void wasora_min_multiminfdf(gsl_vector *x) {
+double wasora_min_multiminfdf(gsl_vector *x) {
 
   int max_iters;
   int iter = 0;
   int gslstatus = GSL_SUCCESS;
   double tol, gradtol;
+  double y;
 
   gsl_multimin_fdfminimizer *fdf_s;
   gsl_multimin_function_fdf f;
@@ -73,9 +74,10 @@ void wasora_min_multiminfdf(gsl_vector *x) {
   } while (gslstatus == GSL_CONTINUE && iter < max_iters);
 
   gsl_vector_memcpy(x, fdf_s->x);
+  y = fdf_s->f;
   gsl_multimin_fdfminimizer_free(fdf_s);
      
-  return;
+  return y;
   
 }
 
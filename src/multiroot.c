@@ -28,12 +28,16 @@
 int wasora_instruction_solve(void *arg) {
   solve_t *solve = (solve_t *)arg;
   
-  gsl_multiroot_fsolver *s;  
+  gsl_multiroot_fsolver *s = NULL;
+  gsl_multiroot_fdfsolver *sdf = NULL;
   
   int status;
   size_t i, iter = 0, maxiter;
   gsl_multiroot_function f = {&wasora_gsl_solve_f, solve->n, solve};  
+  gsl_multiroot_function_fdf fdf = {&wasora_gsl_solve_f, &wasora_gsl_solve_df, &wasora_gsl_solve_fdf, solve->n, solve};
   gsl_vector *x;
+  gsl_matrix *J;
+  const gsl_vector *root, *dx, *residual;
   double epsabs, epsrel;
 
   // leemos los deltas (epsrel = 0 indica que no hay que mirar deltas solo absoluto)
@@ -57,14 +61,32 @@ int wasora_instruction_solve(void *arg) {
     }
   }
   
-  // seteamos cosas
-  s = gsl_multiroot_fsolver_alloc(solve->type, solve->n);
-  gsl_multiroot_fsolver_set(s, &f, x);  
+  // si nos pidieron un metodo con derivadas y todos los residuos se pueden derivar
+  // con numeros duales usamos el jacobiano exacto, si no el que no lo necesita
+  J = gsl_matrix_alloc(solve->n, solve->n);
+  if (solve->fdf_type != NULL && wasora_gsl_solve_df(x, solve, J) == GSL_SUCCESS) {
+    sdf = gsl_multiroot_fdfsolver_alloc(solve->fdf_type, solve->n);
+    gsl_multiroot_fdfsolver_set(sdf, &fdf, x);
+  } else {
+    s = gsl_multiroot_fsolver_alloc(solve->type, solve->n);
+    gsl_multiroot_fsolver_set(s, &f, x);  
+  }
+  gsl_matrix_free(J);
   
   // loopeamos
   do {
     iter++;
-    status = gsl_multiroot_fsolver_iterate(s);
+    if (sdf != NULL) {
+      status = gsl_multiroot_fdfsolver_iterate(sdf);
+      root = gsl_multiroot_fdfsolver_root(sdf);
+      dx = gsl_multiroot_fdfsolver_dx(sdf);
+      residual = gsl_multiroot_fdfsolver_f(sdf);
+    } else {
+      status = gsl_multiroot_fsolver_iterate(s);
+      root = gsl_multiroot_fsolver_root(s);
+      dx = gsl_multiroot_fsolver_dx(s);
+      residual = gsl_multiroot_fsolver_f(s);
+    }
 
     // TODO: verbose
 //    print_state (iter, s);
@@ -73,18 +95,23 @@ int wasora_instruction_solve(void *arg) {
       break;
     }
 
-     status = (epsrel == 0) ? gsl_multiroot_test_residual(gsl_multiroot_fsolver_f(s), epsabs)
-                            : gsl_multiroot_test_delta(gsl_multiroot_fsolver_dx(s), gsl_multiroot_fsolver_root(s), epsabs, epsrel);
+     status = (epsrel == 0) ? gsl_multiroot_test_residual(residual, epsabs)
+                            : gsl_multiroot_test_delta(dx, root, epsabs, epsrel);
   } while (status == GSL_CONTINUE && iter < maxiter);
 
   
   // traemos la solucion desde x a las incognitas
+  root = (sdf != NULL) ? gsl_multiroot_fdfsolver_root(sdf) : gsl_multiroot_fsolver_root(s);
   for (i = 0; i < solve->n; i++) {
-    wasora_var_value(solve->unknown[i]) = gsl_vector_get(gsl_multiroot_fsolver_root(s), i);
+    wasora_var_value(solve->unknown[i]) = gsl_vector_get(root, i);
   }
 
   // limpiamos
-  gsl_multiroot_fsolver_free(s);
+  if (sdf != NULL) {
+    gsl_multiroot_fdfsolver_free(sdf);
+  } else {
+    gsl_multiroot_fsolver_free(s);
+  }
   gsl_vector_free(x);
   
   return status;
@@ -118,3 +145,46 @@ int wasora_gsl_solve_f(const gsl_vector *x, void *params, gsl_vector *f) {
   return GSL_SUCCESS;
   
 }
+
+// jacobiano exacto de los residuos con numeros duales
+int wasora_gsl_solve_df(const gsl_vector *x, void *params, gsl_matrix *J) {
+  solve_t *solve = (solve_t *)params;
+  double **wrt;
+  double xi;
+  int i, status = GSL_SUCCESS;
+  
+  for (i = 0; i < solve->n; i++) {
+    xi = gsl_vector_get(x, i);
+    if (!isnan(xi)) {
+      wasora_var_value(solve->unknown[i]) = xi;
+    } else {
+      return GSL_EDOM;
+    }
+  }
+  
+  wrt = malloc(solve->n * sizeof(double *));
+  for (i = 0; i < solve->n; i++) {
+    wrt[i] = wasora_value_ptr(solve->unknown[i]);
+  }
+  
+  // cada fila del jacobiano es el gradiente de un residuo
+  for (i = 0; status == GSL_SUCCESS && i < solve->n; i++) {
+    if (wasora_evaluate_expression_dual(&solve->residual[i], solve->n, wrt, &xi, gsl_matrix_ptr(J, i, 0)) != WASORA_RUNTIME_OK) {
+      status = GSL_EINVAL;
+    }
+  }
+  
+  free(wrt);
+  
+  return status;
+}
+
+int wasora_gsl_solve_fdf(const gsl_vector *x, void *params, gsl_vector *f, gsl_matrix *J) {
+  int status;
+  
+  if ((status = wasora_gsl_solve_f(x, params, f)) != GSL_SUCCESS) {
+    return status;
+  }
+  
+  return wasora_gsl_solve_df(x, params, J);
+}
@@ -76,17 +76,11 @@ int wasora_parametric_run(void) {
   
   // hacemos una primer pasada hasta donde esta el parametric
   // para asignar las variables de las cuales pueda depender el parametric
-  wasora.ip = wasora.instructions;
-  while (wasora.ip != NULL && wasora.ip->routine != wasora_instruction_parametric) {
-    wasora_call(wasora.ip->routine(wasora.ip->argument));
-
-    if (wasora.next_flow_instruction != NULL) {
-      wasora.ip = wasora.next_flow_instruction;
-      wasora.next_flow_instruction = NULL;
-    } else {
-      wasora.ip = wasora.ip->next;
-    }
+  if (wasora.flat_instructions == NULL) {
+    wasora_call(wasora_instructions_flatten());
   }
+  for (i = 0; i < wasora.n_flat_instructions && wasora.flat_instructions[i].routine != wasora_instruction_parametric; i++);
+  wasora_call(wasora_instructions_run(0, i));
   
   
   wasora.parametric.min = calloc(wasora.parametric.dimensions, sizeof(double));
@@ -245,6 +245,76 @@ int wasora_parser_variable(var_t **var) {
   return WASORA_PARSER_OK;
 }
 
+// defines d<x>_d<p> for each object x of the phase space and each parameter p
+// so the sensitivities integrated by IDAS are available in the input
+int wasora_parser_sensitivities(int n, var_t **parameter) {
+  
+#if HAVE_IDAS
+  phase_object_t *phase_object;
+  expr_t *size_expr;
+  expr_t *rows_expr;
+  expr_t *cols_expr;
+  char *name;
+  int j;
+  
+  if (wasora_dae.phase_objects == NULL) {
+    wasora_push_error_message("SENSITIVITIES need a previous PHASE_SPACE keyword");
+    return WASORA_PARSER_ERROR;
+  }
+  if (wasora_dae.n_sensitivities != 0) {
+    wasora_push_error_message("sensitivities of the phase space were already requested");
+    return WASORA_PARSER_ERROR;
+  }
+  
+  wasora_dae.n_sensitivities = n;
+  wasora_dae.sensitivity_parameter = parameter;
+  
+  LL_FOREACH(wasora_dae.phase_objects, phase_object) {
+    if (phase_object->variable != NULL) {
+      phase_object->variable_sensitivity = calloc(n, sizeof(var_t *));
+    } else if (phase_object->vector != NULL) {
+      phase_object->vector_sensitivity = calloc(n, sizeof(vector_t *));
+    } else if (phase_object->matrix != NULL) {
+      phase_object->matrix_sensitivity = calloc(n, sizeof(matrix_t *));
+    }
+    
+    for (j = 0; j < n; j++) {
+      name = malloc(strlen(phase_object->name)+strlen(parameter[j]->name)+8);
+      sprintf(name, "d%s_d%s", phase_object->name, parameter[j]->name);
+      
+      if (phase_object->variable != NULL) {
+        if ((phase_object->variable_sensitivity[j] = wasora_define_variable(name)) == NULL) {
+          return WASORA_PARSER_ERROR;
+        }
+        
+      } else if (phase_object->vector != NULL) {
+        size_expr = malloc(sizeof(expr_t));
+        wasora_call(wasora_parse_expression(phase_object->vector->size_expr->string, size_expr));
+        if ((phase_object->vector_sensitivity[j] = wasora_define_vector(name, phase_object->vector->size, size_expr, NULL)) == NULL) {
+          return WASORA_PARSER_ERROR;
+        }
+        
+      } else if (phase_object->matrix != NULL) {
+        rows_expr = malloc(sizeof(expr_t));
+        wasora_call(wasora_parse_expression(phase_object->matrix->rows_expr->string, rows_expr));
+        cols_expr = malloc(sizeof(expr_t));
+        wasora_call(wasora_parse_expression(phase_object->matrix->cols_expr->string, cols_expr));
+        if ((phase_object->matrix_sensitivity[j] = wasora_define_matrix(name, phase_object->matrix->rows, rows_expr, phase_object->matrix->cols, cols_expr, NULL)) == NULL) {
+          return WASORA_PARSER_ERROR;
+        }
+      }
+      
+      free(name);
+    }
+  }
+  
+  return WASORA_PARSER_OK;
+#else
+  wasora_push_error_message("wasora cannot compute sensitivities as it was not linked against SUNDIALS IDAS library.");
+  return WASORA_PARSER_ERROR;
+#endif
+}
+
 
 int wasora_parser_keywords_ints(char *keyword[], int *value, int *option) {
 
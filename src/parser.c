@@ -245,8 +245,10 @@ int wasora_parse_input_file(char *filepath, int from, int to) {
 
   FILE *wasora_input_file;
   char *line;
+  char *parent_file;
 
   int line_num, delta_line_num;
+  int parent_line;
   int i, n;
   int understood;
 
@@ -263,6 +265,12 @@ int wasora_parse_input_file(char *filepath, int from, int to) {
     return WASORA_PARSER_ERROR;
   }
 
+  // los INCLUDEs nos llaman recursivamente asi que al final volvemos a dejar
+  // el archivo y la linea del padre para etiquetar sus instrucciones
+  parent_file = wasora.parsing_file;
+  parent_line = wasora.parsing_line;
+  wasora.parsing_file = filepath;
+  
   // parseamos linea por linea
   line_num = 0;
   while ((delta_line_num = wasora_read_line(wasora_input_file)) != 0) {
@@ -279,6 +287,8 @@ int wasora_parse_input_file(char *filepath, int from, int to) {
         return WASORA_PARSER_ERROR;
       }
       
+      wasora.parsing_file = filepath;
+      wasora.parsing_line = line_num;
       line = strdup(wasora.line);
       if ((n = wasora_parse_line(line)) == WASORA_PARSER_ERROR) {
         wasora_push_error_message("%s: %d:", filepath, line_num);
@@ -316,6 +326,8 @@ int wasora_parse_input_file(char *filepath, int from, int to) {
   }
 
   fclose(wasora_input_file);
+  wasora.parsing_file = parent_file;
+  wasora.parsing_line = parent_line;
   
   // everything apple
   return WASORA_PARSER_OK;
@@ -796,6 +808,154 @@ if (strcasecmp(token, "FROM") == 0) {
       
       return WASORA_PARSER_OK;
       
+// ---------------------------------------------------------------------
+///kw+VECTOR_AXPY+usage VECTOR_AXPY
+///kw+VECTOR_AXPY+desc Add a vector times a scalar to another vector, i.e. $\vec{y} = \alpha \vec{x} + \vec{y}$,
+///kw+VECTOR_AXPY+desc using the BLAS routine `daxpy`.
+    } else if ((strcasecmp(token, "VECTOR_AXPY") == 0)) {
+      
+      vector_axpy_t *axpy = calloc(1, sizeof(vector_axpy_t));
+
+///kw+VECTOR_AXPY+usage <vector_y> <vector_x>
+      wasora_call(wasora_parser_vector(&axpy->y));
+      wasora_call(wasora_parser_vector(&axpy->x));
+      
+      while ((token = wasora_get_next_token(NULL)) != NULL) {
+///kw+VECTOR_AXPY+usage [ ALPHA <expr> ]
+///kw+VECTOR_AXPY+detail The scalar $\alpha$ is given by `ALPHA` and defaults to one.
+        if (strcasecmp(token, "ALPHA") == 0) {
+          wasora_call(wasora_parser_expression(&axpy->alpha));
+        } else {
+          wasora_push_error_message("unknown keyword '%s'", token);
+          return WASORA_PARSER_ERROR;
+        }
+      }
+      
+      wasora_define_instruction(wasora_instruction_vector_axpy, axpy);
+      
+      return WASORA_PARSER_OK;
+
+// ---------------------------------------------------------------------
+///kw+MATRIX_MULTIPLY+usage MATRIX_MULTIPLY
+///kw+MATRIX_MULTIPLY+desc Multiply a matrix by another matrix or by a vector using the BLAS routines `dgemm` and `dgemv`,
+///kw+MATRIX_MULTIPLY+desc i.e. $C = \alpha \cdot \text{op}(A) \cdot \text{op}(B) + \beta \cdot C$ or $\vec{y} = \alpha \cdot \text{op}(A) \cdot \vec{x} + \beta \cdot \vec{y}$.
+    } else if ((strcasecmp(token, "MATRIX_MULTIPLY") == 0)) {
+      
+      matrix_multiply_t *multiply = calloc(1, sizeof(matrix_multiply_t));
+      char *names[3];
+
+///kw+MATRIX_MULTIPLY+usage { <matrix_C> <matrix_A> <matrix_B> | <vector_y> <matrix_A> <vector_x> }
+///kw+MATRIX_MULTIPLY+detail The result is the first argument and it may be one of the factors.
+///kw+MATRIX_MULTIPLY+detail It has to be already defined with the proper size.
+      for (i = 0; i < 3; i++) {
+        if ((names[i] = wasora_get_next_token(NULL)) == NULL) {
+          wasora_push_error_message("expected three vector or matrix names");
+          return WASORA_PARSER_ERROR;
+        }
+      }
+      if ((multiply->A = wasora_get_matrix_ptr(names[1])) == NULL) {
+        wasora_push_error_message("undefined matrix identifier '%s'", names[1]);
+        return WASORA_PARSER_ERROR;
+      }
+      if ((multiply->C = wasora_get_matrix_ptr(names[0])) != NULL) {
+        if ((multiply->B = wasora_get_matrix_ptr(names[2])) == NULL) {
+          wasora_push_error_message("undefined matrix identifier '%s'", names[2]);
+          return WASORA_PARSER_ERROR;
+        }
+      } else if ((multiply->y = wasora_get_vector_ptr(names[0])) != NULL) {
+        if ((multiply->x = wasora_get_vector_ptr(names[2])) == NULL) {
+          wasora_push_error_message("undefined vector identifier '%s'", names[2]);
+          return WASORA_PARSER_ERROR;
+        }
+      } else {
+        wasora_push_error_message("undefined vector or matrix identifier '%s'", names[0]);
+        return WASORA_PARSER_ERROR;
+      }
+      
+      while ((token = wasora_get_next_token(NULL)) != NULL) {
+///kw+MATRIX_MULTIPLY+usage [ TRANSPOSE_A ] [ TRANSPOSE_B ]
+///kw+MATRIX_MULTIPLY+detail The keywords `TRANSPOSE_A` and `TRANSPOSE_B` take the transpose of the factors (without computing them).
+        if (strcasecmp(token, "TRANSPOSE_A") == 0) {
+          multiply->transpose_A = 1;
+        } else if (strcasecmp(token, "TRANSPOSE_B") == 0) {
+          if (multiply->B == NULL) {
+            wasora_push_error_message("TRANSPOSE_B only makes sense for matrix-matrix products");
+            return WASORA_PARSER_ERROR;
+          }
+          multiply->transpose_B = 1;
+///kw+MATRIX_MULTIPLY+usage [ ALPHA <expr> ] [ BETA <expr> ]
+///kw+MATRIX_MULTIPLY+detail The scalars $\alpha$ and $\beta$ default to one and zero respectively.
+        } else if (strcasecmp(token, "ALPHA") == 0) {
+          wasora_call(wasora_parser_expression(&multiply->alpha));
+        } else if (strcasecmp(token, "BETA") == 0) {
+          wasora_call(wasora_parser_expression(&multiply->beta));
+        } else {
+          wasora_push_error_message("unknown keyword '%s'", token);
+          return WASORA_PARSER_ERROR;
+        }
+      }
+      
+      wasora_define_instruction(wasora_instruction_matrix_multiply, multiply);
+      
+      return WASORA_PARSER_OK;
+
+// ---------------------------------------------------------------------
+///kw+MATRIX_TRANSPOSE+usage MATRIX_TRANSPOSE
+///kw+MATRIX_TRANSPOSE+desc Transpose a matrix, either in place or into another matrix.
+    } else if ((strcasecmp(token, "MATRIX_TRANSPOSE") == 0)) {
+      
+      matrix_transpose_t *transpose = calloc(1, sizeof(matrix_transpose_t));
+
+///kw+MATRIX_TRANSPOSE+usage <matrix_result> [ <matrix> ]
+///kw+MATRIX_TRANSPOSE+detail If only one matrix is given, it has to be square and it is transposed in place.
+      if ((token = wasora_get_next_token(NULL)) == NULL || (transpose->result = wasora_get_matrix_ptr(token)) == NULL) {
+        wasora_push_error_message("expected matrix name");
+        return WASORA_PARSER_ERROR;
+      }
+      if ((token = wasora_get_next_token(NULL)) == NULL) {
+        transpose->A = transpose->result;
+      } else if ((transpose->A = wasora_get_matrix_ptr(token)) == NULL) {
+        wasora_push_error_message("undefined matrix identifier '%s'", token);
+        return WASORA_PARSER_ERROR;
+      }
+      
+      wasora_define_instruction(wasora_instruction_matrix_transpose, transpose);
+      
+      return WASORA_PARSER_OK;
+
+// ---------------------------------------------------------------------
+///kw+MATRIX_SOLVE+usage MATRIX_SOLVE
+///kw+MATRIX_SOLVE+desc Solve a dense linear system $A \cdot \vec{x} = \vec{b}$.
+    } else if ((strcasecmp(token, "MATRIX_SOLVE") == 0)) {
+      
+      matrix_solve_t *solve = calloc(1, sizeof(matrix_solve_t));
+
+///kw+MATRIX_SOLVE+usage <vector_x> <matrix_A> <vector_b>
+      wasora_call(wasora_parser_vector(&solve->x));
+      if ((token = wasora_get_next_token(NULL)) == NULL || (solve->A = wasora_get_matrix_ptr(token)) == NULL) {
+        wasora_push_error_message("expected matrix name");
+        return WASORA_PARSER_ERROR;
+      }
+      wasora_call(wasora_parser_vector(&solve->b));
+      
+      while ((token = wasora_get_next_token(NULL)) != NULL) {
+///kw+MATRIX_SOLVE+usage [ METHOD { lu | cholesky } ]
+///kw+MATRIX_SOLVE+detail The system is solved by means of an LU decomposition (default) or a Cholesky decomposition
+///kw+MATRIX_SOLVE+detail for symmetric positive-definite matrices. If the matrix is `CONST`, it is factorized only once per run.
+        if (strcasecmp(token, "METHOD") == 0) {
+          char *keywords[] = {"lu", "cholesky", ""};
+          int values[] = {matrix_solve_lu, matrix_solve_cholesky, 0};
+          wasora_call(wasora_parser_keywords_ints(keywords, values, (int *)&solve->method));
+        } else {
+          wasora_push_error_message("unknown keyword '%s'", token);
+          return WASORA_PARSER_ERROR;
+        }
+      }
+      
+      wasora_define_instruction(wasora_instruction_matrix_solve, solve);
+      
+      return WASORA_PARSER_OK;
+      
 // ---------------------------------------------------------------------
 ///kw+MATRIX+usage MATRIX
 ///kw+MATRIX+desc Define a matrix.
@@ -1204,10 +1364,22 @@ if (strcasecmp(token, "FROM") == 0) {
 ///kw+FUNCTION+detail  * shepard_kd, [average of definition points within a kd-tree](https:/\/en.wikipedia.org/wiki/Inverse_distance_weighting#Modified_Shepard&#39;s_method) (more efficient evaluation provided `SHEPARD_RADIUS` is set to a proper value)
           } else if (strcasecmp(token, "shepard_kd") == 0 || strcasecmp(token, "modified_shepard") == 0) {
             function->multidim_interp = shepard_kd;
-///kw+FUNCTION+usage bilinear
+///kw+FUNCTION+usage shepard_knn |
+///kw+FUNCTION+detail  * shepard_knn, modified Shepard average of the `SHEPARD_NEIGHBORS` nearest definition points found in a uniform-grid spatial index (efficient for large scattered data sets)
+          } else if (strcasecmp(token, "shepard_knn") == 0) {
+            function->multidim_interp = shepard_knn;
+///kw+FUNCTION+usage bilinear |
 ///kw+FUNCTION+detail  * bilinear, only available if the definition points configure an structured hypercube-like grid. If $n>3$, `SIZES` should be given.
           } else if (strcasecmp(token, "bilinear") == 0 || strcasecmp(token, "rectangle") == 0 || strcasecmp(token, "rectangular") == 0) {
             function->multidim_interp = bilinear;
+///kw+FUNCTION+usage bicubic |
+///kw+FUNCTION+detail  * bicubic (or tricubic), tensor-product cubic splines over the same kind of grid as `bilinear`. The coefficients are computed once so coarse tables give smooth results.
+          } else if (strcasecmp(token, "bicubic") == 0 || strcasecmp(token, "tricubic") == 0) {
+            function->multidim_interp = rectangular_spline;
+///kw+FUNCTION+usage bisteffen
+///kw+FUNCTION+detail  * bisteffen (or tristeffen), like `bicubic` but with Steffen's monotonic derivatives along each direction, so there are no overshoots along grid lines (available only with GSL >= 2.0, otherwise derivatives are piecewise linear)
+          } else if (strcasecmp(token, "bisteffen") == 0 || strcasecmp(token, "tristeffen") == 0) {
+            function->multidim_interp = rectangular_steffen;
 ///kw+FUNCTION+usage } ]
           } else {
             wasora_push_error_message("undefined interpolation method '%s'", token);
@@ -1236,6 +1408,19 @@ if (strcasecmp(token, "FROM") == 0) {
         } else if (strcasecmp(token, "SHEPARD_EXPONENT") == 0) {
            wasora_parser_expression(&function->expr_shepard_exponent);
 
+///kw+FUNCTION+usage [ SHEPARD_NEIGHBORS <expr> ]
+///kw+FUNCTION+detail The number of nearest definition points used by `shepard_knn` is given by `SHEPARD_NEIGHBORS`.
+///kw+FUNCTION+detail Default is `DEFAULT_SHEPARD_NEIGHBORS`.
+        } else if (strcasecmp(token, "SHEPARD_NEIGHBORS") == 0) {
+           wasora_parser_expression(&function->expr_shepard_neighbors);
+
+///kw+FUNCTION+usage [ SHEPARD_CACHE ]
+///kw+FUNCTION+detail If `SHEPARD_CACHE` is given, `shepard_knn` remembers the neighbors and weights of each evaluation point
+///kw+FUNCTION+detail so evaluating again at the same point (i.e. at fixed mesh nodes each step) is just a dot product with the data.
+///kw+FUNCTION+detail At most `DEFAULT_SHEPARD_CACHE_SIZE` points are remembered, the least recently used one is forgotten first.
+        } else if (strcasecmp(token, "SHEPARD_CACHE") == 0) {
+           function->shepard_cache_enabled = 1;
+
 ///kw+FUNCTION+usage [ SIZES <expr_1> <expr_2> ... <expr_n> ]
 ///kw+FUNCTION+detail When requesting `bilinear` interpolation for $n>3$, the number of definition points for each argument variable has to be given with `SIZES`,
         } else if (strcasecmp(token, "SIZES") == 0) {
@@ -2233,9 +2418,32 @@ if (strcasecmp(token, "FROM") == 0) {
 ///kw+SOLVE+usage hybrids |
           } else if (strcasecmp(token, "hybrids") == 0) {
             solve->type = gsl_multiroot_fsolver_hybrids;
-///kw+SOLVE+usage broyden }
+///kw+SOLVE+usage broyden |
           } else if (strcasecmp(token, "broyden") == 0) {
             solve->type = gsl_multiroot_fsolver_hybrid;
+///kw+SOLVE+usage newton |
+///kw+SOLVE+detail The methods `newton`, `hybridj`, `hybridsj` and `gnewton` need the Jacobian of the residuals,
+///kw+SOLVE+detail which is computed exactly with dual numbers. If some residual cannot be differentiated
+///kw+SOLVE+detail (i.e. it involves functionals or built-in functions with memory) the corresponding
+///kw+SOLVE+detail derivative-free method (`dnewton`, `hybrid`, `hybrids` and `broyden`) is used instead.
+          } else if (strcasecmp(token, "newton") == 0) {
+            solve->type = gsl_multiroot_fsolver_dnewton;
+            solve->fdf_type = gsl_multiroot_fdfsolver_newton;
+///kw+SOLVE+usage hybridj |
+          } else if (strcasecmp(token, "hybridj") == 0) {
+            solve->type = gsl_multiroot_fsolver_hybrid;
+            solve->fdf_type = gsl_multiroot_fdfsolver_hybridj;
+///kw+SOLVE+usage hybridsj |
+          } else if (strcasecmp(token, "hybridsj") == 0) {
+            solve->type = gsl_multiroot_fsolver_hybrids;
+            solve->fdf_type = gsl_multiroot_fdfsolver_hybridsj;
+///kw+SOLVE+usage gnewton }
+          } else if (strcasecmp(token, "gnewton") == 0) {
+            solve->type = gsl_multiroot_fsolver_hybrid;
+            solve->fdf_type = gsl_multiroot_fdfsolver_gnewton;
+          } else {
+            wasora_push_error_message("unknown method '%s'", token);
+            return WASORA_PARSER_ERROR;
           }
 ///kw+SOLVE+usage ]
           
@@ -2462,6 +2670,28 @@ if (strcasecmp(token, "FROM") == 0) {
       // proposed by rvignolo
 //      history->function->arg_name = malloc(1 * sizeof(char *));
 //      history->function->arg_name[0] = strdup(wasora.special_vars.t->name);
+      history->function->type = type_routine_internal;
+      history->function->routine_internal = wasora_history_evaluate;
+      history->function->params = history;
+
+      while ((token = wasora_get_next_token(NULL)) != NULL) {
+///kw+HISTORY+usage [ WINDOW <expr> ]
+///kw+HISTORY+detail The function interpolates linearly the recorded values and returns the
+///kw+HISTORY+detail first (last) recorded value for times before (after) the recorded ones.
+///kw+HISTORY+detail If `WINDOW` is given, only the points of the last `WINDOW` units of time are kept.
+        if (strcasecmp(token, "WINDOW") == 0) {
+          wasora_call(wasora_parser_expression(&history->expr_window));
+
+///kw+HISTORY+usage [ MAX_POINTS <expr> ]
+///kw+HISTORY+detail If `MAX_POINTS` is given, the oldest points are dropped so as to keep at most this number.
+        } else if (strcasecmp(token, "MAX_POINTS") == 0) {
+          wasora_call(wasora_parser_expression(&history->expr_max_points));
+
+        } else {
+          wasora_push_error_message("unknown keyword '%s'", token);
+          return WASORA_PARSER_ERROR;
+        }
+      }
 
       if (wasora_define_instruction(wasora_instruction_history, history) == NULL) {
         return WASORA_PARSER_ERROR;
@@ -2469,6 +2699,68 @@ if (strcasecmp(token, "FROM") == 0) {
 
       return WASORA_PARSER_OK;
 
+    // ----- CHECKPOINT  -----------------------------------------------------------------
+///kw+CHECKPOINT+desc Save the whole state of a transient so it can be continued later with `--restart`.
+///kw+CHECKPOINT+usage CHECKPOINT
+    } else if ((strcasecmp(token, "CHECKPOINT") == 0)) {
+
+///kw+CHECKPOINT+detail The snapshot is taken at the end of the transient step in which the instruction is executed
+///kw+CHECKPOINT+detail (it does nothing during the static steps). It contains the values of all the variables, vectors and matrices,
+///kw+CHECKPOINT+detail the data of the `HISTORY` functions, the internal state of builtin functions such as `lag`,
+///kw+CHECKPOINT+detail `integral_dt` or `random` and the size of the output files. It is written by a child process
+///kw+CHECKPOINT+detail to a temporary file that replaces the previous checkpoint only once it is complete, so the calculation
+///kw+CHECKPOINT+detail goes on meanwhile and a crash never leaves a broken checkpoint behind.
+///kw+CHECKPOINT+detail Executing wasora with `--restart` continues the transient from the step that follows the checkpoint,
+///kw+CHECKPOINT+detail truncating the output files back to where they were.
+///kw+CHECKPOINT+detail DAE systems are re-initialized from the saved phase space and the last time step, as
+///kw+CHECKPOINT+detail the internal history of IDA cannot be saved.
+      checkpoint_t *checkpoint;
+      int n;
+      
+      checkpoint = calloc(1, sizeof(checkpoint_t));
+      LL_APPEND(wasora.checkpoint.checkpoints, checkpoint);
+
+      char *keywords[] = {"SKIP_STEP", "SKIP_TIME", ""};
+      expr_t *expressions[] = {
+        &checkpoint->skip_step,
+        &checkpoint->skip_time,
+        NULL
+      };
+      
+      while ((token = wasora_get_next_token(NULL)) != NULL) {
+///kw+CHECKPOINT+usage [ FILE_PATH <file_path> ]
+///kw+CHECKPOINT+detail The default file is the input file name with the extension `.chk` appended.
+///kw+CHECKPOINT+detail All the `CHECKPOINT` instructions write to the same file.
+        if (strcasecmp(token, "FILE_PATH") == 0) {
+          char *file_path;
+          wasora_call(wasora_parser_string(&file_path));
+          if (wasora.checkpoint.file_path != NULL && strcmp(wasora.checkpoint.file_path, file_path) != 0) {
+            wasora_push_error_message("all the checkpoints have to be written to the same file");
+            free(file_path);
+            return WASORA_PARSER_ERROR;
+          }
+          free(wasora.checkpoint.file_path);
+          wasora.checkpoint.file_path = file_path;
+          
+///kw+CHECKPOINT+usage [ SKIP_STEP <expr> ]
+///kw+CHECKPOINT+usage [ SKIP_TIME <expr> ]
+///kw+CHECKPOINT+detail The `SKIP_STEP` and `SKIP_TIME` keywords take snapshots only every given number of steps or amount of time.
+        } else if ((n = wasora_parser_match_keyword_expression(token, keywords, expressions, sizeof(expressions)/sizeof(expr_t *))) != WASORA_PARSER_UNHANDLED) {
+          if (n == WASORA_PARSER_ERROR) {
+            return WASORA_PARSER_ERROR;
+          }
+        } else {
+          wasora_push_error_message("unknown keyword '%s'", token);
+          return WASORA_PARSER_ERROR;
+        }
+      }
+
+      if (wasora_define_instruction(wasora_instruction_checkpoint, checkpoint) == NULL) {
+        return WASORA_PARSER_ERROR;
+      }
+
+      return WASORA_PARSER_OK;
+
     // ----- PARAMETRIC  -----------------------------------------------------------------
 ///kw+PARAMETRIC+desc Systematically sweep a zone of the parameter space, i.e. perform a parametric run.
     } else if ((strcasecmp(token, "PARAMETRIC") == 0)) {
@@ -2784,6 +3076,29 @@ if (strcasecmp(token, "FROM") == 0) {
 
           wasora.fit.norerun = 0;
 
+///kw+FIT+usage [ MAX_DAUGHTERS <num_expr> ]@
+///kw+FIT+detail When the main loop has to be re-run to compute the numerical gradient, up to `MAX_DAUGHTERS`
+///kw+FIT+detail perturbed runs are executed concurrently in forked processes (default is one, i.e. sequentially).
+///kw+FIT+detail These concurrent runs do not write anything, neither to the standard output nor to files.
+///kw+FIT+detail The step of each parameter starts at `DEFAULT_NLIN_FIT_GRAD_H` relative to its value
+///kw+FIT+detail and is adapted between iterations according to the non-linearity of the model along it.
+        } else if (strcasecmp(token, "MAX_DAUGHTERS") == 0) {
+          double xi;
+          wasora_call(wasora_parser_expression_in_string(&xi));
+          wasora.fit.max_daughters = (int)(ceil(xi));
+
+///kw+FIT+usage [ SENSITIVITIES ]@
+///kw+FIT+detail If the model has a `PHASE_SPACE` (which has to be defined before `FIT`), the keyword `SENSITIVITIES`
+///kw+FIT+detail integrates the forward sensitivities of the DAE system with respect to the parameters
+///kw+FIT+detail together with the transient (this needs wasora to be linked against SUNDIALS IDAS).
+///kw+FIT+detail They are available as `d<x>_d<p>` for each object `x` of the phase space and each parameter `p`.
+///kw+FIT+detail The gradient is then either given by the `GRADIENT` expressions (which can use these objects)
+///kw+FIT+detail or, if the fitted function is the `HISTORY` of a phase-space variable, it is taken
+///kw+FIT+detail from the history of its sensitivities, so only one run per iteration is needed.
+        } else if (strcasecmp(token, "SENSITIVITIES") == 0) {
+          
+          wasora.fit.sensitivities = 1;
+          
         } else {
 
           varitem = calloc(1, sizeof(varlist_t));
@@ -2822,6 +3137,14 @@ if (strcasecmp(token, "FROM") == 0) {
         }
       }
 
+      if (wasora.fit.sensitivities) {
+        if (wasora.fit.norerun) {
+          wasora_push_error_message("SENSITIVITIES and NORERUN are mutually exclusive");
+          return WASORA_PARSER_ERROR;
+        }
+        wasora_call(wasora_parser_sensitivities(wasora.fit.p, wasora.fit.param));
+      }
+
       if (wasora.fit.algorithm == NULL) {
         wasora.fit.algorithm = DEFAULT_NLIN_FIT_METHOD;
       }
@@ -2885,7 +3208,7 @@ if (strcasecmp(token, "FROM") == 0) {
           }
 
 ///kw+MINIMIZE+usage nmsimplex2 |
-          } else if (strcasecmp(token, "nmsimplex2") == 0) {
+          if (strcasecmp(token, "nmsimplex2") == 0) {
             wasora.min.f_type = gsl_multimin_fminimizer_nmsimplex2;
 ///kw+MINIMIZE+usage nmsimplex |
           } else if (strcasecmp(token, "nmsimplex") == 0) {
@@ -2894,7 +3217,7 @@ if (strcasecmp(token, "FROM") == 0) {
           } else if (strcasecmp(token, "nmsimplex2rand") == 0) {
             wasora.min.f_type = gsl_multimin_fminimizer_nmsimplex2rand;
 ///kw+MINIMIZE+usage conjugate_fr |
-          if (strcasecmp(token, "conjugate_fr") == 0) {
+          } else if (strcasecmp(token, "conjugate_fr") == 0) {
             wasora.min.fdf_type = gsl_multimin_fdfminimizer_conjugate_fr;
 ///kw+MINIMIZE+usage conjugate_pr |
           } else if (strcasecmp(token, "conjugate_pr") == 0) {
@@ -2993,6 +3316,36 @@ if (strcasecmp(token, "FROM") == 0) {
         } else if (strcasecmp(token, "NORERUN") == 0) {
           wasora.min.norerun = 1;
 
+///kw+MINIMIZE+usage [ SENSITIVITIES ]@
+///kw+MINIMIZE+detail If the model has a `PHASE_SPACE` (which has to be defined before `MINIMIZE`), the keyword
+///kw+MINIMIZE+detail `SENSITIVITIES` integrates the forward sensitivities of the DAE system with respect to
+///kw+MINIMIZE+detail the arguments of the function together with the transient as `d<x>_d<p>`.
+///kw+MINIMIZE+detail If no `GRADIENT` is given, the gradient is obtained by the chain rule assuming the function
+///kw+MINIMIZE+detail depends on the transient only through the phase space at the end of the run.
+        } else if (strcasecmp(token, "SENSITIVITIES") == 0) {
+          wasora.min.sensitivities = 1;
+
+///kw+MINIMIZE+usage [ MULTISTART_TYPE { sobol | niederreiter | halton | reversehalton } ]@
+///kw+MINIMIZE+detail If `MULTISTART` is given, that number of local searches are started from quasi-random
+///kw+MINIMIZE+detail points of the box given by `MIN` and `MAX` (which are then mandatory) of the sequence
+///kw+MINIMIZE+detail given by `MULTISTART_TYPE` (default is `sobol`) instead of from the single `GUESS`.
+///kw+MINIMIZE+detail Starts that lie closer than `BASIN_RADIUS` (relative to the box, default `DEFAULT_MINIMIZER_BASIN_RADIUS`)
+///kw+MINIMIZE+detail to a minimum or to a previous start are skipped and minima closer than that are merged.
+///kw+MINIMIZE+detail Up to `MAX_DAUGHTERS` local searches run at the same time in forked processes.
+///kw+MINIMIZE+detail The variables are left at the best minimum, `VERBOSE` lists all the distinct minima found.
+        } else if (strcasecmp(token, "MULTISTART_TYPE") == 0) {
+          char *keywords[] = {"sobol", "niederreiter", "halton", "reversehalton", ""};
+          void *values[] = {(void *)gsl_qrng_sobol, (void *)gsl_qrng_niederreiter_2, (void *)gsl_qrng_halton, (void *)gsl_qrng_reversehalton, NULL};
+          void *type = NULL;
+          wasora_call(wasora_parser_read_keywords_voids(keywords, values, &type));
+          wasora.min.multistart_type = (const gsl_qrng_type *)type;
+
+///kw+MINIMIZE+usage [ MAX_DAUGHTERS <num_expr> ]@
+        } else if (strcasecmp(token, "MAX_DAUGHTERS") == 0) {
+          double xi;
+          wasora_call(wasora_parser_expression_in_string(&xi));
+          wasora.min.max_daughters = (int)(ceil(xi));
+
         } else {
 
 ///kw+MINIMIZE+usage [ MAX_ITER <expr> ]
@@ -3000,13 +3353,17 @@ if (strcasecmp(token, "FROM") == 0) {
 ///kw+MINIMIZE+usage [ GRADTOL <expr> ]@
 ///kw+MINIMIZE+usage [ VERBOSE ]
 ///kw+MINIMIZE+usage [ NORERUN ]@
+///kw+MINIMIZE+usage [ MULTISTART <expr> ]
+///kw+MINIMIZE+usage [ BASIN_RADIUS <expr> ]@
           // en una sola linea para el generador del lexer de pygments
-          char *keywords[] = {"MAX_ITER", "TOL", "GRADTOL", ""};
+          char *keywords[] = {"MAX_ITER", "TOL", "GRADTOL", "MULTISTART", "BASIN_RADIUS", ""};
           //, "POPULATION", "GA_STEPS"};
           expr_t *expressions[] = {
             &wasora.min.max_iter,
             &wasora.min.tol,
             &wasora.min.gradtol,
+            &wasora.min.multistart,
+            &wasora.min.basin_radius,
 //            &wasora.min.population,
 //            &wasora.min.ga_steps
             NULL,
@@ -3025,6 +3382,19 @@ if (strcasecmp(token, "FROM") == 0) {
         return WASORA_PARSER_ERROR;
       }
 
+      if (wasora.min.sensitivities) {
+        if (wasora.min.norerun) {
+          wasora_push_error_message("SENSITIVITIES and NORERUN are mutually exclusive");
+          return WASORA_PARSER_ERROR;
+        }
+        wasora_call(wasora_parser_sensitivities(wasora.min.n, wasora.min.x));
+      }
+
+      if (wasora.min.multistart.n_tokens != 0 && (wasora.min.range.min == NULL || wasora.min.range.max == NULL)) {
+        wasora_push_error_message("MULTISTART needs both MIN and MAX");
+        return WASORA_PARSER_ERROR;
+      }
+
       if (wasora.min.genetic != 0) {
         if (wasora.min.range.min == NULL) {
           wasora_push_error_message("need a MIN keyword for genetic algorithms");
@@ -3190,6 +3560,44 @@ if (strcasecmp(token, "FROM") == 0) {
       
       return WASORA_PARSER_OK;
       
+    // ----- EVENT -----------------------------------------------------------
+    } else if (strcasecmp(token, "EVENT") == 0) {
+///kw+EVENT+desc Ask the DAE solver to locate the instants where an expression crosses zero.
+///kw+EVENT+usage EVENT <expr> [ DIRECTION { BOTH | RISING | FALLING } ]
+///kw+EVENT+detail The expression, which may depend on the time and on the phase space, is
+///kw+EVENT+detail handed to IDA’s rootfinding so the integrator stops exactly where it changes sign.
+///kw+EVENT+detail The instructions are executed at that time and the solver is re-initialized
+///kw+EVENT+detail from the resulting state, so discontinuities such as trips or setpoint changes
+///kw+EVENT+detail that depend on the sign of the expression need neither `TIME_PATH` nor a small `min_dt`.
+///kw+EVENT+detail If `INITIAL_CONDITIONS_MODE` is `FROM_VARIABLES`, the algebraic variables and the
+///kw+EVENT+detail derivatives are made consistent again after each event.
+///kw+EVENT+detail By default both directions of the crossing are detected, `RISING` only looks for
+///kw+EVENT+detail crossings from negative to positive and `FALLING` only for the opposite ones.
+      
+      event_t *event = calloc(1, sizeof(event_t));
+      
+      if ((token = wasora_get_next_token(NULL)) == NULL) {
+        wasora_push_error_message("expected an expression");
+        return WASORA_PARSER_ERROR;
+      }
+      wasora_call(wasora_parse_expression(token, &event->condition));
+      
+      while ((token = wasora_get_next_token(NULL)) != NULL) {
+        if (strcasecmp(token, "DIRECTION") == 0) {
+          char *keywords[] = {"BOTH", "RISING", "FALLING", ""};
+          int values[] = {0, 1, -1, 0};
+          wasora_call(wasora_parser_keywords_ints(keywords, values, &event->direction));
+        } else {
+          wasora_push_error_message("unknown keyword '%s'", token);
+          return WASORA_PARSER_ERROR;
+        }
+      }
+      
+      LL_APPEND(wasora_dae.events, event);
+      wasora_dae.n_events++;
+      
+      return WASORA_PARSER_OK;
+      
       // --- DAE -----------------------------------------------------
     } else if (token[0] == '0' || strstr(wasora.line, ".=") != NULL) {
 ///kw+_.=+desc Add an equation to the DAE system to be solved in the phase space spanned by `PHASE_SPACE`.
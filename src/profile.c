@@ -0,0 +1,354 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora runtime profiler
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <time.h>
+
+#ifndef _WASORA_H_
+#include "wasora.h"
+#endif
+
+#define PROFILE_MAX_DEPTH   128
+
+// a node of the call tree, the path from the root down to each
+// node is one line of the folded-stack output
+typedef struct profile_stack_t profile_stack_t;
+struct profile_stack_t {
+  profile_entry_t *entry;
+  profile_stack_t *parent;
+  profile_stack_t *children;
+  double self;
+  UT_hash_handle hh;
+};
+
+static struct {
+  profile_entry_t *entry;
+  profile_stack_t *stack;
+  double start;
+  double children;
+} profile_frame[PROFILE_MAX_DEPTH];
+static int profile_depth = 0;
+
+static profile_stack_t *profile_stacks = NULL;
+static double profile_t0;
+
+// the keywords of the instructions, plugins get their routine symbol name
+static struct {
+  int (*routine)(void *);
+  const char *name;
+} profile_instruction_names[] = {
+  {&wasora_instruction_abort,            "ABORT"},
+  {&wasora_instruction_alias,            "ALIAS"},
+  {&wasora_instruction_assignment,       "assignment"},
+  {&wasora_instruction_call,             "CALL"},
+  {&wasora_instruction_checkpoint,       "CHECKPOINT"},
+  {&wasora_instruction_close_file,       "CLOSE"},
+  {&wasora_instruction_dae,              "DAE"},
+  {&wasora_instruction_if,               "IF"},
+  {&wasora_instruction_history,          "HISTORY"},
+  {&wasora_instruction_io,               "IO"},
+  {&wasora_instruction_m4,               "M4"},
+  {&wasora_instruction_matrix_multiply,  "MATRIX_MULTIPLY"},
+  {&wasora_instruction_matrix_solve,     "MATRIX_SOLVE"},
+  {&wasora_instruction_matrix_transpose, "MATRIX_TRANSPOSE"},
+  {&wasora_instruction_mesh,             "MESH"},
+  {&wasora_instruction_mesh_fill_vector, "MESH_FILL_VECTOR"},
+  {&wasora_instruction_mesh_find_minmax, "MESH_FIND_MAX"},
+  {&wasora_instruction_mesh_integrate,   "MESH_INTEGRATE"},
+  {&wasora_instruction_mesh_post,        "MESH_POST"},
+  {&wasora_instruction_mesh_transfer,    "MESH_TRANSFER"},
+  {&wasora_instruction_parametric,       "PARAMETRIC"},
+  {&wasora_instruction_print,            "PRINT"},
+  {&wasora_instruction_print_function,   "PRINT_FUNCTION"},
+  {&wasora_instruction_print_vector,     "PRINT_VECTOR"},
+  {&wasora_instruction_sem,              "SEMAPHORE"},
+  {&wasora_instruction_shell,            "SHELL"},
+  {&wasora_instruction_solve,            "SOLVE"},
+  {&wasora_instruction_vector_axpy,      "VECTOR_AXPY"},
+  {&wasora_instruction_vector_sort,      "VECTOR_SORT"},
+  {NULL,                                 NULL}
+};
+
+
+static double wasora_profile_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+int wasora_profile_init(void) {
+
+  if (wasora.profile.enabled) {
+    profile_t0 = wasora_profile_now();
+  }
+
+  return WASORA_RUNTIME_OK;
+}
+
+// returns (and creates if needed) the entry with the given label
+profile_entry_t *wasora_profile_entry(const char *kind, const char *label) {
+
+  profile_entry_t *entry;
+
+  HASH_FIND_STR(wasora.profile.entries, label, entry);
+  if (entry == NULL) {
+    entry = calloc(1, sizeof(profile_entry_t));
+    entry->kind = kind;
+    entry->label = strdup(label);
+    HASH_ADD_KEYPTR(hh, wasora.profile.entries, entry->label, strlen(entry->label), entry);
+  }
+
+  return entry;
+}
+
+profile_entry_t *wasora_profile_instruction_entry(instruction_t *instruction) {
+
+  Dl_info info;
+  const char *name = NULL;
+  char *label;
+  int i;
+
+  if (instruction->profile != NULL) {
+    return instruction->profile;
+  }
+
+  for (i = 0; profile_instruction_names[i].routine != NULL; i++) {
+    if (profile_instruction_names[i].routine == instruction->routine) {
+      name = profile_instruction_names[i].name;
+      break;
+    }
+  }
+  if (name == NULL && dladdr((void *)instruction->routine, &info) != 0 && info.dli_sname != NULL) {
+    name = info.dli_sname;
+  }
+
+  // without memory for the location we still have the name
+  if (asprintf(&label, "%s:%d %s", (instruction->file != NULL) ? instruction->file : "?", instruction->line, (name != NULL) ? name : "instruction") == -1) {
+    instruction->profile = wasora_profile_entry("instruction", (name != NULL) ? name : "instruction");
+  } else {
+    instruction->profile = wasora_profile_entry("instruction", label);
+    free(label);
+  }
+
+  return instruction->profile;
+}
+
+profile_entry_t *wasora_profile_function_entry(function_t *function) {
+
+  const char *kind;
+  char *label;
+
+  if (function->profile != NULL) {
+    return function->profile;
+  }
+
+  switch (function->type) {
+    case type_algebraic:
+      kind = "algebraic";
+    break;
+    case type_pointwise_data:
+    case type_pointwise_file:
+    case type_pointwise_vector:
+      kind = "pointwise";
+    break;
+    case type_pointwise_mesh_node:
+    case type_pointwise_mesh_cell:
+    case type_pointwise_mesh_property:
+      kind = "mesh";
+    break;
+    case type_routine:
+    case type_routine_internal:
+      kind = "routine";
+    break;
+    default:
+      kind = "function";
+    break;
+  }
+
+  if (asprintf(&label, "%s function %s", kind, function->name) == -1) {
+    function->profile = wasora_profile_entry("function", function->name);
+  } else {
+    function->profile = wasora_profile_entry("function", label);
+    free(label);
+  }
+
+  return function->profile;
+}
+
+
+void wasora_profile_push(profile_entry_t *entry) {
+
+  profile_stack_t *parent;
+  profile_stack_t *siblings;
+  profile_stack_t *stack;
+
+  if (profile_depth < PROFILE_MAX_DEPTH) {
+    // the node of the call path is a child of the caller's node looked
+    // up by the entry pointer, so no path has to be built at run time
+    parent = (profile_depth > 0) ? profile_frame[profile_depth-1].stack : NULL;
+    siblings = (parent != NULL) ? parent->children : profile_stacks;
+    HASH_FIND_PTR(siblings, &entry, stack);
+    if (stack == NULL) {
+      stack = calloc(1, sizeof(profile_stack_t));
+      stack->entry = entry;
+      stack->parent = parent;
+      HASH_ADD_PTR(siblings, entry, stack);
+      if (parent != NULL) {
+        parent->children = siblings;
+      } else {
+        profile_stacks = siblings;
+      }
+    }
+
+    profile_frame[profile_depth].entry = entry;
+    profile_frame[profile_depth].stack = stack;
+    profile_frame[profile_depth].children = 0;
+    profile_frame[profile_depth].start = wasora_profile_now();
+  }
+  profile_depth++;
+
+  return;
+}
+
+void wasora_profile_pop(void) {
+
+  profile_entry_t *entry;
+  double elapsed, self;
+
+  if (--profile_depth >= PROFILE_MAX_DEPTH || profile_depth < 0) {
+    profile_depth = (profile_depth < 0) ? 0 : profile_depth;
+    return;
+  }
+
+  entry = profile_frame[profile_depth].entry;
+  elapsed = wasora_profile_now() - profile_frame[profile_depth].start;
+  self = elapsed - profile_frame[profile_depth].children;
+
+  entry->count++;
+  entry->total += elapsed;
+  entry->self += self;
+  if (profile_depth > 0) {
+    profile_frame[profile_depth-1].children += elapsed;
+  }
+
+  profile_frame[profile_depth].stack->self += self;
+
+  return;
+}
+
+
+// folded stacks use spaces as separator so we do not want them in the frames
+static void wasora_profile_write_path(FILE *file, profile_stack_t *stack) {
+
+  const char *c;
+
+  if (stack->parent != NULL) {
+    wasora_profile_write_path(file, stack->parent);
+    fputc(';', file);
+  }
+  for (c = stack->entry->label; *c != '\0'; c++) {
+    fputc((*c == ' ') ? '_' : *c, file);
+  }
+
+  return;
+}
+
+// writes one line per node of the tree and frees it on the way
+static void wasora_profile_write_folded(FILE *file, profile_stack_t *stacks) {
+
+  profile_stack_t *stack, *tmp;
+
+  HASH_ITER(hh, stacks, stack, tmp) {
+    wasora_profile_write_path(file, stack);
+    fprintf(file, " %.0f\n", 1e6*stack->self);
+    wasora_profile_write_folded(file, stack->children);
+    HASH_DEL(stacks, stack);
+    free(stack);
+  }
+
+  return;
+}
+
+static int wasora_profile_compare_self(profile_entry_t *a, profile_entry_t *b) {
+  return (a->self < b->self) ? 1 : ((a->self > b->self) ? -1 : 0);
+}
+
+// writes <input>.profile (sorted by self time) and <input>.folded, the latter
+// with one "frame;frame;frame microseconds" line per call path so it can be
+// fed directly to flamegraph.pl or any other tool that reads folded stacks
+int wasora_profile_report(void) {
+
+  profile_entry_t *entry, *tmp;
+  FILE *file;
+  char *filename;
+  const char *input;
+  double wall;
+
+  if (wasora.profile.enabled == 0 || wasora.argv == NULL) {
+    return WASORA_RUNTIME_OK;
+  }
+
+  wall = wasora_profile_now() - profile_t0;
+  input = wasora.argv[wasora.optind];
+  HASH_SORT(wasora.profile.entries, wasora_profile_compare_self);
+
+  if (asprintf(&filename, "%s.profile", input) == -1) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  if ((file = fopen(filename, "w")) == NULL) {
+    wasora_push_error_message("cannot open profile report '%s': %s", filename, strerror(errno));
+    free(filename);
+    return WASORA_RUNTIME_ERROR;
+  }
+  fprintf(file, "# wasora profile of %s, wall time %g s\n", input, wall);
+  fprintf(file, "# %12s %14s %14s %7s  %-12s %s\n", "calls", "total [s]", "self [s]", "self %", "kind", "label");
+  for (entry = wasora.profile.entries; entry != NULL; entry = entry->hh.next) {
+    fprintf(file, "  %12lu %14.6e %14.6e %7.2f  %-12s %s\n", entry->count, entry->total, entry->self, (wall > 0) ? 100*entry->self/wall : 0, entry->kind, entry->label);
+  }
+  fclose(file);
+  free(filename);
+
+  if (asprintf(&filename, "%s.folded", input) == -1) {
+    return WASORA_RUNTIME_ERROR;
+  }
+  if ((file = fopen(filename, "w")) == NULL) {
+    wasora_push_error_message("cannot open folded stacks '%s': %s", filename, strerror(errno));
+    free(filename);
+    return WASORA_RUNTIME_ERROR;
+  }
+  wasora_profile_write_folded(file, profile_stacks);
+  profile_stacks = NULL;
+  fclose(file);
+  free(filename);
+
+  HASH_ITER(hh, wasora.profile.entries, entry, tmp) {
+    HASH_DEL(wasora.profile.entries, entry);
+    free(entry->label);
+    free(entry);
+  }
+
+  return WASORA_RUNTIME_OK;
+}
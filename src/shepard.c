@@ -0,0 +1,362 @@
+/*------------ -------------- -------- --- ----- ---   --       -            -
+ *  wasora's k-nearest-neighbors modified shepard interpolation
+ *
+ *  Copyright (C) 2020 jeremy theler
+ *
+ *  This file is part of wasora.
+ *
+ *  wasora is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  wasora is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with wasora.  If not, see <http://www.gnu.org/licenses/>.
+ *------------------- ------------  ----    --------  --     -       -         -
+ */
+#ifndef _WASORA_H_
+#include "wasora.h"
+#endif
+
+// a uniform grid of cells with about two points per cell, stored in CSR form
+// so the points of a cell are contiguous (both their indexes and coordinates)
+shepard_index_t *shepard_index_create(int dim, size_t n_points, double **argument) {
+
+  shepard_index_t *index;
+  double *max;
+  double volume, h;
+  size_t j, target;
+  int *cell_of_point;
+  int *fill;
+  int i, c, n_nondegenerate;
+
+  index = calloc(1, sizeof(shepard_index_t));
+  index->dim = dim;
+  index->n_points = n_points;
+  index->n_cells = calloc(dim, sizeof(int));
+  index->min = calloc(dim, sizeof(double));
+  index->h = calloc(dim, sizeof(double));
+  max = calloc(dim, sizeof(double));
+
+  // bounding box
+  for (i = 0; i < dim; i++) {
+    index->min[i] = max[i] = argument[i][0];
+    for (j = 1; j < n_points; j++) {
+      if (argument[i][j] < index->min[i]) {
+        index->min[i] = argument[i][j];
+      } else if (argument[i][j] > max[i]) {
+        max[i] = argument[i][j];
+      }
+    }
+  }
+
+  // cell size such that there are about two points per cell
+  volume = 1;
+  n_nondegenerate = 0;
+  for (i = 0; i < dim; i++) {
+    if (max[i] > index->min[i]) {
+      volume *= max[i] - index->min[i];
+      n_nondegenerate++;
+    }
+  }
+  target = (n_points > 2) ? n_points/2 : 1;
+  h = (n_nondegenerate > 0) ? pow(volume/target, 1.0/n_nondegenerate) : 1;
+
+  index->total_cells = 1;
+  index->h_min = INFTY;
+  for (i = 0; i < dim; i++) {
+    if (max[i] > index->min[i]) {
+      index->n_cells[i] = (int)ceil((max[i] - index->min[i])/h);
+      if (index->n_cells[i] < 1) {
+        index->n_cells[i] = 1;
+      } else if (index->n_cells[i] > target) {
+        index->n_cells[i] = target;
+      }
+      index->h[i] = (max[i] - index->min[i])/index->n_cells[i];
+      if (index->h[i] < index->h_min) {
+        index->h_min = index->h[i];
+      }
+    } else {
+      index->n_cells[i] = 1;
+      index->h[i] = 1;
+    }
+    index->total_cells *= index->n_cells[i];
+  }
+  free(max);
+
+  // counting sort of the points by cell
+  cell_of_point = malloc(n_points * sizeof(int));
+  index->cell_start = calloc(index->total_cells+1, sizeof(int));
+  for (j = 0; j < n_points; j++) {
+    c = 0;
+    for (i = dim-1; i >= 0; i--) {
+      c = c*index->n_cells[i] + shepard_index_cell_coordinate(index, i, argument[i][j]);
+    }
+    cell_of_point[j] = c;
+    index->cell_start[c+1]++;
+  }
+  for (c = 0; c < index->total_cells; c++) {
+    index->cell_start[c+1] += index->cell_start[c];
+  }
+
+  fill = malloc(index->total_cells * sizeof(int));
+  memcpy(fill, index->cell_start, index->total_cells * sizeof(int));
+  index->point = malloc(n_points * sizeof(int));
+  index->x = malloc(n_points * dim * sizeof(double));
+  for (j = 0; j < n_points; j++) {
+    c = fill[cell_of_point[j]]++;
+    index->point[c] = j;
+    for (i = 0; i < dim; i++) {
+      index->x[c*dim + i] = argument[i][j];
+    }
+  }
+
+  free(fill);
+  free(cell_of_point);
+
+  return index;
+}
+
+int shepard_index_cell_coordinate(shepard_index_t *index, int i, double x_i) {
+
+  double s = floor((x_i - index->min[i])/index->h[i]);
+
+  if (s >= index->n_cells[i]-1) {
+    return index->n_cells[i]-1;
+  } else if (s >= 0) {
+    return (int)s;
+  }
+
+  return 0;
+}
+
+// distance along direction i from x_i to the cells at offset -R and +R from
+// the center one, or INFTY if both of them lie outside the grid
+static double shepard_index_gap(shepard_index_t *index, int i, double x_i, int center, int R) {
+
+  double gap = INFTY;
+  double face;
+
+  if (center+R < index->n_cells[i]) {
+    face = index->min[i] + (center+R)*index->h[i];
+    gap = (x_i < face) ? face-x_i : 0;
+  }
+  if (center-R >= 0) {
+    face = index->min[i] + (center-R+1)*index->h[i];
+    if (x_i > face && x_i-face < gap) {
+      gap = x_i-face;
+    } else if (x_i <= face) {
+      gap = 0;
+    }
+  }
+
+  return gap;
+}
+
+// finds the k nearest points to x sorted by increasing distance by visiting
+// rings of cells around the one x belongs to until no closer point can exist
+int shepard_index_knn(shepard_index_t *index, const double *x, int k, int *found, double *dist2) {
+
+  int dim = index->dim;
+  int center[dim];
+  int offset[dim];
+  int lo[dim];
+  int hi[dim];
+  int cell, on_surface;
+  int n, m, p, q, i;
+  int R;
+  double d2, diff, bound, gap;
+
+  if (k > index->n_points) {
+    k = index->n_points;
+  }
+
+  for (i = 0; i < dim; i++) {
+    center[i] = shepard_index_cell_coordinate(index, i, x[i]);
+  }
+
+  n = 0;
+  for (R = 0; ; R++) {
+
+    // odometer over the cells of the hypercube [-R,R]^dim that lie inside
+    // the grid, jumping over its interior along the first direction
+    for (i = 0; i < dim; i++) {
+      lo[i] = (center[i]-R < 0) ? -center[i] : -R;
+      hi[i] = (center[i]+R >= index->n_cells[i]) ? index->n_cells[i]-1-center[i] : R;
+      offset[i] = lo[i];
+    }
+    do {
+      on_surface = 0;
+      cell = 0;
+      for (i = dim-1; i >= 0; i--) {
+        if (abs(offset[i]) == R) {
+          on_surface = 1;
+        }
+        cell = cell*index->n_cells[i] + center[i]+offset[i];
+      }
+
+      if (on_surface) {
+        for (p = index->cell_start[cell]; p < index->cell_start[cell+1]; p++) {
+          d2 = 0;
+          for (i = 0; i < dim; i++) {
+            diff = x[i] - index->x[p*dim + i];
+            d2 += diff*diff;
+          }
+
+          // insertion into the sorted list of the best k so far
+          if (n < k || d2 < dist2[n-1]) {
+            m = (n < k) ? n++ : n-1;
+            while (m > 0 && dist2[m-1] > d2) {
+              dist2[m] = dist2[m-1];
+              found[m] = found[m-1];
+              m--;
+            }
+            dist2[m] = d2;
+            found[m] = index->point[p];
+          }
+        }
+      }
+
+      // if no other direction is on the surface go straight to +R
+      on_surface = 0;
+      for (i = 1; i < dim; i++) {
+        if (abs(offset[i]) == R) {
+          on_surface = 1;
+        }
+      }
+      if (on_surface == 0 && offset[0] == -R && hi[0] == R && R > 1) {
+        offset[0] = R-1;
+      }
+
+      for (q = 0; q < dim; q++) {
+        if (++offset[q] <= hi[q]) {
+          break;
+        }
+        offset[q] = lo[q];
+      }
+    } while (q < dim);
+
+    // every cell in the next ring is at least this far away
+    bound = INFTY;
+    for (i = 0; i < dim; i++) {
+      if ((gap = shepard_index_gap(index, i, x[i], center[i], R+1)) < bound) {
+        bound = gap;
+      }
+    }
+    if (bound == INFTY || (n == k && dist2[k-1] <= bound*bound)) {
+      break;
+    }
+  }
+
+  return n;
+}
+
+// normalized modified-shepard weights of the k nearest definition points
+static int shepard_knn_weights(function_t *function, const double *x, int *index, double *weight) {
+
+  int k = function->shepard_neighbors;
+  double dist2[k];
+  double d, R, den;
+  int n, j;
+
+  n = shepard_index_knn(function->shepard_index, x, k, index, dist2);
+
+  // the threshold is a distance and what we have are squared distances
+  if (dist2[0] < gsl_pow_2(function->multidim_threshold)) {
+    // nos pidieron un punto de la definicion
+    weight[0] = 1;
+    return 1;
+  }
+
+  // the radius is the distance to the farthest neighbor
+  R = sqrt(dist2[n-1]);
+  den = 0;
+  for (j = 0; j < n; j++) {
+    d = sqrt(dist2[j]);
+    weight[j] = pow((R-d)/(R*d), function->shepard_exponent);
+    den += weight[j];
+  }
+
+  // all the neighbors are equidistant, go back to plain inverse distance
+  if (den == 0) {
+    for (j = 0; j < n; j++) {
+      weight[j] = (function->shepard_exponent == 2) ? 1.0/dist2[j] : 1.0/pow(dist2[j], 0.5*function->shepard_exponent);
+      den += weight[j];
+    }
+  }
+
+  for (j = 0; j < n; j++) {
+    weight[j] /= den;
+  }
+
+  return n;
+}
+
+double wasora_function_shepard_knn(function_t *function, const double *x) {
+
+  shepard_cache_t *cache = NULL;
+  size_t key_size = function->n_arguments * sizeof(double);
+  int index[function->shepard_neighbors];
+  double weight[function->shepard_neighbors];
+  double y;
+  int n, j;
+
+  if (function->shepard_index == NULL) {
+    return 0;
+  }
+
+  if (function->shepard_cache_enabled) {
+    HASH_FIND(hh, function->shepard_cache, x, key_size, cache);
+    if (cache != NULL) {
+      // the hash keeps the insertion order, so moving a hit to the end
+      // leaves the least recently used point at the head
+      HASH_DELETE(hh, function->shepard_cache, cache);
+      HASH_ADD_KEYPTR(hh, function->shepard_cache, cache->x, key_size, cache);
+    }
+  }
+
+  if (cache == NULL) {
+    n = shepard_knn_weights(function, x, index, weight);
+
+    if (function->shepard_cache_enabled) {
+      // points that are not fixed (i.e. a moving evaluation point) would
+      // make the cache grow without bounds, so the oldest one goes away
+      if (HASH_COUNT(function->shepard_cache) >= DEFAULT_SHEPARD_CACHE_SIZE) {
+        cache = function->shepard_cache;
+        HASH_DELETE(hh, function->shepard_cache, cache);
+        free(cache->x);
+        free(cache->index);
+        free(cache->weight);
+        free(cache);
+      }
+      cache = calloc(1, sizeof(shepard_cache_t));
+      cache->x = malloc(key_size);
+      memcpy(cache->x, x, key_size);
+      cache->n = n;
+      cache->index = malloc(n * sizeof(int));
+      cache->weight = malloc(n * sizeof(double));
+      memcpy(cache->index, index, n * sizeof(int));
+      memcpy(cache->weight, weight, n * sizeof(double));
+      HASH_ADD_KEYPTR(hh, function->shepard_cache, cache->x, key_size, cache);
+    } else {
+      y = 0;
+      for (j = 0; j < n; j++) {
+        y += weight[j] * function->data_value[index[j]];
+      }
+      return y;
+    }
+  }
+
+  // only the data changes between evaluations so this is just a dot product
+  y = 0;
+  for (j = 0; j < cache->n; j++) {
+    y += cache->weight[j] * function->data_value[cache->index[j]];
+  }
+
+  return y;
+}
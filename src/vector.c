@@ -59,6 +59,7 @@ int wasora_vector_set(vector_t *vector, const size_t i, double value) {
   }
   
   gsl_vector_set(wasora_value_ptr(vector), i, value);
+  vector->version++;
   
   return 0;
 }
@@ -107,9 +108,16 @@ int wasora_vector_init(vector_t *vector) {
   }
   
   vector->size = size;
-  wasora_value_ptr(vector) = gsl_vector_calloc(size);
-  vector->initial_static = gsl_vector_calloc(size);
-  vector->initial_transient = gsl_vector_calloc(size);
+  if (vector->arena_reserved && wasora.arena.block != NULL) {
+    // wasora_arena_init() nos guardo un lugar (que ya esta en cero)
+    wasora_value_ptr(vector) = wasora_arena_gsl_vector(wasora.arena.value + vector->arena_offset, size);
+    vector->initial_static = wasora_arena_gsl_vector(wasora.arena.initial_static + vector->arena_offset, size);
+    vector->initial_transient = wasora_arena_gsl_vector(wasora.arena.initial_transient + vector->arena_offset, size);
+  } else {
+    wasora_value_ptr(vector) = gsl_vector_calloc(size);
+    vector->initial_static = gsl_vector_calloc(size);
+    vector->initial_transient = gsl_vector_calloc(size);
+  }
 
   if (vector->datas != NULL) {
     i = 0;
@@ -146,6 +154,35 @@ int wasora_instruction_vector_sort(void *arg) {
     if (vector_sort->v2 != NULL)
       gsl_vector_reverse(vector_sort->v2->value);
   }
+
+  vector_sort->v1->version++;
+  if (vector_sort->v2 != NULL) {
+    vector_sort->v2->version++;
+  }
   
   return WASORA_RUNTIME_OK;
 }
+
+
+int wasora_instruction_vector_axpy(void *arg) {
+
+  vector_axpy_t *axpy = (vector_axpy_t *)arg;
+  double alpha = (axpy->alpha.n_tokens != 0) ? wasora_evaluate_expression(&axpy->alpha) : 1.0;
+
+  if (!axpy->x->initialized) {
+    wasora_call(wasora_vector_init(axpy->x));
+  }
+  if (!axpy->y->initialized) {
+    wasora_call(wasora_vector_init(axpy->y));
+  }
+
+  if (axpy->x->size != axpy->y->size) {
+    wasora_push_error_message("vectors '%s' and '%s' have different sizes (%d and %d)", axpy->x->name, axpy->y->name, axpy->x->size, axpy->y->size);
+    return WASORA_RUNTIME_ERROR;
+  }
+
+  gsl_blas_daxpy(alpha, wasora_value_ptr(axpy->x), wasora_value_ptr(axpy->y));
+  wasora_check_initial_vector(axpy->y);
+
+  return WASORA_RUNTIME_OK;
+}
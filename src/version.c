@@ -49,6 +49,11 @@ void wasora_show_help(char *progname) {
  --plugin library       before reading the input file\n\n\
   -d, --debug           start in debug mode\n\
       --no-debug        ignore standard input, avoid debug mode\n\
+      --jit             compile expressions to native code with the system C compiler\n\
+      --profile         time instructions and functions and write a report at exit\n\
+      --memo[=file]     reuse the results of PARAMETRIC, FIT and MINIMIZE runs with the same\n\
+                        parameters, optionally persisting them to file across invocations\n\
+      --restart[=file]  continue a transient from the last CHECKPOINT (default inputfile.chk)\n\
   -l, --list            list defined symbols and exit\n\
   -h, --help            display this help and exit\n\
   -i, --info            display detailed code information and exit\n\
@@ -228,6 +233,9 @@ void wasora_longversion(void) {
  #elif IDA_VERSION == 3  
   printf("SUNDIALs version   : %s\n", SUNDIALS_VERSION);  
  #endif
+ #if HAVE_IDAS
+  printf("Sensitivities      : IDAS\n");
+ #endif
 #endif
 #if HAVE_READLINE
   printf("Readline version   : %s\n", rl_library_version);
@@ -49,6 +49,10 @@ int main(int argc, char **argv) {
     { "no-debug", no_argument,       NULL, 'n'},
     { "debug",    no_argument,       NULL, 'd'},
     { "list",     no_argument,       NULL, 'l'},
+    { "jit",      no_argument,       NULL, 'j'},
+    { "profile",  no_argument,       NULL, 'f'},
+    { "memo",     optional_argument, NULL, 'm'},
+    { "restart",  optional_argument, NULL, 'r'},
     { NULL, 0, NULL, 0 }
   };  
 
@@ -97,6 +101,24 @@ int main(int argc, char **argv) {
       case 'l':
         wasora.mode = mode_list_vars;
         break;
+      case 'j':
+        wasora.jit.enabled = 1;
+        break;
+      case 'f':
+        wasora.profile.enabled = 1;
+        break;
+      case 'm':
+        wasora.memo.enabled = 1;
+        if (optarg != NULL) {
+          wasora.memo.file_path = strdup(optarg);
+        }
+        break;
+      case 'r':
+        wasora.checkpoint.restart = 1;
+        if (optarg != NULL) {
+          wasora.checkpoint.restart_path = strdup(optarg);
+        }
+        break;
       case '?':
         break;
       default:
@@ -151,6 +173,8 @@ int main(int argc, char **argv) {
     exit(WASORA_PARSER_ERROR);
   }
  
+  wasora_profile_init();
+  
   // vemos como tenemos que correr
   if (show_version) {
     wasora_show_version(1);
@@ -184,17 +208,30 @@ int main(int argc, char **argv) {
 
 int wasora_standard_run(void) {
 
+  int memo_hit, restarted = 0;
 #ifdef HAVE_IDA
-  int err;
-  double ida_step_dt, ida_step_t_old, ida_step_t_new, t_old;
+  int err, on_time_path, event;
+  double ida_step_dt, ida_step_t_old, ida_step_t_new, t_old, t_out, t_path, ida_t;
 #endif
 
   wasora_call(wasora_init_before_run());
   
+  // si ya hicimos esta misma corrida nos traemos lo que dio y listo
+  wasora_call(wasora_memo_lookup(&memo_hit));
+  if (memo_hit) {
+    return WASORA_RUNTIME_OK;
+  }
+  
+  // si nos pidieron seguir desde un checkpoint vamos directo al transitorio
+  if (wasora.checkpoint.restart) {
+    wasora_call(wasora_checkpoint_restore());
+    restarted = 1;
+  }
+  
   // calculo estatico
   wasora_value(wasora_special_var(in_static)) = 1;
   wasora_value(wasora_special_var(in_static_first)) = 1;
-  while (!wasora_value(wasora_special_var(done)) && !wasora_value(wasora_special_var(done_static)) && (int)(wasora_var(wasora_special_var(step_static))) < rint(wasora_var(wasora_special_var(static_steps)))) {
+  while (!restarted && !wasora_value(wasora_special_var(done)) && !wasora_value(wasora_special_var(done_static)) && (int)(wasora_var(wasora_special_var(step_static))) < rint(wasora_var(wasora_special_var(static_steps)))) {
 
     wasora_debug();
 
@@ -227,6 +264,7 @@ int wasora_standard_run(void) {
   
 #ifdef HAVE_IDA
   ida_step_dt = INFTY;
+  ida_t = wasora_var(wasora_special_var(time));
 #endif
   
   // si hay realtime, inicializamos despues del calculo estationario por si tuvimos
@@ -237,7 +275,7 @@ int wasora_standard_run(void) {
   
   // loop  transitorio (si es necesario)
   wasora_value(wasora_special_var(in_transient)) = 1;
-  wasora_value(wasora_special_var(in_transient_first)) = 1;
+  wasora_value(wasora_special_var(in_transient_first)) = !restarted;
   while (wasora_var(wasora_special_var(done)) == 0) {
 
     wasora_debug();
@@ -278,6 +316,7 @@ int wasora_standard_run(void) {
 #ifdef HAVE_IDA
         
       wasora_call(wasora_step(STEP_BEFORE_DAE));
+      event = 0;
       // integration step
       // nos acordamos de cuanto valia el tiempo antes de avanzar un paso
       // para despues saber cuanto vale dt
@@ -288,8 +327,61 @@ int wasora_standard_run(void) {
         IDASetMaxStep(wasora_dae.system, wasora_var(wasora_special_var(max_dt)));
       }
 
-      // miramos si el dt actual (del paso interno de ida) es mas chiquito que min_dt
-      if (ida_step_dt < wasora_var(wasora_special_var(min_dt)) || (wasora_var(wasora_special_var(min_dt)) != 0 && wasora_var(wasora_special_var(time)) == 0)) {
+      if (wasora_var(wasora_special_var(output_dt)) != 0) {
+        
+        // dense output: ida avanza con los pasos que le pide la precision
+        // y el estado en el tiempo de salida lo interpolamos con IDAGetDky
+        if (wasora_var(wasora_special_var(min_dt)) != 0) {
+          wasora_push_error_message("both min_dt and output_dt given");
+          wasora_runtime_error();
+          return WASORA_RUNTIME_ERROR;
+        }
+        
+        t_out = t_old + wasora_var(wasora_special_var(output_dt));
+        if (t_out > wasora_var(wasora_special_var(end_time))) {
+          t_out = wasora_var(wasora_special_var(end_time));
+        }
+        // los puntos del TIME_PATH siguen siendo stop times (son discontinuidades)
+        // aunque caigan en un intervalo posterior, porque el ultimo paso interno
+        // de ida puede pasarse de t_out y no tiene que cruzar la discontinuidad
+        on_time_path = 0;
+        if (wasora.current_time_path != NULL && wasora.current_time_path->n_tokens != 0) {
+          t_path = wasora_evaluate_expression(wasora.current_time_path)+wasora_var(wasora_special_var(zero));
+          IDASetStopTime(wasora_dae.system, t_path);
+          if (t_path <= t_out) {
+            t_out = t_path;
+            on_time_path = 1;
+          }
+        }
+        
+        while (ida_t < t_out) {
+          ida_step_t_old = ida_t;
+          err = IDASolve(wasora_dae.system, t_out, &ida_t, wasora_dae.x, wasora_dae.dxdt, IDA_ONE_STEP);
+          if (err < 0) {
+            wasora_push_error_message("ida returned error code %d", err);
+            wasora_runtime_error();
+            return WASORA_RUNTIME_ERROR;
+          }
+          ida_step_dt = ida_t - ida_step_t_old;
+          if (err == IDA_ROOT_RETURN) {
+            // un evento antes del tiempo de salida, paramos ahi
+            t_out = ida_t;
+            on_time_path = 0;
+            event = 1;
+            break;
+          } else if (err == IDA_TSTOP_RETURN) {
+            break;
+          }
+        }
+        if (on_time_path) {
+          ++wasora.current_time_path;
+        }
+        
+        wasora_var(wasora_special_var(time)) = t_out;
+        wasora_call(wasora_dae_interpolate(t_out));
+        
+      } else if (ida_step_dt < wasora_var(wasora_special_var(min_dt)) || (wasora_var(wasora_special_var(min_dt)) != 0 && wasora_var(wasora_special_var(time)) == 0)) {
+        // miramos si el dt actual (del paso interno de ida) es mas chiquito que min_dt
 
         if (wasora.current_time_path != NULL && wasora.current_time_path->n_tokens != 0) {
           wasora_push_error_message("both min_dt and TIME_PATH given");
@@ -312,7 +404,8 @@ int wasora_standard_run(void) {
           }
           wasora_var(wasora_special_var(time)) = ida_step_t_new;
           ida_step_dt = ida_step_t_new - ida_step_t_old;
-        } while (err != IDA_TSTOP_RETURN);
+        } while (err != IDA_TSTOP_RETURN && err != IDA_ROOT_RETURN);
+        event = (err == IDA_ROOT_RETURN);
 
       } else {
 
@@ -338,6 +431,8 @@ int wasora_standard_run(void) {
           ; // ok!
         } else if (err == IDA_TSTOP_RETURN) {
           ++wasora.current_time_path;
+        } else if (err == IDA_ROOT_RETURN) {
+          event = 1;
         } else {
           wasora_push_error_message("ida returned error code %d", err);
           return WASORA_RUNTIME_ERROR;
@@ -350,8 +445,24 @@ int wasora_standard_run(void) {
         wasora_value(wasora_special_var(done_transient)) = 1;
       }
       
+      // las sensibilidades (si las hay) en el tiempo al que llego ida
+      // (con dense output ya las interpolamos junto con el estado)
+      // en un evento ademas ponemos el phase space exactamente en la raiz
+      if (wasora_var(wasora_special_var(output_dt)) == 0) {
+        if (event) {
+          wasora_call(wasora_dae_interpolate(wasora_var(wasora_special_var(time))));
+        } else {
+          wasora_call(wasora_dae_get_sensitivities());
+        }
+      }
+      
       wasora_call(wasora_step(STEP_AFTER_DAE));
       
+      // si hubo un evento arrancamos de nuevo desde lo que dejaron las instrucciones
+      if (event) {
+        wasora_call(wasora_dae_reinit());
+      }
+      
       // dormimos si hay que hacer realtime
       if (wasora_var(wasora.special_vars.realtime_scale) != 0) {
         wasora_wait_realtime();
@@ -362,9 +473,15 @@ int wasora_standard_run(void) {
     
     // listo! (bug encontrado por ramiro)
     wasora_value(wasora_special_var(in_transient_first)) = 0;
+    
+    // si algun CHECKPOINT lo pidio, guardamos el estado al final del paso
+    if (wasora.checkpoint.pending) {
+      wasora_call(wasora_checkpoint_write());
+    }
 
   }
   
+  wasora_call(wasora_memo_store());
   
   return WASORA_RUNTIME_OK;
 }
@@ -372,7 +489,7 @@ int wasora_standard_run(void) {
 
 
 int wasora_step(int whence) {
-  instruction_t *first, *last;
+  int first, last;
 
   // ponemos done en true si nos pasamos para que este disponible durante el step
   if ((int)(wasora_var(wasora_special_var(in_static)))) {
@@ -386,34 +503,28 @@ int wasora_step(int whence) {
     wasora_var(wasora_special_var(done)) = 1;
   }  
   
+  if (wasora.flat_instructions == NULL) {
+    wasora_call(wasora_instructions_flatten());
+  }
+  
   switch (whence) {
     case STEP_BEFORE_DAE:
-      first = wasora.instructions;
-      last = wasora_dae.instruction;
+      first = 0;
+      last = wasora_dae.instruction->index;
     break;
     case STEP_AFTER_DAE:
-      first = wasora_dae.instruction;
-      last = NULL;
+      first = wasora_dae.instruction->index;
+      last = wasora.n_flat_instructions;
     break;
     default:
-      first = wasora.instructions;
-      last = NULL;
+      first = 0;
+      last = wasora.n_flat_instructions;
     break;
   }
 
-  // barremos la lista en los extremos que nos dijeron
-  // pero siguiendo la logica de condicionales
-  wasora.ip = first;
-  while (wasora.ip != last) {
-    wasora_call(wasora.ip->routine(wasora.ip->argument));
-
-    if (wasora.next_flow_instruction != NULL) {
-      wasora.ip = wasora.next_flow_instruction;
-      wasora.next_flow_instruction = NULL;
-    } else {
-      wasora.ip = wasora.ip->next;
-    }
-  }
+  // barremos el arreglo en los extremos que nos dijeron
+  // pero siguiendo los saltos de los condicionales
+  wasora_call(wasora_instructions_run(first, last));
 
 
   // volvemos a poner done en true por si algun salame puso done = 0 por alguna otra razon
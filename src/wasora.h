@@ -63,16 +63,29 @@
 
 
 #ifdef HAVE_IDA
- #include <ida/ida.h>
+ // idas is a superset of ida that also integrates forward sensitivities
+ #ifdef HAVE_IDAS
+  #include <idas/idas.h>
+ #else
+  #include <ida/ida.h>
+ #endif
  #include <nvector/nvector_serial.h>
  #include <sundials/sundials_types.h>
  #include <sundials/sundials_math.h>
  #if IDA_VERSION == 2
-  #include <ida/ida_dense.h>
+  #ifdef HAVE_IDAS
+   #include <idas/idas_dense.h>
+  #else
+   #include <ida/ida_dense.h>
+  #endif
  #elif IDA_VERSION == 3
   #include <sunmatrix/sunmatrix_dense.h> /* access to dense SUNMatrix            */
   #include <sunlinsol/sunlinsol_dense.h> /* access to dense SUNLinearSolver      */
-  #include <ida/ida_direct.h>            /* access to IDADls interface           */
+  #ifdef HAVE_IDAS
+   #include <idas/idas_direct.h>         /* access to IDADls interface           */
+  #else
+   #include <ida/ida_direct.h>           /* access to IDADls interface           */
+  #endif
  #endif
 #endif
 
@@ -150,6 +163,8 @@ extern const char factorseparators[];
 
 #define DEFAULT_INTERPOLATION              (*gsl_interp_linear)
 
+#define DEFAULT_HISTORY_SIZE               256
+
 #define DEFAULT_RANDOM_METHOD              gsl_rng_knuthran2002
 
 #define DEFAULT_NLIN_FIT_METHOD            gsl_multifit_fdfsolver_lmsder
@@ -157,6 +172,8 @@ extern const char factorseparators[];
 #define DEFAULT_NLIN_FIT_EPSREL            1e-4
 #define DEFAULT_NLIN_FIT_EPSABS            1e-6
 #define DEFAULT_NLIN_FIT_GRAD_H            1e-2
+#define DEFAULT_NLIN_FIT_GRAD_H_MIN        1e-8
+#define DEFAULT_NLIN_FIT_GRAD_H_MAX        1e-1
 
 #define DEFAULT_SOLVE_METHOD               gsl_multiroot_fsolver_dnewton
 #define DEFAULT_SOLVE_EPSREL               0   // cero quiere decir que no mire deltas en derivadas
@@ -172,6 +189,7 @@ extern const char factorseparators[];
 #define DEFAULT_MINIMIZER_F_STEP           1
 #define DEFAULT_MINIMIZER_FDF_STEP         1e-2
 #define DEFAULT_MINIMIZER_GRAD_H           1e-2
+#define DEFAULT_MINIMIZER_BASIN_RADIUS     5e-2
 
 
 #define DEFAULT_ROOT_MAX_TER               1024
@@ -183,9 +201,14 @@ extern const char factorseparators[];
 
 #define DEFAULT_DERIVATIVE_STEP            (9.765625e-4)         // (1/2)^-10
 
+#define DEFAULT_JIT_COMPILER               "cc"
+#define DEFAULT_JIT_CFLAGS                 "-O2 -fPIC -shared"
+
 #define DEFAULT_MULTIDIM_INTERPOLATION_THRESHOLD   9.5367431640625e-07 // (1/2)^-20
 #define DEFAULT_SHEPARD_RADIUS                     1.0
 #define DEFAULT_SHEPARD_EXPONENT                   2
+#define DEFAULT_SHEPARD_NEIGHBORS                  8
+#define DEFAULT_SHEPARD_CACHE_SIZE                 65536
 
 #define MINMAX_ARGS       10
 
@@ -211,9 +234,14 @@ typedef struct matrix_t matrix_t;
 typedef struct alias_t alias_t;
 
 typedef struct vector_sort_t vector_sort_t;
+typedef struct vector_axpy_t vector_axpy_t;
+typedef struct matrix_multiply_t matrix_multiply_t;
+typedef struct matrix_transpose_t matrix_transpose_t;
+typedef struct matrix_solve_t matrix_solve_t;
 
 typedef struct phase_object_t phase_object_t;
 typedef struct dae_t dae_t;
+typedef struct event_t event_t;
 
 typedef struct file_t file_t;
 typedef struct loadable_routine_t loadable_routine_t;
@@ -222,11 +250,16 @@ typedef struct expr_t expr_t;
 typedef struct factor_t factor_t;
 
 typedef struct function_t function_t;
+typedef struct shepard_index_t shepard_index_t;
+typedef struct shepard_cache_t shepard_cache_t;
 
 typedef struct instruction_t instruction_t;
+typedef struct flat_instruction_t flat_instruction_t;
+typedef struct profile_entry_t profile_entry_t;
 typedef struct conditional_block_t conditional_block_t;
 
 typedef struct history_t history_t;
+typedef struct checkpoint_t checkpoint_t;
 typedef struct io_t io_t;
 typedef struct io_thing_t io_thing_t;
 typedef struct assignment_t assignment_t;
@@ -263,6 +296,9 @@ struct expr_t {
   // por si acaso nos guardamos el string
   char *string;
 
+  // si se compilo a codigo nativo (--jit) esta es la funcion que la evalua
+  double (*jit)(void);
+
   expr_t *next;
 };
 
@@ -304,9 +340,16 @@ struct vector_t {
   gsl_vector *initial_transient;
   gsl_vector *initial_static;
 
+  // se incrementa cada vez que alguna instruccion escribe el vector
+  unsigned int version;
+
   // flag para saber si el apuntador de arriba lo alocamos nosotros o alguien mas
   int realloced;
   
+  // lugar reservado en la arena para cuando se inicialice
+  int arena_reserved;
+  size_t arena_offset;
+  
   // funcion para sacarle los datos
   function_t *function_data;
   function_t *function_arg;
@@ -373,6 +416,54 @@ struct vector_sort_t {
   vector_t *v1;
   vector_t *v2;
 };
+
+// y = alpha*x + y
+struct vector_axpy_t {
+  vector_t *y;
+  vector_t *x;
+  expr_t alpha;
+};
+
+// C = alpha*op(A)*op(B) + beta*C, con B y C vectores o matrices
+struct matrix_multiply_t {
+  matrix_t *A;
+  matrix_t *B;
+  vector_t *x;
+  matrix_t *C;
+  vector_t *y;
+  
+  int transpose_A;
+  int transpose_B;
+  
+  expr_t alpha;
+  expr_t beta;
+  
+  // por si el resultado es uno de los factores
+  gsl_matrix *tmp_matrix;
+  gsl_vector *tmp_vector;
+};
+
+struct matrix_transpose_t {
+  matrix_t *A;
+  matrix_t *result;
+};
+
+// A*x = b por LU o cholesky
+struct matrix_solve_t {
+  matrix_t *A;
+  vector_t *b;
+  vector_t *x;
+  
+  enum {
+    matrix_solve_lu,
+    matrix_solve_cholesky
+  } method;
+  
+  // la factorizacion, que si A es constante se hace una sola vez
+  gsl_matrix *factor;
+  gsl_permutation *permutation;
+  int factorized;
+};
   
   
 // -- function ------------ -----        ----           --     -
@@ -440,6 +531,15 @@ struct function_t {
   expr_t *expr_rectangular_mesh_size;
   int *rectangular_mesh_size;
   double **rectangular_mesh_point;
+  // paso entre indices de cada direccion y delta constante (o cero si la
+  // direccion no es uniforme) para ir directo al intervalo sin biseccionar
+  int *rectangular_mesh_stride;
+  double *rectangular_mesh_delta;
+  // valores y derivadas (parciales y cruzadas) en cada punto de la malla rectangular
+  // para interpolar con hermite cubicas, 2^n coeficientes contiguos por punto
+  double *rectangular_mesh_coef;
+  // con que versiones de los vectores, paso y tiempo se calcularon los coeficientes
+  double rectangular_mesh_stamp[6];
 
   // archivo con los datos point-wise
   char *data_file;
@@ -463,7 +563,10 @@ struct function_t {
     nearest,
     shepard,
     shepard_kd,
-    bilinear
+    bilinear,
+    rectangular_spline,
+    rectangular_steffen,
+    shepard_knn
   } multidim_interp;
 
   
@@ -473,6 +576,16 @@ struct function_t {
   double shepard_radius;
   expr_t expr_shepard_exponent;
   double shepard_exponent;
+  expr_t expr_shepard_neighbors;
+  int shepard_neighbors;
+  
+  // indice espacial y cache de vecinos y pesos por punto de evaluacion para shepard_knn
+  shepard_index_t *shepard_index;
+  int shepard_cache_enabled;
+  shepard_cache_t *shepard_cache;
+
+  // entrada del profiler (--profile)
+  profile_entry_t *profile;
 
   // propiedad
   void *property;
@@ -496,6 +609,32 @@ struct function_t {
   UT_hash_handle hh;
 };
 
+
+// grilla uniforme de celdas con los puntos de definicion ordenados por celda
+struct shepard_index_t {
+  int dim;
+  int n_points;
+  int *n_cells;       // celdas en cada direccion
+  int total_cells;
+  double *min;        // esquina de la caja que contiene a los puntos
+  double *h;          // ancho de las celdas en cada direccion
+  double h_min;
+  
+  int *cell_start;    // los puntos de la celda c van de cell_start[c] a cell_start[c+1]-1
+  int *point;         // indice original de cada punto
+  double *x;          // coordenadas de cada punto, contiguas
+};
+
+// vecinos y pesos normalizados de un punto de evaluacion (que es la clave del hash)
+struct shepard_cache_t {
+  double *x;
+  int n;
+  int *index;
+  double *weight;
+  
+  UT_hash_handle hh;
+};
+
 // archivo (puede se de entrada o de salida)
 struct file_t {
   char *name;
@@ -574,12 +713,38 @@ struct history_t {
   
   var_t *variable;
   function_t *function;
-  int position;
+
+  expr_t expr_window;
+  expr_t expr_max_points;
+  double window;        // points older than this are dropped (zero means keep them all)
+  int max;              // and there cannot be more than these (zero means no limit)
+
+  // ring buffer, the oldest of the n points is at head
+  double *time;
+  double *value;
+  int size;
+  int head;
+  int n;
+  int last_hit;         // interval of the last lookup, as an index from the oldest point
 
   history_t *next;
 };
 
 
+// -- checkpoint ------------ -----        ----           --     -
+
+// instruccion que pide guardar el estado al final del paso
+struct checkpoint_t {
+  expr_t skip_step;
+  expr_t skip_time;
+  
+  int last_step;
+  double last_time;
+  
+  checkpoint_t *next;
+};
+
+
 
 // -- bloques condicionales ------ -       ----           --     -
 struct conditional_block_t {
@@ -603,9 +768,42 @@ struct instruction_t {
   void *argument;
   int argument_alloced;
 
+  // posicion en el arreglo aplanado
+  int index;
+
+  // donde se definio en el input y su entrada del profiler (--profile)
+  char *file;
+  int line;
+  profile_entry_t *profile;
+
   instruction_t *next;
 };
 
+// tiempo y cantidad de llamadas de una instruccion, funcion, etc (--profile)
+struct profile_entry_t {
+  const char *kind;
+  char *label;
+  
+  unsigned long count;
+  double total;      // incluyendo lo que se llama desde adentro
+  double self;       // sin incluirlo
+  
+  UT_hash_handle hh;
+};
+
+// las instrucciones aplanadas en un arreglo contiguo con los saltos de
+// los IF/ELSE/ENDIF ya resueltos a indices dentro del arreglo
+struct flat_instruction_t {
+  int (*routine)(void *);   // NULL quiere decir salto incondicional a jump_false
+  void *argument;
+  conditional_block_t *conditional_block;  // distinto de NULL solo para los IF
+
+  int jump_true;
+  int jump_false;
+
+  instruction_t *instruction;
+};
+
 // -- acoples ------------ -----        ----           --     -
 
 // semaforo 
@@ -777,6 +975,10 @@ struct  assignment_t {
   // A(8,j) = 1 es un assignment que depende solo de j
   int expression_only_of_j;
   
+  // las otras asignaciones sobre el mismo vector o matriz (se llena la primera
+  // vez que se ejecuta) asi no tenemos que recorrerlas todas en cada elemento
+  assignment_t **others;
+  int n_others;
   
   assignment_t *next;
 
@@ -944,6 +1146,8 @@ struct solve_t {
   int verbose;
 
   const gsl_multiroot_fsolver_type *type;
+  // el equivalente con jacobiano, que usamos si los residuos se pueden derivar
+  const gsl_multiroot_fdfsolver_type *fdf_type;
   
   solve_t *next;  
 };
@@ -997,6 +1201,9 @@ typedef struct {
   int norerun;
   int verbose;
   
+  // flag que indica si podemos derivar la funcion con numeros duales
+  int dual;
+  
   // cantidad de parametros (i.e. a y b -> 2)
   int p;
   // cantidad de datos experimentales a ajustar (i.e. del orden de 1000)
@@ -1026,6 +1233,17 @@ typedef struct {
   expr_t deltaepsabs;
   expr_t deltaepsrel;
   
+  // corridas perturbadas en paralelo para el gradiente numerico
+  int max_daughters;
+  // paso relativo de cada parametro, que se va adaptando
+  double *h;
+  // valores del modelo en los puntos de los datos y parametros con los que se calcularon
+  double *model;
+  double *model_param;
+  
+  // integrar las sensibilidades del phase space junto con el transitorio
+  int sensitivities;
+  
 } fit_t;
 
 
@@ -1035,6 +1253,9 @@ typedef struct {
   int norerun;
   int verbose;
   
+  // flag que indica si podemos derivar la funcion con numeros duales
+  int dual;
+  
   // dimension de la optimizacion (ej. n = 2)
   int n;
 
@@ -1079,6 +1300,17 @@ typedef struct {
   expr_t max_iter;
   expr_t tol;
   expr_t gradtol;
+  
+  // integrar las sensibilidades del phase space junto con el transitorio
+  // y los argumentos con los que se corrio la ultima vez
+  int sensitivities;
+  double *x_run;
+  
+  // busqueda global con varios puntos de arranque cuasi-aleatorios
+  expr_t multistart;
+  expr_t basin_radius;
+  const gsl_qrng_type *multistart_type;
+  int max_daughters;
 } min_t;
 
 // plugin dinamico
@@ -1127,6 +1359,7 @@ typedef struct {
 
   int rank;
   int nprocs;
+  int mute_output;
   parametric_t parametric;
   fit_t fit;
   min_t min;
@@ -1157,6 +1390,9 @@ typedef struct {
   conditional_block_t *conditional_blocks;
   instruction_t *instructions;
   instruction_t *last_defined_instruction;
+  
+  flat_instruction_t *flat_instructions;
+  int n_flat_instructions;
 
   struct {
     var_t *done_static;
@@ -1187,6 +1423,7 @@ typedef struct {
     var_t *rel_error;
     var_t *min_dt;
     var_t *max_dt;
+    var_t *output_dt;
   
     var_t *i;
     var_t *j;
@@ -1223,6 +1460,53 @@ typedef struct {
   } mode;
   expr_t cond_breakpoint;
 
+  // planos contiguos con los valores de todos los simbolos
+  struct {
+    size_t size;
+    double *block;
+    double *value;
+    double *initial_static;
+    double *initial_transient;
+  } arena;
+
+  // profiler (--profile)
+  struct {
+    int enabled;
+    profile_entry_t *entries;
+  } profile;
+  
+  // donde estamos parseando, para etiquetar las instrucciones
+  char *parsing_file;
+  int parsing_line;
+
+  // snapshots del estado de un transitorio (CHECKPOINT y --restart)
+  struct {
+    char *file_path;
+    char *restart_path;
+    int restart;
+    int pending;
+    int writer;
+    checkpoint_t *checkpoints;
+    
+    // tokens de funciones con estado (lag, integral_dt, random, etc)
+    factor_t **stateful;
+    int n_stateful;
+  } checkpoint;
+
+  // resultados de corridas enteras indexados por los parametros (--memo)
+  struct {
+    int enabled;
+    char *file_path;
+  } memo;
+  
+  // compilacion de las expresiones a codigo nativo
+  struct {
+    int enabled;
+    void *handle;
+    void **table;
+    int n_table;
+  } jit;
+
   // instruction pointer
   instruction_t *ip;
   instruction_t *next_flow_instruction;
@@ -1276,6 +1560,11 @@ struct phase_object_t {
   matrix_t *matrix;
   matrix_t *matrix_dot;
 
+  // derivadas con respecto a cada uno de los parametros de las sensibilidades
+  var_t **variable_sensitivity;
+  vector_t **vector_sensitivity;
+  matrix_t **matrix_sensitivity;
+
   phase_object_t *next;
 };
 
@@ -1300,6 +1589,14 @@ struct dae_t {
   dae_t *next;
 };
 
+// expresion cuyos ceros tiene que encontrar IDA
+struct event_t {
+  expr_t condition;
+  int direction;      // +1 rising, -1 falling, 0 both
+  
+  event_t *next;
+};
+
 struct {
   int dimension;
   // arreglo de apuntadores a los current y a las derivadas de los
@@ -1311,6 +1608,10 @@ struct {
   // linked list con las ecuaciones de los residuos
   dae_t *daes;
 
+  // linked list con los eventos (zero crossings) a detectar
+  event_t *events;
+  int n_events;
+
   void *system;
 
   enum {
@@ -1322,6 +1623,22 @@ struct {
   int reading_daes;
   instruction_t *instruction;
 
+  // forward sensitivities with respect to the FIT or MINIMIZE parameters
+  // phase_sensitivity[j*dimension + k] points to d(phase_k)/d(parameter_j)
+  int n_sensitivities;
+  var_t **sensitivity_parameter;
+  double **phase_sensitivity;
+  
+  // time history of the sensitivities of one phase-space variable (the one
+  // whose HISTORY is being fitted), value[j][step] for parameter j
+  struct {
+    phase_object_t *phase_object;
+    int size;
+    int n;
+    double *time;
+    double **value;
+  } sensitivity_history;
+
 // ojo que el tamanio de esta estructura depende de si esta
 // definido HAVE_IDA o no (ojo plugins!)
 #if HAVE_IDA
@@ -1333,6 +1650,10 @@ struct {
   SUNMatrix A;
   SUNLinearSolver LS;
  #endif 
+ #if HAVE_IDAS
+  N_Vector *yS;
+  N_Vector *ypS;
+ #endif
 #endif
 
 } wasora_dae;
@@ -1383,16 +1704,27 @@ extern int wasora_parse_expression(const char *, struct expr_t *);
 extern int wasora_parse_madeup_expression(char *, struct factor_t *);
 extern int wasora_parse_factor(char *, struct factor_t *);
 
+extern double wasora_evaluate_factor(struct factor_t *);
 extern double wasora_evaluate_expression(struct expr_t *);
 extern double wasora_evaluate_expression_in_string(const char *);
 
 extern int wasora_count_divisions(expr_t *);
 
+// arena.c
+extern int wasora_arena_init(void);
+extern int wasora_arena_contains(const double *ptr);
+extern void wasora_arena_free(double *ptr);
+extern gsl_vector *wasora_arena_gsl_vector(double *data, size_t size);
+extern void wasora_arena_save(double *buffer);
+extern void wasora_arena_restore(const double *buffer);
+extern void wasora_arena_finalize(void);
+
 // assignment.c 
 extern void wasora_check_initial_variable(struct var_t *);
 extern void wasora_check_initial_vector(struct vector_t *);
 extern void wasora_check_initial_matrix(struct matrix_t *);
 extern int wasora_assign_scalar(struct assignment_t *, int, int);
+extern int wasora_assign_array(assignment_t *, int, int, int, int);
 extern struct var_t *wasora_get_assignment_variable(struct assignment_t *, int, int);
 extern int wasora_get_assignment_array_boundaries(assignment_t *, int *, int *, int *, int *);
 extern int wasora_get_assignment_rowcol(assignment_t *, int, int, int *, int *);
@@ -1400,11 +1732,28 @@ extern int wasora_get_assignment_rowcol(assignment_t *, int, int, int *, int *);
 
 // builtinfunctionals.c 
 extern double wasora_gsl_function(double, void *);
+extern void wasora_free_functional_aux(factor_t *);
 
 // builtinvectorfunctions 
 
+// cache.c
+extern unsigned long wasora_cache_hash(const void *data, size_t length, unsigned long hash);
+extern unsigned long wasora_cache_input_key(void);
+extern char *wasora_cache_dir(const char *variable);
+extern int wasora_memo_lookup(int *hit);
+extern int wasora_memo_store(void);
+extern void wasora_memo_finalize(void);
+
 // call.c 
 
+// checkpoint.c
+extern void wasora_checkpoint_register_factor(factor_t *factor);
+extern void wasora_checkpoint_unregister_factor(factor_t *factor);
+extern int wasora_checkpoint_wait(void);
+extern int wasora_checkpoint_write(void);
+extern int wasora_checkpoint_restore(void);
+extern void wasora_checkpoint_finalize(void);
+
 // cleanup.c 
 extern void wasora_polite_exit(int);
 extern void wasora_free_shm(void);
@@ -1444,8 +1793,23 @@ extern char *wasora_get_nth_token(char *, int);
 // dae.c 
 extern int wasora_dae_init(void);
 extern int wasora_dae_ic(void);
+extern int wasora_dae_get_sensitivities(void);
+extern int wasora_dae_interpolate(double t);
+extern int wasora_dae_reinit(void);
+extern double wasora_dae_sensitivity_history(int j, double t);
+extern void wasora_dae_free_sensitivities(void);
 #if HAVE_IDA
 extern int wasora_ida_dae(realtype, N_Vector, N_Vector, N_Vector, void *);
+extern int wasora_ida_dae_root(realtype, N_Vector, N_Vector, realtype *, void *);
+extern int wasora_dae_dual_jacobian(double cj, double *jac);
+ #if IDA_VERSION == 2
+extern int wasora_ida_dae_jacobian(long int, realtype, realtype, N_Vector, N_Vector, N_Vector, DlsMat, void *, N_Vector, N_Vector, N_Vector);
+ #elif IDA_VERSION == 3
+extern int wasora_ida_dae_jacobian(realtype, realtype, N_Vector, N_Vector, N_Vector, SUNMatrix, void *, N_Vector, N_Vector, N_Vector);
+ #endif
+ #if HAVE_IDAS
+extern int wasora_ida_dae_sensitivity(int, realtype, N_Vector, N_Vector, N_Vector, N_Vector *, N_Vector *, N_Vector *, void *, N_Vector, N_Vector, N_Vector);
+ #endif
 #else
 extern int wasora_ida_dae(void);
 #endif
@@ -1457,6 +1821,9 @@ extern char **wasora_rl_completion(const char *, int, int);
 extern char *wasora_rl_symbol_generator(const char *, int);
 extern void wasora_list_symbols(void);
 
+// dual.c
+extern int wasora_evaluate_expression_dual(expr_t *expr, int n, double **wrt, double *value, double *derivative);
+
 // dyncall.c 
 typedef double (*user_func_t)(const double*);
 extern user_func_t set_dyn_call_so(const char *, const char *);
@@ -1473,6 +1840,7 @@ extern void wasora_gsl_handler (const char *, const char *, int, int);
 // file.c 
 extern char *wasora_evaluate_string(char *, int, expr_t *);
 extern FILE *wasora_fopen(const char *, const char *);
+extern int wasora_mute_output(void);
 
 
 // fit.c 
@@ -1481,6 +1849,8 @@ extern void wasora_fit_read_params_from_solver(const gsl_vector *);
 extern int wasora_fit_compute_f(gsl_vector *);
 extern void wasora_fit_compute_analytical_df(gsl_matrix *);
 extern int wasora_fit_compute_numerical_df(gsl_matrix *);
+extern int wasora_fit_compute_dual_df(gsl_matrix *);
+extern int wasora_fit_compute_sensitivity_df(gsl_matrix *);
 extern int wasora_gsl_fit_f(const gsl_vector *m, void *, gsl_vector *);
 extern int wasora_gsl_fit_df(const gsl_vector *, void *, gsl_matrix *);
 extern int wasora_gsl_fit_fdf(const gsl_vector *, void *, gsl_vector *, gsl_matrix *);
@@ -1492,6 +1862,7 @@ extern double wasora_evaluate_factor_function(struct factor_t *);
 extern int wasora_function_init(function_t *);
 extern double wasora_evaluate_function(function_t *, const double *);
 extern int wasora_structured_scalar_index(int, int *, int *, int);
+extern int wasora_function_init_rectangular_cubic(function_t *);
 
 extern double mesh_interpolate_function_node_dummy(function_t *, const double *);
 extern double mesh_interpolate_function_cell_dummy(function_t *, const double *);
@@ -1522,6 +1893,9 @@ extern void wasora_signal_handler(int);
 
 // history.c 
 extern void wasora_init_history(history_t *);
+extern double wasora_history_evaluate(const double *, function_t *);
+extern void wasora_history_get(history_t *, double *, double *);
+extern void wasora_history_set(history_t *, int, const double *, const double *);
 
 // init.c 
 extern int wasora_init_before_parser(void);
@@ -1530,6 +1904,10 @@ extern int wasora_init_before_run(void);
 extern int wasora_is_structured_grid_2d(double *, double *, int, int *, int *);
 extern int wasora_is_structured_grid_3d(double *, double *, double *, int, int *, int *, int *);
 
+// jit.c
+extern int wasora_jit_init(void);
+extern void wasora_jit_finalize(void);
+
 // io.c 
 extern int wasora_io_init(io_t *);
 extern int wasora_io_read_shm(io_t *, double *, int);
@@ -1545,25 +1923,32 @@ extern double wasora_matrix_get(matrix_t *, const size_t, const size_t);
 extern double wasora_matrix_get_initial_transient(matrix_t *, const size_t,  const size_t);
 extern double wasora_matrix_get_initial_static(matrix_t *, const size_t,  const size_t);
 extern int wasora_matrix_init(matrix_t *);
+extern int wasora_instruction_matrix_multiply(void *);
+extern int wasora_instruction_matrix_transpose(void *);
+extern int wasora_instruction_matrix_solve(void *);
 
 // minimize.c 
 extern int wasora_min_run();
 extern void wasora_min_read_params_from_solver(const gsl_vector *) ;
 extern double wasora_min_compute_f(const double *);
+extern int wasora_min_compute_dual_df(const double *, gsl_vector *);
+extern int wasora_min_compute_sensitivity_df(const double *, gsl_vector *);
 extern double wasora_gsl_min_f(const gsl_vector *, void *);
 extern void wasora_gsl_min_df(const gsl_vector *, void *, gsl_vector *);
 extern void wasora_gsl_min_fdf(const gsl_vector *, void *, double *, gsl_vector *);
 
 // multiminf.c 
-void wasora_min_multiminf(gsl_vector *);
+double wasora_min_multiminf(gsl_vector *);
 extern void wasora_multiminf_print_state(int, gsl_multimin_fminimizer *);
 
 // multiminfdf.c 
-void wasora_min_multiminfdf(gsl_vector *);
+double wasora_min_multiminfdf(gsl_vector *);
 extern void wasora_multiminfdf_print_state(int, gsl_multimin_fdfminimizer *);
 
 // multirootc
 extern int wasora_gsl_solve_f(const gsl_vector *x, void *params, gsl_vector *f);
+extern int wasora_gsl_solve_df(const gsl_vector *x, void *params, gsl_matrix *J);
+extern int wasora_gsl_solve_fdf(const gsl_vector *x, void *params, gsl_vector *f, gsl_matrix *J);
 
 // parametric.c 
 extern int wasora_parametric_run();
@@ -1586,6 +1971,8 @@ extern int wasora_parser_function(function_t **);
 extern int wasora_parser_vector(vector_t **);
 extern int wasora_parser_variable(var_t **);
 extern int wasora_parser_keywords_ints(char *[], int *, int *);
+extern int wasora_parser_read_keywords_voids(char *[], void *[], void **);
+extern int wasora_parser_sensitivities(int, var_t **);
 extern int wasora_parse_assignment(char *, assignment_t *);
 
 extern void wasora_realloc_variable_ptr(var_t *, double *, int);
@@ -1631,6 +2018,15 @@ extern int wasora_dlopen_try(const char *, const char *, const char *, void **);
 
 // print.c
 
+// profile.c
+extern int wasora_profile_init(void);
+extern profile_entry_t *wasora_profile_entry(const char *kind, const char *label);
+extern profile_entry_t *wasora_profile_instruction_entry(instruction_t *instruction);
+extern profile_entry_t *wasora_profile_function_entry(function_t *function);
+extern void wasora_profile_push(profile_entry_t *entry);
+extern void wasora_profile_pop(void);
+extern int wasora_profile_report(void);
+
 // randomline.c
 extern void wasora_print_random_line(FILE *, int);
 
@@ -1641,6 +2037,12 @@ extern void wasora_wait_realtime(void);
 // shell.c
 
 
+// shepard.c
+extern shepard_index_t *shepard_index_create(int dim, size_t n_points, double **argument);
+extern int shepard_index_cell_coordinate(shepard_index_t *index, int i, double x_i);
+extern int shepard_index_knn(shepard_index_t *index, const double *x, int k, int *found, double *dist2);
+extern double wasora_function_shepard_knn(function_t *function, const double *x);
+
 // shmem.c
 extern void *wasora_get_shared_pointer(char *, size_t);
 extern void wasora_free_shared_pointer(void *, char *, size_t);
@@ -1666,6 +2068,7 @@ extern double wasora_vector_get_initial_static(vector_t *, const size_t);
 extern int wasora_vector_set(vector_t *, const size_t, double);
 extern int wasora_vector_init(vector_t *);
 extern int wasora_instruction_vector_sort(void *);
+extern int wasora_instruction_vector_axpy(void *);
 
 // version.c
 extern void wasora_show_help();
@@ -1677,6 +2080,11 @@ extern void wasora_longversion(void);
 // str_replace.c
 char *str_replace (const char *, const char *, const char *);
 
+// flow.c
+extern int wasora_instructions_flatten(void);
+extern int wasora_instructions_run(int first, int last);
+extern int wasora_instructions_replay_output(void);
+
 // instructions
 extern int wasora_instruction_if(void *);
 extern int wasora_instruction_else(void *);
@@ -1688,6 +2096,7 @@ extern int wasora_instruction_alias(void *);
 extern int wasora_instruction_sem(void *);
 extern int wasora_instruction_io(void *);
 extern int wasora_instruction_history(void *);
+extern int wasora_instruction_checkpoint(void *);
 extern int wasora_instruction_print(void *);
 extern int wasora_instruction_print_function(void *);
 extern int wasora_instruction_print_vector(void *);
@@ -1707,6 +2116,7 @@ extern int wasora_instruction_mesh_post(void *);
 extern int wasora_instruction_mesh_fill_vector(void *);
 extern int wasora_instruction_mesh_find_minmax(void *);
 extern int wasora_instruction_mesh_integrate(void *arg);
+extern int wasora_instruction_mesh_transfer(void *arg);
 
 
 // interface.h
@@ -1776,9 +2186,11 @@ typedef struct material_t material_t;
 typedef struct material_list_item_t material_list_item_t;
 typedef struct mesh_post_t mesh_post_t;
 typedef struct mesh_post_dist_t mesh_post_dist_t;
+typedef struct mesh_vtu_t mesh_vtu_t;
 typedef struct mesh_fill_vector_t mesh_fill_vector_t;
 typedef struct mesh_find_minmax_t mesh_find_minmax_t;
 typedef struct mesh_integrate_t mesh_integrate_t;
+typedef struct mesh_transfer_t mesh_transfer_t;
 
 // es esta mas arriba porque se necesita en print_function
 //typedef struct physical_entity_t physical_entity_t;
@@ -1825,6 +2237,10 @@ typedef enum {
 #define ELEMENT_TYPE_PRISM15        18
 #define NUMBER_ELEMENT_TYPE         19
 
+// sizes for stack arrays holding per-element shape function data
+#define MESH_MAX_NODES_PER_ELEMENT  27
+#define MESH_MAX_DIM                 3
+
 //#define GAUSS_POINTS_FULL      0
 //#define GAUSS_POINTS_REDUCED   1
 
@@ -1909,6 +2325,7 @@ struct {
   mesh_fill_vector_t *fill_vectors;
   mesh_find_minmax_t *find_minmaxs;
   mesh_integrate_t *integrates;
+  mesh_transfer_t *transfers;
 
 } wasora_mesh;
 
@@ -1970,6 +2387,11 @@ struct element_type_t {
   // apuntadores a funciones de forma y sus derivadas
   double (*h)(int, double *);
   double (*dhdr)(int, int, double *);
+  
+  // all the shape functions (or all their derivatives, as dhdr[j*dim+m]) at once
+  // into arrays provided by the caller
+  void (*h_all)(const double *, double *);
+  void (*dhdr_all)(const double *, double *);
   int (*point_in_element)(element_t *, const double *);
   double (*element_volume)(element_t *);
   
@@ -2297,8 +2719,17 @@ struct mesh_post_t {
     post_format_fromextension,
     post_format_gmsh,
     post_format_vtk,
+    post_format_vtu,
   } format;
 
+  // codificacion de los datos binarios de vtu y si se escriben en otro thread
+  enum {
+    post_encoding_raw,
+    post_encoding_zlib,
+  } encoding;
+  int async;
+  mesh_vtu_t *vtu;
+
   int no_physical_names;
   centering_t centering;
   
@@ -2306,6 +2737,9 @@ struct mesh_post_t {
   int (*write_mesh)(mesh_t *, int, FILE *);
   int (*write_scalar)(mesh_post_t *, function_t *, centering_t);
   int (*write_vector)(mesh_post_t *, function_t **, centering_t);
+  // si no es NULL escribe todos los campos de una pasada en lugar de los dos de arriba
+  int (*write_fields)(mesh_post_t *);
+  int binary;
   
   // estos dos son para saber si tenemos que cambiar de tipo en VTK
   int point_init;
@@ -2367,6 +2801,23 @@ struct mesh_integrate_t {
   mesh_integrate_t *next;
 };
 
+struct mesh_transfer_t {
+  function_t *function;       // source function defined over the nodes of a mesh
+  mesh_t *mesh;               // target mesh
+  vector_t *vector;           // where the transferred values go
+  centering_t centering;
+  
+  // sparse interpolation operator in compressed-row form:
+  // value[i] = sum_{k=row[i]}^{row[i+1]-1} weight[k] * data_value[col[k]]
+  int built;
+  int n_rows;
+  int *row;
+  int *col;
+  double *weight;
+
+  mesh_transfer_t *next;
+};
+
 // mesh.c
 extern element_t *mesh_find_element(mesh_t *, node_t *, const double *);
 extern node_t *mesh_find_nearest_node(mesh_t *, const double *);
@@ -2400,9 +2851,12 @@ extern void mesh_init_fem_objects(mesh_t *mesh);
 // gmsh.c
 extern int mesh_gmsh_readmesh(mesh_t *);
 extern int mesh_gmsh_write_header(FILE *);
+extern int mesh_gmsh_write_header_binary(FILE *);
 extern int mesh_gmsh_write_mesh(mesh_t *, int, FILE *);
+extern int mesh_gmsh_write_mesh_binary(mesh_t *, int, FILE *);
 extern int mesh_gmsh_write_scalar(mesh_post_t *, function_t *, centering_t);
 extern int mesh_gmsh_write_vector(mesh_post_t *, function_t **, centering_t);
+extern int mesh_gmsh_write_fields(mesh_post_t *);
 extern int mesh_gmsh_update_function(function_t *, double, double);
 
 // frd.c
@@ -2416,12 +2870,25 @@ extern int mesh_vtk_write_unstructured_mesh(mesh_t *, FILE *);
 extern int mesh_vtk_write_scalar(mesh_post_t *, function_t *, centering_t);
 extern int mesh_vtk_write_vector(mesh_post_t *, function_t **, centering_t);
 extern int mesh_vtk_readmesh(mesh_t *);
+extern int vtkfromgmsh_types[NUMBER_ELEMENT_TYPE];
+extern int hexa20fromgmsh[20];
+extern int hexa27fromgmsh[27];
+
+// vtu.c
+extern int mesh_vtu_write_scalar(mesh_post_t *, function_t *, centering_t);
+extern int mesh_vtu_write_vector(mesh_post_t *, function_t **, centering_t);
+extern int mesh_vtu_write_step(mesh_post_t *);
+extern void mesh_vtu_finalize(void);
 
 // init.c
 extern int wasora_mesh_init_before_parser(void);
 extern void wasora_mesh_add_node_parent(node_relative_t **, int);
 extern void wasora_mesh_compute_coords_from_parent(element_type_t *, int);
 
+// transfer.c
+extern int mesh_transfer_build(mesh_transfer_t *);
+extern void mesh_transfer_free(mesh_transfer_t *);
+
 // interpolate.c
 extern double mesh_interpolate_function_node(function_t *, const double *);
 extern double mesh_interpolate_function_cell(function_t *, const double *);
@@ -2482,6 +2949,8 @@ extern int wasora_mesh_struct_find_cell(int, double *, double *, double);
 extern int mesh_one_node_point_init(void);
 extern double mesh_one_node_point_h(int, double *);
 extern double mesh_one_node_point_dhdr(int, int, double *);
+extern void mesh_one_node_point_h_all(const double *, double *);
+extern void mesh_one_node_point_dhdr_all(const double *, double *);
 extern double mesh_point_vol(element_t *);
 
 
@@ -2489,6 +2958,8 @@ extern double mesh_point_vol(element_t *);
 extern int mesh_line2_init(void);
 extern double mesh_line2_h(int, double *);
 extern double mesh_line2_dhdr(int, int, double *);
+extern void mesh_line2_h_all(const double *, double *);
+extern void mesh_line2_dhdr_all(const double *, double *);
 
 extern int mesh_point_in_line(element_t *, const double *);
 extern double mesh_line_vol(element_t *);
@@ -2501,11 +2972,15 @@ extern void mesh_gauss_init_line3(element_type_t *, gauss_t *);
 extern int mesh_line3_init(void);
 extern double mesh_line3_h(int, double *);
 extern double mesh_line3_dhdr(int, int, double *);
+extern void mesh_line3_h_all(const double *, double *);
+extern void mesh_line3_dhdr_all(const double *, double *);
 
 // triang3.c
 extern int mesh_triang3_init(void);
 extern double mesh_triang3_h(int, double *);
 extern double mesh_triang3_dhdr(int, int, double *);
+extern void mesh_triang3_h_all(const double *, double *);
+extern void mesh_triang3_dhdr_all(const double *, double *);
 extern int mesh_point_in_triangle(element_t *, const double *);
 extern double mesh_triang_vol(element_t *);
 
@@ -2517,11 +2992,15 @@ extern void mesh_gauss_init_triang3(element_type_t *, gauss_t *);
 extern int mesh_triang6_init(void);
 extern double mesh_triang6_h(int, double *);
 extern double mesh_triang6_dhdr(int, int, double *);
+extern void mesh_triang6_h_all(const double *, double *);
+extern void mesh_triang6_dhdr_all(const double *, double *);
 
 // quad4.c
 extern int mesh_quad4_init(void);
 extern double mesh_quad4_h(int, double *);
 extern double mesh_quad4_dhdr(int, int, double *);
+extern void mesh_quad4_h_all(const double *, double *);
+extern void mesh_quad4_dhdr_all(const double *, double *);
 
 extern void mesh_gauss_init_quad1(element_type_t *, gauss_t *);
 extern void mesh_gauss_init_quad4(element_type_t *, gauss_t *);
@@ -2534,16 +3013,22 @@ extern double mesh_quad_vol(element_t *);
 extern int mesh_quad8_init(void);
 extern double mesh_quad8_h(int , double *);
 extern double mesh_quad8_dhdr(int , int , double *);
+extern void mesh_quad8_h_all(const double *, double *);
+extern void mesh_quad8_dhdr_all(const double *, double *);
 
 // quad9.c
 extern int mesh_quad9_init(void);
 extern double mesh_quad9_h(int , double *);
 extern double mesh_quad9_dhdr(int , int , double *);
+extern void mesh_quad9_h_all(const double *, double *);
+extern void mesh_quad9_dhdr_all(const double *, double *);
 
 // hexahedron8.c
 extern int mesh_hexa8_init(void);
 extern double mesh_hexa8_h(int, double *);
 extern double mesh_hexa8_dhdr(int, int, double *);
+extern void mesh_hexa8_h_all(const double *, double *);
+extern void mesh_hexa8_dhdr_all(const double *, double *);
 
 extern void mesh_gauss_init_hexa1(element_type_t *, gauss_t *);
 extern void mesh_gauss_init_hexa8(element_type_t *, gauss_t *);
@@ -2556,16 +3041,22 @@ extern double mesh_hexahedron_vol(element_t *);
 extern int mesh_hexa20_init(void);
 extern double mesh_hexa20_h(int, double *);
 extern double mesh_hexa20_dhdr(int, int, double *);
+extern void mesh_hexa20_h_all(const double *, double *);
+extern void mesh_hexa20_dhdr_all(const double *, double *);
 
 // hexahedron27.c
 extern int mesh_hexa27_init(void);
 extern double mesh_hexa27_h(int, double *);
 extern double mesh_hexa27_dhdr(int, int, double *);
+extern void mesh_hexa27_h_all(const double *, double *);
+extern void mesh_hexa27_dhdr_all(const double *, double *);
 
 // tet4.c
 extern int mesh_tet4_init(void);
 extern double mesh_tet4_h(int, double *);
 extern double mesh_tet4_dhdr(int, int, double *);
+extern void mesh_tet4_h_all(const double *, double *);
+extern void mesh_tet4_dhdr_all(const double *, double *);
 extern int mesh_point_in_tetrahedron(element_t *, const double *);
 extern double mesh_tetrahedron_vol(element_t *);
 
@@ -2576,6 +3067,8 @@ extern void mesh_gauss_init_tet4(element_type_t *, gauss_t *);
 extern int mesh_tet10_init(void);
 extern double mesh_tet10_h(int, double *);
 extern double mesh_tet10_dhdr(int, int, double *);
+extern void mesh_tet10_h_all(const double *, double *);
+extern void mesh_tet10_dhdr_all(const double *, double *);
 
 
 // prism6.c
@@ -2583,6 +3076,8 @@ extern int mesh_prism6_init(void);
 extern void mesh_prism_gauss6_init(element_type_t *);
 extern double mesh_prism6_h(int, double *);
 extern double mesh_prism6_dhdr(int, int, double *);
+extern void mesh_prism6_h_all(const double *, double *);
+extern void mesh_prism6_dhdr_all(const double *, double *);
 extern int mesh_point_in_prism(element_t *, const double *);
 extern double mesh_prism_vol(element_t *);
 
@@ -2590,6 +3085,8 @@ extern double mesh_prism_vol(element_t *);
 extern int mesh_prism15_init(void);
 extern double mesh_prism15_h(int, double *);
 extern double mesh_prism15_dhdr(int, int, double *);
+extern void mesh_prism15_h_all(const double *, double *);
+extern void mesh_prism15_dhdr_all(const double *, double *);
 
 // geom.c
 extern void mesh_subtract(const double *, const double *, double *);
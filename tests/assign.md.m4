@@ -0,0 +1,17 @@
+# Vector and matrix assignments
+
+An assignment to a vector or a matrix resolves once everything that does not depend on the element, such as index ranges and competing `_0` assignments, and then writes the elements in a single loop. This input builds a tridiagonal matrix with ranges that keep the indices within bounds, fills a non-square matrix to check the row-major layout and assigns vectors over partial ranges and against an `_0` assignment.
+
+## Input file
+
+~~~wasora
+include(assign.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora assign.was
+include(assign.txt)
+$
+~~~
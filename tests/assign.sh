@@ -0,0 +1,25 @@
+#!/bin/bash
+# assign whole vectors and matrices, with and without index ranges
+. locateruntest.sh
+
+# remove stale output file
+output="assign.txt"
+rm -rf ${output}
+
+runwasora assign.was | tee ${output}
+
+# compare the elements against the values they have to take
+awk 'BEGIN {
+       expected[1] = "2 -1 -1 0 -1 -1 2"
+       expected[2] = "12 43 31"
+       expected[3] = "0 9 16 0"
+       expected[4] = "-1 -3 40 60"
+     }
+     {$1 = $1; err += ($0 != expected[NR])}
+     END {exit err + (NR != 4)}' ${output}
+outcome=$?
+
+m4 quotes.m4 assign.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,17 @@
+# Multilinear interpolation over rectangular grids
+
+When the definition points of a function form a rectangular grid, `bilinear` interpolation locates the cell along each uniform axis by index arithmetic and along each non-uniform axis by bisection. Two and three-dimensional functions add up the corners with unrolled sums and higher dimensions go through a generic loop. Multilinear interpolation has to reproduce multilinear polynomials exactly, inside the cells, on the nodes and on the upper faces of the grids.
+
+## Input file
+
+~~~wasora
+include(bilinear.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora bilinear.was
+include(bilinear.txt)
+$
+~~~
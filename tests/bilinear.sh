@@ -0,0 +1,17 @@
+#!/bin/bash
+# interpolate bilinear and trilinear data over uniform and non-uniform rectangular grids
+. locateruntest.sh
+
+# remove stale output file
+output="bilinear.txt"
+rm -rf ${output}
+
+# all the errors should be zero up to round-off
+runwasora bilinear.was | tee ${output}
+awk '{for (i = 1; i <= NF; i++) err += ($i > 1e-9)} END {exit err + (NR != 3)}' ${output}
+outcome=$?
+
+m4 quotes.m4 bilinear.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
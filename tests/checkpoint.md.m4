@@ -0,0 +1,21 @@
+# Checkpoint and restart
+
+`CHECKPOINT` saves the whole state of a transient at the end of the step it is executed in, including the internal state of functions such as `random_gauss`, `lag` and `integral_dt`, the `HISTORY` functions and the size of the output files. Running the same input with `--restart` continues from the step that follows the last checkpoint, cutting the output files back to where they were, so the final output is the same as the one of a run that was never interrupted.
+
+## Input file
+
+~~~wasora
+include(checkpoint.was)
+~~~
+
+## Execution
+
+~~~
+$ echo "stop = 5" > checkpoint-stop.was
+$ wasora checkpoint.was
+$ echo "stop = 100" > checkpoint-stop.was
+$ wasora --restart checkpoint.was
+$ tail -3 checkpoint.dat
+esyscmd(tail -3 checkpoint.dat)
+$
+~~~
@@ -0,0 +1,30 @@
+#!/bin/bash
+# run a whole transient in one go and then stop it halfway and
+# continue it with --restart, the outputs should be the same
+. locateruntest.sh
+
+# remove stale output files
+rm -f checkpoint.was.chk checkpoint.dat checkpoint-full.dat checkpoint-stop.was
+
+# the stop time comes from an included file so the checkpoint,
+# which is keyed by the main input file, stays valid
+echo "stop = 100" > checkpoint-stop.was
+runwasora checkpoint.was
+mv checkpoint.dat checkpoint-full.dat
+rm -f checkpoint.was.chk
+
+echo "stop = 5" > checkpoint-stop.was
+runwasora checkpoint.was
+echo "stop = 100" > checkpoint-stop.was
+runwasora --restart checkpoint.was
+
+if [ -s checkpoint.was.chk ] && [ `wc -l < checkpoint-full.dat` = 21 ] && diff checkpoint-full.dat checkpoint.dat; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 checkpoint.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,17 @@
+# Cubature of nested integrals
+
+When the integrand of `integral` is another `integral` and none of the limits depend on the integration variables, the whole chain is computed as a single multidimensional integral over a hyper-rectangle with an adaptive Genz-Malik cubature. Its rule is exact for polynomials up to seventh order. Otherwise, the integrals are nested one inside the other.
+
+## Input file
+
+~~~wasora
+include(cubature.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora cubature.was
+include(cubature.txt)
+$
+~~~
@@ -0,0 +1,21 @@
+#!/bin/bash
+# integrate polynomials with nested integrals
+. locateruntest.sh
+
+# remove stale output files
+rm -f cubature.txt
+
+runwasora cubature.was | tee cubature.txt
+
+# one line per step and all the integrals should be exact
+if [ `wc -l < cubature.txt` = 3 ] && \
+   awk '{for (i = 1; i <= NF; i++) err += ($i > 1e-10)} END {exit err}' cubature.txt; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 cubature.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,17 @@
+# Dense output
+
+With a non-zero `output_dt` the DAE solver takes steps as large as the error bounds allow and the solution is interpolated to the output times with the solver’s own polynomial. The instructions after the DAE block, such as `PRINT`, are executed only at those times, which have to be exactly every `output_dt` and where the solution has to match the exact one within the tolerance of the solver. A `TIME_PATH` entry in the middle of an output interval marks a jump in the decay rate, and the solver has to stop exactly there instead of stepping across it.
+
+## Input file
+
+~~~wasora
+include(dense.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora dense.was
+include(dense.txt)
+$
+~~~
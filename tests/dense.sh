@@ -0,0 +1,22 @@
+#!/bin/bash
+# integrate an ode printing the interpolated solution at fixed output times
+. locateruntest.sh
+checkida
+
+# remove stale output file
+output="dense.txt"
+rm -rf ${output}
+
+runwasora dense.was | tee ${output}
+
+# the output times go every 0.1 up to the TIME_PATH entry
+# and every 0.1 from there, with the exact solution at all of them
+awk 'BEGIN {split("0 0.1 0.2 0.3 0.4 0.5 0.55 0.65 0.75 0.85 0.95 1", times, " ")}
+     {err += (($1-times[NR])^2 > 1e-20 || $3 > 1e-4)}
+     END {exit err + (NR != 12)}' ${output}
+outcome=$?
+
+m4 quotes.m4 dense.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
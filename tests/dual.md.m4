@@ -0,0 +1,17 @@
+# Derivatives with dual numbers
+
+When neither the step nor the stencil are given, the functional `derivative` evaluates the expression with dual numbers and obtains the exact derivative in a single pass. The same machinery gives the Jacobians used by `SOLVE`, `FIT`, `MINIMIZE` and the DAE solver. This input compares the exact derivatives of a few expressions against finite differences and solves a system with a derivative-based method.
+
+## Input file
+
+~~~wasora
+include(dual.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora dual.was
+include(dual.txt)
+$
+~~~
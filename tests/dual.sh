@@ -0,0 +1,17 @@
+#!/bin/bash
+# compare the derivatives computed with dual numbers against finite differences
+. locateruntest.sh
+
+# remove stale output file
+output="dual.txt"
+rm -rf ${output}
+
+# all the differences should be small
+runwasora dual.was | tee ${output}
+awk '{for (i = 1; i <= NF; i++) err += ($i > 1e-6)} END {exit err}' ${output}
+outcome=$?
+
+m4 quotes.m4 dual.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,17 @@
+# Events
+
+An `EVENT` asks the DAE solver to stop exactly where an expression crosses zero. The instructions run there and the solver restarts from whatever state they leave. Here the decay rate of $\dot{a} = -k a$ goes from one to three when $a$ falls below one half, so both the instant of the change and the final value can be compared with the exact solution.
+
+## Input file
+
+~~~wasora
+include(event.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora event.was
+include(event.txt)
+$
+~~~
@@ -0,0 +1,20 @@
+#!/bin/bash
+# change a parameter of an ode when the solution crosses a threshold
+# located by the rootfinding of the DAE solver
+. locateruntest.sh
+checkida
+
+# remove stale output file
+output="event.txt"
+rm -rf ${output}
+
+runwasora event.was | tee ${output}
+
+# both the time of the event and the final state should be accurate
+awk '{err += ($1 > 1e-6 || $2 > 1e-4)} END {exit err + (NR != 1)}' ${output}
+outcome=$?
+
+m4 quotes.m4 event.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
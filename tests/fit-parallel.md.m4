@@ -0,0 +1,18 @@
+# Concurrent fit
+
+The model depends on a variable computed in the main loop, so the numerical gradient needs the main loop to be re-run with each parameter perturbed. With `MAX_DAUGHTERS` these runs are forked and executed concurrently. Since the children compute exactly the same values as the sequential runs, both fits have to go through the same iterations and end at the same parameters, which are the ones the data was generated with.
+
+## Input file
+
+~~~wasora
+include(fit-parallel.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora fit-parallel.was 1
+$ wasora fit-parallel.was 4
+include(fit-parallel-4.txt)
+$
+~~~
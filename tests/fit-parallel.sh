@@ -0,0 +1,23 @@
+#!/bin/bash
+# fit a model whose gradient needs re-running the main loop,
+# once sequentially and once with the perturbed runs forked
+. locateruntest.sh
+
+# remove stale output files
+rm -f fit-parallel-1.txt fit-parallel-4.txt
+
+runwasora fit-parallel.was 1 | tee fit-parallel-1.txt
+runwasora fit-parallel.was 4 | tee fit-parallel-4.txt
+
+# both fits have to take the same iterations to the same parameters
+if diff fit-parallel-1.txt fit-parallel-4.txt && \
+   awk '{err += (abs($1-2) > 1e-5 || abs($2-0.5) > 1e-5)} END {exit err + (NR != 1)} function abs(x) {return x < 0 ? -x : x}' fit-parallel-4.txt; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 fit-parallel.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,17 @@
+# Conditional blocks
+
+The instructions are run from a flat array where each `IF` already knows the index of the first instruction of both of its branches, and `ELSE` and `ENDIF` are plain jumps. This input nests `IF` blocks inside both branches of other blocks, leaves an `ELSE` empty and closes the input with a conditional block, so every kind of jump is taken at least once over the twelve steps.
+
+## Input file
+
+~~~wasora
+include(flow.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora flow.was
+include(flow.txt)
+$
+~~~
@@ -0,0 +1,24 @@
+#!/bin/bash
+# run nested conditional blocks through the precomputed jumps
+. locateruntest.sh
+
+# remove stale output file
+output="flow.txt"
+rm -rf ${output}
+
+runwasora flow.was | tee ${output}
+
+# each line has to follow the branches taken for n and the last one closes the run
+awk 'NF == 4 {
+       a = ($1 % 2 == 0)
+       b = a ? (($1 % 3 == 0) ? 6 : 2) : (($1 % 3 == 0) ? 3 : 0)
+       c = ($1 > 9) ? 2 : (($1 > 6) ? 1 : 0)
+       err += ($1 != NR || $2 != a || $3 != b || $4 != c)
+     }
+     END {exit err + (NR != 13) + ($0 != "done")}' ${output}
+outcome=$?
+
+m4 quotes.m4 flow.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
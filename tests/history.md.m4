@@ -0,0 +1,17 @@
+# Bounded histories
+
+`HISTORY` records the values a variable takes at each time step and defines a function of time that interpolates them. With `WINDOW`, only the points of the last `WINDOW` units of time (plus the one right before) are kept. With `MAX_POINTS`, at most that number of points are kept. Either way, a bounded history returns its oldest kept value when evaluated before it.
+
+## Input file
+
+~~~wasora
+include(history.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora history.was
+include(history.txt)
+$
+~~~
@@ -0,0 +1,20 @@
+#!/bin/bash
+# record a linear signal with HISTORY, WINDOW and MAX_POINTS
+. locateruntest.sh
+
+# remove stale output files
+rm -f history.txt
+
+runwasora history.was | tee history.txt
+
+if [ `wc -l < history.txt` = 1 ] && \
+   awk '{exit !($1 == 10 && $2 == 28 && $3 == 28 && $4 == 28 && $5 == 16 && $6 == 25 && $7 == 26.5)}' history.txt; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 history.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,18 @@
+# Native code for expressions
+
+With `--jit`, the expressions of assignments, conditional blocks, algebraic functions and DAE residuals are translated to C, compiled into a shared object with the system compiler (`$CC` or `cc`) and called instead of being interpreted. The objects are kept in `$WASORA_JIT_CACHE`, `$XDG_CACHE_HOME/wasora` or `~/.cache/wasora`, which have to belong to the user. Without a compiler or such a directory the expressions are just interpreted. Either way the results are the same.
+
+## Input file
+
+~~~wasora
+include(jit.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora --jit jit.was
+esyscmd(head jit-1.txt)
+[...]
+$
+~~~
@@ -0,0 +1,31 @@
+#!/bin/bash
+# run the same input interpreted and with --jit twice, the
+# second time the compiled object comes from the cache
+. locateruntest.sh
+
+if [ -z "`which ${CC:-cc}`" ]; then
+ echo "there is no C compiler, skipping test"
+ exit 77
+fi
+
+# remove stale output files and use a private cache
+rm -rf jit-interp.txt jit-1.txt jit-2.txt jit-dir
+export WASORA_JIT_CACHE=`pwd`/jit-dir
+
+runwasora jit.was > jit-interp.txt
+runwasora --jit jit.was > jit-1.txt
+runwasora --jit jit.was > jit-2.txt
+
+# the three outputs should be the same, there should be one
+# compiled object and no temporary files left behind
+if [ -s jit-interp.txt ] && diff jit-interp.txt jit-1.txt && diff jit-interp.txt jit-2.txt && \
+   [ `ls jit-dir/wasora-jit-*.so | wc -l` = 1 ] && [ `ls jit-dir | wc -l` = 1 ]; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 jit.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
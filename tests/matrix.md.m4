@@ -0,0 +1,17 @@
+# Dense linear algebra
+
+`MATRIX_MULTIPLY`, `MATRIX_TRANSPOSE`, `MATRIX_SOLVE` and `VECTOR_AXPY` work directly on the storage of matrices and vectors. The factorization of a `CONST` matrix is computed only once per run, so a parametric study that changes the matrix from one run to the next still gets the right solution.
+
+## Input file
+
+~~~wasora
+include(matrix.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora matrix.was
+include(matrix.txt)
+$
+~~~
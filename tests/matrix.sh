@@ -0,0 +1,22 @@
+#!/bin/bash
+# solve the same linear system with a constant matrix that changes
+# from one parametric run to the next and check the residuals
+. locateruntest.sh
+
+# remove stale output files
+rm -f matrix.txt
+
+runwasora matrix.was | tee matrix.txt
+
+# there should be one line per run and all the errors should be small
+if [ `wc -l < matrix.txt` = 3 ] && \
+   awk '{err += ($2 > 1e-9) + ($3 > 1e-9) + ($4 > 1e-9)} END {exit err}' matrix.txt; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 matrix.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
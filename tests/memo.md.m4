@@ -0,0 +1,43 @@
+# Memoization of outer-loop runs
+
+With `--memo=file`, the results of each run of `PARAMETRIC`, `FIT` or `MINIMIZE` are stored keyed by the values of the parameters and kept in `file` so a later invocation with the same input can skip the runs that were already done. The key also covers the identity, size and modification time of the data files the input reads, so touching one of them makes the runs be done again. For `FIT` and `MINIMIZE` the last run, the one with `done_outer` equal to one, is always executed because it is the one meant to print the results. A memoized `PARAMETRIC` point does not run either but it prints again what it printed the first time. Only the points whose run is a single static step are memoized.
+
+## Input file
+
+~~~wasora
+include(memo.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora --memo=memo.dat memo.was
+include(memo-1.txt)
+$ wasora --memo=memo.dat memo.was
+include(memo-2.txt)
+$
+~~~
+
+## Parametric input file
+
+~~~wasora
+include(memo-parametric.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora --memo=memo-parametric.dat memo-parametric.was
+include(memo-parametric-1.txt)
+$ wasora --memo=memo-parametric.dat memo-parametric.was
+include(memo-parametric-2.txt)
+$
+~~~
+
+After writing other values into `memo-data.dat` the points are computed again:
+
+~~~
+$ wasora --memo=memo-parametric.dat memo-parametric.was
+include(memo-parametric-4.txt)
+$
+~~~
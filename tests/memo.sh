@@ -0,0 +1,45 @@
+#!/bin/bash
+# run the same minimization twice, the second time all the runs but the
+# last one come from the memoization file written by the first one
+. locateruntest.sh
+
+# remove stale output files
+rm -f memo.dat memo-1.txt memo-2.txt memo-parametric.dat memo-parametric-*.txt memo-data.dat memo-stamp
+
+runwasora --memo=memo.dat memo.was | tee memo-1.txt
+runwasora --memo=memo.dat memo.was | tee memo-2.txt
+
+# a sweep over a data file, run twice so the second time every point is a hit
+printf "1 1\n2 4\n3 9\n4 16\n5 25\n" > memo-data.dat
+runwasora --memo=memo-parametric.dat memo-parametric.was | tee memo-parametric-1.txt
+runwasora --memo=memo-parametric.dat memo-parametric.was | tee memo-parametric-2.txt
+
+# other data with the same size and modification time in the same file still
+# gives the stored points, but touching the file makes them run again
+touch -r memo-data.dat memo-stamp
+printf "1 2\n2 5\n3 8\n4 17\n5 26\n" > memo-data.dat
+touch -r memo-stamp memo-data.dat
+runwasora --memo=memo-parametric.dat memo-parametric.was | tee memo-parametric-3.txt
+touch -t 200001010000 memo-data.dat
+runwasora --memo=memo-parametric.dat memo-parametric.was | tee memo-parametric-4.txt
+
+# both results should be the same and close to the minimum at (1,2),
+# the memo file should have been written, the memoized sweeps should print
+# the five points they printed the first time and the last one the new data
+if [ -s memo.dat ] && diff memo-1.txt memo-2.txt && \
+   awk '{err += (sqrt(($1-1)^2 + ($2-2)^2) > 1e-3)} END {exit err}' memo-2.txt && \
+   [ `wc -l < memo-parametric-1.txt` = 5 ] && \
+   diff memo-parametric-1.txt memo-parametric-2.txt && \
+   diff memo-parametric-1.txt memo-parametric-3.txt && \
+   awk '{err += ($2 != $1^2)} END {exit (NR != 5) || err}' memo-parametric-1.txt && \
+   awk 'BEGIN {split("2 5 8 17 26", y)} {err += ($2 != y[NR])} END {exit (NR != 5) || err}' memo-parametric-4.txt && \
+   [ "`stat -c %a memo.dat`" = 600 ]; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 memo.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
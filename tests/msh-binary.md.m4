@@ -0,0 +1,22 @@
+# Binary MSH read-back
+
+A linear nodal function over a mesh of quadrangles is written with `MESH_POST ... BINARY` as a binary MSH 2.2 file, which is then read back with `READ_FUNCTION`. The area of the domain, the integral of the function and its value at a node have to match the exact values.
+
+## Input files
+
+~~~wasora
+include(msh-binary.was)
+~~~
+
+~~~wasora
+include(msh-binary-read.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora msh-binary.was
+$ wasora msh-binary-read.was
+include(msh-binary.txt)
+$
+~~~
@@ -0,0 +1,23 @@
+#!/bin/bash
+# write a mesh with a nodal function in binary msh 2.2
+# and then read both of them back
+. locateruntest.sh
+
+# remove stale output files
+rm -f msh-binary.msh msh-binary.txt
+
+runwasora msh-binary.was
+runwasora msh-binary-read.was | tee msh-binary.txt
+
+# the area, the integral and a nodal value should match
+if [ -e msh-binary.msh ] && [ `wc -l < msh-binary.txt` = 1 ] && \
+   awk '{for (i = 1; i <= NF; i++) err += ($i > 1e-12)} END {exit err}' msh-binary.txt; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 msh-binary.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,19 @@
+# Multi-start minimization
+
+The function has a local minimum next to the initial guess and the global one on the other side of the box. With `MULTISTART` the local searches start from quasi-random points of the `MIN`-`MAX` box instead of the guess, and the variables are left at the best minimum found. The search is run once sequentially and once with up to four local searches forked at the same time, and both have to reach the global minimum.
+
+## Input file
+
+~~~wasora
+include(multistart.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora multistart.was 1
+include(multistart-1.txt)
+$ wasora multistart.was 4
+include(multistart-4.txt)
+$
+~~~
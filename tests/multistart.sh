@@ -0,0 +1,23 @@
+#!/bin/bash
+# find the global minimum of a function with two basins through a
+# multi-start search, both sequentially and with forked local searches
+. locateruntest.sh
+
+# remove stale output files
+rm -f multistart-1.txt multistart-4.txt
+
+runwasora multistart.was 1 | tee multistart-1.txt
+runwasora multistart.was 4 | tee multistart-4.txt
+
+# both searches have to end at the global minimum
+if cat multistart-1.txt multistart-4.txt | \
+   awk '{err += (sqrt(($1+1.035579)^2 + $2^2) > 1e-3 || $3 > -0.3054)} END {exit err + (NR != 2)}'; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 multistart.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,19 @@
+# Runtime profile
+
+With `--profile`, wasora times every instruction, function and functional and writes two reports at exit. The file `input.profile` lists the number of calls and the total and self times of each one sorted by self time. The file `input.folded` has one line per call path with its self time in microseconds, which can be fed to `flamegraph.pl`.
+
+## Input file
+
+~~~wasora
+include(profile.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora --profile profile.was
+[...]
+$ grep algebraic profile.was.folded
+esyscmd(grep algebraic profile.was.folded)
+$
+~~~
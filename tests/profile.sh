@@ -0,0 +1,24 @@
+#!/bin/bash
+# profile a small input and check both reports
+. locateruntest.sh
+
+# remove stale output files
+rm -f profile.was.profile profile.was.folded
+
+runwasora --profile profile.was
+
+# the report should list the function, the folded stacks should have
+# two columns per line and the function should appear nested
+if [ -s profile.was.profile ] && [ -s profile.was.folded ] && \
+   grep -q "algebraic function f" profile.was.profile && \
+   awk 'NF != 2 {err++} END {exit err}' profile.was.folded && \
+   grep -q "functional_integral;algebraic_function_f " profile.was.folded; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 profile.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,17 @@
+# Interpolation over structured grids
+
+When the definition points of a two or three-dimensional function form a structured grid, `bilinear` interpolation goes straight to the cell by index arithmetic and `bicubic` interpolation uses tensor-product cubic splines whose coefficients are computed once. If the data come from vectors, the coefficients are computed again only when the vectors change. This input checks that both schemes reproduce the polynomials they are exact for, before and after the vectors are re-assigned.
+
+## Input file
+
+~~~wasora
+include(rectangular.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora rectangular.was
+include(rectangular.txt)
+$
+~~~
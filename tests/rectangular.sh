@@ -0,0 +1,17 @@
+#!/bin/bash
+# interpolate functions whose data come from vectors over a structured grid
+. locateruntest.sh
+
+# remove stale output file
+output="rectangular.txt"
+rm -rf ${output}
+
+# all the errors should be zero up to round-off
+runwasora rectangular.was | tee ${output}
+awk '{for (i = 1; i <= NF; i++) err += ($i > 1e-9)} END {exit err + (NR != 2)}' ${output}
+outcome=$?
+
+m4 quotes.m4 rectangular.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -47,3 +47,11 @@ function checkida {
   exit 77
  fi
 }
+
+# checks if wasora is compiled with idas and skips the test if necessary
+function checkidas {
+ if [ `${wasorabin} -i | grep IDAS | wc -l` = 0 ]; then
+  echo "wasora was not compiled with IDAS, skipping test"
+  exit 77
+ fi
+}
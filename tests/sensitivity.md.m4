@@ -0,0 +1,25 @@
+# Forward sensitivities
+
+With `SENSITIVITIES`, the DAE system is integrated by IDAS together with the derivatives of the phase space with respect to the arguments of the minimized function. As all the residuals can be differentiated with dual numbers, the right-hand side of the sensitivity equations is exact and the gradient of the function is obtained by the chain rule from a single run. This input finds the rate\ $k$ such that the solution of\ $\dot{a} = -k \cdot a$ with\ $a(0)=1$ is equal to\ $e^{-2}$ at\ $t=1$, and compares both the solution and its sensitivity with the analytical ones.
+
+The second input reads the solution at\ $t=1/2$ through a `HISTORY` instead. The chain rule through the phase space at the end of the transient cannot follow it, so the gradient has to be computed with finite differences and the minimizer still has to find $k=2$ instead of stopping at the initial guess.
+
+## Input files
+
+~~~wasora
+include(sensitivity.was)
+~~~
+
+~~~wasora
+include(sensitivity-history.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora sensitivity.was
+include(sensitivity.txt)
+$ wasora sensitivity-history.was
+include(sensitivity-history.txt)
+$
+~~~
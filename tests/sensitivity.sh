@@ -0,0 +1,23 @@
+#!/bin/bash
+# minimize a function of the solution of an ode using its exact sensitivities
+. locateruntest.sh
+checkidas
+
+# remove stale output files
+output="sensitivity.txt"
+rm -rf ${output} sensitivity-history.txt
+
+# the errors of the solution, of the sensitivity and of the parameter should be small
+runwasora sensitivity.was | tee ${output}
+awk '{for (i = 2; i <= NF; i++) err += ($i > 1e-3)} END {exit err}' ${output}
+outcome=$?
+
+# when the objective does not depend only on the final state the
+# minimizer should still move away from the guess and find k = 2
+runwasora sensitivity-history.was | tee sensitivity-history.txt
+awk '{err += ($1 > 1e-2)} END {exit err + (NR != 1)}' sensitivity-history.txt || outcome=99
+
+m4 quotes.m4 sensitivity.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
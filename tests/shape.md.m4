@@ -0,0 +1,17 @@
+# Shape functions at the gauss points
+
+The shape functions and their derivatives of each element type are evaluated at all the gauss points of each integration scheme at once when the mesh is read. Polynomials of low enough order have to be integrated exactly, i.e. up to $x^3 y^3$ with the $2\times 2$ gauss points of quadrangles and up to second order with the three points of triangles.
+
+## Input file
+
+~~~wasora
+include(shape.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora shape.was
+include(shape.txt)
+$
+~~~
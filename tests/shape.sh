@@ -0,0 +1,22 @@
+#!/bin/bash
+# integrate polynomials over meshes of quadrangles and triangles
+# using the shape functions evaluated at the gauss points
+. locateruntest.sh
+
+# remove stale output files
+rm -f shape.txt
+
+runwasora shape.was | tee shape.txt
+
+# all the integrals should be exact
+if [ `wc -l < shape.txt` = 1 ] && \
+   awk '{for (i = 1; i <= NF; i++) err += ($i > 1e-12)} END {exit err}' shape.txt; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 shape.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
@@ -0,0 +1,17 @@
+# Shepard interpolation with nearest neighbors
+
+The `shepard_knn` interpolation averages only the `SHEPARD_NEIGHBORS` definition points nearest to the evaluation point. A point closer than `INTERPOLATION_THRESHOLD` to a definition point gets its value. With `SHEPARD_CACHE`, the neighbors and weights of the last evaluation points are remembered so evaluating again at the same point is just a dot product with the data.
+
+## Input file
+
+~~~wasora
+include(shepard.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora shepard.was
+include(shepard.txt)
+$
+~~~
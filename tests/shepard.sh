@@ -0,0 +1,23 @@
+#!/bin/bash
+# evaluate a shepard_knn function right at, close to and away
+# from its definition points with and without the cache
+. locateruntest.sh
+
+# remove stale output files
+rm -f shepard.txt
+
+runwasora shepard.was | tee shepard.txt
+
+# the first line should be the data at (1,1) and (0,0) and something
+# interpolated (i.e. not zero) close to (0,0), the second one should be zero
+if [ `wc -l < shepard.txt` = 2 ] && \
+   awk 'NR == 1 {err += ($1 != 3) + ($2 != 0) + ($3 == 0)} NR == 2 {err += ($1 != 0)} END {exit err}' shepard.txt; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 shepard.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
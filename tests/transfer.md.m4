@@ -0,0 +1,17 @@
+# Transfer between meshes
+
+`MESH_TRANSFER` fills a vector with the values of a nodal function of a mesh at the nodes (or cells) of another mesh. The interpolation weights are computed the first time and reused afterwards, so the second step only multiplies them by the new data. Points outside the source mesh take the value of the nearest node (spatial derivatives are zero there).
+
+## Input file
+
+~~~wasora
+include(transfer.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora transfer.was
+include(transfer.txt)
+$
+~~~
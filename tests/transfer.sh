@@ -0,0 +1,22 @@
+#!/bin/bash
+# transfer functions from a mesh to another one and back
+. locateruntest.sh
+
+# remove stale output files
+rm -f transfer.txt
+
+runwasora transfer.was | tee transfer.txt
+
+# the transferred values are known exactly at each step
+if [ `wc -l < transfer.txt` = 2 ] && \
+   awk '{s = $1; split("1 3 6 4 1 3 6 4 3 6", v, " "); for (i = 1; i <= 10; i++) err += (abs($(i+1) - s*v[i]) > 1e-12)} END {exit err}
+        function abs(x) {return (x < 0) ? -x : x}' transfer.txt; then
+ outcome=0
+else
+ outcome=99
+fi
+
+m4 quotes.m4 transfer.md.m4 >> test-suite.md
+
+# exit
+exit $outcome
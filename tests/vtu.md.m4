@@ -0,0 +1,22 @@
+# VTU output
+
+`MESH_POST` writes XML VTK unstructured grids whose arrays are appended in binary form. A single file holds the nodal values of a linear function, which are read back from the raw appended data and compared to the exact ones. In a transient, each step goes to its own file and a `.pvd` index lists the times. The files written by the background thread with `ASYNC` have to be identical to the ones written from the main thread.
+
+## Input files
+
+~~~wasora
+include(vtu.was)
+~~~
+
+~~~wasora
+include(vtu-series.was)
+~~~
+
+## Execution
+
+~~~
+$ wasora vtu.was
+$ wasora vtu-series.was
+include(vtu.txt)
+$
+~~~
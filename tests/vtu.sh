@@ -0,0 +1,39 @@
+#!/bin/bash
+# write vtu files, both a single one and a time series indexed by a pvd
+. locateruntest.sh
+
+# remove stale output files
+rm -f vtu-static.vtu vtu-sync*.vtu vtu-sync.pvd vtu-async*.vtu vtu-async.pvd vtu.txt
+
+runwasora vtu.was
+runwasora vtu-series.was
+
+outcome=0
+
+# the raw appended data starts after the underscore with the UInt64 size
+# of the first array, that is the nodal function at the six nodes
+offset=`grep -abo '^   _' vtu-static.vtu | head -n1 | cut -d: -f1`
+if [ -z "${offset}" ]; then
+ outcome=99
+else
+ od -A n -v -t f8 -j $((offset + 4 + 8)) -N 48 vtu-static.vtu | tr -s ' ' '\n' | grep -v '^$' | tee vtu.txt
+ awk 'BEGIN {split("1 3 6 4 5 8", expected, " ")}
+      {err += ($1 != expected[NR])}
+      END {exit err + (NR != 6)}' vtu.txt || outcome=99
+fi
+grep -q 'NumberOfPoints="6" NumberOfCells="2"' vtu-static.vtu || outcome=99
+
+# three steps indexed in the pvd, and the background writer has to produce the same files
+for pvd in vtu-sync.pvd vtu-async.pvd; do
+ if [ ! -e ${pvd} ] || [ `grep -c '<DataSet' ${pvd}` != 3 ]; then
+  outcome=99
+ fi
+done
+for step in 000000 000001 000002; do
+ cmp vtu-sync-${step}.vtu vtu-async-${step}.vtu || outcome=99
+done
+
+m4 quotes.m4 vtu.md.m4 >> test-suite.md
+
+# exit
+exit $outcome